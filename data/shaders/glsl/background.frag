@@ -1,16 +1,25 @@
 #version 410 core
+// REDUCED_PRECISION: 1 samples in mediump, the lookup direction stays highp
+#ifndef REDUCED_PRECISION
+#define REDUCED_PRECISION 0
+#endif
+
+#if REDUCED_PRECISION
+#define MEDIUMP mediump
+#else
+#define MEDIUMP highp
+#endif
+
 layout (location = 0) out vec4 out_color;
 
 in vec3 pass_position;
 
-uniform samplerCube u_env_map;
+uniform MEDIUMP samplerCube u_env_map;
 
 void main()
 {
     vec3 uvw = pass_position;
-    vec3 env_color = textureLod(u_env_map, uvw, 0.0).rgb;
-    env_color = env_color / (env_color + vec3(1.0));
-    env_color = pow(env_color, vec3(1.0 / 2.2));
+    MEDIUMP vec3 env_color = textureLod(u_env_map, uvw, 0.0).rgb;
 
     out_color = vec4(env_color, 1.0);
 }
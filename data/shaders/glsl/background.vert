@@ -3,13 +3,15 @@ layout (location = 0) in vec3 in_position;
 
 out vec3 pass_position;
 
-struct PerFrameBuffer
+// same block as in pbr_model.vert
+layout (std140) uniform PerFrameBuffer
 {
     mat4 view;
     mat4 projection;
-};
-
-uniform PerFrameBuffer u_per_frame;
+    vec4 view_pos;
+    int tonemap;      // 0 copies the debug views as they are
+    float sharpness;  // of a target rendered below the window resolution, 0 disables it
+} u_per_frame;
 
 void main()
 {
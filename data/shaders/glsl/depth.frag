@@ -0,0 +1,6 @@
+#version 410 core
+// depth prepass, only the depth of pbr_model.vert is written
+
+void main()
+{
+}
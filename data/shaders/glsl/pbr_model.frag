@@ -1,6 +1,53 @@
 #version 410 core
 #define PI 3.14159265358979323846264338327950288
-#define MAX_LIGHT_COUNT 4
+
+// variant features, the renderer injects them right after #version
+// DEBUG_VIEW: 0 shaded, 1 albedo, 2 normal, 3 metallic, 4 roughness, 5 ao, 6 emissive
+#ifndef DEBUG_VIEW
+#define DEBUG_VIEW 0
+#endif
+// number of analytic point lights
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 0
+#endif
+// IBL_MODE: 0 no image based lighting, 1 split sum
+#ifndef IBL_MODE
+#define IBL_MODE 1
+#endif
+#ifndef HAS_ALBEDO_METALLIC_MAP
+#define HAS_ALBEDO_METALLIC_MAP 1
+#endif
+#ifndef HAS_NORMAL_ROUGHNESS_MAP
+#define HAS_NORMAL_ROUGHNESS_MAP 1
+#endif
+#ifndef HAS_EMISSIVE_AO_MAP
+#define HAS_EMISSIVE_AO_MAP 1
+#endif
+// VIRTUAL_TEXTURE: 1 the maps are page atlases addressed through u_page_table
+#ifndef VIRTUAL_TEXTURE
+#define VIRTUAL_TEXTURE 0
+#endif
+#ifndef MAX_REFLECTION_LOD
+#define MAX_REFLECTION_LOD 4.0
+#endif
+// REDUCED_PRECISION: 1 shades material and IBL terms in mediump (fp16 on mobile GPUs).
+// positions, uvs and the analytic light loop stay highp, the GGX lobe of a smooth surface
+// does not survive fp16. tool/precisionCheck measures the error against the highp path
+#ifndef REDUCED_PRECISION
+#define REDUCED_PRECISION 0
+#endif
+
+#if REDUCED_PRECISION
+#define MEDIUMP mediump
+#else
+#define MEDIUMP highp
+#endif
+// N and V feed NdotH of the light loop, they may only drop precision without lights
+#if REDUCED_PRECISION && LIGHT_COUNT == 0
+#define DIRECTIONP mediump
+#else
+#define DIRECTIONP highp
+#endif
 
 struct VS_OUT
 {
@@ -19,18 +66,67 @@ struct Light
     vec3 color;
 };
 
-uniform Light u_lights[MAX_LIGHT_COUNT];
+#if LIGHT_COUNT > 0
+uniform Light u_lights[LIGHT_COUNT];
+#endif
 
-uniform vec4 u_view_pos;
+// same block as in pbr_model.vert
+layout (std140) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    int tonemap;      // 0 copies the debug views as they are
+    float sharpness;  // of a target rendered below the window resolution, 0 disables it
+} u_per_frame;
 
 /// IBL
-uniform samplerCube u_irradiance_map;
-uniform samplerCube u_specular_map;
-uniform sampler2D u_brdf_lut;
-uniform sampler2D u_albedoMetallic;
-uniform sampler2D u_normalRoughness;
-uniform sampler2D u_emissiveAO;
-uniform int u_debug;
+#if IBL_MODE == 1
+uniform MEDIUMP samplerCube u_irradiance_map;
+uniform MEDIUMP samplerCube u_specular_map;
+uniform MEDIUMP sampler2D u_brdf_lut;
+#endif
+#if HAS_ALBEDO_METALLIC_MAP
+uniform MEDIUMP sampler2D u_albedoMetallic;
+#endif
+#if HAS_NORMAL_ROUGHNESS_MAP
+uniform MEDIUMP sampler2D u_normalRoughness;
+#endif
+#if HAS_EMISSIVE_AO_MAP
+uniform MEDIUMP sampler2D u_emissiveAO;
+#endif
+
+#if VIRTUAL_TEXTURE
+struct VirtualTexture
+{
+    vec2 pages;        // of level 0
+    float max_level;
+    float page_size;   // texels without the border
+    float border;
+    float atlas_size;  // texels
+};
+uniform VirtualTexture u_vt;
+// per level the atlas slot and level of the finest resident page
+uniform highp sampler2D u_page_table;
+
+// the page table is sampled at the level the texel footprint asks for, a missing page
+// falls back to the coarser page its entry points at. filtering is bilinear within a page
+vec2 VirtualToAtlas(vec2 uv)
+{
+    vec2 texels = uv * u_vt.pages * u_vt.page_size;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float level = clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, u_vt.max_level);
+    vec3 entry = floor(textureLod(u_page_table, uv, floor(level)).xyz * 255.0 + 0.5);
+    vec2 inPage = fract(uv * u_vt.pages / exp2(entry.z));
+    vec2 slot = entry.xy * (u_vt.page_size + 2.0 * u_vt.border);
+    return (slot + u_vt.border + inPage * u_vt.page_size) / u_vt.atlas_size;
+}
+
+#define SAMPLE_MAP(map) textureLod(map, atlasUV, 0.0)
+#else
+#define SAMPLE_MAP(map) texture(map, vs_pass.uv)
+#endif
 
 // NDF(n, h, alpha) = alpha^2 / (pi * ((n dot h)^2 * (alpha^2 - 1) + 1)^2)
 float DistributionGGX(in vec3 N, in vec3 H, float roughness)
@@ -74,7 +170,7 @@ vec3 FresnelSchlick(float cosTheta, in vec3 F0)
     return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
-vec3 FresnelSchlickRoughness(float cosTheta, in vec3 F0, float roughness)
+MEDIUMP vec3 FresnelSchlickRoughness(MEDIUMP float cosTheta, in MEDIUMP vec3 F0, MEDIUMP float roughness)
 {
     return F0 + (max(vec3(1.0 - roughness) - F0, vec3(0.0))) * pow(1.0 - cosTheta, 5.0);
 }
@@ -83,61 +179,64 @@ void main()
 {
     // variables
     vec3 position = vs_pass.position;
+#if VIRTUAL_TEXTURE
+    highp vec2 atlasUV = VirtualToAtlas(vs_pass.uv);
+#endif
 
-    vec4 albedoMetallic = texture(u_albedoMetallic, vs_pass.uv);
-    vec4 normalRoughness = texture(u_normalRoughness, vs_pass.uv);
-    vec4 emissiveAO = texture(u_emissiveAO, vs_pass.uv);
+#if HAS_ALBEDO_METALLIC_MAP
+    MEDIUMP vec4 albedoMetallic = SAMPLE_MAP(u_albedoMetallic);
+#else
+    MEDIUMP vec4 albedoMetallic = vec4(0.8, 0.8, 0.8, 0.0);
+#endif
+#if HAS_NORMAL_ROUGHNESS_MAP
+    MEDIUMP vec4 normalRoughness = SAMPLE_MAP(u_normalRoughness);
+#else
+    MEDIUMP vec4 normalRoughness = vec4(0.5, 0.5, 1.0, 0.5);
+#endif
+#if HAS_EMISSIVE_AO_MAP
+    MEDIUMP vec4 emissiveAO = SAMPLE_MAP(u_emissiveAO);
+#else
+    MEDIUMP vec4 emissiveAO = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
 
-    vec3 albedo = albedoMetallic.rgb;
-    float metallic = albedoMetallic.a;
-    float roughness = normalRoughness.a;
-    float ao = emissiveAO.a;
+    MEDIUMP vec3 albedo = albedoMetallic.rgb;
+    MEDIUMP float metallic = albedoMetallic.a;
+    MEDIUMP float roughness = normalRoughness.a;
+    MEDIUMP float ao = emissiveAO.a;
 
-    vec3 N = normalRoughness.rgb;
+#if HAS_NORMAL_ROUGHNESS_MAP
+    DIRECTIONP vec3 N = normalRoughness.rgb;
     N = 2.0 * N - 1.0;
     N = normalize(vs_pass.TBN * N);
+#else
+    DIRECTIONP vec3 N = normalize(vs_pass.TBN[2]);
+#endif
 
-    vec3 V = normalize(u_view_pos.xyz - position);
-    vec3 R = reflect(-V, N);
-
-    if (u_debug == 1)
-    {
-        out_color = vec4(albedo, 1.0);
-        return;
-    }
-    else if (u_debug == 2)
-    {
-        out_color = vec4(N, 1.0);
-        return;
-    }
-    else if (u_debug == 3)
-    {
-        out_color = vec4(vec3(metallic), 1.0);
-        return;
-    }
-    else if (u_debug == 4)
-    {
-        out_color = vec4(vec3(roughness), 1.0);
-        return;
-    }
-    else if (u_debug == 5)
-    {
-        out_color = vec4(vec3(ao), 1.0);
-        return;
-    }
-    else if (u_debug == 6)
-    {
-        out_color = vec4(emissiveAO.rgb, 1.0);
-        return;
-    }
+    // the difference is taken in highp, only the unit vector is stored at reduced precision
+    DIRECTIONP vec3 V = normalize(u_per_frame.view_pos.xyz - position);
+    DIRECTIONP vec3 R = reflect(-V, N);
+
+#if DEBUG_VIEW == 1
+    out_color = vec4(albedo, 1.0);
+#elif DEBUG_VIEW == 2
+    out_color = vec4(N, 1.0);
+#elif DEBUG_VIEW == 3
+    out_color = vec4(vec3(metallic), 1.0);
+#elif DEBUG_VIEW == 4
+    out_color = vec4(vec3(roughness), 1.0);
+#elif DEBUG_VIEW == 5
+    out_color = vec4(vec3(ao), 1.0);
+#elif DEBUG_VIEW == 6
+    out_color = vec4(emissiveAO.rgb, 1.0);
+#else
 
     // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0
     // of 0.04 and if it's a metal, use the albedo color as F0 (metallic workflow)
-    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    MEDIUMP vec3 F0 = mix(vec3(0.04), albedo, metallic);
 
     vec3 Lo = vec3(0.0);
-#if 0
-    for (int i = 0; i < MAX_LIGHT_COUNT; ++i)
+#if LIGHT_COUNT > 0
+    for (int i = 0; i < LIGHT_COUNT; ++i)
     {
         // calculate per-light radiance
         vec3 delta = u_lights[i].position - position;
@@ -155,7 +254,7 @@ void main()
         vec3 nom = NDF * G * F;
         float NdotV = max(dot(N, V), 0.0);
         float NdotL = max(dot(N, L), 0.0);
-        float denom = 4.0 * NdotV * NdotV;
+        float denom = 4.0 * NdotV * NdotL;
         vec3 specular = nom / max(denom, 0.001); // prevent devide by 0
 
         // kS is equal to Fresnel
@@ -175,29 +274,31 @@ void main()
 #endif
 
     // image based ambient lighting
-    vec3 F = FresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
-    vec3 kS = F;
-    vec3 kD = 1.0 - kS;
+#if IBL_MODE == 1
+    // unit vectors rounded to mediump can have a dot product above 1, and pow(1 - NdotV) of a negative base is undefined
+    MEDIUMP float NdotV = clamp(dot(N, V), 0.0, 1.0);
+    MEDIUMP vec3 F = FresnelSchlickRoughness(NdotV, F0, roughness);
+    MEDIUMP vec3 kS = F;
+    MEDIUMP vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;
-    vec3 irradiance = texture(u_irradiance_map, N).rgb;
-    vec3 diffuse = irradiance * albedo;
+    MEDIUMP vec3 irradiance = texture(u_irradiance_map, N).rgb;
+    MEDIUMP vec3 diffuse = irradiance * albedo;
 
     // sample both pre-filtered map and BRDF lut and combine then together
-    const float MAX_REFLECTION_LOD = 4.0;
-    vec3 prefilteredColor = textureLod(u_specular_map, R, roughness * MAX_REFLECTION_LOD).rgb;
-    float reflectPower = max(dot(N, V), 0.0);
-    vec2 brdfUV = vec2(reflectPower, 1.0 - roughness); // flip
-    vec2 brdf = texture(u_brdf_lut, brdfUV).rg;
-    vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
-
-    vec3 ambient = (kD * diffuse + specular) * ao;
+    MEDIUMP vec3 prefilteredColor = textureLod(u_specular_map, R, roughness * MAX_REFLECTION_LOD).rgb;
+    MEDIUMP vec2 brdfUV = vec2(NdotV, 1.0 - roughness); // flip
+    MEDIUMP vec2 brdf = texture(u_brdf_lut, brdfUV).rg;
+    MEDIUMP vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
+
+    MEDIUMP vec3 ambient = (kD * diffuse + specular) * ao;
+#else
+    MEDIUMP vec3 ambient = vec3(0.0);
+#endif
 
-    vec3 color = ambient + Lo + pow(emissiveAO.rgb, vec3(2.2));
-    // HDR tonemapping
-    color = color / (color + vec3(1.0));
-    // gamma correction
-    color = pow(color, vec3(1.0 / 2.2));
+    // linear radiance, tonemap.frag maps it to the display once per pixel
+    MEDIUMP vec3 color = ambient + Lo + pow(emissiveAO.rgb, vec3(2.2));
 
     out_color = vec4(color, 1.0);
+#endif
 }
 
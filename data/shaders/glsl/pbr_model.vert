@@ -13,19 +13,25 @@ struct VS_OUT
 };
 
 out VS_OUT vs_pass;
-
-struct PerFrameBuffer
-{
-    mat4 view;
-    mat4 projection;
-};
+// the depth prepass links this shader too, GL_EQUAL needs the same depth in both programs
+invariant gl_Position;
 
 struct PerDrawBuffer
 {
     mat4 transform;
 };
 
-uniform PerFrameBuffer u_per_frame;
+// per frame constants, the renderer writes them into a region of a uniform buffer every frame.
+// Every program declares the whole block so they share one layout
+layout (std140) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    int tonemap;      // 0 copies the debug views as they are
+    float sharpness;  // of a target rendered below the window resolution, 0 disables it
+} u_per_frame;
+
 uniform PerDrawBuffer u_per_draw;
 
 void main()
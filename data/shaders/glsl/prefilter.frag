@@ -1,6 +1,12 @@
 #version 410 core
 #define PI 3.14159265359
+// injected by the renderer
+#ifndef SAMPLE_COUNT
 #define SAMPLE_COUNT 1024u
+#endif
+#ifndef ENV_MAP_RESOLUTION
+#define ENV_MAP_RESOLUTION 512.0
+#endif
 layout (location = 0) out vec4 out_color;
 in vec3 pass_position;
 uniform samplerCube u_env_map;
@@ -86,7 +92,7 @@ void main()
             float HdotV = max(dot(H, V), 0.0);
             float pdf = D * NdotH / (4.0 * HdotV) + 0.0001;
 
-            float resolution = 512.0; // resolution of source cubemap (per face)
+            float resolution = ENV_MAP_RESOLUTION; // resolution of source cubemap (per face)
             float saTexel  = 4.0 * PI / (6.0 * resolution * resolution);
             float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
 
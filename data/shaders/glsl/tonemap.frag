@@ -0,0 +1,74 @@
+#version 410 core
+// REDUCED_PRECISION: 1 tonemaps in mediump
+#ifndef REDUCED_PRECISION
+#define REDUCED_PRECISION 0
+#endif
+// SRGB_FRAMEBUFFER: 1 leaves the gamma encoding to an sRGB backbuffer
+#ifndef SRGB_FRAMEBUFFER
+#define SRGB_FRAMEBUFFER 0
+#endif
+
+#if REDUCED_PRECISION
+#define MEDIUMP mediump
+#else
+#define MEDIUMP highp
+#endif
+
+layout (location = 0) out vec4 out_color;
+
+in vec2 pass_uv;
+
+uniform MEDIUMP sampler2D u_hdr_color;
+// the background is at the far plane, 1.0 must stay exact
+uniform highp sampler2D u_scene_depth;
+// same block as in pbr_model.vert
+layout (std140) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    int tonemap;      // 0 copies the debug views of the model as they are
+    float sharpness;  // of a target rendered below the window resolution, 0 disables it
+} u_per_frame;
+
+bool tonemapped(vec2 uv)
+{
+    return u_per_frame.tonemap != 0 || texture(u_scene_depth, uv).r == 1.0;
+}
+
+MEDIUMP vec3 fetch(vec2 uv)
+{
+    MEDIUMP vec3 color = texture(u_hdr_color, uv).rgb;
+    // HDR tonemapping
+    if (tonemapped(uv))
+        color = color / (color + vec3(1.0));
+    return color;
+}
+
+void main()
+{
+    MEDIUMP vec3 color = fetch(pass_uv);
+    if (u_per_frame.sharpness > 0.0)
+    {
+        // unsharp mask over the neighbouring source texels of the bilinear upscale,
+        // limited to their range so edges don't ring
+        vec2 texel = 1.0 / vec2(textureSize(u_hdr_color, 0));
+        MEDIUMP vec3 north = fetch(pass_uv + vec2(0.0, texel.y));
+        MEDIUMP vec3 south = fetch(pass_uv - vec2(0.0, texel.y));
+        MEDIUMP vec3 east = fetch(pass_uv + vec2(texel.x, 0.0));
+        MEDIUMP vec3 west = fetch(pass_uv - vec2(texel.x, 0.0));
+        MEDIUMP vec3 low = min(color, min(min(north, south), min(east, west)));
+        MEDIUMP vec3 high = max(color, max(max(north, south), max(east, west)));
+        MEDIUMP vec3 detail = color - 0.25 * (north + south + east + west);
+        color = clamp(color + u_per_frame.sharpness * detail, low, high);
+    }
+    // gamma correction, an sRGB backbuffer only encodes when nothing is copied
+#if SRGB_FRAMEBUFFER
+    if (u_per_frame.tonemap == 0 && tonemapped(pass_uv))
+#else
+    if (tonemapped(pass_uv))
+#endif
+        color = pow(color, vec3(1.0 / 2.2));
+
+    out_color = vec4(color, 1.0);
+}
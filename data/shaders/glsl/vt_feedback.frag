@@ -0,0 +1,40 @@
+#version 410 core
+// virtual texture feedback, every pixel writes the page of the level pbr_model.frag samples.
+// the target is FEEDBACK_SCALE times smaller, so are the pixels' derivatives
+#ifndef FEEDBACK_SCALE
+#define FEEDBACK_SCALE 8.0
+#endif
+
+struct VS_OUT
+{
+    vec3 position;
+    vec2 uv;
+    mat3 TBN;
+};
+
+in VS_OUT vs_pass;
+
+layout (location = 0) out vec4 out_page;
+
+// same as in pbr_model.frag
+struct VirtualTexture
+{
+    vec2 pages;
+    float max_level;
+    float page_size;
+    float border;
+    float atlas_size;
+};
+uniform VirtualTexture u_vt;
+
+void main()
+{
+    highp vec2 texels = vs_pass.uv * u_vt.pages * u_vt.page_size;
+    highp vec2 dx = dFdx(texels);
+    highp vec2 dy = dFdy(texels);
+    float level = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - log2(FEEDBACK_SCALE);
+    level = floor(clamp(level, 0.0, u_vt.max_level));
+    vec2 page = floor(fract(vs_pass.uv) * u_vt.pages / exp2(level));
+    // level 0 is left for the pixels the model does not cover
+    out_page = vec4(page, level + 1.0, 255.0) / 255.0;
+}
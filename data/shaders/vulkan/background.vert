@@ -0,0 +1,27 @@
+#version 450
+layout (location = 0) in vec3 in_position;
+
+layout (location = 0) out vec3 pass_position;
+
+struct Light
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout (set = 0, binding = 0) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    Light lights[4];
+} u_per_frame;
+
+void main()
+{
+    pass_position = in_position;
+    vec4 world_position = vec4(10.0f * in_position, 1.0);
+    mat4 viewRotation = mat4(mat3(u_per_frame.view));
+    vec4 clip_position = u_per_frame.projection * viewRotation * world_position;
+    gl_Position = clip_position.xyww; // force depth to be 1
+}
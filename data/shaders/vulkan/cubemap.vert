@@ -0,0 +1,16 @@
+#version 450
+layout (location = 0) in vec3 in_position;
+
+layout (location = 0) out vec3 pass_position;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 view_projection;
+    float roughness;
+} u_push;
+
+void main()
+{
+    pass_position = in_position;
+    gl_Position = u_push.view_projection * vec4(in_position, 1.0);
+}
@@ -0,0 +1,37 @@
+#version 450
+#define PI 3.14159265359
+// CPU devices integrate a coarser grid
+layout (constant_id = 0) const float SAMPLE_STEP = 0.025;
+
+layout (location = 0) in vec3 pass_position;
+
+layout (location = 0) out vec4 out_color;
+
+layout (set = 0, binding = 0) uniform samplerCube u_env_map;
+
+void main()
+{
+    vec3 N = normalize(pass_position);
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    vec3 right = cross(up, N);
+    up = cross(N, right);
+
+    vec3 irradiance = vec3(0.0);
+    float samples = 0.0;
+
+    for (float phi = 0.0; phi < 2.0 * PI; phi += SAMPLE_STEP)
+    {
+        for (float theta = 0.0; theta < 0.5 * PI; theta += SAMPLE_STEP)
+        {
+            float xdir = sin(theta) * cos(phi);
+            float ydir = sin(theta) * sin(phi);
+            float zdir = cos(theta);
+            vec3 sampleVec = xdir * right + ydir * up + zdir * N;
+            irradiance += textureLod(u_env_map, sampleVec, 0.0).rgb * cos(theta) * sin(theta);
+            samples += 1.0;
+        }
+    }
+
+    irradiance = PI * irradiance * (1.0 / samples);
+    out_color = vec4(irradiance, 1.0);
+}
@@ -0,0 +1,192 @@
+#version 450
+#define PI 3.14159265358979323846264338327950288
+
+// variant features, the renderer specializes them per pipeline
+// DEBUG_VIEW: 0 shaded, 1 albedo, 2 normal, 3 metallic, 4 roughness, 5 ao, 6 emissive
+layout (constant_id = 0) const int DEBUG_VIEW = 0;
+// number of analytic point lights
+layout (constant_id = 1) const int LIGHT_COUNT = 0;
+layout (constant_id = 2) const bool HAS_ALBEDO_METALLIC_MAP = true;
+layout (constant_id = 3) const bool HAS_NORMAL_ROUGHNESS_MAP = true;
+layout (constant_id = 4) const bool HAS_EMISSIVE_AO_MAP = true;
+layout (constant_id = 5) const float MAX_REFLECTION_LOD = 4.0;
+
+layout (location = 0) in vec3 pass_position;
+layout (location = 1) in vec2 pass_uv;
+layout (location = 2) in mat3 pass_TBN;
+
+layout (location = 0) out vec4 out_color;
+
+struct Light
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout (set = 0, binding = 0) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    Light lights[4];
+} u_per_frame;
+
+// binding 0 is the environment map of the background
+layout (set = 1, binding = 1) uniform samplerCube u_irradiance_map;
+layout (set = 1, binding = 2) uniform samplerCube u_specular_map;
+layout (set = 1, binding = 3) uniform sampler2D u_brdf_lut;
+// missing maps are bound to a 1x1 texture and never sampled
+layout (set = 1, binding = 4) uniform sampler2D u_albedoMetallic;
+layout (set = 1, binding = 5) uniform sampler2D u_normalRoughness;
+layout (set = 1, binding = 6) uniform sampler2D u_emissiveAO;
+
+// NDF(n, h, alpha) = alpha^2 / (pi * ((n dot h)^2 * (alpha^2 - 1) + 1)^2)
+float DistributionGGX(in vec3 N, in vec3 H, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float nom = a2;
+    float denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    denom = PI * denom * denom;
+    // if roughness = 0, NDF = 0,
+    // if roughness = 1, NDF = 1 / pi
+    return nom / denom;
+}
+
+// G_SchlickGGX(n, v, k) = dot(n, v) / (dot(n, v)(1 - k) + k)
+// k is a remapping of alpha
+float G_SchlickGGX(float NdotV, float roughness)
+{
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+
+    float nom = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+    return nom / denom;
+}
+
+float GeometrySmith(in vec3 N, in vec3 V, in vec3 L, float roughness)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx1 = G_SchlickGGX(NdotV, roughness);
+    float ggx2 = G_SchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+// Fresnel approximation F0 + (1 - F0) * (1 - (cosine))^5
+vec3 FresnelSchlick(float cosTheta, in vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 FresnelSchlickRoughness(float cosTheta, in vec3 F0, float roughness)
+{
+    return F0 + (max(vec3(1.0 - roughness) - F0, vec3(0.0))) * pow(1.0 - cosTheta, 5.0);
+}
+
+void main()
+{
+    // variables
+    vec3 position = pass_position;
+
+    vec4 albedoMetallic = HAS_ALBEDO_METALLIC_MAP ? texture(u_albedoMetallic, pass_uv) : vec4(0.8, 0.8, 0.8, 0.0);
+    vec4 normalRoughness = HAS_NORMAL_ROUGHNESS_MAP ? texture(u_normalRoughness, pass_uv) : vec4(0.5, 0.5, 1.0, 0.5);
+    vec4 emissiveAO = HAS_EMISSIVE_AO_MAP ? texture(u_emissiveAO, pass_uv) : vec4(0.0, 0.0, 0.0, 1.0);
+
+    vec3 albedo = albedoMetallic.rgb;
+    float metallic = albedoMetallic.a;
+    float roughness = normalRoughness.a;
+    float ao = emissiveAO.a;
+
+    vec3 N;
+    if (HAS_NORMAL_ROUGHNESS_MAP)
+        N = normalize(pass_TBN * (2.0 * normalRoughness.rgb - 1.0));
+    else
+        N = normalize(pass_TBN[2]);
+
+    vec3 V = normalize(u_per_frame.view_pos.xyz - position);
+    vec3 R = reflect(-V, N);
+
+    if (DEBUG_VIEW == 1) {
+        out_color = vec4(albedo, 1.0);
+        return;
+    } else if (DEBUG_VIEW == 2) {
+        out_color = vec4(N, 1.0);
+        return;
+    } else if (DEBUG_VIEW == 3) {
+        out_color = vec4(vec3(metallic), 1.0);
+        return;
+    } else if (DEBUG_VIEW == 4) {
+        out_color = vec4(vec3(roughness), 1.0);
+        return;
+    } else if (DEBUG_VIEW == 5) {
+        out_color = vec4(vec3(ao), 1.0);
+        return;
+    } else if (DEBUG_VIEW == 6) {
+        out_color = vec4(emissiveAO.rgb, 1.0);
+        return;
+    }
+
+    // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0
+    // of 0.04 and if it's a metal, use the albedo color as F0 (metallic workflow)
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+
+    vec3 Lo = vec3(0.0);
+    for (int i = 0; i < LIGHT_COUNT; ++i)
+    {
+        // calculate per-light radiance
+        vec3 delta = u_per_frame.lights[i].position.xyz - position;
+        vec3 L = normalize(delta);
+        vec3 H = normalize(V + L);
+        float distance = length(delta);
+        float attenuation = 1.0 / (distance * distance);
+        vec3 radiance = u_per_frame.lights[i].color.rgb * attenuation;
+
+        // Cook-Torracne BRDF
+        float NDF = DistributionGGX(N, H, roughness);
+        float G = GeometrySmith(N, V, L, roughness);
+        vec3 F = FresnelSchlick(clamp(dot(H, V), 0.0, 1.0), F0);
+
+        vec3 nom = NDF * G * F;
+        float NdotV = max(dot(N, V), 0.0);
+        float NdotL = max(dot(N, L), 0.0);
+        float denom = 4.0 * NdotV * NdotL;
+        vec3 specular = nom / max(denom, 0.001); // prevent devide by 0
+
+        // kS is equal to Fresnel
+        vec3 kS = F;
+        // energy conservation, only non-metals have diffuse lighting
+        vec3 kD = vec3(1.0) - kS;
+        kD *= 1.0 - metallic;
+
+        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+    }
+
+    // image based ambient lighting
+    float NdotV = clamp(dot(N, V), 0.0, 1.0);
+    vec3 F = FresnelSchlickRoughness(NdotV, F0, roughness);
+    vec3 kS = F;
+    vec3 kD = 1.0 - kS;
+    kD *= 1.0 - metallic;
+    vec3 irradiance = texture(u_irradiance_map, N).rgb;
+    vec3 diffuse = irradiance * albedo;
+
+    // sample both pre-filtered map and BRDF lut and combine then together
+    vec3 prefilteredColor = textureLod(u_specular_map, R, roughness * MAX_REFLECTION_LOD).rgb;
+    vec2 brdfUV = vec2(NdotV, 1.0 - roughness); // flip
+    vec2 brdf = texture(u_brdf_lut, brdfUV).rg;
+    vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
+
+    vec3 ambient = (kD * diffuse + specular) * ao;
+
+    vec3 color = ambient + Lo + pow(emissiveAO.rgb, vec3(2.2));
+    // HDR tonemapping
+    color = color / (color + vec3(1.0));
+    // gamma correction
+    color = pow(color, vec3(1.0 / 2.2));
+
+    out_color = vec4(color, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 450
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec2 in_uv;
+layout (location = 2) in vec3 in_normal;
+layout (location = 3) in vec3 in_tangent;
+layout (location = 4) in vec3 in_bitangent;
+
+layout (location = 0) out vec3 pass_position;
+layout (location = 1) out vec2 pass_uv;
+layout (location = 2) out mat3 pass_TBN;
+
+struct Light
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout (set = 0, binding = 0) uniform PerFrameBuffer
+{
+    mat4 view;
+    mat4 projection;
+    vec4 view_pos;
+    Light lights[4];
+} u_per_frame;
+
+layout (push_constant) uniform PerDrawBuffer
+{
+    mat4 transform;
+} u_per_draw;
+
+void main()
+{
+    vec4 world_position = u_per_draw.transform * vec4(in_position, 1.0);
+    pass_position = world_position.xyz;
+    pass_uv = in_uv;
+
+    mat3 rotation = mat3(u_per_draw.transform);
+    vec3 T = normalize(rotation * in_tangent);
+    vec3 B = normalize(rotation * in_bitangent);
+    vec3 N = normalize(rotation * in_normal);
+
+    pass_TBN = mat3(T, B, N);
+
+    gl_Position = u_per_frame.projection * u_per_frame.view * world_position;
+}
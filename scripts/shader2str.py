@@ -30,6 +30,7 @@ output_file_path = temp_dir + 'shaders.generated.h'
 outfile = open(output_file_path, 'w+')
 outfile.write('#pragma once\nnamespace generated {\n\n')
 
+# highp stays the default, REDUCED_PRECISION shaders opt into mediump per variable
 version_strings = [
     "#version 300 es",
     "precision highp float;",
@@ -0,0 +1,5 @@
+#include "base/Config.h"
+
+namespace pbr {
+WindowCreateInfo g_windowCreateInfo(RenderApi::SOFTWARE, 0.5f, { 800, 500 }, true);
+}  // namespace pbr
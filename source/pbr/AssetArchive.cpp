@@ -0,0 +1,303 @@
+#include "AssetArchive.h"
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include "Utility.h"
+#include "base/Error.h"
+#include "base/Hash.h"
+#if TARGET_PLATFORM == PLATFORM_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using std::ifstream;
+using std::ios;
+using std::ofstream;
+
+namespace pbr {
+
+// the buckets follow the header, the entries follow the buckets, then the names and the data
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketCount;  // a power of two, at least twice the entry count
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct ArchiveEntry {
+    uint64_t nameHash;
+    uint64_t contentHash;  // of the uncompressed bytes
+    uint64_t offset;
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t nameOffset;  // into the names, which are NUL terminated
+    uint32_t compression;
+};
+
+namespace {
+
+constexpr uint32_t ARCHIVE_MAGIC = 0x41524250;  // 'PBRA'
+constexpr uint32_t ARCHIVE_VERSION = 1;
+
+enum Compression : uint32_t {
+    COMPRESSION_NONE,
+    COMPRESSION_DEFLATE,
+};
+
+uint64_t alignUp(uint64_t value) {
+    return (value + AssetArchive::ALIGNMENT - 1) & ~uint64_t(AssetArchive::ALIGNMENT - 1);
+}
+
+vector<uint8_t> readLooseFile(const string& path) {
+    ifstream file(path, ios::ate | ios::binary);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to open file '" + path + "'");
+    vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    return bytes;
+}
+
+}  // namespace
+
+AssetArchive::BuildStats AssetArchive::Build(const string& root, const vector<string>& names, const string& path, bool compress) {
+    BuildStats stats;
+    stats.entryCount = static_cast<int>(names.size());
+
+    uint32_t bucketCount = 2;
+    while (bucketCount < 2 * names.size())
+        bucketCount *= 2;
+
+    ArchiveHeader header;
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(names.size());
+    header.bucketCount = bucketCount;
+    header.namesOffset = sizeof(ArchiveHeader) + sizeof(uint32_t) * bucketCount + sizeof(ArchiveEntry) * names.size();
+    header.namesSize = 0;
+    for (const string& name : names)
+        header.namesSize += name.size() + 1;
+
+    vector<uint32_t> buckets(bucketCount, 0);
+    vector<ArchiveEntry> entries(names.size());
+    vector<vector<uint8_t>> blobs;  // the stored bytes of every entry that isn't a duplicate
+    std::unordered_map<uint64_t, vector<int>> byContent;
+    vector<int> blobOf(names.size());
+    uint64_t offset = alignUp(header.namesOffset + header.namesSize);
+    uint32_t nameOffset = 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        ArchiveEntry& entry = entries[i];
+        entry.nameHash = Fnv1a64(names[i]);
+        entry.nameOffset = nameOffset;
+        nameOffset += static_cast<uint32_t>(names[i].size() + 1);
+
+        uint32_t bucket = static_cast<uint32_t>(entry.nameHash) & (bucketCount - 1);
+        while (buckets[bucket] != 0)
+            bucket = (bucket + 1) & (bucketCount - 1);
+        buckets[bucket] = static_cast<uint32_t>(i + 1);
+
+        vector<uint8_t> bytes = readLooseFile(root + names[i]);
+        entry.size = bytes.size();
+        entry.contentHash = Fnv1a64(bytes.data(), bytes.size());
+        stats.inputSize += bytes.size();
+
+        // a hash collision must not merge two files, the earlier bytes are inflated and compared
+        const ArchiveEntry* pSame = nullptr;
+        for (int earlier : byContent[entry.contentHash]) {
+            const ArchiveEntry& candidate = entries[earlier];
+            if (candidate.size != entry.size)
+                continue;
+            const vector<uint8_t>& blob = blobs[blobOf[earlier]];
+            vector<uint8_t> original(candidate.compression == COMPRESSION_NONE ? 0 : candidate.size);
+            if (candidate.compression != COMPRESSION_NONE)
+                utility::Inflate(blob.data(), blob.size(), original.data(), original.size());
+            const uint8_t* pEarlier = candidate.compression == COMPRESSION_NONE ? blob.data() : original.data();
+            // empty files are the same, memcmp must not be handed their null data
+            if (bytes.empty() || memcmp(pEarlier, bytes.data(), bytes.size()) == 0) {
+                pSame = &candidate;
+                blobOf[i] = blobOf[earlier];
+                break;
+            }
+        }
+        if (pSame) {
+            entry.offset = pSame->offset;
+            entry.storedSize = pSame->storedSize;
+            entry.compression = pSame->compression;
+            ++stats.duplicateCount;
+            continue;
+        }
+        byContent[entry.contentHash].push_back(static_cast<int>(i));
+
+        entry.compression = COMPRESSION_NONE;
+        if (compress && !bytes.empty()) {
+            vector<uint8_t> deflated = utility::Deflate(bytes.data(), bytes.size());
+            if (!deflated.empty() && deflated.size() < bytes.size() - bytes.size() / 10) {
+                bytes = std::move(deflated);
+                entry.compression = COMPRESSION_DEFLATE;
+                ++stats.compressedCount;
+            }
+        }
+        entry.offset = offset;
+        entry.storedSize = bytes.size();
+        offset = alignUp(offset + bytes.size());
+        blobOf[i] = static_cast<int>(blobs.size());
+        blobs.push_back(std::move(bytes));
+    }
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to write archive '" + path + "'");
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(buckets.data()), sizeof(uint32_t) * buckets.size());
+    file.write(reinterpret_cast<const char*>(entries.data()), sizeof(ArchiveEntry) * entries.size());
+    for (const string& name : names)
+        file.write(name.c_str(), name.size() + 1);
+    const char padding[ALIGNMENT] = {};
+    uint64_t written = header.namesOffset + header.namesSize;
+    for (const vector<uint8_t>& blob : blobs) {
+        file.write(padding, alignUp(written) - written);
+        file.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+        written = alignUp(written) + blob.size();
+    }
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to write archive '" + path + "'");
+
+    stats.archiveSize = written;
+    return stats;
+}
+
+void AssetArchive::Open(const string& path) {
+    Close();
+#if TARGET_PLATFORM == PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        THROW_EXCEPTION("filesystem: Failed to open archive '" + path + "'");
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* pView = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!pView) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        THROW_EXCEPTION("filesystem: Failed to map archive '" + path + "'");
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_pData = static_cast<const uint8_t*>(pView);
+    m_size = static_cast<size_t>(size.QuadPart);
+#elif TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    m_memory = readLooseFile(path);
+    m_pData = m_memory.data();
+    m_size = m_memory.size();
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        THROW_EXCEPTION("filesystem: Failed to open archive '" + path + "'");
+    struct stat info;
+    void* pView = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        pView = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (pView == MAP_FAILED)
+        THROW_EXCEPTION("filesystem: Failed to map archive '" + path + "'");
+    m_pData = static_cast<const uint8_t*>(pView);
+    m_size = static_cast<size_t>(info.st_size);
+#endif
+    m_path = path;
+
+    // everything Find and Read touch is checked once here
+    bool valid = m_size >= sizeof(ArchiveHeader);
+    if (valid) {
+        const ArchiveHeader& h = header();
+        const uint64_t tableEnd = sizeof(ArchiveHeader) + sizeof(uint32_t) * uint64_t(h.bucketCount) + sizeof(ArchiveEntry) * uint64_t(h.entryCount);
+        valid = h.magic == ARCHIVE_MAGIC && h.version == ARCHIVE_VERSION && h.bucketCount != 0 &&
+                (h.bucketCount & (h.bucketCount - 1)) == 0 && h.bucketCount >= h.entryCount &&
+                h.namesOffset == tableEnd && h.namesOffset + h.namesSize <= m_size && h.namesSize > 0 &&
+                m_pData[h.namesOffset + h.namesSize - 1] == '\0';
+        for (int i = 0; valid && i < EntryCount(); ++i) {
+            const ArchiveEntry& e = entry(i);
+            valid = e.offset + e.storedSize <= m_size && e.nameOffset < h.namesSize &&
+                    (e.compression == COMPRESSION_DEFLATE || (e.compression == COMPRESSION_NONE && e.storedSize == e.size));
+        }
+    }
+    if (!valid) {
+        Close();
+        THROW_EXCEPTION("filesystem: '" + path + "' is not an asset archive");
+    }
+}
+
+void AssetArchive::Close() {
+#if TARGET_PLATFORM == PLATFORM_WINDOWS
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_file = m_mapping = nullptr;
+#elif TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    m_memory = vector<uint8_t>();
+#else
+    if (m_pData)
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+    m_path.clear();
+}
+
+int AssetArchive::EntryCount() const {
+    return m_pData ? static_cast<int>(header().entryCount) : 0;
+}
+
+int AssetArchive::Find(const string& name) const {
+    if (!m_pData)
+        return -1;
+    const ArchiveHeader& h = header();
+    const uint32_t* pBuckets = reinterpret_cast<const uint32_t*>(m_pData + sizeof(ArchiveHeader));
+    const char* pNames = reinterpret_cast<const char*>(m_pData + h.namesOffset);
+    const uint64_t hash = Fnv1a64(name);
+    uint32_t bucket = static_cast<uint32_t>(hash) & (h.bucketCount - 1);
+    for (uint32_t probe = 0; probe < h.bucketCount && pBuckets[bucket] != 0; ++probe) {
+        const uint32_t index = pBuckets[bucket] - 1;
+        if (index < h.entryCount) {
+            const ArchiveEntry& e = entry(index);
+            if (e.nameHash == hash && name == pNames + e.nameOffset)
+                return static_cast<int>(index);
+        }
+        bucket = (bucket + 1) & (h.bucketCount - 1);
+    }
+    return -1;
+}
+
+FileData AssetArchive::Read(int index) const {
+    const ArchiveEntry& e = entry(index);
+    if (e.compression == COMPRESSION_NONE)
+        return FileData::View(m_pData + e.offset, static_cast<size_t>(e.size));
+
+    vector<uint8_t> bytes(static_cast<size_t>(e.size));
+    if (!utility::Inflate(m_pData + e.offset, static_cast<size_t>(e.storedSize), bytes.data(), bytes.size()))
+        THROW_EXCEPTION("filesystem: entry " + std::to_string(index) + " of '" + m_path + "' is corrupt");
+    return FileData::Own(std::move(bytes));
+}
+
+const ArchiveHeader& AssetArchive::header() const {
+    return *reinterpret_cast<const ArchiveHeader*>(m_pData);
+}
+
+const ArchiveEntry& AssetArchive::entry(int index) const {
+    const size_t offset = sizeof(ArchiveHeader) + sizeof(uint32_t) * header().bucketCount + sizeof(ArchiveEntry) * index;
+    return *reinterpret_cast<const ArchiveEntry*>(m_pData + offset);
+}
+
+}  // namespace pbr
@@ -0,0 +1,59 @@
+#pragma once
+#include "FileSystem.h"
+#include "base/Platform.h"
+
+namespace pbr {
+
+struct ArchiveHeader;
+struct ArchiveEntry;
+
+// A single file of read only entries, named by their path relative to the data directory. The table of
+// contents is an open addressing hash table over the names, the data of an entry starts on an ALIGNMENT
+// boundary, entries that deflate well are stored deflated, and entries with the same content share their
+// data. The archive is memory mapped, reading a stored entry copies nothing.
+class AssetArchive {
+   public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    struct BuildStats {
+        int entryCount = 0;
+        int compressedCount = 0;
+        int duplicateCount = 0;  // entries that share the data of an earlier one
+        uint64_t inputSize = 0;
+        uint64_t archiveSize = 0;
+    };
+
+    // packs root + name for every name, an entry is deflated when compress is set and that saves a tenth
+    static BuildStats Build(const string& root, const vector<string>& names, const string& path, bool compress);
+
+    AssetArchive() = default;
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+    ~AssetArchive() { Close(); }
+
+    void Open(const string& path);
+    void Close();
+    const string& Path() const { return m_path; }
+    int EntryCount() const;
+    // -1 when there is no entry of that name
+    int Find(const string& name) const;
+    // inflates a compressed entry, a stored one is a view into the mapping
+    FileData Read(int entry) const;
+
+   private:
+    const ArchiveHeader& header() const;
+    const ArchiveEntry& entry(int index) const;
+
+   private:
+    string m_path;
+    const uint8_t* m_pData = nullptr;
+    size_t m_size = 0;
+#if TARGET_PLATFORM == PLATFORM_WINDOWS
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#elif TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    vector<uint8_t> m_memory;  // the virtual file system lives in memory already, it is read once
+#endif
+};
+
+}  // namespace pbr
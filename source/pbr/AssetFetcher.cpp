@@ -0,0 +1,150 @@
+#include "AssetFetcher.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "FileSystem.h"
+#include "base/Error.h"
+#include "base/Platform.h"
+
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+#include <emscripten/fetch.h>
+#endif
+
+namespace pbr {
+
+void AssetFetcher::Initialize(const string& baseUrl) {
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    if (baseUrl.compare(0, 7, "http://") == 0 || baseUrl.compare(0, 8, "https://") == 0)
+        THROW_EXCEPTION("asset fetcher: only the web build downloads over HTTP, pass a directory instead of '" + baseUrl + "'");
+#endif
+    m_baseUrl = baseUrl;
+    if (!m_baseUrl.empty() && m_baseUrl.back() != '/')
+        m_baseUrl.push_back('/');
+    m_startTime = std::chrono::steady_clock::now();
+}
+
+void AssetFetcher::Fetch(const string& path, int priority, Callback callback) {
+    static const string s_dataDir = DATA_DIR;
+    if (path.compare(0, s_dataDir.size(), s_dataDir) != 0)
+        THROW_EXCEPTION("asset fetcher: '" + path + "' is not under the data directory");
+    unique_ptr<Request> pRequest = std::make_unique<Request>();
+    pRequest->path = path;
+    pRequest->priority = priority;
+    pRequest->order = m_order++;
+    pRequest->callback = std::move(callback);
+    m_queue.push_back(std::move(pRequest));
+}
+
+void AssetFetcher::Update() {
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+#endif
+    vector<unique_ptr<Request>> finished;
+    for (size_t i = 0; i < m_inFlight.size();) {
+        Request& request = *m_inFlight[i];
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+        // a single thread reads when it waits
+        if (request.read.IsDone() || jobSystem.ThreadCount() == 1) {
+            jobSystem.Wait(request.read);
+            request.done = true;
+        }
+#endif
+        if (!request.done) {
+            ++i;
+            continue;
+        }
+        finished.push_back(std::move(m_inFlight[i]));
+        m_inFlight.erase(m_inFlight.begin() + i);
+    }
+
+    // a callback may fetch the next files, they compete with the queued ones
+    for (unique_ptr<Request>& pRequest : finished) {
+        Request& request = *pRequest;
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+        if (request.succeeded) {
+            ++m_fetchedCount;
+            m_fetchedBytes += request.bytes.size();
+            if (m_firstArrival < 0.0)
+                m_firstArrival = seconds;
+            m_lastArrival = seconds;
+            FileSystem::GetSingleton().Add(request.path, std::move(request.bytes));
+        } else {
+            ++m_failedCount;
+        }
+        request.callback(request.succeeded);
+    }
+
+    while (m_inFlight.size() < MAX_IN_FLIGHT && !m_queue.empty()) {
+        auto next = std::min_element(m_queue.begin(), m_queue.end(), [](const unique_ptr<Request>& a, const unique_ptr<Request>& b) {
+            return a->priority != b->priority ? a->priority < b->priority : a->order < b->order;
+        });
+        m_inFlight.push_back(std::move(*next));
+        m_queue.erase(next);
+        start(*m_inFlight.back());
+    }
+}
+
+void AssetFetcher::Report(ostream& os) const {
+    if (m_fetchedCount + m_failedCount == 0)
+        return;
+    os << "[Log] asset fetcher: " << m_fetchedCount << " files, " << (m_fetchedBytes >> 10) << " KB from " << m_baseUrl
+       << ", first after " << int(1000.0 * m_firstArrival) << " ms, last after " << int(1000.0 * m_lastArrival) << " ms";
+    if (m_failedCount)
+        os << ", " << m_failedCount << " not found";
+    os << endl;
+}
+
+void AssetFetcher::Finalize() {
+    m_queue.clear();
+    for (unique_ptr<Request>& pRequest : m_inFlight) {
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        // aborts the download, its callbacks don't run anymore
+        if (pRequest->pFetch)
+            emscripten_fetch_close(static_cast<emscripten_fetch_t*>(pRequest->pFetch));
+#else
+        JobSystem::GetSingleton().Wait(pRequest->read);
+#endif
+    }
+    m_inFlight.clear();
+}
+
+void AssetFetcher::start(Request& request) {
+    const string url = m_baseUrl + request.path.substr(strlen(DATA_DIR));
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    emscripten_fetch_attr_t attributes;
+    emscripten_fetch_attr_init(&attributes);
+    strcpy(attributes.requestMethod, "GET");
+    attributes.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
+    attributes.userData = &request;
+    // both run on the main thread between frames
+    attributes.onsuccess = [](emscripten_fetch_t* pFetch) {
+        Request& request = *static_cast<Request*>(pFetch->userData);
+        const uint8_t* pData = reinterpret_cast<const uint8_t*>(pFetch->data);
+        request.bytes.assign(pData, pData + pFetch->numBytes);
+        request.succeeded = pFetch->status == 200;
+        request.done = true;
+        request.pFetch = nullptr;
+        emscripten_fetch_close(pFetch);
+    };
+    attributes.onerror = [](emscripten_fetch_t* pFetch) {
+        Request& request = *static_cast<Request*>(pFetch->userData);
+        request.done = true;
+        request.pFetch = nullptr;
+        emscripten_fetch_close(pFetch);
+    };
+    request.pFetch = emscripten_fetch(&attributes, url.c_str());
+#else
+    Request* pRequest = &request;
+    JobSystem::GetSingleton().Schedule("fetch asset", [pRequest, url] {
+        std::ifstream file(url, std::ios::ate | std::ios::binary);
+        if (!file.good())
+            return;
+        pRequest->bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(pRequest->bytes.data()), pRequest->bytes.size());
+        pRequest->succeeded = file.good();
+    }, &request.read);
+#endif
+}
+
+}  // namespace pbr
@@ -0,0 +1,59 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include "base/Definitions.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+
+// Downloads files under DATA_DIR from a mirror of the data directory, e.g. what tool/webAssets writes,
+// and adds them to FileSystem, where the loaders find them under their usual path. The web build fetches
+// over HTTP, elsewhere the base url is a directory that is read on the workers, which stands in for a
+// server. Requests start in order of priority, lower first, a few at a time so the urgent ones don't
+// queue behind big downloads. Callbacks run on the main thread in Update().
+class AssetFetcher {
+   public:
+    // false when the file couldn't be downloaded, e.g. a material map the model doesn't have
+    typedef std::function<void(bool)> Callback;
+
+    static constexpr int MAX_IN_FLIGHT = 4;
+
+    void Initialize(const string& baseUrl);
+    void Fetch(const string& path, int priority, Callback callback);
+    // starts queued requests and runs the callbacks of the finished ones, called once per frame
+    void Update();
+    bool IsBusy() const { return !m_queue.empty() || !m_inFlight.empty(); }
+    void Report(ostream& os) const;
+    // drops queued requests and waits for the ones in flight without running their callbacks
+    void Finalize();
+
+   private:
+    struct Request {
+        string path;
+        int priority;
+        uint64_t order;  // requests of the same priority start first come first served
+        Callback callback;
+        vector<uint8_t> bytes;
+        bool done = false;  // written by the download, read on the main thread
+        bool succeeded = false;
+        JobCounter read;         // without HTTP
+        void* pFetch = nullptr;  // emscripten_fetch_t of a download of the web build
+    };
+
+    void start(Request& request);
+
+   private:
+    string m_baseUrl;
+    uint64_t m_order = 0;
+    std::deque<unique_ptr<Request>> m_queue;
+    // JobCounter can't move, the requests stay where they were created
+    vector<unique_ptr<Request>> m_inFlight;
+    int m_fetchedCount = 0;
+    int m_failedCount = 0;
+    uint64_t m_fetchedBytes = 0;
+    double m_firstArrival = -1.0;  // seconds after Initialize()
+    double m_lastArrival = 0.0;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+
+}  // namespace pbr
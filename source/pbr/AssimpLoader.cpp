@@ -7,6 +7,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include "MeshCodec.h"
 #include "base/Error.h"
 
 using namespace std;
@@ -68,6 +69,15 @@ TexturedMesh AssimpLoader::load(const char* path) {
     bin.write((char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(TexturedVertex));
     bin.close();
 
+    // what the renderers load, see MeshCodec.h
+    const vector<uint8_t> encoded = MeshCodec::Encode(mesh);
+    std::cout << "size of compressed mesh: " << encoded.size() << std::endl;
+    std::ofstream compressed("test.mesh", ios::out | ios::binary);
+    if (!compressed.is_open())
+        throw runtime_error("Failed to open for write");
+    compressed.write((const char*)encoded.data(), encoded.size());
+    compressed.close();
+
     return mesh;
 }
 
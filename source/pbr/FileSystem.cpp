@@ -0,0 +1,147 @@
+#include "FileSystem.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "AssetArchive.h"
+#include "base/Error.h"
+using std::ifstream;
+using std::ios;
+
+namespace pbr {
+
+namespace {
+
+// the archive names of files under DATA_DIR, empty for any other file
+string archiveName(const string& path) {
+    static const string s_dataDir = DATA_DIR;
+    if (path.compare(0, s_dataDir.size(), s_dataDir) != 0)
+        return string();
+    string name = path.substr(s_dataDir.size());
+    std::replace(name.begin(), name.end(), '\\', '/');
+    return name;
+}
+
+}  // namespace
+
+FileData FileData::View(const uint8_t* pData, size_t size) {
+    FileData data;
+    data.m_pData = pData;
+    data.m_size = size;
+    return data;
+}
+
+FileData FileData::Own(vector<uint8_t>&& bytes) {
+    return Share(std::make_shared<const vector<uint8_t>>(std::move(bytes)));
+}
+
+FileData FileData::Share(shared_ptr<const vector<uint8_t>> pBytes) {
+    FileData data;
+    data.m_pOwned = std::move(pBytes);
+    data.m_pData = data.m_pOwned->data();
+    data.m_size = data.m_pOwned->size();
+    return data;
+}
+
+FileSystem& FileSystem::GetSingleton() {
+    static FileSystem s_fileSystem;
+    return s_fileSystem;
+}
+
+void FileSystem::Mount(const string& archivePath) {
+    auto archive = std::make_unique<AssetArchive>();
+    archive->Open(archivePath);
+    m_archives.push_back(std::move(archive));
+}
+
+void FileSystem::Finalize() {
+    m_archives.clear();
+    std::lock_guard<std::mutex> lock(m_memoryMutex);
+    m_memoryFiles.clear();
+}
+
+void FileSystem::Add(const string& path, vector<uint8_t>&& bytes) {
+    auto pBytes = std::make_shared<const vector<uint8_t>>(std::move(bytes));
+    std::lock_guard<std::mutex> lock(m_memoryMutex);
+    m_memoryFiles[path] = std::move(pBytes);
+}
+
+void FileSystem::Remove(const string& path) {
+    std::lock_guard<std::mutex> lock(m_memoryMutex);
+    m_memoryFiles.erase(path);
+}
+
+shared_ptr<const vector<uint8_t>> FileSystem::findInMemory(const string& path) const {
+    std::lock_guard<std::mutex> lock(m_memoryMutex);
+    auto it = m_memoryFiles.find(path);
+    return it == m_memoryFiles.end() ? nullptr : it->second;
+}
+
+const AssetArchive* FileSystem::find(const string& path, int& entry) const {
+    if (m_archives.empty())
+        return nullptr;
+    const string name = archiveName(path);
+    if (name.empty())
+        return nullptr;
+    for (auto it = m_archives.rbegin(); it != m_archives.rend(); ++it) {
+        entry = (*it)->Find(name);
+        if (entry >= 0)
+            return it->get();
+    }
+    return nullptr;
+}
+
+bool FileSystem::Exists(const string& path) const {
+    int entry;
+    return findInMemory(path) || find(path, entry) || ifstream(path).good();
+}
+
+FileData FileSystem::Read(const string& path) const {
+    if (auto pBytes = findInMemory(path))
+        return FileData::Share(std::move(pBytes));
+    int entry;
+    if (const AssetArchive* pArchive = find(path, entry))
+        return pArchive->Read(entry);
+
+    ifstream file(path, ios::ate | ios::binary);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to open file '" + path + "'");
+    vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    return FileData::Own(std::move(bytes));
+}
+
+void FileSystem::ReadRange(const string& path, uint64_t offset, size_t size, void* pOut) const {
+    const auto pBytes = findInMemory(path);
+    int entry;
+    const AssetArchive* pArchive = pBytes ? nullptr : find(path, entry);
+    if (pBytes || pArchive) {
+        // a compressed entry is inflated as a whole
+        const FileData data = pBytes ? FileData::Share(pBytes) : pArchive->Read(entry);
+        if (offset + size > data.Size())
+            THROW_EXCEPTION("filesystem: '" + path + "' is truncated");
+        memcpy(pOut, data.Data() + offset, size);
+        return;
+    }
+
+    ifstream file(path, ios::binary);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to open file '" + path + "'");
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(static_cast<char*>(pOut), size);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: '" + path + "' is truncated");
+}
+
+std::filesystem::file_time_type FileSystem::LastWriteTime(const string& path) const {
+    if (findInMemory(path))
+        return std::filesystem::file_time_type::min();
+    int entry;
+    const AssetArchive* pArchive = find(path, entry);
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(pArchive ? pArchive->Path() : path, error);
+    // a missing file is newer than anything built from it
+    return error ? std::filesystem::file_time_type::max() : time;
+}
+
+}  // namespace pbr
@@ -0,0 +1,69 @@
+#pragma once
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include "base/Definitions.h"
+
+namespace pbr {
+
+class AssetArchive;
+
+// The bytes of a file, either a view into a mounted archive, valid until FileSystem::Finalize(), or a
+// buffer it shares, of a loose file, a compressed entry or a file added in memory.
+class FileData {
+   public:
+    FileData() = default;
+    FileData(const FileData&) = delete;
+    FileData& operator=(const FileData&) = delete;
+    FileData(FileData&&) = default;
+    FileData& operator=(FileData&&) = default;
+
+    static FileData View(const uint8_t* pData, size_t size);
+    static FileData Own(vector<uint8_t>&& bytes);
+    static FileData Share(shared_ptr<const vector<uint8_t>> pBytes);
+
+    const uint8_t* Data() const { return m_pData; }
+    size_t Size() const { return m_size; }
+    string Text() const { return string(reinterpret_cast<const char*>(m_pData), m_size); }
+
+   private:
+    shared_ptr<const vector<uint8_t>> m_pOwned;
+    const uint8_t* m_pData = nullptr;
+    size_t m_size = 0;
+};
+
+// Every runtime file is read through here. A path is looked up in the files added in memory, e.g. the
+// ones AssetFetcher downloaded, then paths under DATA_DIR in the mounted archives, relative to DATA_DIR,
+// then on disk. Mounting happens before the loaders run, reads, adds and removes may come from any thread.
+class FileSystem {
+   public:
+    static FileSystem& GetSingleton();
+
+    // the entries of a later archive hide those of earlier ones
+    void Mount(const string& archivePath);
+    void Finalize();
+    // the file hides any other of that path until it is removed, readers keep the bytes they hold
+    void Add(const string& path, vector<uint8_t>&& bytes);
+    void Remove(const string& path);
+
+    bool Exists(const string& path) const;
+    FileData Read(const string& path) const;
+    // copies size bytes from offset on, throws when the file is shorter
+    void ReadRange(const string& path, uint64_t offset, size_t size, void* pOut) const;
+    // of the archive for an archived file, caches built from a file compare against it, a file added
+    // in memory is older than any cache
+    std::filesystem::file_time_type LastWriteTime(const string& path) const;
+
+   private:
+    FileSystem() = default;
+    // the archive holding the file and its entry, null for loose files
+    const AssetArchive* find(const string& path, int& entry) const;
+    shared_ptr<const vector<uint8_t>> findInMemory(const string& path) const;
+
+   private:
+    vector<unique_ptr<AssetArchive>> m_archives;
+    mutable std::mutex m_memoryMutex;
+    std::unordered_map<string, shared_ptr<const vector<uint8_t>>> m_memoryFiles;
+};
+
+}  // namespace pbr
@@ -0,0 +1,216 @@
+#include "HdrDecoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "ImageKernels.h"
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+
+namespace {
+
+// scanlines of the run length encoding are 8 to 32767 texels wide
+constexpr int MIN_RLE_WIDTH = 8;
+constexpr int MAX_RLE_WIDTH = 0x7FFF;
+constexpr float HALF_MAX = 65504.0f;
+
+struct HdrLayout {
+    int width = 0, height = 0;
+    vector<size_t> scanlines;  // offsets in the file
+};
+
+// the next line of the header without its newline, false at the end of the data
+bool readLine(const uint8_t* pData, size_t size, size_t& offset, string& line) {
+    if (offset >= size)
+        return false;
+    const uint8_t* pEnd = static_cast<const uint8_t*>(memchr(pData + offset, '\n', size - offset));
+    const size_t end = pEnd ? pEnd - pData : size;
+    line.assign(reinterpret_cast<const char*>(pData) + offset, end - offset);
+    // the last line of a truncated file has no newline
+    offset = pEnd ? end + 1 : size;
+    return true;
+}
+
+// a new style encoded scanline starts with 2, 2 and its width, anything else is flat RGBE
+bool isRunLength(const uint8_t* p, size_t remaining, int width) {
+    return width >= MIN_RLE_WIDTH && width <= MAX_RLE_WIDTH && remaining >= 4 && p[0] == 2 && p[1] == 2 && ((p[2] << 8) | p[3]) == width;
+}
+
+// the offset after the scanline at offset, checks the runs so the decoder doesn't have to
+size_t skipScanline(const uint8_t* pData, size_t size, size_t offset, int width, const string& name) {
+    if (offset >= size)
+        THROW_EXCEPTION("image: '" + name + "' is truncated");
+    if (!isRunLength(pData + offset, size - offset, width)) {
+        if (size - offset < 4 * size_t(width))
+            THROW_EXCEPTION("image: '" + name + "' is truncated");
+        return offset + 4 * size_t(width);
+    }
+    offset += 4;
+    // the four components one after the other, each a sequence of runs and literals
+    for (int component = 0; component < 4; ++component) {
+        for (int x = 0; x < width;) {
+            if (offset >= size)
+                THROW_EXCEPTION("image: '" + name + "' is truncated");
+            const int count = pData[offset++];
+            const int length = count > 128 ? count - 128 : count;
+            const size_t bytes = count > 128 ? 1 : count;
+            if (length == 0 || x + length > width)
+                THROW_EXCEPTION("image: '" + name + "' has a corrupt scanline");
+            if (size - offset < bytes)
+                THROW_EXCEPTION("image: '" + name + "' is truncated");
+            offset += bytes;
+            x += length;
+        }
+    }
+    return offset;
+}
+
+HdrLayout parse(const uint8_t* pData, size_t size, const string& name) {
+    size_t offset = 0;
+    string line;
+    if (!readLine(pData, size, offset, line) || (line != "#?RADIANCE" && line != "#?RGBE"))
+        THROW_EXCEPTION("image: '" + name + "' is not a Radiance hdr");
+    // variables up to an empty line, only the format matters
+    while (readLine(pData, size, offset, line) && !line.empty()) {
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+            THROW_EXCEPTION("image: '" + name + "' has unsupported " + line);
+    }
+
+    if (offset >= size)
+        THROW_EXCEPTION("image: '" + name + "' is truncated");
+
+    HdrLayout layout;
+    if (!readLine(pData, size, offset, line) || sscanf(line.c_str(), "-Y %d +X %d", &layout.height, &layout.width) != 2)
+        THROW_EXCEPTION("image: '" + name + "' is not stored top to bottom, left to right");
+    if (layout.width <= 0 || layout.height <= 0 || layout.width > (1 << 16) || layout.height > (1 << 16))
+        THROW_EXCEPTION("image: '" + name + "' has an unsupported size");
+
+    layout.scanlines.resize(layout.height);
+    for (int y = 0; y < layout.height; ++y) {
+        layout.scanlines[y] = offset;
+        offset = skipScanline(pData, size, offset, layout.width, name);
+    }
+    return layout;
+}
+
+// interleaved RGBE texels of a scanline checked by skipScanline(), planes is scratch of 4 * width
+void decodeScanline(const uint8_t* p, int width, uint8_t* pPlanes, uint8_t* pTarget) {
+    if (!isRunLength(p, 4, width)) {
+        memcpy(pTarget, p, 4 * size_t(width));
+        return;
+    }
+    p += 4;
+    // runs and literals are contiguous in a plane, they are interleaved at the end
+    for (int component = 0; component < 4; ++component) {
+        uint8_t* pPlane = pPlanes + component * size_t(width);
+        for (int x = 0; x < width;) {
+            const int count = *p++;
+            if (count > 128) {
+                memset(pPlane + x, *p++, count - 128);
+                x += count - 128;
+            } else {
+                memcpy(pPlane + x, p, count);
+                p += count;
+                x += count;
+            }
+        }
+    }
+    const uint8_t* pR = pPlanes;
+    const uint8_t* pG = pR + width;
+    const uint8_t* pB = pG + width;
+    const uint8_t* pE = pB + width;
+    for (int x = 0; x < width; ++x) {
+        pTarget[4 * x + 0] = pR[x];
+        pTarget[4 * x + 1] = pG[x];
+        pTarget[4 * x + 2] = pB[x];
+        pTarget[4 * x + 3] = pE[x];
+    }
+}
+
+size_t bytesPerTexel(HdrFormat format) {
+    switch (format) {
+        case HdrFormat::FLOAT16:
+            return 3 * sizeof(half_t);
+        case HdrFormat::RGB9E5:
+            return sizeof(uint32_t);
+        default:
+            return 3 * sizeof(float);
+    }
+}
+
+}  // namespace
+
+Image DecodeHdr(const uint8_t* pData, size_t size, HdrFormat format, int maxWidth, const string& name) {
+    const HdrLayout layout = parse(pData, size, name);
+    int reduction = 1;
+    while (maxWidth > 0 && layout.width / reduction > maxWidth && layout.height / (2 * reduction) > 0)
+        reduction *= 2;
+
+    Image image;
+    image.width = layout.width / reduction;
+    image.height = layout.height / reduction;
+    image.component = 3;
+    image.dataType = format == HdrFormat::FLOAT16 ? DataType::FLOAT_16T : format == HdrFormat::RGB9E5 ? DataType::RGB9E5 : DataType::FLOAT_32T;
+    const size_t rowSize = image.width * bytesPerTexel(format);
+    image.Allocate(rowSize * image.height);
+    uint8_t* pImage = static_cast<uint8_t*>(image.buffer.pData);
+
+    JobSystem::GetSingleton().ParallelFor("decode hdr", image.height, [&](int y, int) {
+        LinearArena& scratch = GetScratchArena();
+        ArenaScope scope(scratch);
+        uint8_t* pPlanes = scratch.AllocateArray<uint8_t>(4 * size_t(layout.width));
+        uint8_t* pRgbe = scratch.AllocateArray<uint8_t>(4 * size_t(layout.width));
+        uint8_t* pRow = pImage + y * rowSize;
+        // full size float rows go straight into the image
+        float* pTexels = reduction == 1 && format == HdrFormat::FLOAT32 ? reinterpret_cast<float*>(pRow)
+                                                                         : scratch.AllocateArray<float>(3 * size_t(layout.width));
+        float* pSums = nullptr;
+        if (reduction > 1) {
+            pSums = scratch.AllocateArray<float>(3 * size_t(image.width));
+            std::fill(pSums, pSums + 3 * size_t(image.width), 0.0f);
+        }
+
+        for (int row = 0; row < reduction; ++row) {
+            decodeScanline(pData + layout.scanlines[y * reduction + row], layout.width, pPlanes, pRgbe);
+            kernels::RgbeToFloat(pRgbe, pTexels, layout.width);
+            if (reduction == 1)
+                break;
+            for (int x = 0; x < image.width; ++x) {
+                const float* pBlock = pTexels + 3 * size_t(x) * reduction;
+                float* pSum = pSums + 3 * x;
+                for (int i = 0; i < 3 * reduction; i += 3) {
+                    pSum[0] += pBlock[i + 0];
+                    pSum[1] += pBlock[i + 1];
+                    pSum[2] += pBlock[i + 2];
+                }
+            }
+        }
+        if (reduction > 1) {
+            const float scale = 1.0f / (reduction * reduction);
+            for (size_t i = 0; i < 3 * size_t(image.width); ++i)
+                pSums[i] *= scale;
+            pTexels = pSums;
+        }
+
+        const size_t count = 3 * size_t(image.width);
+        switch (format) {
+            case HdrFormat::FLOAT32:
+                if (reinterpret_cast<uint8_t*>(pTexels) != pRow)
+                    memcpy(pRow, pTexels, rowSize);
+                break;
+            case HdrFormat::FLOAT16:
+                // the sun of an outdoor environment can be brighter than a half, it saturates instead of turning infinite
+                for (size_t i = 0; i < count; ++i)
+                    pTexels[i] = std::min(pTexels[i], HALF_MAX);
+                kernels::FloatToHalf(pTexels, reinterpret_cast<half_t*>(pRow), count);
+                break;
+            case HdrFormat::RGB9E5:
+                kernels::FloatToRgb9e5(pTexels, reinterpret_cast<uint32_t*>(pRow), image.width);
+                break;
+        }
+    });
+    return image;
+}
+
+}  // namespace pbr
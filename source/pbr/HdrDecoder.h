@@ -0,0 +1,19 @@
+#pragma once
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// what DecodeHdr() writes, RGB texels of 12, 6 or 4 bytes
+enum class HdrFormat {
+    FLOAT32,
+    FLOAT16,  // clamped to the largest half, 65504
+    RGB9E5,   // DataType::RGB9E5, GL_RGB9_E5 texels
+};
+
+// Radiance .hdr files of RGBE texels, flat or run length encoded scanlines in -Y H +X W order. The
+// scanlines are located in one pass over the file and decoded on the job system, which must be
+// initialized. A maxWidth above 0 halves the image until it is at most that wide, the texels of each
+// 2^n x 2^n block are averaged as they are decoded, e.g. an environment only the bake samples.
+Image DecodeHdr(const uint8_t* pData, size_t size, HdrFormat format, int maxWidth, const string& name);
+
+}  // namespace pbr
@@ -0,0 +1,1116 @@
+#include "ImageKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+// x86 builds compile the SSE4.1 and AVX2 kernels whatever the target, cpuid decides which of them run
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PBR_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PBR_TARGET_SSE41
+#define PBR_TARGET_AVX2
+#else
+#define PBR_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define PBR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define PBR_KERNELS_X86 0
+#endif
+
+// gcc's -O3 vectorizer stores strided bytes one extract at a time, slower than the scalar loop
+#if defined(__GNUC__) && !defined(__clang__)
+#define PBR_NO_VECTORIZE __attribute__((optimize("no-tree-vectorize")))
+#else
+#define PBR_NO_VECTORIZE
+#endif
+
+namespace pbr {
+namespace kernels {
+
+namespace {
+
+// elements of a job, shorter runs stay on the calling thread
+constexpr size_t CHUNK_SIZE = 1 << 16;
+// Kaiser taps of a target texel, at -2.5 to 2.5 source texels from its center
+constexpr int KAISER_TAPS = 6;
+
+// a swizzle as a byte shuffle of 4 pixels, the form the SIMD versions apply
+struct Shuffle {
+    array<int, 4> map;
+    alignas(16) uint8_t index[16];  // of the source byte, 0x80 gives 0
+    alignas(16) uint8_t keep[16];   // 0xFF where the target byte stays
+    alignas(16) uint8_t one[16];    // 0xFF where the target byte is 255
+};
+
+struct KernelTable {
+    void (*swizzle)(const uint8_t*, int, uint8_t*, int, const Shuffle&, size_t);
+    void (*floatToHalf)(const float*, half_t*, size_t);
+    void (*halfToFloat)(const half_t*, float*, size_t);
+    void (*unormToFloat)(const uint8_t*, float*, size_t);
+    void (*floatToUnorm)(const float*, uint8_t*, size_t);
+    void (*rgbeToFloat)(const uint8_t*, float*, size_t);
+    void (*floatToRgb9e5)(const float*, uint32_t*, size_t);
+    // a target row of the 2x2 average of two source rows, 8 bit
+    void (*boxRow)(const uint8_t*, const uint8_t*, uint8_t*, int, int, int);
+    // the same in float
+    void (*averageRows)(const float*, const float*, float*, int, int, int);
+    // the horizontal Kaiser pass of a row
+    void (*kaiserRow)(const float*, float*, int, int, int);
+    // the vertical Kaiser pass, the weighted sum of KAISER_TAPS rows
+    void (*kaiserColumns)(const float* const*, float*, size_t);
+};
+
+template <typename Function>
+void forChunks(const char* name, size_t count, const Function& function) {
+    if (count <= CHUNK_SIZE) {
+        function(size_t(0), count);
+        return;
+    }
+    const int chunkCount = static_cast<int>((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    JobSystem::GetSingleton().ParallelFor(name, chunkCount, [&](int chunk, int) {
+        const size_t begin = chunk * CHUNK_SIZE;
+        function(begin, std::min(begin + CHUNK_SIZE, count));
+    }, 1);
+}
+
+float bitsToFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// zeroth order modified Bessel function of the first kind
+double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// sinc of the halved frequency under a Kaiser window of radius 3 and alpha 4, normalized
+const float* kaiserWeights() {
+    static const array<float, KAISER_TAPS> s_weights = [] {
+        array<double, KAISER_TAPS> weights;
+        double sum = 0.0;
+        for (int k = 0; k < KAISER_TAPS; ++k) {
+            const double d = k - 2.5;
+            const double x = 3.14159265358979 * d / 2.0;
+            const double window = besselI0(4.0 * std::sqrt(1.0 - (d / 3.0) * (d / 3.0))) / besselI0(4.0);
+            weights[k] = std::sin(x) / x * window;
+            sum += weights[k];
+        }
+        array<float, KAISER_TAPS> result;
+        for (int k = 0; k < KAISER_TAPS; ++k)
+            result[k] = static_cast<float>(weights[k] / sum);
+        return result;
+    }();
+    return s_weights.data();
+}
+
+// 8 bit sRGB of linear light quantized to 16 bits
+const uint8_t* srgbEncodeTable() {
+    static const vector<uint8_t> s_table = [] {
+        vector<uint8_t> table(65536);
+        for (size_t i = 0; i < table.size(); ++i) {
+            const double linear = i / 65535.0;
+            const double srgb = linear <= 0.0031308 ? 12.92 * linear : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            table[i] = static_cast<uint8_t>(std::lround(srgb * 255.0));
+        }
+        return table;
+    }();
+    return s_table.data();
+}
+
+const float* srgbDecodeTable() {
+    static const array<float, 256> s_table = [] {
+        array<float, 256> table;
+        for (int i = 0; i < 256; ++i) {
+            const double srgb = i / 255.0;
+            table[i] = static_cast<float>(srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4));
+        }
+        return table;
+    }();
+    return s_table.data();
+}
+
+//------------------------------------------------------------------------------
+// scalar reference, the SIMD versions give the same bits
+
+// every channel of the target is its own source channel, a constant or kept, a texel is a word masked bytewise.
+// The word read runs past the last texels of a source narrower than 4 bytes, they are read byte by byte
+template <int SOURCE_COMPONENT, int TARGET_COMPONENT, bool READ_TARGET>
+void swizzleMasked(const uint8_t* pSource, uint8_t* pTarget, uint32_t sourceMask, uint32_t keepMask, uint32_t one, size_t count) {
+    auto write = [&](uint32_t source, uint8_t* pOut) {
+        uint32_t target = 0;
+        if (READ_TARGET)
+            memcpy(&target, pOut, TARGET_COMPONENT);
+        target = (source & sourceMask) | (target & keepMask) | one;
+        memcpy(pOut, &target, TARGET_COMPONENT);
+    };
+    auto writeWord = [&](size_t i) {
+        uint32_t source;
+        memcpy(&source, pSource + i * SOURCE_COMPONENT, 4);
+        write(source, pTarget + i * TARGET_COMPONENT);
+    };
+    const size_t wordCount = count * SOURCE_COMPONENT >= 4 ? (count * SOURCE_COMPONENT - 4) / SOURCE_COMPONENT + 1 : 0;
+    size_t i = 0;
+    // unrolled, the loop itself costs as much as a texel
+    for (; i + 4 <= wordCount; i += 4) {
+        writeWord(i);
+        writeWord(i + 1);
+        writeWord(i + 2);
+        writeWord(i + 3);
+    }
+    for (; i < wordCount; ++i)
+        writeWord(i);
+    for (; i < count; ++i) {
+        uint32_t source = 0;
+        memcpy(&source, pSource + i * SOURCE_COMPONENT, SOURCE_COMPONENT);
+        write(source, pTarget + i * TARGET_COMPONENT);
+    }
+}
+
+// a SOURCE_STRIDE of 0 fills the channel with *pIn
+template <int SOURCE_STRIDE, int TARGET_COMPONENT>
+PBR_NO_VECTORIZE void copyChannel(const uint8_t* pIn, uint8_t* pOut, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        pOut[i * TARGET_COMPONENT] = pIn[i * SOURCE_STRIDE];
+        pOut[(i + 1) * TARGET_COMPONENT] = pIn[(i + 1) * SOURCE_STRIDE];
+        pOut[(i + 2) * TARGET_COMPONENT] = pIn[(i + 2) * SOURCE_STRIDE];
+        pOut[(i + 3) * TARGET_COMPONENT] = pIn[(i + 3) * SOURCE_STRIDE];
+    }
+    for (; i < count; ++i)
+        pOut[i * TARGET_COMPONENT] = pIn[i * SOURCE_STRIDE];
+}
+
+// a pixel at a time where the channels stay in place, like the loops the kernels replaced, channels that move
+// a pass per channel over tiles that stay in the L1 cache. A pass over the whole image walks it once per channel
+template <int SOURCE_COMPONENT, int TARGET_COMPONENT>
+void swizzleScalar(const uint8_t* pSource, uint8_t* pTarget, const Shuffle& shuffle, size_t count) {
+    // the masks are built bytewise, they work the same on either endianness
+    bool masked = true;
+    uint8_t sourceBytes[4] = {}, keepBytes[4] = {}, oneBytes[4] = {};
+    for (int c = 0; c < TARGET_COMPONENT; ++c) {
+        const int channel = shuffle.map[c];
+        masked &= channel < 0 || channel == c;
+        sourceBytes[c] = channel >= 0 ? 255 : 0;
+        keepBytes[c] = channel == KEEP ? 255 : 0;
+        oneBytes[c] = channel == ONE ? 255 : 0;
+    }
+    if (masked) {
+        uint32_t sourceMask, keepMask, one;
+        memcpy(&sourceMask, sourceBytes, 4);
+        memcpy(&keepMask, keepBytes, 4);
+        memcpy(&one, oneBytes, 4);
+        if (keepMask)
+            return swizzleMasked<SOURCE_COMPONENT, TARGET_COMPONENT, true>(pSource, pTarget, sourceMask, keepMask, one, count);
+        return swizzleMasked<SOURCE_COMPONENT, TARGET_COMPONENT, false>(pSource, pTarget, sourceMask, keepMask, one, count);
+    }
+
+    constexpr size_t TILE = 1024;
+    for (size_t begin = 0; begin < count; begin += TILE) {
+        const size_t tileCount = std::min(TILE, count - begin);
+        for (int c = 0; c < TARGET_COMPONENT; ++c) {
+            const int channel = shuffle.map[c];
+            if (channel == KEEP)
+                continue;
+            uint8_t* pOut = pTarget + begin * TARGET_COMPONENT + c;
+            if (channel < 0) {
+                const uint8_t value = channel == ONE ? 255 : 0;
+                copyChannel<0, TARGET_COMPONENT>(&value, pOut, tileCount);
+            } else {
+                copyChannel<SOURCE_COMPONENT, TARGET_COMPONENT>(pSource + begin * SOURCE_COMPONENT + channel, pOut, tileCount);
+            }
+        }
+    }
+}
+
+template <int SOURCE_COMPONENT>
+void swizzleScalar(const uint8_t* pSource, uint8_t* pTarget, int targetComponent, const Shuffle& shuffle, size_t count) {
+    switch (targetComponent) {
+        case 1:
+            return swizzleScalar<SOURCE_COMPONENT, 1>(pSource, pTarget, shuffle, count);
+        case 2:
+            return swizzleScalar<SOURCE_COMPONENT, 2>(pSource, pTarget, shuffle, count);
+        case 3:
+            return swizzleScalar<SOURCE_COMPONENT, 3>(pSource, pTarget, shuffle, count);
+        default:
+            return swizzleScalar<SOURCE_COMPONENT, 4>(pSource, pTarget, shuffle, count);
+    }
+}
+
+void swizzleScalar(const uint8_t* pSource, int sourceComponent, uint8_t* pTarget, int targetComponent, const Shuffle& shuffle, size_t count) {
+    switch (sourceComponent) {
+        case 1:
+            return swizzleScalar<1>(pSource, pTarget, targetComponent, shuffle, count);
+        case 2:
+            return swizzleScalar<2>(pSource, pTarget, targetComponent, shuffle, count);
+        case 3:
+            return swizzleScalar<3>(pSource, pTarget, targetComponent, shuffle, count);
+        default:
+            return swizzleScalar<4>(pSource, pTarget, targetComponent, shuffle, count);
+    }
+}
+
+// pbr::FloatToHalf() without its branches, they mispredict on every other texel of a lookup table
+inline half_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t magnitude = bits & 0x7FFFFFFFu;
+    // rebias the exponent, round the 13 dropped bits to nearest even
+    uint32_t result = (magnitude - (112u << 23) + 0xFFFu + ((magnitude >> 13) & 1u)) >> 13;
+    // below the smallest normal half the FPU rounds: the mantissa bits of 0.5 + |value| are the subnormal
+    float absolute;
+    memcpy(&absolute, &magnitude, sizeof(absolute));
+    const float shifted = absolute + 0.5f;
+    uint32_t subnormal;
+    memcpy(&subnormal, &shifted, sizeof(subnormal));
+    subnormal -= 126u << 23;
+    result = magnitude < (113u << 23) ? subnormal : result;
+    result = magnitude > 0x477FFFFFu ? 0x7C00u : result;
+    result = magnitude > 0x7F800000u ? 0x7E00u : result;
+    return static_cast<half_t>(sign | result);
+}
+
+void floatToHalfScalar(const float* pSource, half_t* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        pTarget[i] = floatToHalf(pSource[i]);
+}
+
+void halfToFloatScalar(const half_t* pSource, float* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        pTarget[i] = pbr::HalfToFloat(pSource[i]);
+}
+
+void unormToFloatScalar(const uint8_t* pSource, float* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        pTarget[i] = pSource[i] / 255.0f;
+}
+
+// NaN is 0
+inline uint8_t floatToUnorm(float value) {
+    const float clamped = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+    return static_cast<uint8_t>(static_cast<int>(clamped * 255.0f + 0.5f));
+}
+
+void floatToUnormScalar(const float* pSource, uint8_t* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        pTarget[i] = floatToUnorm(pSource[i]);
+}
+
+void rgbeToFloatScalar(const uint8_t* pSource, float* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* pIn = pSource + 4 * i;
+        // 2^(e - 128 - 8), the mantissas are 8 bit
+        const float scale = pIn[3] > 9 ? bitsToFloat(static_cast<uint32_t>(pIn[3] - 9) << 23) : 0.0f;
+        for (int c = 0; c < 3; ++c)
+            pTarget[3 * i + c] = pIn[c] * scale;
+    }
+}
+
+// the largest value RGB9E5 holds, 511 / 512 * 2^16
+constexpr float RGB9E5_MAX = 65408.0f;
+
+// EXT_texture_shared_exponent: 9 bit mantissas and a 5 bit exponent biased by 15 shared by the channels
+void floatToRgb9e5Scalar(const float* pSource, uint32_t* pTarget, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float rgb[3];
+        for (int c = 0; c < 3; ++c) {
+            const float value = pSource[3 * i + c];
+            rgb[c] = value > 0.0f ? std::min(value, RGB9E5_MAX) : 0.0f;
+        }
+        const float maximum = std::max(std::max(rgb[0], rgb[1]), rgb[2]);
+        uint32_t bits;
+        memcpy(&bits, &maximum, sizeof(bits));
+        // floor(log2(maximum)) + 16, at least 0
+        int exponent = std::max(static_cast<int>(bits >> 23) - 127, -16) + 16;
+        float scale = bitsToFloat(static_cast<uint32_t>(151 - exponent) << 23);
+        // the largest channel may round up to the next power of two
+        if (static_cast<int>(maximum * scale + 0.5f) == 512) {
+            ++exponent;
+            scale *= 0.5f;
+        }
+        uint32_t texel = static_cast<uint32_t>(exponent) << 27;
+        for (int c = 0; c < 3; ++c)
+            texel |= static_cast<uint32_t>(static_cast<int>(rgb[c] * scale + 0.5f)) << (9 * c);
+        pTarget[i] = texel;
+    }
+}
+
+void boxRowScalarFrom(int x, const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth, int c) {
+    for (; x < targetWidth; ++x) {
+        const int x0 = std::min(2 * x, sourceWidth - 1) * c;
+        const int x1 = std::min(2 * x + 1, sourceWidth - 1) * c;
+        for (int i = 0; i < c; ++i)
+            pOut[x * c + i] = static_cast<uint8_t>((pRow0[x0 + i] + pRow0[x1 + i] + pRow1[x0 + i] + pRow1[x1 + i] + 2) / 4);
+    }
+}
+
+void boxRowScalar(const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth, int c) {
+    boxRowScalarFrom(0, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+void averageRowsScalarFrom(int x, const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth, int c) {
+    for (; x < targetWidth; ++x) {
+        const int x0 = std::min(2 * x, sourceWidth - 1) * c;
+        const int x1 = std::min(2 * x + 1, sourceWidth - 1) * c;
+        for (int i = 0; i < c; ++i)
+            pOut[x * c + i] = (pRow0[x0 + i] + pRow0[x1 + i] + pRow1[x0 + i] + pRow1[x1 + i]) * 0.25f;
+    }
+}
+
+void averageRowsScalar(const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth, int c) {
+    averageRowsScalarFrom(0, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+void kaiserRowScalarFrom(int x, const float* pRow, float* pOut, int sourceWidth, int targetWidth, int c) {
+    const float* pWeights = kaiserWeights();
+    for (; x < targetWidth; ++x) {
+        for (int i = 0; i < c; ++i) {
+            float sum = 0.0f;
+            for (int k = 0; k < KAISER_TAPS; ++k)
+                sum += pWeights[k] * pRow[std::clamp(2 * x - 2 + k, 0, sourceWidth - 1) * c + i];
+            pOut[x * c + i] = sum;
+        }
+    }
+}
+
+void kaiserRowScalar(const float* pRow, float* pOut, int sourceWidth, int targetWidth, int c) {
+    kaiserRowScalarFrom(0, pRow, pOut, sourceWidth, targetWidth, c);
+}
+
+void kaiserColumnsScalar(const float* const* ppRows, float* pOut, size_t count) {
+    const float* pWeights = kaiserWeights();
+    for (size_t i = 0; i < count; ++i) {
+        float sum = 0.0f;
+        for (int k = 0; k < KAISER_TAPS; ++k)
+            sum += pWeights[k] * ppRows[k][i];
+        pOut[i] = sum;
+    }
+}
+
+const KernelTable SCALAR_KERNELS = {
+    swizzleScalar,
+    floatToHalfScalar,
+    halfToFloatScalar,
+    unormToFloatScalar,
+    floatToUnormScalar,
+    rgbeToFloatScalar,
+    floatToRgb9e5Scalar,
+    boxRowScalar,
+    averageRowsScalar,
+    kaiserRowScalar,
+    kaiserColumnsScalar,
+};
+
+#if PBR_KERNELS_X86
+//------------------------------------------------------------------------------
+// SSE4.1
+
+PBR_TARGET_SSE41 void swizzleSse41(const uint8_t* pSource, int sourceComponent, uint8_t* pTarget, int targetComponent, const Shuffle& shuffle, size_t count) {
+    const __m128i index = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.index));
+    const __m128i keep = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.keep));
+    const __m128i one = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.one));
+    size_t i = 0;
+    // 4 pixels a step, the 16 byte loads and stores stay in the run, the target bytes past the
+    // 4 pixels are kept and written again by the next step
+    for (; (count - i) * sourceComponent >= 16 && (count - i) * targetComponent >= 16; i += 4) {
+        const __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i * sourceComponent));
+        __m128i* pOut = reinterpret_cast<__m128i*>(pTarget + i * targetComponent);
+        const __m128i target = _mm_and_si128(_mm_loadu_si128(pOut), keep);
+        _mm_storeu_si128(pOut, _mm_or_si128(_mm_or_si128(target, _mm_shuffle_epi8(source, index)), one));
+    }
+    swizzleScalar(pSource + i * sourceComponent, sourceComponent, pTarget + i * targetComponent, targetComponent, shuffle, count - i);
+}
+
+PBR_TARGET_SSE41 inline __m128i floatToHalf4(__m128 value) {
+    const __m128i bits = _mm_castps_si128(value);
+    const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+    const __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+    // rebias the exponent, round the 13 dropped bits to nearest even
+    const __m128i odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+    const __m128i rebiased = _mm_sub_epi32(magnitude, _mm_set1_epi32(112 << 23));
+    __m128i result = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(rebiased, _mm_set1_epi32(0xFFF)), odd), 13);
+    // below the smallest normal half the FPU rounds: the mantissa bits of 0.5 + |value| are the subnormal
+    const __m128 half = _mm_castsi128_ps(_mm_set1_epi32(126 << 23));
+    const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), half)), _mm_castps_si128(half));
+    result = _mm_blendv_epi8(result, subnormal, _mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23)));
+    result = _mm_blendv_epi8(result, _mm_set1_epi32(0x7C00), _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x477FFFFF)));
+    result = _mm_blendv_epi8(result, _mm_set1_epi32(0x7E00), _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000)));
+    return _mm_or_si128(result, sign);
+}
+
+PBR_TARGET_SSE41 void floatToHalfSse41(const float* pSource, half_t* pTarget, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i low = floatToHalf4(_mm_loadu_ps(pSource + i));
+        const __m128i high = floatToHalf4(_mm_loadu_ps(pSource + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pTarget + i), _mm_packus_epi32(low, high));
+    }
+    floatToHalfScalar(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_SSE41 inline __m128 halfToFloat4(__m128i half) {
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    __m128i bits = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7FFF)), 13);
+    const __m128i exponent = _mm_and_si128(bits, _mm_set1_epi32(0x0F800000));
+    bits = _mm_add_epi32(bits, _mm_set1_epi32(112 << 23));
+    // infinity and NaN keep the largest exponent
+    bits = _mm_add_epi32(bits, _mm_and_si128(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x0F800000)), _mm_set1_epi32(112 << 23)));
+    // subnormals and zero are normalized by the FPU
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+    const __m128 subnormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(1 << 23))), magic);
+    const __m128i isSubnormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+    bits = _mm_blendv_epi8(bits, _mm_castps_si128(subnormal), isSubnormal);
+    return _mm_castsi128_ps(_mm_or_si128(bits, sign));
+}
+
+PBR_TARGET_SSE41 void halfToFloatSse41(const half_t* pSource, float* pTarget, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i));
+        _mm_storeu_ps(pTarget + i, halfToFloat4(_mm_cvtepu16_epi32(halves)));
+        _mm_storeu_ps(pTarget + i + 4, halfToFloat4(_mm_cvtepu16_epi32(_mm_srli_si128(halves, 8))));
+    }
+    halfToFloatScalar(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_SSE41 void unormToFloatSse41(const uint8_t* pSource, float* pTarget, size_t count) {
+    const __m128 scale = _mm_set1_ps(255.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i));
+        _mm_storeu_ps(pTarget + i, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes)), scale));
+        _mm_storeu_ps(pTarget + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4))), scale));
+        _mm_storeu_ps(pTarget + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8))), scale));
+        _mm_storeu_ps(pTarget + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12))), scale));
+    }
+    unormToFloatScalar(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_SSE41 inline __m128i floatToUnorm4(__m128 value) {
+    // max returns its second operand for NaN
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+PBR_TARGET_SSE41 void floatToUnormSse41(const float* pSource, uint8_t* pTarget, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i low = _mm_packus_epi32(floatToUnorm4(_mm_loadu_ps(pSource + i)), floatToUnorm4(_mm_loadu_ps(pSource + i + 4)));
+        const __m128i high = _mm_packus_epi32(floatToUnorm4(_mm_loadu_ps(pSource + i + 8)), floatToUnorm4(_mm_loadu_ps(pSource + i + 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pTarget + i), _mm_packus_epi16(low, high));
+    }
+    floatToUnormScalar(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_SSE41 inline __m128 rgbeScale(__m128i texel) {
+    const __m128i exponent = _mm_shuffle_epi32(texel, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i bits = _mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(9)), 23);
+    return _mm_castsi128_ps(_mm_and_si128(bits, _mm_cmpgt_epi32(exponent, _mm_set1_epi32(9))));
+}
+
+PBR_TARGET_SSE41 void rgbeToFloatSse41(const uint8_t* pSource, float* pTarget, size_t count) {
+    size_t i = 0;
+    // a pixel is stored as 4 floats, the fourth is overwritten by the next pixel
+    for (; i + 5 <= count; i += 4) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + 4 * i));
+        const __m128i texels[4] = { _mm_cvtepu8_epi32(bytes), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)),
+                                    _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)) };
+        for (int p = 0; p < 4; ++p)
+            _mm_storeu_ps(pTarget + 3 * (i + p), _mm_mul_ps(_mm_cvtepi32_ps(texels[p]), rgbeScale(texels[p])));
+    }
+    rgbeToFloatScalar(pSource + 4 * i, pTarget + 3 * i, count - i);
+}
+
+PBR_TARGET_SSE41 void floatToRgb9e5Sse41(const float* pSource, uint32_t* pTarget, size_t count) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maximum = _mm_set1_ps(RGB9E5_MAX);
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3 to the channels of 4 texels
+        const __m128 a = _mm_loadu_ps(pSource + 3 * i);
+        const __m128 b = _mm_loadu_ps(pSource + 3 * i + 4);
+        const __m128 c = _mm_loadu_ps(pSource + 3 * i + 8);
+        __m128 red = _mm_blend_ps(_mm_blend_ps(a, b, 0x4), c, 0x2);
+        __m128 green = _mm_blend_ps(_mm_blend_ps(a, b, 0x9), c, 0x4);
+        __m128 blue = _mm_blend_ps(_mm_blend_ps(a, b, 0x2), c, 0x9);
+        red = _mm_min_ps(_mm_max_ps(_mm_shuffle_ps(red, red, _MM_SHUFFLE(1, 2, 3, 0)), zero), maximum);
+        green = _mm_min_ps(_mm_max_ps(_mm_shuffle_ps(green, green, _MM_SHUFFLE(2, 3, 0, 1)), zero), maximum);
+        blue = _mm_min_ps(_mm_max_ps(_mm_shuffle_ps(blue, blue, _MM_SHUFFLE(3, 0, 1, 2)), zero), maximum);
+
+        const __m128 largest = _mm_max_ps(_mm_max_ps(red, green), blue);
+        const __m128i log2 = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(largest), 23), _mm_set1_epi32(127));
+        __m128i exponent = _mm_add_epi32(_mm_max_epi32(log2, _mm_set1_epi32(-16)), _mm_set1_epi32(16));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(151), exponent), 23));
+        const __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(largest, scale), half));
+        const __m128i carry = _mm_cmpeq_epi32(rounded, _mm_set1_epi32(512));
+        exponent = _mm_sub_epi32(exponent, carry);
+        scale = _mm_blendv_ps(scale, _mm_mul_ps(scale, half), _mm_castsi128_ps(carry));
+
+        __m128i texel = _mm_slli_epi32(exponent, 27);
+        texel = _mm_or_si128(texel, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(red, scale), half)));
+        texel = _mm_or_si128(texel, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(green, scale), half)), 9));
+        texel = _mm_or_si128(texel, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(blue, scale), half)), 18));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pTarget + i), texel);
+    }
+    floatToRgb9e5Scalar(pSource + 3 * i, pTarget + i, count - i);
+}
+
+// 4 channels, 2 target texels a step
+PBR_TARGET_SSE41 int boxRowSse41Main(const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth, int x) {
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= targetWidth && 2 * x + 4 <= sourceWidth; x += 2) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + 8 * x));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + 8 * x));
+        __m128i low = _mm_add_epi16(_mm_cvtepu8_epi16(a), _mm_cvtepu8_epi16(b));
+        __m128i high = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)));
+        low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+        high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+        const __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + 4 * x), _mm_packus_epi16(sum, sum));
+    }
+    return x;
+}
+
+void boxRowSse41(const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth, int c) {
+    const int x = c == 4 ? boxRowSse41Main(pRow0, pRow1, pOut, sourceWidth, targetWidth, 0) : 0;
+    boxRowScalarFrom(x, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+PBR_TARGET_SSE41 int averageRowsSse41Main(const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth, int x) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; x < targetWidth && 2 * x + 2 <= sourceWidth; ++x) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(pRow0 + 8 * x), _mm_loadu_ps(pRow0 + 8 * x + 4));
+        sum = _mm_add_ps(_mm_add_ps(sum, _mm_loadu_ps(pRow1 + 8 * x)), _mm_loadu_ps(pRow1 + 8 * x + 4));
+        _mm_storeu_ps(pOut + 4 * x, _mm_mul_ps(sum, quarter));
+    }
+    return x;
+}
+
+void averageRowsSse41(const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth, int c) {
+    const int x = c == 4 ? averageRowsSse41Main(pRow0, pRow1, pOut, sourceWidth, targetWidth, 0) : 0;
+    averageRowsScalarFrom(x, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+// the texels whose taps are all inside the row, the ones at the edges clamp
+PBR_TARGET_SSE41 void kaiserRowSse41Main(const float* pRow, float* pOut, int begin, int end) {
+    const float* pWeights = kaiserWeights();
+    for (int x = begin; x < end; ++x) {
+        const float* pIn = pRow + 4 * (2 * x - 2);
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pWeights[k]), _mm_loadu_ps(pIn + 4 * k)));
+        _mm_storeu_ps(pOut + 4 * x, sum);
+    }
+}
+
+// texels [1, end) read source texels 0 to 2 * end + 2
+inline int kaiserInteriorEnd(int sourceWidth, int targetWidth) {
+    return std::max(1, std::min(targetWidth, (sourceWidth - 2) / 2));
+}
+
+void kaiserRowSse41(const float* pRow, float* pOut, int sourceWidth, int targetWidth, int c) {
+    if (c != 4) {
+        kaiserRowScalar(pRow, pOut, sourceWidth, targetWidth, c);
+        return;
+    }
+    const int end = kaiserInteriorEnd(sourceWidth, targetWidth);
+    kaiserRowScalarFrom(0, pRow, pOut, sourceWidth, 1, c);
+    kaiserRowSse41Main(pRow, pOut, 1, end);
+    kaiserRowScalarFrom(end, pRow, pOut, sourceWidth, targetWidth, c);
+}
+
+PBR_TARGET_SSE41 void kaiserColumnsSse41(const float* const* ppRows, float* pOut, size_t count) {
+    const float* pWeights = kaiserWeights();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pWeights[k]), _mm_loadu_ps(ppRows[k] + i)));
+        _mm_storeu_ps(pOut + i, sum);
+    }
+    const float* ppRest[KAISER_TAPS];
+    for (int k = 0; k < KAISER_TAPS; ++k)
+        ppRest[k] = ppRows[k] + i;
+    kaiserColumnsScalar(ppRest, pOut + i, count - i);
+}
+
+const KernelTable SSE41_KERNELS = {
+    swizzleSse41,
+    floatToHalfSse41,
+    halfToFloatSse41,
+    unormToFloatSse41,
+    floatToUnormSse41,
+    rgbeToFloatSse41,
+    floatToRgb9e5Sse41,
+    boxRowSse41,
+    averageRowsSse41,
+    kaiserRowSse41,
+    kaiserColumnsSse41,
+};
+
+//------------------------------------------------------------------------------
+// AVX2, the rest of a run that doesn't fill a step goes to the SSE4.1 version
+
+PBR_TARGET_AVX2 inline __m256i loadPair(const uint8_t* pLow, const uint8_t* pHigh) {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pLow));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHigh));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+
+PBR_TARGET_AVX2 void swizzleAvx2(const uint8_t* pSource, int sourceComponent, uint8_t* pTarget, int targetComponent, const Shuffle& shuffle, size_t count) {
+    const __m256i index = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.index)));
+    const __m256i keep = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.keep)));
+    const __m256i one = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.one)));
+    const int sourceStep = 4 * sourceComponent;
+    const int targetStep = 4 * targetComponent;
+    size_t i = 0;
+    // 2x4 pixels a step, one in each lane, the low lane is stored first so the high one overwrites
+    // the bytes past its 4 pixels
+    for (; (count - i) * sourceComponent >= 16 + size_t(sourceStep) && (count - i) * targetComponent >= 16 + size_t(targetStep); i += 8) {
+        const uint8_t* pIn = pSource + i * sourceComponent;
+        uint8_t* pOut = pTarget + i * targetComponent;
+        const __m256i source = loadPair(pIn, pIn + sourceStep);
+        const __m256i target = _mm256_and_si256(loadPair(pOut, pOut + targetStep), keep);
+        const __m256i result = _mm256_or_si256(_mm256_or_si256(target, _mm256_shuffle_epi8(source, index)), one);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm256_castsi256_si128(result));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + targetStep), _mm256_extracti128_si256(result, 1));
+    }
+    swizzleSse41(pSource + i * sourceComponent, sourceComponent, pTarget + i * targetComponent, targetComponent, shuffle, count - i);
+}
+
+// the same steps as floatToHalf4()
+PBR_TARGET_AVX2 inline __m256i floatToHalf8(__m256 value) {
+    const __m256i bits = _mm256_castps_si256(value);
+    const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+    const __m256i magnitude = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+    const __m256i odd = _mm256_and_si256(_mm256_srli_epi32(magnitude, 13), _mm256_set1_epi32(1));
+    const __m256i rebiased = _mm256_sub_epi32(magnitude, _mm256_set1_epi32(112 << 23));
+    __m256i result = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(rebiased, _mm256_set1_epi32(0xFFF)), odd), 13);
+    const __m256 half = _mm256_castsi256_ps(_mm256_set1_epi32(126 << 23));
+    const __m256i subnormal = _mm256_sub_epi32(_mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(magnitude), half)), _mm256_castps_si256(half));
+    result = _mm256_blendv_epi8(result, subnormal, _mm256_cmpgt_epi32(_mm256_set1_epi32(113 << 23), magnitude));
+    result = _mm256_blendv_epi8(result, _mm256_set1_epi32(0x7C00), _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(0x477FFFFF)));
+    result = _mm256_blendv_epi8(result, _mm256_set1_epi32(0x7E00), _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(0x7F800000)));
+    return _mm256_or_si256(result, sign);
+}
+
+PBR_TARGET_AVX2 void floatToHalfAvx2(const float* pSource, half_t* pTarget, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // the pack interleaves the lanes
+        const __m256i packed = _mm256_packus_epi32(floatToHalf8(_mm256_loadu_ps(pSource + i)), floatToHalf8(_mm256_loadu_ps(pSource + i + 8)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pTarget + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    floatToHalfSse41(pSource + i, pTarget + i, count - i);
+}
+
+// the same steps as halfToFloat4()
+PBR_TARGET_AVX2 inline __m256 halfToFloat8(__m256i half) {
+    const __m256i sign = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x8000)), 16);
+    __m256i bits = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x7FFF)), 13);
+    const __m256i exponent = _mm256_and_si256(bits, _mm256_set1_epi32(0x0F800000));
+    bits = _mm256_add_epi32(bits, _mm256_set1_epi32(112 << 23));
+    bits = _mm256_add_epi32(bits, _mm256_and_si256(_mm256_cmpeq_epi32(exponent, _mm256_set1_epi32(0x0F800000)), _mm256_set1_epi32(112 << 23)));
+    const __m256 magic = _mm256_castsi256_ps(_mm256_set1_epi32(113 << 23));
+    const __m256 subnormal = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_add_epi32(bits, _mm256_set1_epi32(1 << 23))), magic);
+    bits = _mm256_blendv_epi8(bits, _mm256_castps_si256(subnormal), _mm256_cmpeq_epi32(exponent, _mm256_setzero_si256()));
+    return _mm256_castsi256_ps(_mm256_or_si256(bits, sign));
+}
+
+PBR_TARGET_AVX2 void halfToFloatAvx2(const half_t* pSource, float* pTarget, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + i + 8));
+        _mm256_storeu_ps(pTarget + i, halfToFloat8(_mm256_cvtepu16_epi32(low)));
+        _mm256_storeu_ps(pTarget + i + 8, halfToFloat8(_mm256_cvtepu16_epi32(high)));
+    }
+    halfToFloatSse41(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_AVX2 void unormToFloatAvx2(const uint8_t* pSource, float* pTarget, size_t count) {
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        for (int part = 0; part < 4; ++part) {
+            const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSource + i + 8 * part));
+            _mm256_storeu_ps(pTarget + i + 8 * part, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale));
+        }
+    }
+    unormToFloatSse41(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_AVX2 inline __m256i floatToUnorm8(__m256 value) {
+    const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(clamped, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+PBR_TARGET_AVX2 void floatToUnormAvx2(const float* pSource, uint8_t* pTarget, size_t count) {
+    // the packs interleave the lanes in 4 byte groups
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i low = _mm256_packus_epi32(floatToUnorm8(_mm256_loadu_ps(pSource + i)), floatToUnorm8(_mm256_loadu_ps(pSource + i + 8)));
+        const __m256i high = _mm256_packus_epi32(floatToUnorm8(_mm256_loadu_ps(pSource + i + 16)), floatToUnorm8(_mm256_loadu_ps(pSource + i + 24)));
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pTarget + i), bytes);
+    }
+    floatToUnormSse41(pSource + i, pTarget + i, count - i);
+}
+
+PBR_TARGET_AVX2 void rgbeToFloatAvx2(const uint8_t* pSource, float* pTarget, size_t count) {
+    size_t i = 0;
+    // 2 pixels in a register, stored as 4 floats each like rgbeToFloatSse41()
+    for (; i + 9 <= count; i += 8) {
+        for (int p = 0; p < 8; p += 2) {
+            const __m256i texels = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSource + 4 * (i + p))));
+            const __m256i exponent = _mm256_shuffle_epi32(texels, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m256i bits = _mm256_slli_epi32(_mm256_sub_epi32(exponent, _mm256_set1_epi32(9)), 23);
+            const __m256 scale = _mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_cmpgt_epi32(exponent, _mm256_set1_epi32(9))));
+            const __m256 rgb = _mm256_mul_ps(_mm256_cvtepi32_ps(texels), scale);
+            _mm_storeu_ps(pTarget + 3 * (i + p), _mm256_castps256_ps128(rgb));
+            _mm_storeu_ps(pTarget + 3 * (i + p + 1), _mm256_extractf128_ps(rgb, 1));
+        }
+    }
+    rgbeToFloatSse41(pSource + 4 * i, pTarget + 3 * i, count - i);
+}
+
+// 4 channels, 4 target texels a step
+PBR_TARGET_AVX2 int boxRowAvx2Main(const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth) {
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 4 <= targetWidth && 2 * x + 8 <= sourceWidth; x += 4) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow0 + 8 * x));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow1 + 8 * x));
+        // a lane holds the vertical sums of a source texel pair
+        __m256i low = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b)));
+        __m256i high = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1)));
+        low = _mm256_add_epi16(low, _mm256_srli_si256(low, 8));
+        high = _mm256_add_epi16(high, _mm256_srli_si256(high, 8));
+        // texels 0 2 | 1 3 to 0 1 2 3
+        __m256i sum = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        sum = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+        const __m256i packed = _mm256_packus_epi16(sum, sum);
+        const __m128i bytes = _mm_unpacklo_epi64(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 4 * x), bytes);
+    }
+    return x;
+}
+
+void boxRowAvx2(const uint8_t* pRow0, const uint8_t* pRow1, uint8_t* pOut, int sourceWidth, int targetWidth, int c) {
+    if (c != 4) {
+        boxRowScalar(pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+        return;
+    }
+    const int x = boxRowSse41Main(pRow0, pRow1, pOut, sourceWidth, targetWidth, boxRowAvx2Main(pRow0, pRow1, pOut, sourceWidth, targetWidth));
+    boxRowScalarFrom(x, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+PBR_TARGET_AVX2 int averageRowsAvx2Main(const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth) {
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int x = 0;
+    for (; x + 2 <= targetWidth && 2 * x + 4 <= sourceWidth; x += 2) {
+        // the even and odd source texels of 2 target texels
+        const __m256 a0 = _mm256_loadu_ps(pRow0 + 8 * x);
+        const __m256 b0 = _mm256_loadu_ps(pRow0 + 8 * x + 8);
+        const __m256 a1 = _mm256_loadu_ps(pRow1 + 8 * x);
+        const __m256 b1 = _mm256_loadu_ps(pRow1 + 8 * x + 8);
+        __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20), _mm256_permute2f128_ps(a0, b0, 0x31));
+        sum = _mm256_add_ps(sum, _mm256_permute2f128_ps(a1, b1, 0x20));
+        sum = _mm256_add_ps(sum, _mm256_permute2f128_ps(a1, b1, 0x31));
+        _mm256_storeu_ps(pOut + 4 * x, _mm256_mul_ps(sum, quarter));
+    }
+    return x;
+}
+
+void averageRowsAvx2(const float* pRow0, const float* pRow1, float* pOut, int sourceWidth, int targetWidth, int c) {
+    if (c != 4) {
+        averageRowsScalar(pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+        return;
+    }
+    const int x = averageRowsSse41Main(pRow0, pRow1, pOut, sourceWidth, targetWidth, averageRowsAvx2Main(pRow0, pRow1, pOut, sourceWidth, targetWidth));
+    averageRowsScalarFrom(x, pRow0, pRow1, pOut, sourceWidth, targetWidth, c);
+}
+
+PBR_TARGET_AVX2 int kaiserRowAvx2Main(const float* pRow, float* pOut, int begin, int end) {
+    const float* pWeights = kaiserWeights();
+    int x = begin;
+    for (; x + 2 <= end; x += 2) {
+        const float* pIn = pRow + 4 * (2 * x - 2);
+        __m256 sum = _mm256_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; ++k) {
+            // the taps of x and x + 1 are 2 texels apart
+            const __m256 taps = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pIn + 4 * k)), _mm_loadu_ps(pIn + 4 * k + 8), 1);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(pWeights[k]), taps));
+        }
+        _mm256_storeu_ps(pOut + 4 * x, sum);
+    }
+    return x;
+}
+
+void kaiserRowAvx2(const float* pRow, float* pOut, int sourceWidth, int targetWidth, int c) {
+    if (c != 4) {
+        kaiserRowScalar(pRow, pOut, sourceWidth, targetWidth, c);
+        return;
+    }
+    const int end = kaiserInteriorEnd(sourceWidth, targetWidth);
+    kaiserRowScalarFrom(0, pRow, pOut, sourceWidth, 1, c);
+    kaiserRowSse41Main(pRow, pOut, kaiserRowAvx2Main(pRow, pOut, 1, end), end);
+    kaiserRowScalarFrom(end, pRow, pOut, sourceWidth, targetWidth, c);
+}
+
+PBR_TARGET_AVX2 void kaiserColumnsAvx2(const float* const* ppRows, float* pOut, size_t count) {
+    const float* pWeights = kaiserWeights();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; ++k)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(pWeights[k]), _mm256_loadu_ps(ppRows[k] + i)));
+        _mm256_storeu_ps(pOut + i, sum);
+    }
+    const float* ppRest[KAISER_TAPS];
+    for (int k = 0; k < KAISER_TAPS; ++k)
+        ppRest[k] = ppRows[k] + i;
+    kaiserColumnsSse41(ppRest, pOut + i, count - i);
+}
+
+const KernelTable AVX2_KERNELS = {
+    swizzleAvx2,
+    floatToHalfAvx2,
+    halfToFloatAvx2,
+    unormToFloatAvx2,
+    floatToUnormAvx2,
+    rgbeToFloatAvx2,
+    // no AVX2 version, RGB texels don't transpose well across its lanes
+    floatToRgb9e5Sse41,
+    boxRowAvx2,
+    averageRowsAvx2,
+    kaiserRowAvx2,
+    kaiserColumnsAvx2,
+};
+#endif  // PBR_KERNELS_X86
+
+//------------------------------------------------------------------------------
+// dispatch
+
+bool cpuSupports(Isa isa) {
+    if (isa == Isa::SCALAR)
+        return true;
+#if PBR_KERNELS_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    // AVX state must be enabled by the OS as well
+    const bool ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    const bool avx2 = ymm && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return isa == Isa::SSE41 ? sse41 : avx2;
+#else
+    return false;
+#endif
+}
+
+Isa& activeIsa() {
+    static Isa s_isa = cpuSupports(Isa::AVX2) ? Isa::AVX2 : cpuSupports(Isa::SSE41) ? Isa::SSE41 : Isa::SCALAR;
+    return s_isa;
+}
+
+const KernelTable& activeKernels() {
+#if PBR_KERNELS_X86
+    switch (activeIsa()) {
+        case Isa::AVX2:
+            return AVX2_KERNELS;
+        case Isa::SSE41:
+            return SSE41_KERNELS;
+        default:
+            break;
+    }
+#endif
+    return SCALAR_KERNELS;
+}
+
+Shuffle makeShuffle(int sourceComponent, int targetComponent, const array<int, 4>& map) {
+    if (sourceComponent < 1 || sourceComponent > 4 || targetComponent < 1 || targetComponent > 4)
+        THROW_EXCEPTION("image: swizzle of " + std::to_string(sourceComponent) + " to " + std::to_string(targetComponent) + " channels");
+    Shuffle shuffle;
+    shuffle.map = map;
+    for (int byte = 0; byte < 16; ++byte) {
+        const int pixel = byte / targetComponent;
+        const int channel = pixel < 4 ? map[byte % targetComponent] : KEEP;
+        if (channel >= sourceComponent || channel < KEEP)
+            THROW_EXCEPTION("image: swizzle reads channel " + std::to_string(channel) + " of " + std::to_string(sourceComponent));
+        shuffle.index[byte] = channel >= 0 ? static_cast<uint8_t>(pixel * sourceComponent + channel) : 0x80;
+        shuffle.keep[byte] = channel == KEEP ? 0xFF : 0;
+        shuffle.one[byte] = channel == ONE ? 0xFF : 0;
+    }
+    return shuffle;
+}
+
+// filtered values of sRGB channels are linear light
+void decodeRow(const KernelTable& table, const uint8_t* pIn, float* pOut, int width, int c, uint32_t srgbMask) {
+    table.unormToFloat(pIn, pOut, static_cast<size_t>(width) * c);
+    if (!srgbMask)
+        return;
+    const float* pSrgb = srgbDecodeTable();
+    for (int i = 0; i < c; ++i) {
+        if (!((srgbMask >> i) & 1))
+            continue;
+        for (int x = 0; x < width; ++x)
+            pOut[x * c + i] = pSrgb[pIn[x * c + i]];
+    }
+}
+
+// all channels, or only the sRGB ones
+void encodeRow(const KernelTable& table, const float* pIn, uint8_t* pOut, int width, int c, uint32_t srgbMask, bool onlySrgb) {
+    if (!onlySrgb)
+        table.floatToUnorm(pIn, pOut, static_cast<size_t>(width) * c);
+    if (!srgbMask)
+        return;
+    const uint8_t* pSrgb = srgbEncodeTable();
+    for (int i = 0; i < c; ++i) {
+        if (!((srgbMask >> i) & 1))
+            continue;
+        for (int x = 0; x < width; ++x) {
+            const float value = pIn[x * c + i];
+            const float clamped = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+            pOut[x * c + i] = pSrgb[static_cast<int>(clamped * 65535.0f + 0.5f)];
+        }
+    }
+}
+
+}  // namespace
+
+Isa ActiveIsa() {
+    return activeIsa();
+}
+
+void SetIsa(Isa isa) {
+    if (!IsSupported(isa))
+        THROW_EXCEPTION(string("image: this CPU has no ") + IsaToString(isa));
+    activeIsa() = isa;
+}
+
+bool IsSupported(Isa isa) {
+    return cpuSupports(isa);
+}
+
+const char* IsaToString(Isa isa) {
+    switch (isa) {
+        case Isa::SSE41:
+            return "SSE4.1";
+        case Isa::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
+
+void Swizzle(const uint8_t* pSource, int sourceComponent, uint8_t* pTarget, int targetComponent, const array<int, 4>& map, size_t pixelCount) {
+    const Shuffle shuffle = makeShuffle(sourceComponent, targetComponent, map);
+    const KernelTable& table = activeKernels();
+    forChunks("swizzle", pixelCount, [&](size_t begin, size_t end) {
+        table.swizzle(pSource + begin * sourceComponent, sourceComponent, pTarget + begin * targetComponent, targetComponent, shuffle, end - begin);
+    });
+}
+
+void FloatToHalf(const float* pSource, half_t* pTarget, size_t count) {
+    const KernelTable& table = activeKernels();
+    forChunks("float to half", count, [&](size_t begin, size_t end) { table.floatToHalf(pSource + begin, pTarget + begin, end - begin); });
+}
+
+void HalfToFloat(const half_t* pSource, float* pTarget, size_t count) {
+    const KernelTable& table = activeKernels();
+    forChunks("half to float", count, [&](size_t begin, size_t end) { table.halfToFloat(pSource + begin, pTarget + begin, end - begin); });
+}
+
+void UnormToFloat(const uint8_t* pSource, float* pTarget, size_t count) {
+    const KernelTable& table = activeKernels();
+    forChunks("unorm to float", count, [&](size_t begin, size_t end) { table.unormToFloat(pSource + begin, pTarget + begin, end - begin); });
+}
+
+void FloatToUnorm(const float* pSource, uint8_t* pTarget, size_t count) {
+    const KernelTable& table = activeKernels();
+    forChunks("float to unorm", count, [&](size_t begin, size_t end) { table.floatToUnorm(pSource + begin, pTarget + begin, end - begin); });
+}
+
+void RgbeToFloat(const uint8_t* pSource, float* pTarget, size_t pixelCount) {
+    const KernelTable& table = activeKernels();
+    forChunks("rgbe to float", pixelCount, [&](size_t begin, size_t end) { table.rgbeToFloat(pSource + 4 * begin, pTarget + 3 * begin, end - begin); });
+}
+
+void FloatToRgb9e5(const float* pSource, uint32_t* pTarget, size_t pixelCount) {
+    const KernelTable& table = activeKernels();
+    forChunks("float to rgb9e5", pixelCount, [&](size_t begin, size_t end) { table.floatToRgb9e5(pSource + 3 * begin, pTarget + begin, end - begin); });
+}
+
+void Downsample(const Image& source, Image& target, MipFilter filter, uint32_t srgbMask) {
+    if (source.dataType != DataType::UINT_8T)
+        THROW_EXCEPTION("image: only 8 bit images are downsampled");
+    const int c = source.component;
+    srgbMask &= (1u << c) - 1;
+    target.width = std::max(1, source.width / 2);
+    target.height = std::max(1, source.height / 2);
+    target.component = c;
+    target.dataType = DataType::UINT_8T;
+    target.Allocate(static_cast<size_t>(target.width) * target.height * c);
+
+    const KernelTable& table = activeKernels();
+    const uint8_t* pSource = static_cast<const uint8_t*>(source.buffer.pData);
+    uint8_t* pTarget = static_cast<uint8_t*>(target.buffer.pData);
+    auto sourceRow = [&](int y) { return pSource + static_cast<size_t>(std::clamp(y, 0, source.height - 1)) * source.width * c; };
+    const size_t sourceFloats = static_cast<size_t>(source.width) * c;
+    const size_t targetFloats = static_cast<size_t>(target.width) * c;
+
+    JobSystem::GetSingleton().ParallelFor("downsample", target.height, [&](int y, int) {
+        // rows of floats
+        LinearArena& scratch = GetScratchArena();
+        ArenaScope scope(scratch);
+        uint8_t* pOut = pTarget + static_cast<size_t>(y) * targetFloats;
+        if (filter == MipFilter::BOX) {
+            table.boxRow(sourceRow(2 * y), sourceRow(2 * y + 1), pOut, source.width, target.width, c);
+            if (!srgbMask)
+                return;
+            // the sRGB channels again, averaged as linear light
+            float* pRows = scratch.AllocateArray<float>(2 * sourceFloats + targetFloats);
+            decodeRow(table, sourceRow(2 * y), pRows, source.width, c, srgbMask);
+            decodeRow(table, sourceRow(2 * y + 1), pRows + sourceFloats, source.width, c, srgbMask);
+            table.averageRows(pRows, pRows + sourceFloats, pRows + 2 * sourceFloats, source.width, target.width, c);
+            encodeRow(table, pRows + 2 * sourceFloats, pOut, target.width, c, srgbMask, true);
+            return;
+        }
+
+        // separable, the vertical pass over the source rows under the target row, then the horizontal one
+        float* pRows = scratch.AllocateArray<float>((KAISER_TAPS + 1) * sourceFloats + targetFloats);
+        const float* ppRows[KAISER_TAPS];
+        for (int k = 0; k < KAISER_TAPS; ++k) {
+            float* pRow = pRows + k * sourceFloats;
+            decodeRow(table, sourceRow(2 * y - 2 + k), pRow, source.width, c, srgbMask);
+            ppRows[k] = pRow;
+        }
+        float* pColumns = pRows + KAISER_TAPS * sourceFloats;
+        float* pFiltered = pColumns + sourceFloats;
+        table.kaiserColumns(ppRows, pColumns, sourceFloats);
+        table.kaiserRow(pColumns, pFiltered, source.width, target.width, c);
+        encodeRow(table, pFiltered, pOut, target.width, c, srgbMask, false);
+    });
+}
+
+}  // namespace kernels
+}  // namespace pbr
@@ -0,0 +1,59 @@
+#pragma once
+#include "base/Definitions.h"
+#include "base/Half.h"
+
+namespace pbr {
+
+// Pixel loops of the image loaders, the mip chain builder and the tools. Every kernel has a scalar
+// reference and SSE4.1 and AVX2 versions that give the same bits. The best version the CPU supports is
+// picked at the first call, other targets run the scalar reference. Long runs are split over the job
+// system, which must be initialized.
+namespace kernels {
+
+enum class Isa {
+    SCALAR,
+    SSE41,
+    AVX2,
+};
+
+// the version the kernels run
+Isa ActiveIsa();
+// at most what the CPU supports, e.g. the scalar reference to compare with
+void SetIsa(Isa isa);
+bool IsSupported(Isa isa);
+const char* IsaToString(Isa isa);
+
+// Swizzle() entries that don't name a channel of the source
+constexpr int ZERO = -1;
+constexpr int ONE = -2;   // 255
+constexpr int KEEP = -3;  // the channel of the target is left as it is
+
+// channel c of every target pixel is channel map[c] of the source pixel, pixels have 1 to 4 channels,
+// e.g. { 0, 1, 2, ONE } expands RGB to opaque RGBA and { KEEP, KEEP, KEEP, 0 } copies into the alpha
+void Swizzle(const uint8_t* pSource, int sourceComponent, uint8_t* pTarget, int targetComponent, const array<int, 4>& map, size_t pixelCount);
+
+// round to nearest even like pbr::FloatToHalf()
+void FloatToHalf(const float* pSource, half_t* pTarget, size_t count);
+void HalfToFloat(const half_t* pSource, float* pTarget, size_t count);
+// [0, 255] to [0, 1] and back, clamped and rounded to nearest
+void UnormToFloat(const uint8_t* pSource, float* pTarget, size_t count);
+void FloatToUnorm(const float* pSource, uint8_t* pTarget, size_t count);
+// Radiance shared exponent texels to float RGB, exponents below 2^-126 decode to zero
+void RgbeToFloat(const uint8_t* pSource, float* pTarget, size_t pixelCount);
+// float RGB texels to GL_RGB9_E5 ones, clamped to [0, 65408] and rounded to nearest, NaN is 0
+void FloatToRgb9e5(const float* pSource, uint32_t* pTarget, size_t pixelCount);
+
+enum class MipFilter {
+    BOX,     // 2x2 average
+    KAISER,  // Kaiser windowed sinc over 6x6 texels, sharper, rings a little at hard edges
+};
+
+// bit c: channel c is sRGB encoded and filtered as linear light
+constexpr uint32_t SRGB_RGB = 0x7;
+
+// the next mip of an 8 bit image, half the size rounded down, an odd last row or column is repeated
+void Downsample(const Image& source, Image& target, MipFilter filter, uint32_t srgbMask = 0);
+
+}  // namespace kernels
+
+}  // namespace pbr
@@ -1,4 +1,9 @@
 #include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
 
 namespace pbr {
 
@@ -67,14 +72,14 @@ Mesh CreateSphereMesh(float radius, uint32_t widthSegment, uint32_t heightSegmen
     const float thetaStart = 0.0f;
     const float thetaLength = Pi;
 
-    vector<vector<uint32_t>> grid;
-    uint32_t index = 0;
+    // the vertices are a grid of rows of widthSegment + 1, stored row by row
+    const uint32_t rowSize = widthSegment + 1;
+    sphere.vertices.reserve(rowSize * (heightSegment + 1));
+    sphere.indices.reserve(2 * widthSegment * heightSegment);
 
     for (uint32_t iy = 0; iy <= heightSegment; ++iy) {
         const float v = (float)iy / (float)heightSegment;
 
-        grid.push_back(vector<uint32_t>(0));
-
         for (uint32_t ix = 0; ix <= widthSegment; ++ix) {
             const float u = (float)ix / (float)widthSegment;
             float x = radius * -1.0f * glm::cos(u * TwoPi) * glm::sin(v * Pi);
@@ -85,16 +90,15 @@ Mesh CreateSphereMesh(float radius, uint32_t widthSegment, uint32_t heightSegmen
 
             sphere.vertices.push_back({ p, glm::normalize(p) });
             // sphere.vertices.push_back({ p, vec2(u, v), glm::normalize(p) });
-            grid.back().push_back(index++);
         }
     }
 
     for (uint32_t iy = 0; iy < heightSegment; ++iy) {
         for (uint32_t ix = 0; ix < widthSegment; ++ix) {
-            const uint32_t a = grid[iy][ix + 1];
-            const uint32_t b = grid[iy][ix];
-            const uint32_t c = grid[iy + 1][ix];
-            const uint32_t d = grid[iy + 1][ix + 1];
+            const uint32_t a = iy * rowSize + ix + 1;
+            const uint32_t b = iy * rowSize + ix;
+            const uint32_t c = (iy + 1) * rowSize + ix;
+            const uint32_t d = (iy + 1) * rowSize + ix + 1;
 
             if (iy != 0)
                 sphere.indices.push_back(uvec3(b, a, d));
@@ -106,4 +110,254 @@ Mesh CreateSphereMesh(float radius, uint32_t widthSegment, uint32_t heightSegmen
     return sphere;
 }
 
+// the density is averaged over the surface, sqrt of the UV area over the world area
+UvFootprint MeasureUvFootprint(const TexturedMesh& mesh, const mat4& transform) {
+    UvFootprint footprint;
+    if (mesh.vertices.empty())
+        return footprint;
+    vector<vec3> positions(mesh.vertices.size());
+    vec3 minCorner(std::numeric_limits<float>::max());
+    vec3 maxCorner(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = vec3(transform * vec4(mesh.vertices[i].position, 1.0f));
+        minCorner = glm::min(minCorner, positions[i]);
+        maxCorner = glm::max(maxCorner, positions[i]);
+    }
+    footprint.center = 0.5f * (minCorner + maxCorner);
+    for (const vec3& position : positions)
+        footprint.radius = std::max(footprint.radius, glm::length(position - footprint.center));
+
+    double worldArea = 0.0, uvArea = 0.0;
+    for (const uvec3& face : mesh.indices) {
+        const vec3 e1 = positions[face.y] - positions[face.x];
+        const vec3 e2 = positions[face.z] - positions[face.x];
+        const vec2 uv1 = mesh.vertices[face.y].uv - mesh.vertices[face.x].uv;
+        const vec2 uv2 = mesh.vertices[face.z].uv - mesh.vertices[face.x].uv;
+        worldArea += 0.5 * glm::length(glm::cross(e1, e2));
+        uvArea += 0.5 * std::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+    }
+    if (worldArea > 0.0)
+        footprint.uvDensity = static_cast<float>(std::sqrt(uvArea / worldArea));
+    return footprint;
+}
+
+// every cell keeps the vertex closest to the mean of the vertices that fell into it, vertices
+// far apart in UV space stay apart so the coarse model keeps its texture seams
+TexturedMesh SimplifyMesh(const TexturedMesh& mesh, int cellCount) {
+    constexpr float UV_CELLS = 16.0f;
+    TexturedMesh simplified;
+    if (mesh.vertices.empty())
+        return simplified;
+    cellCount = std::max(1, std::min(cellCount, 1023));
+
+    vec3 minCorner(std::numeric_limits<float>::max());
+    vec3 maxCorner(-std::numeric_limits<float>::max());
+    for (const TexturedVertex& vertex : mesh.vertices) {
+        minCorner = glm::min(minCorner, vertex.position);
+        maxCorner = glm::max(maxCorner, vertex.position);
+    }
+    const vec3 extent = maxCorner - minCorner;
+    const float cellSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) / cellCount;
+
+    std::unordered_map<uint64_t, uint32_t> clusterOfKey;
+    vector<uint32_t> clusterOf(mesh.vertices.size());
+    vector<vec3> sums;
+    vector<uint32_t> counts;
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const TexturedVertex& vertex = mesh.vertices[i];
+        const uvec3 cell = uvec3(glm::min(glm::floor((vertex.position - minCorner) / cellSize), vec3(float(cellCount - 1))));
+        const uint64_t u = static_cast<uint64_t>(static_cast<int64_t>(std::floor(vertex.uv.x * UV_CELLS)) & 0xff);
+        const uint64_t v = static_cast<uint64_t>(static_cast<int64_t>(std::floor(vertex.uv.y * UV_CELLS)) & 0xff);
+        const uint64_t key = uint64_t(cell.x) | uint64_t(cell.y) << 10 | uint64_t(cell.z) << 20 | u << 30 | v << 38;
+        auto it = clusterOfKey.emplace(key, static_cast<uint32_t>(sums.size())).first;
+        if (it->second == sums.size()) {
+            sums.push_back(vec3(0.0f));
+            counts.push_back(0);
+        }
+        clusterOf[i] = it->second;
+        sums[it->second] += vertex.position;
+        ++counts[it->second];
+    }
+
+    vector<uint32_t> representative(sums.size(), UINT32_MAX);
+    vector<float> distance(sums.size(), std::numeric_limits<float>::max());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const uint32_t cluster = clusterOf[i];
+        const vec3 offset = mesh.vertices[i].position - sums[cluster] / float(counts[cluster]);
+        const float d = glm::dot(offset, offset);
+        if (d < distance[cluster]) {
+            distance[cluster] = d;
+            representative[cluster] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // only clusters a remaining triangle uses become vertices
+    vector<uint32_t> newIndex(sums.size(), UINT32_MAX);
+    for (const uvec3& face : mesh.indices) {
+        const uvec3 clusters(clusterOf[face.x], clusterOf[face.y], clusterOf[face.z]);
+        if (clusters.x == clusters.y || clusters.y == clusters.z || clusters.z == clusters.x)
+            continue;
+        uvec3 triangle;
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t& index = newIndex[clusters[corner]];
+            if (index == UINT32_MAX) {
+                index = static_cast<uint32_t>(simplified.vertices.size());
+                simplified.vertices.push_back(mesh.vertices[representative[clusters[corner]]]);
+            }
+            triangle[corner] = index;
+        }
+        simplified.indices.push_back(triangle);
+    }
+    return simplified;
+}
+
+// Greedy: a meshlet grows by the candidate triangle next to it that adds the fewest vertices and bends its
+// normal cone the least, and the next one starts next to it, so meshlets stay compact and their cones narrow
+void BuildMeshlets(TexturedMesh& mesh) {
+    constexpr float CONE_WEIGHT = 0.5f;
+    // a wider cone culls too rarely to be worth testing
+    constexpr float MIN_CONE_DOT = 0.1f;
+    mesh.meshlets.clear();
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size());
+
+    // the triangles around every position, split vertices of a seam are welded so meshlets grow across it
+    vector<uint32_t> positionOf(vertexCount);
+    std::unordered_map<uint64_t, uint32_t> positionIds;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const vec3& p = mesh.vertices[v].position;
+        uint32_t bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        const uint64_t key = (uint64_t(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(bits[1]) * 0xC2B2AE3D27D4EB4Full) ^ bits[2];
+        auto it = positionIds.find(key);
+        // a hash collision of different positions only costs a candidate
+        positionOf[v] = it != positionIds.end() ? it->second : positionIds.emplace(key, static_cast<uint32_t>(positionIds.size())).first->second;
+    }
+    const uint32_t positionCount = static_cast<uint32_t>(positionIds.size());
+    vector<uint32_t> firstAdjacent(positionCount + 1, 0);
+    for (const uvec3& face : mesh.indices) {
+        for (int corner = 0; corner < 3; ++corner)
+            ++firstAdjacent[positionOf[face[corner]] + 1];
+    }
+    for (uint32_t p = 0; p < positionCount; ++p)
+        firstAdjacent[p + 1] += firstAdjacent[p];
+    vector<uint32_t> adjacent(firstAdjacent.back());
+    vector<uint32_t> filled(firstAdjacent.begin(), firstAdjacent.end() - 1);
+    vector<vec3> normals(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const uvec3& face = mesh.indices[t];
+        for (int corner = 0; corner < 3; ++corner)
+            adjacent[filled[positionOf[face[corner]]]++] = t;
+        // clockwise front faces
+        const vec3& a = mesh.vertices[face.x].position;
+        const vec3 normal = glm::cross(mesh.vertices[face.z].position - a, mesh.vertices[face.y].position - a);
+        const float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : vec3(0.0f);
+    }
+
+    // stamps of the meshlet that holds a vertex or lists a triangle as a candidate
+    vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+    vector<uint32_t> candidateMeshlet(triangleCount, UINT32_MAX);
+    vector<bool> assigned(triangleCount, false);
+    vector<uint32_t> candidates, triangles, vertices;
+    vector<uvec3> ordered;
+    ordered.reserve(triangleCount);
+    uint32_t scan = 0;
+    uint32_t seed = UINT32_MAX;
+    while (ordered.size() < triangleCount) {
+        const uint32_t id = static_cast<uint32_t>(mesh.meshlets.size());
+        if (seed == UINT32_MAX) {
+            while (assigned[scan])
+                ++scan;
+            seed = scan;
+        }
+        candidates.assign(1, seed);
+        candidateMeshlet[seed] = id;
+        triangles.clear();
+        vertices.clear();
+        vec3 normalSum(0.0f);
+
+        while (triangles.size() < MESHLET_MAX_TRIANGLES) {
+            const float normalLength = glm::length(normalSum);
+            const vec3 axis = normalLength > 0.0f ? normalSum / normalLength : vec3(0.0f);
+            size_t best = SIZE_MAX;
+            float bestScore = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < candidates.size();) {
+                const uint32_t t = candidates[i];
+                if (assigned[t]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                const uvec3& face = mesh.indices[t];
+                const int added = (vertexMeshlet[face.x] != id) + (vertexMeshlet[face.y] != id) + (vertexMeshlet[face.z] != id);
+                if (vertices.size() + added <= MESHLET_MAX_VERTICES) {
+                    const float score = added + CONE_WEIGHT * (1.0f - glm::dot(axis, normals[t]));
+                    if (score < bestScore) {
+                        bestScore = score;
+                        best = i;
+                    }
+                }
+                ++i;
+            }
+            if (best == SIZE_MAX)
+                break;
+
+            const uint32_t t = candidates[best];
+            assigned[t] = true;
+            triangles.push_back(t);
+            normalSum += normals[t];
+            for (int corner = 0; corner < 3; ++corner) {
+                const uint32_t v = mesh.indices[t][corner];
+                if (vertexMeshlet[v] == id)
+                    continue;
+                vertexMeshlet[v] = id;
+                vertices.push_back(v);
+                for (uint32_t i = firstAdjacent[positionOf[v]]; i < firstAdjacent[positionOf[v] + 1]; ++i) {
+                    const uint32_t neighbor = adjacent[i];
+                    if (!assigned[neighbor] && candidateMeshlet[neighbor] != id) {
+                        candidateMeshlet[neighbor] = id;
+                        candidates.push_back(neighbor);
+                    }
+                }
+            }
+        }
+
+        seed = UINT32_MAX;
+        for (uint32_t t : candidates) {
+            if (!assigned[t]) {
+                seed = t;
+                break;
+            }
+        }
+
+        Meshlet meshlet;
+        meshlet.firstTriangle = static_cast<uint32_t>(ordered.size());
+        meshlet.triangleCount = static_cast<uint32_t>(triangles.size());
+        vec3 minCorner(std::numeric_limits<float>::max());
+        vec3 maxCorner(-std::numeric_limits<float>::max());
+        for (uint32_t v : vertices) {
+            minCorner = glm::min(minCorner, mesh.vertices[v].position);
+            maxCorner = glm::max(maxCorner, mesh.vertices[v].position);
+        }
+        meshlet.center = 0.5f * (minCorner + maxCorner);
+        meshlet.radius = 0.0f;
+        for (uint32_t v : vertices)
+            meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[v].position - meshlet.center));
+
+        // degenerate triangles have no normal and are never drawn, they don't widen the cone
+        const float normalLength = glm::length(normalSum);
+        meshlet.coneAxis = normalLength > 0.0f ? normalSum / normalLength : vec3(0.0f, 0.0f, 1.0f);
+        float minDot = normalLength > 0.0f ? 1.0f : -1.0f;
+        for (uint32_t t : triangles) {
+            ordered.push_back(mesh.indices[t]);
+            if (normals[t] != vec3(0.0f))
+                minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[t]));
+        }
+        meshlet.coneCutoff = minDot > MIN_CONE_DOT ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+        mesh.meshlets.push_back(meshlet);
+    }
+    mesh.indices.swap(ordered);
+}
+
 }  // namespace pbr
@@ -27,9 +27,26 @@ struct Mesh {
     vector<uvec3> indices;
 };
 
+// Up to MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles of a mesh that lie close together
+// and face about the same way, a contiguous range of its triangles, see BuildMeshlets()
+struct Meshlet {
+    vec3 center;  // bounding sphere
+    float radius;
+    // front faces, clockwise as the renderers draw them, turn away from an eye that looks along the axis
+    // at less than acos(coneCutoff) from it, a cutoff of 1 never culls
+    vec3 coneAxis;
+    float coneCutoff;
+    uint32_t firstTriangle;
+    uint32_t triangleCount;
+};
+
+constexpr int MESHLET_MAX_VERTICES = 64;
+constexpr int MESHLET_MAX_TRIANGLES = 124;
+
 struct TexturedMesh {
     vector<TexturedVertex> vertices;
     vector<uvec3> indices;
+    vector<Meshlet> meshlets;  // empty until BuildMeshlets()
 };
 
 struct VertexOnlyMesh {
@@ -37,6 +54,22 @@ struct VertexOnlyMesh {
     vector<uvec3> indices;
 };
 
+// bounding sphere of a mesh in world space and the UV units per world unit of its surface,
+// together they tell how many texels a pixel of it covers
+struct UvFootprint {
+    vec3 center { 0.0f };
+    float radius = 0.0f;
+    float uvDensity = 0.0f;
+};
+
+extern UvFootprint MeasureUvFootprint(const TexturedMesh& mesh, const mat4& transform);
+
+// a coarse level of detail by vertex clustering on a grid of cellCount cells along the longest side
+extern TexturedMesh SimplifyMesh(const TexturedMesh& mesh, int cellCount);
+
+// groups the triangles into meshlets and reorders them so every meshlet is a range of the indices
+extern void BuildMeshlets(TexturedMesh& mesh);
+
 extern VertexOnlyMesh CreateCubeMesh(float scale = 1.0f);
 
 extern Mesh CreateSphereMesh(float radius = 1.0f, uint32_t widthSegment = 32, uint32_t heightSegment = 32);
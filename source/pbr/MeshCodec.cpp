@@ -0,0 +1,479 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+// SSE2 is part of x86-64, other targets take the scalar decoder
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBR_MESH_SSE 1
+#include <emmintrin.h>
+#else
+#define PBR_MESH_SSE 0
+#endif
+
+namespace pbr {
+
+namespace {
+
+struct MeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    uint32_t vertexChunkCount;
+    uint32_t indexChunkCount;
+    uint32_t meshletCount;
+    // followed by the offsets of the chunks and of their end, from the end of the meshlets, then the
+    // meshlets as they are
+};
+
+constexpr uint32_t MESH_MAGIC = 0x5A524250;  // 'PBRZ'
+constexpr uint32_t MESH_VERSION = 2;
+static_assert(sizeof(Meshlet) == 40, "meshlets are stored as they are");
+
+// a vertex after filtering
+struct PackedVertex {
+    vec3 position;
+    vec2 uv;
+    int16_t normal[2];
+    int16_t tangent[2];
+    int16_t bitangent[2];
+};
+static_assert(sizeof(PackedVertex) == 32, "the decoder transposes two 16 byte halves of a vertex");
+
+constexpr int VERTEX_BYTES = sizeof(PackedVertex);
+constexpr int VECTOR_OFFSET = 20;  // of the octahedral pairs
+static_assert(sizeof(vec3) + sizeof(vec2) == VECTOR_OFFSET, "the pairs follow the position and uv");
+constexpr int GROUP_SIZE = 16;  // vertices of a block
+// 2 bits per byte of the vertex
+constexpr int BLOCK_HEADER_SIZE = VERTEX_BYTES / 4;
+constexpr int GROUP_DATA_SIZE[4] = { 0, 4, 8, 16 };
+
+// normals, tangents and bitangents of a block, [vector][component][vertex]
+typedef float BlockVectors[3][3][GROUP_SIZE];
+
+float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void encodeOctahedral(const vec3& v, int16_t out[2]) {
+    const float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    float x = length > 0.0f ? v.x / length : 0.0f;
+    float y = length > 0.0f ? v.y / length : 0.0f;
+    // the lower hemisphere is folded over the diagonals
+    if (v.z < 0.0f) {
+        const float foldedX = (1.0f - std::abs(y)) * signNotZero(x);
+        y = (1.0f - std::abs(x)) * signNotZero(y);
+        x = foldedX;
+    }
+    out[0] = static_cast<int16_t>(std::round(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+    out[1] = static_cast<int16_t>(std::round(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+#if !PBR_MESH_SSE
+// the same operations as the SSE decoder, both paths give the same bits
+vec3 decodeOctahedral(const int16_t in[2]) {
+    float x = in[0] * (1.0f / 32767.0f);
+    float y = in[1] * (1.0f / 32767.0f);
+    const float z = 1.0f - std::abs(x) - std::abs(y);
+    const float fold = std::max(-z, 0.0f);
+    x -= x >= 0.0f ? fold : -fold;
+    y -= y >= 0.0f ? fold : -fold;
+    const float length = std::sqrt(x * x + y * y + z * z);
+    return vec3(x / length, y / length, z / length);
+}
+#endif
+
+uint8_t zigzag8(uint8_t delta) {
+    return static_cast<uint8_t>((delta << 1) ^ static_cast<uint8_t>(static_cast<int8_t>(delta) >> 7));
+}
+
+uint32_t zigzag32(int32_t delta) {
+    return (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+}
+
+uint32_t unzigzag32(uint32_t value) {
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+void writeVarint(vector<uint8_t>& out, uint32_t value) {
+    for (; value >= 0x80; value >>= 7)
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// every byte column of a block of 16 vertices takes the fewest bits its deltas fit in.
+// a 2 bit delta i is in bits 2 * (i / 4) of byte i % 4, a 4 bit one in bits 4 * (i / 8) of byte i % 8
+void encodeVertexChunk(const PackedVertex* pVertices, int count, vector<uint8_t>& out) {
+    uint8_t previous[VERTEX_BYTES] = {};
+    for (int base = 0; base < count; base += GROUP_SIZE) {
+        // the last block repeats its last vertex, the padding has deltas of 0
+        uint8_t deltas[VERTEX_BYTES][GROUP_SIZE];
+        for (int i = 0; i < GROUP_SIZE; ++i) {
+            const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&pVertices[std::min(base + i, count - 1)]);
+            for (int k = 0; k < VERTEX_BYTES; ++k) {
+                deltas[k][i] = zigzag8(static_cast<uint8_t>(pBytes[k] - previous[k]));
+                previous[k] = pBytes[k];
+            }
+        }
+
+        const size_t headerOffset = out.size();
+        out.resize(out.size() + BLOCK_HEADER_SIZE, 0);
+        for (int k = 0; k < VERTEX_BYTES; ++k) {
+            const uint8_t* pDeltas = deltas[k];
+            const uint8_t largest = *std::max_element(pDeltas, pDeltas + GROUP_SIZE);
+            const int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+            out[headerOffset + k / 4] |= static_cast<uint8_t>(mode << (2 * (k % 4)));
+            if (mode == 1) {
+                for (int j = 0; j < 4; ++j)
+                    out.push_back(static_cast<uint8_t>(pDeltas[j] | pDeltas[4 + j] << 2 | pDeltas[8 + j] << 4 | pDeltas[12 + j] << 6));
+            } else if (mode == 2) {
+                for (int j = 0; j < 8; ++j)
+                    out.push_back(static_cast<uint8_t>(pDeltas[j] | pDeltas[8 + j] << 4));
+            } else if (mode == 3) {
+                out.insert(out.end(), pDeltas, pDeltas + GROUP_SIZE);
+            }
+        }
+    }
+}
+
+#if PBR_MESH_SSE
+__m128i unpackGroup(int mode, const uint8_t* pData) {
+    switch (mode) {
+        case 1: {
+            int32_t bits;
+            memcpy(&bits, pData, sizeof(bits));
+            // bits above a 2 bit field that the 16 bit shifts pull in are masked away
+            const __m128i packed = _mm_cvtsi32_si128(bits);
+            const __m128i low = _mm_unpacklo_epi32(packed, _mm_srli_epi16(packed, 2));
+            const __m128i high = _mm_unpacklo_epi32(_mm_srli_epi16(packed, 4), _mm_srli_epi16(packed, 6));
+            return _mm_and_si128(_mm_unpacklo_epi64(low, high), _mm_set1_epi8(3));
+        }
+        case 2: {
+            const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pData));
+            return _mm_and_si128(_mm_unpacklo_epi64(packed, _mm_srli_epi16(packed, 4)), _mm_set1_epi8(15));
+        }
+        case 3:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData));
+        default:
+            return _mm_setzero_si128();
+    }
+}
+
+// the bytes of 16 vertices from their zigzag deltas, carry holds the byte of the previous vertex in every lane
+__m128i decodeDeltas(__m128i zigzag, __m128i& carry) {
+    const __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzag, _mm_set1_epi8(1)));
+    __m128i bytes = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(zigzag, 1), _mm_set1_epi8(0x7F)), sign);
+    bytes = _mm_add_epi8(bytes, _mm_slli_si128(bytes, 1));
+    bytes = _mm_add_epi8(bytes, _mm_slli_si128(bytes, 2));
+    bytes = _mm_add_epi8(bytes, _mm_slli_si128(bytes, 4));
+    bytes = _mm_add_epi8(bytes, _mm_slli_si128(bytes, 8));
+    bytes = _mm_add_epi8(bytes, carry);
+    const __m128i last = _mm_unpackhi_epi16(_mm_unpackhi_epi8(bytes, bytes), _mm_unpackhi_epi8(bytes, bytes));
+    carry = _mm_shuffle_epi32(last, 0xFF);
+    return bytes;
+}
+
+// the 16 pairs of a vector from the columns of their bytes, 4 vertices at a time
+void decodeOctahedral(const __m128i* pColumns, float pOut[3][GROUP_SIZE]) {
+    const __m128i xs[2] = { _mm_unpacklo_epi8(pColumns[0], pColumns[1]), _mm_unpackhi_epi8(pColumns[0], pColumns[1]) };
+    const __m128i ys[2] = { _mm_unpacklo_epi8(pColumns[2], pColumns[3]), _mm_unpackhi_epi8(pColumns[2], pColumns[3]) };
+    const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < GROUP_SIZE / 4; ++i) {
+        // the int16 in the top half of an int32 is sign extended by the arithmetic shift
+        const __m128i x16 = xs[i / 2];
+        const __m128i y16 = ys[i / 2];
+        const __m128i x32 = i % 2 ? _mm_unpackhi_epi16(x16, x16) : _mm_unpacklo_epi16(x16, x16);
+        const __m128i y32 = i % 2 ? _mm_unpackhi_epi16(y16, y16) : _mm_unpacklo_epi16(y16, y16);
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(x32, 16)), scale);
+        __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(y32, 16)), scale);
+        const __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+        const __m128 fold = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        x = _mm_sub_ps(x, _mm_or_ps(fold, _mm_and_ps(x, signMask)));
+        y = _mm_sub_ps(y, _mm_or_ps(fold, _mm_and_ps(y, signMask)));
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        _mm_storeu_ps(pOut[0] + 4 * i, _mm_div_ps(x, length));
+        _mm_storeu_ps(pOut[1] + 4 * i, _mm_div_ps(y, length));
+        _mm_storeu_ps(pOut[2] + 4 * i, _mm_div_ps(z, length));
+    }
+}
+
+// four rounds of interleaving the top and bottom half transpose 16 x 16 bytes
+void transpose16x16(__m128i* pRows) {
+    for (int round = 0; round < 4; ++round) {
+        __m128i interleaved[16];
+        for (int i = 0; i < 8; ++i) {
+            interleaved[2 * i] = _mm_unpacklo_epi8(pRows[i], pRows[i + 8]);
+            interleaved[2 * i + 1] = _mm_unpackhi_epi8(pRows[i], pRows[i + 8]);
+        }
+        for (int i = 0; i < 16; ++i)
+            pRows[i] = interleaved[i];
+    }
+}
+#endif
+
+void unfilter(const PackedVertex* pPacked, const BlockVectors& vectors, int count, TexturedVertex* pVertices) {
+    for (int i = 0; i < count; ++i) {
+        TexturedVertex& vertex = pVertices[i];
+        vertex.position = pPacked[i].position;
+        vertex.uv = pPacked[i].uv;
+        vertex.normal = vec3(vectors[0][0][i], vectors[0][1][i], vectors[0][2][i]);
+        vertex.tangent = vec3(vectors[1][0][i], vectors[1][1][i], vectors[1][2][i]);
+        vertex.bitangent = vec3(vectors[2][0][i], vectors[2][1][i], vectors[2][2][i]);
+    }
+}
+
+void decodeVertexChunk(const uint8_t* pData, const uint8_t* pEnd, int count, TexturedVertex* pVertices) {
+#if PBR_MESH_SSE
+    __m128i carry[VERTEX_BYTES];
+    for (__m128i& bytes : carry)
+        bytes = _mm_setzero_si128();
+#else
+    uint8_t previous[VERTEX_BYTES] = {};
+#endif
+    alignas(16) PackedVertex block[GROUP_SIZE];
+    BlockVectors vectors;
+    for (int base = 0; base < count; base += GROUP_SIZE) {
+        if (pEnd - pData < BLOCK_HEADER_SIZE)
+            THROW_EXCEPTION("mesh: Vertex chunk is truncated");
+        const uint8_t* pHeader = pData;
+        pData += BLOCK_HEADER_SIZE;
+#if PBR_MESH_SSE
+        __m128i columns[VERTEX_BYTES];
+#else
+        uint8_t* pBlock = reinterpret_cast<uint8_t*>(block);
+#endif
+        for (int k = 0; k < VERTEX_BYTES; ++k) {
+            const int mode = (pHeader[k / 4] >> (2 * (k % 4))) & 3;
+            if (pEnd - pData < GROUP_DATA_SIZE[mode])
+                THROW_EXCEPTION("mesh: Vertex chunk is truncated");
+#if PBR_MESH_SSE
+            columns[k] = decodeDeltas(unpackGroup(mode, pData), carry[k]);
+#else
+            for (int i = 0; i < GROUP_SIZE; ++i) {
+                uint8_t zigzag = 0;
+                if (mode == 1)
+                    zigzag = (pData[i % 4] >> (2 * (i / 4))) & 3;
+                else if (mode == 2)
+                    zigzag = (pData[i % 8] >> (4 * (i / 8))) & 15;
+                else if (mode == 3)
+                    zigzag = pData[i];
+                previous[k] += static_cast<uint8_t>((zigzag >> 1) ^ (0u - (zigzag & 1)));
+                pBlock[i * VERTEX_BYTES + k] = previous[k];
+            }
+#endif
+            pData += GROUP_DATA_SIZE[mode];
+        }
+#if PBR_MESH_SSE
+        for (int v = 0; v < 3; ++v)
+            decodeOctahedral(columns + VECTOR_OFFSET + 4 * v, vectors[v]);
+        // a column per byte to a row per vertex
+        transpose16x16(columns);
+        transpose16x16(columns + 16);
+        __m128i* pBlock = reinterpret_cast<__m128i*>(block);
+        for (int i = 0; i < GROUP_SIZE; ++i) {
+            _mm_store_si128(pBlock + 2 * i, columns[i]);
+            _mm_store_si128(pBlock + 2 * i + 1, columns[16 + i]);
+        }
+#else
+        for (int i = 0; i < GROUP_SIZE; ++i) {
+            const int16_t* pPairs[3] = { block[i].normal, block[i].tangent, block[i].bitangent };
+            for (int v = 0; v < 3; ++v) {
+                const vec3 vector = decodeOctahedral(pPairs[v]);
+                for (int c = 0; c < 3; ++c)
+                    vectors[v][c][i] = vector[c];
+            }
+        }
+#endif
+        unfilter(block, vectors, std::min(GROUP_SIZE, count - base), pVertices + base);
+    }
+}
+
+// a triangle that shares an edge with the previous one, which it walks the other way around, is stored as
+// the edge's index in the previous triangle and its third index. the others are op 3 and store all three
+void encodeIndexChunk(const uvec3* pTriangles, int count, vector<uint8_t>& out) {
+    const size_t opOffset = out.size();
+    out.resize(out.size() + (count + 3) / 4, 0);
+    uint32_t last = 0;
+    auto writeIndex = [&](uint32_t index) {
+        writeVarint(out, zigzag32(static_cast<int32_t>(index - last)));
+        last = index;
+    };
+    uvec3 previous(0);
+    for (int t = 0; t < count; ++t) {
+        const uvec3& triangle = pTriangles[t];
+        int op = 3;
+        uvec3 rotated = triangle;
+        for (int edge = 0; t > 0 && edge < 3 && op == 3; ++edge) {
+            const uint32_t a = previous[(edge + 1) % 3];
+            const uint32_t b = previous[edge];
+            for (int r = 0; r < 3; ++r) {
+                if (triangle[r] == a && triangle[(r + 1) % 3] == b) {
+                    op = edge;
+                    rotated = uvec3(a, b, triangle[(r + 2) % 3]);
+                    break;
+                }
+            }
+        }
+        out[opOffset + t / 4] |= static_cast<uint8_t>(op << (2 * (t % 4)));
+        if (op == 3) {
+            writeIndex(triangle.x);
+            writeIndex(triangle.y);
+            writeIndex(triangle.z);
+        } else {
+            writeIndex(rotated.z);
+        }
+        previous = rotated;
+    }
+}
+
+void decodeIndexChunk(const uint8_t* pData, const uint8_t* pEnd, int count, uint32_t vertexCount, uvec3* pTriangles) {
+    const uint8_t* pOps = pData;
+    if (pEnd - pData < (count + 3) / 4)
+        THROW_EXCEPTION("mesh: Index chunk is truncated");
+    pData += (count + 3) / 4;
+    uint32_t last = 0;
+    auto readIndex = [&]() {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pData == pEnd || shift > 28)
+                THROW_EXCEPTION("mesh: Index chunk is truncated");
+            const uint8_t byte = *pData++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        last += unzigzag32(value);
+        if (last >= vertexCount)
+            THROW_EXCEPTION("mesh: Index " + std::to_string(last) + " is out of range");
+        return last;
+    };
+    uvec3 previous(0);
+    for (int t = 0; t < count; ++t) {
+        const int op = (pOps[t / 4] >> (2 * (t % 4))) & 3;
+        uvec3 triangle;
+        if (op == 3) {
+            triangle.x = readIndex();
+            triangle.y = readIndex();
+            triangle.z = readIndex();
+        } else {
+            triangle = uvec3(previous[(op + 1) % 3], previous[op], readIndex());
+        }
+        pTriangles[t] = previous = triangle;
+    }
+}
+
+}  // namespace
+
+vector<uint8_t> MeshCodec::Encode(const TexturedMesh& mesh) {
+    const int vertexCount = static_cast<int>(mesh.vertices.size());
+    const int triangleCount = static_cast<int>(mesh.indices.size());
+    vector<PackedVertex> packed(vertexCount);
+    for (int i = 0; i < vertexCount; ++i) {
+        const TexturedVertex& vertex = mesh.vertices[i];
+        packed[i].position = vertex.position;
+        packed[i].uv = vertex.uv;
+        encodeOctahedral(vertex.normal, packed[i].normal);
+        encodeOctahedral(vertex.tangent, packed[i].tangent);
+        encodeOctahedral(vertex.bitangent, packed[i].bitangent);
+    }
+
+    MeshHeader header;
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexCount = vertexCount;
+    header.triangleCount = triangleCount;
+    header.vertexChunkCount = (vertexCount + VERTEX_CHUNK - 1) / VERTEX_CHUNK;
+    header.indexChunkCount = (triangleCount + INDEX_CHUNK - 1) / INDEX_CHUNK;
+    header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+
+    vector<uint32_t> offsets;
+    vector<uint8_t> payload;
+    for (int first = 0; first < vertexCount; first += VERTEX_CHUNK) {
+        offsets.push_back(static_cast<uint32_t>(payload.size()));
+        encodeVertexChunk(packed.data() + first, std::min(VERTEX_CHUNK, vertexCount - first), payload);
+    }
+    for (int first = 0; first < triangleCount; first += INDEX_CHUNK) {
+        offsets.push_back(static_cast<uint32_t>(payload.size()));
+        encodeIndexChunk(mesh.indices.data() + first, std::min(INDEX_CHUNK, triangleCount - first), payload);
+    }
+    offsets.push_back(static_cast<uint32_t>(payload.size()));
+
+    const size_t tableSize = offsets.size() * sizeof(uint32_t);
+    const size_t meshletSize = mesh.meshlets.size() * sizeof(Meshlet);
+    vector<uint8_t> out(sizeof(header) + tableSize + meshletSize);
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + sizeof(header), offsets.data(), tableSize);
+    if (meshletSize)
+        memcpy(out.data() + sizeof(header) + tableSize, mesh.meshlets.data(), meshletSize);
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+}
+
+bool MeshCodec::IsEncoded(const void* pData, size_t size) {
+    MeshHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, pData, sizeof(header));
+    return header.magic == MESH_MAGIC && header.version == MESH_VERSION;
+}
+
+TexturedMesh MeshCodec::Decode(const void* pData, size_t size) {
+    if (!IsEncoded(pData, size))
+        THROW_EXCEPTION("mesh: Not a compressed mesh");
+    MeshHeader header;
+    memcpy(&header, pData, sizeof(header));
+    const size_t chunkCount = static_cast<size_t>(header.vertexChunkCount) + header.indexChunkCount;
+    if (header.vertexChunkCount != (header.vertexCount + VERTEX_CHUNK - 1) / VERTEX_CHUNK ||
+        header.indexChunkCount != (header.triangleCount + INDEX_CHUNK - 1) / INDEX_CHUNK ||
+        header.meshletCount > header.triangleCount ||
+        size < sizeof(header) + (chunkCount + 1) * sizeof(uint32_t) + size_t(header.meshletCount) * sizeof(Meshlet))
+        THROW_EXCEPTION("mesh: Corrupt header");
+
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    vector<uint32_t> offsets(chunkCount + 1);
+    memcpy(offsets.data(), pBytes + sizeof(header), offsets.size() * sizeof(uint32_t));
+    const uint8_t* pMeshlets = pBytes + sizeof(header) + offsets.size() * sizeof(uint32_t);
+    const uint8_t* pPayload = pMeshlets + header.meshletCount * sizeof(Meshlet);
+    const size_t payloadSize = size - (pPayload - pBytes);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > payloadSize)
+            THROW_EXCEPTION("mesh: Corrupt chunk table");
+    }
+
+    TexturedMesh mesh;
+    mesh.vertices.resize(header.vertexCount);
+    mesh.indices.resize(header.triangleCount);
+    // they cover the triangles in order
+    mesh.meshlets.resize(header.meshletCount);
+    if (header.meshletCount)
+        memcpy(mesh.meshlets.data(), pMeshlets, header.meshletCount * sizeof(Meshlet));
+    uint32_t nextTriangle = 0;
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        if (meshlet.firstTriangle != nextTriangle || meshlet.triangleCount == 0 || meshlet.triangleCount > header.triangleCount - nextTriangle)
+            THROW_EXCEPTION("mesh: Corrupt meshlet table");
+        nextTriangle += meshlet.triangleCount;
+    }
+    if (header.meshletCount && nextTriangle != header.triangleCount)
+        THROW_EXCEPTION("mesh: Corrupt meshlet table");
+    const int vertexChunkCount = static_cast<int>(header.vertexChunkCount);
+    const int vertexCount = static_cast<int>(header.vertexCount);
+    const int triangleCount = static_cast<int>(header.triangleCount);
+    JobSystem::GetSingleton().ParallelFor("decode mesh", static_cast<int>(chunkCount), [&](int chunk, int) {
+        const uint8_t* pChunk = pPayload + offsets[chunk];
+        const uint8_t* pEnd = pPayload + offsets[chunk + 1];
+        if (chunk < vertexChunkCount) {
+            const int first = chunk * VERTEX_CHUNK;
+            decodeVertexChunk(pChunk, pEnd, std::min(VERTEX_CHUNK, vertexCount - first), mesh.vertices.data() + first);
+        } else {
+            const int first = (chunk - vertexChunkCount) * INDEX_CHUNK;
+            decodeIndexChunk(pChunk, pEnd, std::min(INDEX_CHUNK, triangleCount - first), header.vertexCount, mesh.indices.data() + first);
+        }
+    }, 1);
+    return mesh;
+}
+
+}  // namespace pbr
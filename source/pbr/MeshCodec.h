@@ -0,0 +1,25 @@
+#pragma once
+#include "Mesh.h"
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// Compressed TexturedMesh payload, the model.mesh next to a model.bin. Normals, tangents and
+// bitangents are filtered to 16 bit octahedral pairs, which shrinks a vertex to 32 bytes, and
+// every byte of a vertex is delta coded against the previous vertex in groups of 16 that take
+// 0, 2, 4 or 8 bits per delta. Triangles that share an edge with the previous one store their
+// third index only, indices are zigzag varints relative to the last one. Vertices and triangles
+// are cut into chunks that decode independently, on the job system. Meshlets, if the mesh has them,
+// are stored as they are.
+class MeshCodec {
+   public:
+    static constexpr int VERTEX_CHUNK = 4096;  // a multiple of 16
+    static constexpr int INDEX_CHUNK = 8192;   // triangles
+
+    static vector<uint8_t> Encode(const TexturedMesh& mesh);
+    // the triangles may come back rotated, their winding is kept
+    static TexturedMesh Decode(const void* pData, size_t size);
+    static bool IsEncoded(const void* pData, size_t size);
+};
+
+}  // namespace pbr
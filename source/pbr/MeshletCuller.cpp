@@ -0,0 +1,114 @@
+#include "MeshletCuller.h"
+#include <cmath>
+
+// SSE2 is part of x86-64, other targets test one meshlet at a time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBR_CULL_SSE 1
+#include <emmintrin.h>
+#else
+#define PBR_CULL_SSE 0
+#endif
+
+namespace pbr {
+
+void MeshletCuller::Initialize(const vector<Meshlet>& meshlets) {
+    const size_t padded = (meshlets.size() + 3) & ~size_t(3);
+    for (vector<float>* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_radius, &m_axisX, &m_axisY, &m_axisZ, &m_cutoff })
+        pArray->assign(padded, 0.0f);
+    m_firstTriangle.resize(meshlets.size());
+    m_triangleCount.resize(meshlets.size());
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        m_centerX[i] = meshlet.center.x;
+        m_centerY[i] = meshlet.center.y;
+        m_centerZ[i] = meshlet.center.z;
+        m_radius[i] = meshlet.radius;
+        m_axisX[i] = meshlet.coneAxis.x;
+        m_axisY[i] = meshlet.coneAxis.y;
+        m_axisZ[i] = meshlet.coneAxis.z;
+        m_cutoff[i] = meshlet.coneCutoff;
+        m_firstTriangle[i] = meshlet.firstTriangle;
+        m_triangleCount[i] = meshlet.triangleCount;
+    }
+}
+
+void MeshletCuller::Cull(const mat4& viewProjection, const mat4& transform, const vec3& viewPosition, vector<TriangleRange>& ranges) {
+    ranges.clear();
+    // the planes of the frustum in the space of the mesh, normalized so they give distances
+    const mat4 clip = viewProjection * transform;
+    const vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    vec4 planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+        const vec4 row(clip[0][axis], clip[1][axis], clip[2][axis], clip[3][axis]);
+        planes[2 * axis] = w + row;
+        planes[2 * axis + 1] = w - row;
+    }
+    for (vec4& plane : planes)
+        plane /= glm::length(vec3(plane));
+    const vec3 eye = vec3(glm::inverse(transform) * vec4(viewPosition, 1.0f));
+    // a mirroring transform turns the front faces around
+    const float side = glm::determinant(glm::mat3(transform)) < 0.0f ? -1.0f : 1.0f;
+
+    const size_t count = m_firstTriangle.size();
+    for (size_t group = 0; group < count; group += 4) {
+        // bit i for meshlet group + i
+        int insideMask = 0, backMask = 0;
+#if PBR_CULL_SSE
+        const __m128 centerX = _mm_loadu_ps(&m_centerX[group]);
+        const __m128 centerY = _mm_loadu_ps(&m_centerY[group]);
+        const __m128 centerZ = _mm_loadu_ps(&m_centerZ[group]);
+        const __m128 radius = _mm_loadu_ps(&m_radius[group]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const vec4& plane : planes) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        const __m128 viewX = _mm_sub_ps(centerX, _mm_set1_ps(eye.x));
+        const __m128 viewY = _mm_sub_ps(centerY, _mm_set1_ps(eye.y));
+        const __m128 viewZ = _mm_sub_ps(centerZ, _mm_set1_ps(eye.z));
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(viewX, viewX), _mm_mul_ps(viewY, viewY)), _mm_mul_ps(viewZ, viewZ)));
+        __m128 along = _mm_add_ps(_mm_mul_ps(viewX, _mm_loadu_ps(&m_axisX[group])), _mm_mul_ps(viewY, _mm_loadu_ps(&m_axisY[group])));
+        along = _mm_mul_ps(_mm_add_ps(along, _mm_mul_ps(viewZ, _mm_loadu_ps(&m_axisZ[group]))), _mm_set1_ps(side));
+        const __m128 back = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_cutoff[group]), length), radius));
+        insideMask = _mm_movemask_ps(inside);
+        backMask = _mm_movemask_ps(back);
+#else
+        for (size_t lane = 0; lane < 4; ++lane) {
+            const size_t i = group + lane;
+            const vec3 center(m_centerX[i], m_centerY[i], m_centerZ[i]);
+            bool inside = true;
+            for (const vec4& plane : planes)
+                inside = inside && glm::dot(vec3(plane), center) + plane.w + m_radius[i] > 0.0f;
+            const vec3 view = center - eye;
+            const float along = side * glm::dot(view, vec3(m_axisX[i], m_axisY[i], m_axisZ[i]));
+            insideMask |= inside ? 1 << lane : 0;
+            backMask |= along >= m_cutoff[i] * glm::length(view) + m_radius[i] ? 1 << lane : 0;
+        }
+#endif
+        for (size_t lane = 0; lane < 4 && group + lane < count; ++lane) {
+            const size_t i = group + lane;
+            if (!(insideMask >> lane & 1)) {
+                m_frustumCulled += m_triangleCount[i];
+            } else if (backMask >> lane & 1) {
+                m_backfaceCulled += m_triangleCount[i];
+            } else if (!ranges.empty() && ranges.back().first + ranges.back().count == m_firstTriangle[i]) {
+                ranges.back().count += m_triangleCount[i];
+            } else {
+                ranges.push_back({ m_firstTriangle[i], m_triangleCount[i] });
+            }
+            m_triangles += m_triangleCount[i];
+        }
+    }
+    ++m_frameCount;
+}
+
+void MeshletCuller::Report(ostream& os) const {
+    if (m_triangles == 0)
+        return;
+    const double percent = 100.0 / m_triangles;
+    os << "[Log] meshlet culling: " << MeshletCount() << " meshlets, on average " << m_frustumCulled * percent << "% of the triangles outside the frustum, "
+       << m_backfaceCulled * percent << "% facing away, " << (m_triangles - m_frustumCulled - m_backfaceCulled) * percent << "% drawn" << endl;
+}
+
+}  // namespace pbr
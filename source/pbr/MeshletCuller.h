@@ -0,0 +1,36 @@
+#pragma once
+#include "Mesh.h"
+
+namespace pbr {
+
+// a range of the triangles of a mesh
+struct TriangleRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Tests the meshlets of a mesh against the view frustum and their normal cones against the eye, four at a
+// time with SSE where it is available. The tests run in the space of the mesh, the frustum and the eye are
+// moved there instead of every meshlet into the world. What survives is drawn as ranges of the index buffer,
+// neighboring meshlets merged into one range.
+class MeshletCuller {
+   public:
+    void Initialize(const vector<Meshlet>& meshlets);
+    // ranges never grows past the number of meshlets, reserve that to cull without allocating
+    void Cull(const mat4& viewProjection, const mat4& transform, const vec3& viewPosition, vector<TriangleRange>& ranges);
+    size_t MeshletCount() const { return m_firstTriangle.size(); }
+    void Report(ostream& os) const;
+
+   private:
+    // structure of arrays, padded to a multiple of four
+    vector<float> m_centerX, m_centerY, m_centerZ, m_radius;
+    vector<float> m_axisX, m_axisY, m_axisZ, m_cutoff;
+    vector<uint32_t> m_firstTriangle;
+    vector<uint32_t> m_triangleCount;
+    uint64_t m_frameCount = 0;
+    uint64_t m_triangles = 0;  // summed over the frames
+    uint64_t m_frustumCulled = 0;
+    uint64_t m_backfaceCulled = 0;
+};
+
+}  // namespace pbr
@@ -0,0 +1,164 @@
+#include "MipChain.h"
+#include <filesystem>
+#include <fstream>
+#include "FileSystem.h"
+#include "Utility.h"
+#include "base/Error.h"
+using std::ios;
+using std::ofstream;
+
+namespace pbr {
+
+namespace {
+
+struct MipChainHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t component;
+    int32_t levelCount;
+    uint32_t filter;  // kernels::MipFilter of the levels
+    uint32_t srgbMask;
+};
+
+constexpr uint32_t MIP_CHAIN_MAGIC = 0x4d524250;  // 'PBRM'
+constexpr uint32_t MIP_CHAIN_VERSION = 2;
+
+}  // namespace
+
+void MipChainFile::Build(const string& pngPath, const string& path, kernels::MipFilter filter, uint32_t srgbMask) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (fs::exists(path, error) && fs::last_write_time(path, error) >= FileSystem::GetSingleton().LastWriteTime(pngPath) && !error) {
+        MipChainHeader header = {};
+        std::ifstream(path, ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (header.magic == MIP_CHAIN_MAGIC && header.version == MIP_CHAIN_VERSION && header.filter == static_cast<uint32_t>(filter) && header.srgbMask == srgbMask)
+            return;
+    }
+
+    vector<Image> levels;
+    levels.push_back(utility::ReadPng(pngPath));
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        Image next;
+        kernels::Downsample(levels.back(), next, filter, srgbMask);
+        levels.push_back(std::move(next));
+    }
+
+    MipChainHeader header;
+    header.magic = MIP_CHAIN_MAGIC;
+    header.version = MIP_CHAIN_VERSION;
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.component = levels[0].component;
+    header.levelCount = static_cast<int32_t>(levels.size());
+    header.filter = static_cast<uint32_t>(filter);
+    header.srgbMask = srgbMask;
+    vector<Level> table(levels.size());
+    uint64_t offset = sizeof(header) + sizeof(Level) * table.size();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        table[i] = { offset, levels[i].buffer.sizeInByte };
+        offset += table[i].size;
+    }
+
+    // written next to the final name and renamed, a reader never sees half a file
+    fs::create_directories(fs::path(path).parent_path(), error);
+    const string tempPath = path + ".tmp";
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        if (!file.good())
+            THROW_EXCEPTION("filesystem: Failed to write mip chain '" + tempPath + "'");
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()), sizeof(Level) * table.size());
+        for (const Image& level : levels)
+            file.write(static_cast<const char*>(level.buffer.pData), level.buffer.sizeInByte);
+        if (!file.good())
+            THROW_EXCEPTION("filesystem: Failed to write mip chain '" + tempPath + "'");
+    }
+    fs::rename(tempPath, path, error);
+    if (error)
+        THROW_EXCEPTION("filesystem: Failed to write mip chain '" + path + "'");
+}
+
+void MipChainFile::Split(const string& mipChainPath, const string& path, int tailSize) {
+    MipChainFile source;
+    source.Open(mipChainPath);
+    MipChainHeader header;
+    header.magic = MIP_CHAIN_MAGIC;
+    header.version = MIP_CHAIN_VERSION;
+    header.width = source.m_width;
+    header.height = source.m_height;
+    header.component = source.m_component;
+    header.levelCount = source.LevelCount();
+    header.filter = source.m_filter;
+    header.srgbMask = source.m_srgbMask;
+
+    // the levels above the tail move to chunks of their own, an offset of 0 names a chunk
+    vector<Level> table(source.m_levels.size());
+    uint64_t offset = sizeof(header) + sizeof(Level) * table.size();
+    for (int level = 0; level < source.LevelCount(); ++level) {
+        const bool tail = source.Width(level) <= tailSize && source.Height(level) <= tailSize;
+        table[level] = { tail ? offset : 0, source.m_levels[level].size };
+        if (tail)
+            offset += table[level].size;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), sizeof(Level) * table.size());
+    for (int level = 0; level < source.LevelCount(); ++level) {
+        const Image image = source.ReadLevel(level);
+        if (table[level].offset) {
+            file.write(static_cast<const char*>(image.buffer.pData), image.buffer.sizeInByte);
+            continue;
+        }
+        const vector<uint8_t> deflated = utility::Deflate(image.buffer.pData, image.buffer.sizeInByte);
+        ofstream chunk(path + "." + std::to_string(level), ios::binary | ios::trunc);
+        chunk.write(reinterpret_cast<const char*>(deflated.data()), deflated.size());
+        if (!chunk.good())
+            THROW_EXCEPTION("filesystem: Failed to write mip chain chunk '" + path + "." + std::to_string(level) + "'");
+    }
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to write mip chain '" + path + "'");
+}
+
+void MipChainFile::Open(const string& path) {
+    const FileSystem& fileSystem = FileSystem::GetSingleton();
+    MipChainHeader header;
+    fileSystem.ReadRange(path, 0, sizeof(header), &header);
+    if (header.magic != MIP_CHAIN_MAGIC || header.version != MIP_CHAIN_VERSION || header.levelCount <= 0)
+        THROW_EXCEPTION("image: '" + path + "' is not a mip chain");
+    m_path = path;
+    m_width = header.width;
+    m_height = header.height;
+    m_component = header.component;
+    m_filter = header.filter;
+    m_srgbMask = header.srgbMask;
+    m_levels.resize(header.levelCount);
+    fileSystem.ReadRange(path, sizeof(header), sizeof(Level) * m_levels.size(), m_levels.data());
+}
+
+string MipChainFile::ChunkPath(int level) const {
+    return m_path + "." + std::to_string(level);
+}
+
+Image MipChainFile::ReadLevel(int level) const {
+    Image image;
+    image.width = Width(level);
+    image.height = Height(level);
+    image.component = m_component;
+    image.dataType = DataType::UINT_8T;
+    image.Allocate(LevelSize(level));
+    if (!IsChunk(level)) {
+        FileSystem::GetSingleton().ReadRange(m_path, m_levels[level].offset, image.buffer.sizeInByte, image.buffer.pData);
+        return image;
+    }
+    const FileData chunk = FileSystem::GetSingleton().Read(ChunkPath(level));
+    if (!utility::Inflate(chunk.Data(), chunk.Size(), image.buffer.pData, image.buffer.sizeInByte))
+        THROW_EXCEPTION("image: chunk of level " + std::to_string(level) + " of '" + m_path + "' is corrupt");
+    return image;
+}
+
+}  // namespace pbr
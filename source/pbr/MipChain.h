@@ -0,0 +1,47 @@
+#pragma once
+#include <algorithm>
+#include "ImageKernels.h"
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// An 8-bit image and all of its mips in one file, finest level first. The header and
+// the offset of every level come before the texels, so any level can be read without the others.
+// A split chain keeps only its coarse levels inline, every finer level is a deflated chunk file of
+// its own that can be downloaded when it is needed.
+class MipChainFile {
+   public:
+    // writes the container of the png unless one newer than the png was filtered the same way
+    static void Build(const string& pngPath, const string& path, kernels::MipFilter filter = kernels::MipFilter::BOX, uint32_t srgbMask = 0);
+    // writes the chain with the levels up to tailSize inline, the others as ChunkPath() files
+    static void Split(const string& mipChainPath, const string& path, int tailSize);
+
+    // reads the header and the level offsets, through FileSystem like the levels
+    void Open(const string& path);
+    int LevelCount() const { return static_cast<int>(m_levels.size()); }
+    int Width(int level) const { return std::max(1, m_width >> level); }
+    int Height(int level) const { return std::max(1, m_height >> level); }
+    int Component() const { return m_component; }
+    size_t LevelSize(int level) const { return static_cast<size_t>(m_levels[level].size); }
+    // the level is in a chunk file of a split chain
+    bool IsChunk(int level) const { return m_levels[level].offset == 0; }
+    string ChunkPath(int level) const;
+    // levels can be read on several threads at once
+    Image ReadLevel(int level) const;
+
+   private:
+    struct Level {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    int m_component = 0;
+    uint32_t m_filter = 0;
+    uint32_t m_srgbMask = 0;
+    vector<Level> m_levels;
+};
+
+}  // namespace pbr
@@ -0,0 +1,125 @@
+#include "PageFile.h"
+#include <filesystem>
+#include <fstream>
+#include "MipChain.h"
+#include "base/Error.h"
+using std::ifstream;
+using std::ios;
+using std::ofstream;
+
+namespace pbr {
+
+namespace {
+
+struct PageFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t pageSize;
+    int32_t border;
+    int32_t levelCount;
+};
+
+constexpr uint32_t PAGE_FILE_MAGIC = 0x56524250;  // 'PBRV'
+constexpr uint32_t PAGE_FILE_VERSION = 1;
+
+bool isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+}  // namespace
+
+void PageFile::Build(const string& mipChainPath, const string& path) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (fs::exists(path, error) && fs::last_write_time(path, error) >= fs::last_write_time(mipChainPath, error) && !error)
+        return;
+
+    MipChainFile chain;
+    chain.Open(mipChainPath);
+    const int width = chain.Width(0);
+    const int height = chain.Height(0);
+    if (chain.Component() != 4 || !isPowerOfTwo(width) || !isPowerOfTwo(height) || width < PAGE_SIZE || height < PAGE_SIZE)
+        THROW_EXCEPTION("image: '" + mipChainPath + "' must be RGBA, a power of two and at least " + std::to_string(PAGE_SIZE) + " texels");
+
+    PageFileHeader header;
+    header.magic = PAGE_FILE_MAGIC;
+    header.version = PAGE_FILE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.pageSize = PAGE_SIZE;
+    header.border = BORDER;
+    header.levelCount = 0;
+    while (header.levelCount < chain.LevelCount() && chain.Width(header.levelCount) >= PAGE_SIZE && chain.Height(header.levelCount) >= PAGE_SIZE)
+        ++header.levelCount;
+
+    const string tempPath = path + ".tmp";
+    fs::create_directories(fs::path(path).parent_path(), error);
+    {
+        ofstream file(tempPath, ios::binary | ios::trunc);
+        if (!file.good())
+            THROW_EXCEPTION("filesystem: Failed to write page file '" + tempPath + "'");
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        vector<uint8_t> page(PageBytes());
+        for (int level = 0; level < header.levelCount; ++level) {
+            const Image image = chain.ReadLevel(level);
+            const uint32_t* pTexels = static_cast<const uint32_t*>(image.buffer.pData);
+            const int pagesX = image.width / PAGE_SIZE;
+            const int pagesY = image.height / PAGE_SIZE;
+            for (int py = 0; py < pagesY; ++py) {
+                for (int px = 0; px < pagesX; ++px) {
+                    // the border wraps around like GL_REPEAT, the sizes are powers of two
+                    uint32_t* pOut = reinterpret_cast<uint32_t*>(page.data());
+                    for (int y = 0; y < SLOT_SIZE; ++y) {
+                        const int sy = (py * PAGE_SIZE - BORDER + y) & (image.height - 1);
+                        for (int x = 0; x < SLOT_SIZE; ++x) {
+                            const int sx = (px * PAGE_SIZE - BORDER + x) & (image.width - 1);
+                            *pOut++ = pTexels[sy * image.width + sx];
+                        }
+                    }
+                    file.write(reinterpret_cast<const char*>(page.data()), page.size());
+                }
+            }
+        }
+        if (!file.good())
+            THROW_EXCEPTION("filesystem: Failed to write page file '" + tempPath + "'");
+    }
+    fs::rename(tempPath, path, error);
+    if (error)
+        THROW_EXCEPTION("filesystem: Failed to write page file '" + path + "'");
+}
+
+void PageFile::Open(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to open page file '" + path + "'");
+    PageFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() || header.magic != PAGE_FILE_MAGIC || header.version != PAGE_FILE_VERSION ||
+        header.pageSize != PAGE_SIZE || header.border != BORDER || header.levelCount <= 0)
+        THROW_EXCEPTION("image: '" + path + "' is not a page file");
+    m_path = path;
+    m_width = header.width;
+    m_height = header.height;
+    m_levelCount = header.levelCount;
+    m_levelOffsets.resize(m_levelCount);
+    uint64_t offset = sizeof(header);
+    for (int level = 0; level < m_levelCount; ++level) {
+        m_levelOffsets[level] = offset;
+        offset += PageBytes() * PagesX(level) * PagesY(level);
+    }
+}
+
+void PageFile::ReadPage(int level, int x, int y, void* pData) const {
+    ifstream file(m_path, ios::binary);
+    const uint64_t offset = m_levelOffsets[level] + PageBytes() * (static_cast<uint64_t>(y) * PagesX(level) + x);
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(static_cast<char*>(pData), PageBytes());
+    if (!file.good())
+        THROW_EXCEPTION("image: Failed to read page " + std::to_string(x) + ", " + std::to_string(y) + " of level " +
+                        std::to_string(level) + " of '" + m_path + "'");
+}
+
+}  // namespace pbr
@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// The levels of a mip chain cut into square pages, each with a border of texels from its neighbours
+// so a page samples bilinearly on its own. Levels are paged down to the one that is a single page
+// wide or high. Every page has the same size and any one is a single read, the unit virtual
+// texturing loads.
+class PageFile {
+   public:
+    static constexpr int PAGE_SIZE = 128;
+    static constexpr int BORDER = 4;
+    // texels of a page with its border on each side
+    static constexpr int SLOT_SIZE = PAGE_SIZE + 2 * BORDER;
+
+    // writes the pages of the RGBA mip chain unless a file newer than it exists, the size of
+    // level 0 must be a power of two of at least a page
+    static void Build(const string& mipChainPath, const string& path);
+
+    void Open(const string& path);
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+    int LevelCount() const { return m_levelCount; }
+    int PagesX(int level) const { return std::max(1, m_width / PAGE_SIZE >> level); }
+    int PagesY(int level) const { return std::max(1, m_height / PAGE_SIZE >> level); }
+    static constexpr size_t PageBytes() { return static_cast<size_t>(SLOT_SIZE) * SLOT_SIZE * 4; }
+    // reads PageBytes() into pData, pages can be read on several threads at once
+    void ReadPage(int level, int x, int y, void* pData) const;
+
+   private:
+    string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    int m_levelCount = 0;
+    vector<uint64_t> m_levelOffsets;
+};
+
+}  // namespace pbr
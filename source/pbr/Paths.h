@@ -2,3 +2,5 @@
 #define GLSL_DIR DATA_DIR "shaders/glsl/"
 #define HLSL_DIR DATA_DIR "shaders/hlsl/"
 #define BRDF_LUT DATA_DIR "preload/brdf.bin"
+#define SHADER_CACHE_DIR DATA_DIR "cache/shaders/"
+#define TEXTURE_CACHE_DIR DATA_DIR "cache/textures/"
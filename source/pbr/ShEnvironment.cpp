@@ -0,0 +1,86 @@
+#include "ShEnvironment.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "FileSystem.h"
+#include "base/Error.h"
+
+namespace pbr {
+
+static void shBasis(const vec3& d, float (&basis)[9]) {
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * d.y;
+    basis[2] = 0.488603f * d.z;
+    basis[3] = 0.488603f * d.x;
+    basis[4] = 1.092548f * d.x * d.y;
+    basis[5] = 1.092548f * d.y * d.z;
+    basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    basis[7] = 1.092548f * d.x * d.z;
+    basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+// the directions of to_cubemap.frag, the first row is the top of the image
+ShEnvironment ShEnvironment::Project(const Image& image) {
+    if (image.dataType != DataType::FLOAT_32T || image.component < 3)
+        THROW_EXCEPTION("image: the environment is not a float RGB image");
+
+    const float pi = glm::pi<float>();
+    const float* texels = reinterpret_cast<const float*>(image.buffer.pData);
+    ShEnvironment environment;
+    for (vec3& coefficient : environment.m_coefficients)
+        coefficient = vec3(0.0f);
+    for (int y = 0; y < image.height; ++y) {
+        const float latitude = (0.5f - (y + 0.5f) / image.height) * pi;
+        // a texel covers less of the sphere towards the poles
+        const float solidAngle = std::cos(latitude) * (2.0f * pi / image.width) * (pi / image.height);
+        for (int x = 0; x < image.width; ++x) {
+            const float longitude = ((x + 0.5f) / image.width - 0.5f) * 2.0f * pi;
+            const vec3 d(std::cos(latitude) * std::cos(longitude), std::sin(latitude), std::cos(latitude) * std::sin(longitude));
+            const float* p = texels + (static_cast<size_t>(y) * image.width + x) * image.component;
+            const vec3 radiance = vec3(p[0], p[1], p[2]) * solidAngle;
+            float basis[9];
+            shBasis(d, basis);
+            for (int i = 0; i < 9; ++i)
+                environment.m_coefficients[i] += radiance * basis[i];
+        }
+    }
+    return environment;
+}
+
+ShEnvironment ShEnvironment::Read(const string& path) {
+    ShEnvironment environment;
+    const FileData data = FileSystem::GetSingleton().Read(path);
+    if (data.Size() != sizeof(environment.m_coefficients))
+        THROW_EXCEPTION("image: '" + path + "' is not a spherical harmonics environment");
+    memcpy(environment.m_coefficients.data(), data.Data(), data.Size());
+    return environment;
+}
+
+void ShEnvironment::Write(const string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(m_coefficients.data()), sizeof(m_coefficients));
+    if (!file.good())
+        THROW_EXCEPTION("filesystem: Failed to write '" + path + "'");
+}
+
+vec3 ShEnvironment::Radiance(const vec3& direction) const {
+    float basis[9];
+    shBasis(direction, basis);
+    vec3 radiance(0.0f);
+    for (int i = 0; i < 9; ++i)
+        radiance += m_coefficients[i] * basis[i];
+    return glm::max(radiance, vec3(0.0f));
+}
+
+vec3 ShEnvironment::Irradiance(const vec3& normal) const {
+    // cosine lobe convolution (pi, 2pi/3, pi/4 per band), then the division by pi
+    static const float s_bands[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    float basis[9];
+    shBasis(normal, basis);
+    vec3 irradiance(0.0f);
+    for (int i = 0; i < 9; ++i)
+        irradiance += m_coefficients[i] * (basis[i] * s_bands[i]);
+    return glm::max(irradiance, vec3(0.0f));
+}
+
+}  // namespace pbr
@@ -0,0 +1,23 @@
+#pragma once
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// Third order spherical harmonics projection of the radiance of an environment, nine RGB coefficients
+// in a 108 byte file next to the hdr. It lights the model until the environment map itself arrived.
+class ShEnvironment {
+   public:
+    // a float RGB equirectangular image as utility::ReadHDRImage returns it
+    static ShEnvironment Project(const Image& image);
+    static ShEnvironment Read(const string& path);
+    void Write(const string& path) const;
+
+    vec3 Radiance(const vec3& direction) const;
+    // cosine convolution divided by pi, what irradiance.frag stores
+    vec3 Irradiance(const vec3& normal) const;
+
+   private:
+    array<vec3, 9> m_coefficients;
+};
+
+}  // namespace pbr
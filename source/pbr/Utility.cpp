@@ -1,60 +1,74 @@
 #include "Utility.h"
+#include "FileSystem.h"
+#include "ImageKernels.h"
+#include "MeshCodec.h"
 #include "base/Error.h"
+#include "base/Half.h"
 
+// decoded pixels are handed to Image as they are, stb allocates them from the image heap
+#define STBI_MALLOC(size) pbr::GetImageHeap().Allocate(size)
+#define STBI_REALLOC(pData, size) pbr::GetImageHeap().Reallocate(pData, size)
+#define STBI_FREE(pData) pbr::GetImageHeap().Free(pData)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
-#include <fstream>
-#include <streambuf>
-using std::ifstream;
-using std::ios;
-using std::istreambuf_iterator;
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+using std::istringstream;
 
 namespace pbr {
 namespace utility {
 
 TexturedMesh LoadModel(const char* path) {
-    string txtpath(path);
-    txtpath.append("model.txt");
-    string binpath(path);
-    binpath.append("model.bin");
-    ifstream txt(txtpath);
-    if (!txt.is_open())
-        THROW_EXCEPTION("Failed to open file \"" + txtpath + "\"");
-
-    ifstream bin(binpath, std::ios_base::out | std::ios::binary);
-    if (!bin.is_open())
-        THROW_EXCEPTION("Failed to open file \"" + binpath + "\"");
-
-    // dummy loader
+    // the compressed payload is preferred over the raw one
+    const string meshPath = string(path) + "model.mesh";
+    if (FileExists(meshPath)) {
+        const FileData data = FileSystem::GetSingleton().Read(meshPath);
+        return MeshCodec::Decode(data.Data(), data.Size());
+    }
+    return LoadRawModel(path);
+}
+
+TexturedMesh LoadRawModel(const char* path) {
+    const FileData txtData = FileSystem::GetSingleton().Read(string(path) + "model.txt");
+    const FileData bin = FileSystem::GetSingleton().Read(string(path) + "model.bin");
+    istringstream txt(txtData.Text());
+
+    // dummy loader, a short model.bin leaves the missing tail zeroed
     TexturedMesh mesh;
     string str;
     int counter = 0;
+    size_t offset = 0;
     while (txt >> str) {
         if (str == "size") {
             int size;
             txt >> size;
+            void* pTarget;
             if (counter == 0) {
                 mesh.indices.resize(size / sizeof(uvec3));
-                bin.read(reinterpret_cast<char*>(mesh.indices.data()), size);
+                pTarget = mesh.indices.data();
             } else {
                 mesh.vertices.resize(size / sizeof(TexturedVertex));
-                bin.read(reinterpret_cast<char*>(mesh.vertices.data()), size);
+                pTarget = mesh.vertices.data();
             }
+            const size_t count = std::min(static_cast<size_t>(size), bin.Size() - std::min(offset, bin.Size()));
+            if (count)
+                memcpy(pTarget, bin.Data() + offset, count);
+            offset += size;
             ++counter;
         }
     }
 
-    txt.close();
-    bin.close();
-
     return mesh;
 }
-string ReadAsciiFile(const char* path) {
-    ifstream f(path);
-    if (!f.good())
-        THROW_EXCEPTION("filesystem: Failed to open file '" + string(path) + "'");
+bool FileExists(const string& path) {
+    return FileSystem::GetSingleton().Exists(path);
+}
 
-    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+string ReadAsciiFile(const char* path) {
+    return FileSystem::GetSingleton().Read(path).Text();
 }
 
 string ReadAsciiFile(const string& path) {
@@ -62,16 +76,9 @@ string ReadAsciiFile(const string& path) {
 }
 
 vector<char> ReadBinaryFile(const char* path) {
-    ifstream f(path, ios::ate | ios::binary);
-    if (!f.good())
-        THROW_EXCEPTION("filesystem: Failed to open file '" + string(path) + "'");
-
-    size_t fileSize = static_cast<size_t>(f.tellg());
-    vector<char> buffer(fileSize);
-    f.seekg(0);
-    f.read(buffer.data(), fileSize);
-    f.close();
-    return buffer;
+    const FileData data = FileSystem::GetSingleton().Read(path);
+    const char* pData = reinterpret_cast<const char*>(data.Data());
+    return vector<char>(pData, pData + data.Size());
 }
 
 vector<char> ReadBinaryFile(const string& path) {
@@ -80,28 +87,23 @@ vector<char> ReadBinaryFile(const string& path) {
 
 Image ReadPng(const char* path, int comp) {
     Image image;
-    unsigned char* data = stbi_load(path, &image.width, &image.height, &image.component, 0);
+    const FileData file = FileSystem::GetSingleton().Read(path);
+    unsigned char* data = stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &image.width, &image.height, &image.component, 0);
     if (!data)
         THROW_EXCEPTION("filesystem: Failed to open image '" + string(path) + "'");
 
     image.dataType = DataType::UINT_8T;
     if (comp == 0) {
-        image.buffer.pData = data;
-        image.buffer.sizeInByte = image.width * image.height * image.component;
+        image.Adopt(data, image.width * image.height * image.component);
     } else {
-        if (!(comp == 4 && image.component == 3))
+        if (!(comp == 4 && image.component == 3)) {
+            stbi_image_free(data);
             THROW_EXCEPTION("image: unsupported component");
-        image.buffer.sizeInByte = image.width * image.height * comp;
-        image.component = comp;
-        unsigned char* buffer = (unsigned char*)malloc(image.buffer.sizeInByte);
-        for (int i = 0; i < image.width * image.height; ++i) {
-            buffer[4 * i] = data[3 * i];
-            buffer[4 * i + 1] = data[3 * i + 1];
-            buffer[4 * i + 2] = data[3 * i + 2];
-            buffer[4 * i + 3] = 0;
         }
-        free(data);
-        image.buffer.pData = buffer;
+        image.Allocate(image.width * image.height * comp);
+        image.component = comp;
+        kernels::Swizzle(data, 3, static_cast<uint8_t*>(image.buffer.pData), 4, { 0, 1, 2, kernels::ZERO }, size_t(image.width) * image.height);
+        stbi_image_free(data);
     }
     return image;
 }
@@ -110,34 +112,26 @@ Image ReadPng(const string& path, int comp) {
     return ReadPng(path.c_str(), comp);
 }
 
-Image ReadHDRImage(const string& path) {
-    return ReadHDRImage(path.c_str());
+Image ReadHDRImage(const string& path, HdrFormat format, int maxWidth) {
+    return ReadHDRImage(path.c_str(), format, maxWidth);
 }
 
-Image ReadHDRImage(const char* path) {
-    Image image;
-    float* data = stbi_loadf(path, &image.width, &image.height, &image.component, 0);
-    if (!data)
-        THROW_EXCEPTION("filesystem: Failed to open image '" + string(path) + "'");
-
-    image.buffer.pData = data;
-    image.buffer.sizeInByte = sizeof(float) * image.width * image.height * image.component;
-    image.dataType = DataType::FLOAT_32T;
-    return image;
+Image ReadHDRImage(const char* path, HdrFormat format, int maxWidth) {
+    const FileData file = FileSystem::GetSingleton().Read(path);
+    return DecodeHdr(file.Data(), file.Size(), format, maxWidth, path);
 }
 
+// brdf.bin is written by tool/brdfLutGenerator, half-float RG texels uploaded as is
 Image ReadBrdfLUT(const char* path, int size) {
-    ifstream bin(path, ios::out | ios::binary);
-    if (!bin.is_open())
-        THROW_EXCEPTION("filesystem: Failed to open image '" + string(path) + "'");
-    const int sizeInByte = sizeof(float) * 2 * size * size;
-    float* buffer = reinterpret_cast<float*>(malloc(sizeInByte));
-    bin.read(reinterpret_cast<char*>(buffer), sizeInByte);
+    const FileData bin = FileSystem::GetSingleton().Read(path);
+    const size_t sizeInByte = sizeof(half_t) * 2 * size * size;
+    if (bin.Size() != sizeInByte)
+        THROW_EXCEPTION("image: '" + string(path) + "' is not a " + std::to_string(size) + "x" + std::to_string(size) + " half-float LUT");
     Image image;
+    image.Allocate(sizeInByte);
+    memcpy(image.buffer.pData, bin.Data(), sizeInByte);
     image.component = 2;
-    image.buffer.pData = buffer;
-    image.buffer.sizeInByte = sizeInByte;
-    image.dataType = DataType::FLOAT_32T;
+    image.dataType = DataType::FLOAT_16T;
     image.width = image.height = size;
     return image;
 }
@@ -146,6 +140,38 @@ Image ReadBrdfLUT(const string& path, int size) {
     return ReadBrdfLUT(path.c_str(), size);
 }
 
+// 8 bit images, the first row is the top of the picture
+void WritePng(const string& path, const Image& image) {
+    if (image.dataType != DataType::UINT_8T)
+        THROW_EXCEPTION("image: only 8 bit images can be written as png");
+    const int stride = image.width * image.component;
+    if (!stbi_write_png(path.c_str(), image.width, image.height, image.component, image.buffer.pData, stride))
+        THROW_EXCEPTION("filesystem: Failed to write image '" + path + "'");
+}
+
+// float RGB images, the first row is the top of the picture
+void WriteHdr(const string& path, const Image& image) {
+    if (image.dataType != DataType::FLOAT_32T)
+        THROW_EXCEPTION("image: only float images can be written as hdr");
+    if (!stbi_write_hdr(path.c_str(), image.width, image.height, image.component, reinterpret_cast<const float*>(image.buffer.pData)))
+        THROW_EXCEPTION("filesystem: Failed to write image '" + path + "'");
+}
+
+vector<uint8_t> Deflate(const void* pData, size_t size) {
+    int outSize = 0;
+    unsigned char* pOut = stbi_zlib_compress(static_cast<unsigned char*>(const_cast<void*>(pData)), static_cast<int>(size), &outSize, 8);
+    if (!pOut)
+        return vector<uint8_t>();
+    vector<uint8_t> result(pOut, pOut + outSize);
+    STBIW_FREE(pOut);
+    return result;
+}
+
+bool Inflate(const void* pData, size_t size, void* pOut, size_t outSize) {
+    const int written = stbi_zlib_decode_buffer(static_cast<char*>(pOut), static_cast<int>(outSize), static_cast<const char*>(pData), static_cast<int>(size));
+    return written >= 0 && static_cast<size_t>(written) == outSize;
+}
+
 bool IsNaN(const mat4& m) {
     const float* p = &m[0].x;
     for (int i = 0; i < 16; ++i)
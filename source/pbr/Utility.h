@@ -1,20 +1,30 @@
 #pragma once
+#include "HdrDecoder.h"
 #include "Mesh.h"
 #include "base/Definitions.h"
 
 namespace pbr {
 namespace utility {
+extern bool FileExists(const string& path);
 extern string ReadAsciiFile(const char* path);
 extern string ReadAsciiFile(const string& path);
 extern vector<char> ReadBinaryFile(const char* path);
 extern vector<char> ReadBinaryFile(const string& path);
 extern Image ReadPng(const char* path, int comp = 0);
 extern Image ReadPng(const string& path, int comp = 0);
-extern Image ReadHDRImage(const char* path);
-extern Image ReadHDRImage(const string& path);
+// see DecodeHdr(), maxWidth 0 keeps the full size
+extern Image ReadHDRImage(const char* path, HdrFormat format = HdrFormat::FLOAT32, int maxWidth = 0);
+extern Image ReadHDRImage(const string& path, HdrFormat format = HdrFormat::FLOAT32, int maxWidth = 0);
 extern Image ReadBrdfLUT(const char* path, int size);
 extern Image ReadBrdfLUT(const string& path, int size);
+extern void WritePng(const string& path, const Image& image);
+extern void WriteHdr(const string& path, const Image& image);
+// zlib streams of the deflate in stb_image_write, Inflate fails unless exactly outSize bytes come out
+extern vector<uint8_t> Deflate(const void* pData, size_t size);
+extern bool Inflate(const void* pData, size_t size, void* pOut, size_t outSize);
 extern bool IsNaN(const mat4& m);
+// model.mesh if there is one, see MeshCodec.h, model.txt and model.bin otherwise
 extern TexturedMesh LoadModel(const char* path);
+extern TexturedMesh LoadRawModel(const char* path);
 }  // namespace utility
 }  // namespace pbr
@@ -0,0 +1,283 @@
+#include "Allocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace pbr {
+
+static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+// blocks grow in steps of this, a slightly bigger peak does not reallocate every frame
+static constexpr size_t ARENA_GRANULARITY = 64 << 10;
+static constexpr size_t FRAME_ARENA_CAPACITY = 256 << 10;
+static constexpr size_t SCRATCH_ARENA_CAPACITY = 64 << 10;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void updatePeak(AllocatorStats& stats) {
+    stats.peakBytes = std::max(stats.peakBytes, stats.bytesInUse);
+}
+
+struct LinearArena::Block {
+    Block* pPrevious;
+    size_t size;
+
+    uint8_t* Data() { return reinterpret_cast<uint8_t*>(this) + alignUp(sizeof(Block), ALIGNMENT); }
+};
+
+LinearArena::LinearArena(const char* name, size_t capacity)
+    : m_name(name), m_minCapacity(capacity) {
+    if (capacity)
+        pushBlock(capacity);
+}
+
+LinearArena::~LinearArena() {
+    while (m_pBlock)
+        popBlock();
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+    assert(alignment <= ALIGNMENT && (alignment & (alignment - 1)) == 0);
+    size_t offset = alignUp(m_offset, alignment);
+    if (!m_pBlock || offset + size > m_pBlock->size) {
+        pushBlock(std::max(size, m_pBlock ? m_pBlock->size : std::max(m_minCapacity, ARENA_GRANULARITY)));
+        offset = 0;
+    }
+    void* pData = m_pBlock->Data() + offset;
+    m_stats.bytesInUse += offset + size - m_offset;
+    m_offset = offset + size;
+    ++m_stats.allocations;
+    updatePeak(m_stats);
+    return pData;
+}
+
+const char* LinearArena::Copy(const char* string) {
+    const size_t length = strlen(string) + 1;
+    char* pCopy = AllocateArray<char>(length);
+    memcpy(pCopy, string, length);
+    return pCopy;
+}
+
+void LinearArena::Rewind(const Marker& marker) {
+    // back to empty, e.g. the last scope of a scratch arena, settles on one block like Reset()
+    if (marker.bytesInUse == 0) {
+        Reset();
+        return;
+    }
+    while (m_pBlock != marker.pBlock)
+        popBlock();
+    m_offset = marker.offset;
+    m_stats.bytesInUse = marker.bytesInUse;
+}
+
+void LinearArena::Reset() {
+    if (m_pBlock && m_pBlock->pPrevious) {
+        // merge the spilled blocks into one that fits everything the arena held at once
+        while (m_pBlock)
+            popBlock();
+        m_minCapacity = alignUp(m_stats.peakBytes, ARENA_GRANULARITY);
+        pushBlock(m_minCapacity);
+    }
+    m_offset = 0;
+    m_stats.bytesInUse = 0;
+}
+
+void LinearArena::pushBlock(size_t size) {
+    void* pMemory = malloc(alignUp(sizeof(Block), ALIGNMENT) + size);
+    if (!pMemory)
+        throw std::bad_alloc();
+    Block* pBlock = static_cast<Block*>(pMemory);
+    pBlock->pPrevious = m_pBlock;
+    pBlock->size = size;
+    // the tail of the previous block is lost until the next Reset()
+    if (m_pBlock)
+        m_stats.bytesInUse += m_pBlock->size - m_offset;
+    m_pBlock = pBlock;
+    m_offset = 0;
+    m_stats.capacity += size;
+    ++m_stats.heapAllocations;
+}
+
+void LinearArena::popBlock() {
+    Block* pBlock = m_pBlock;
+    m_pBlock = pBlock->pPrevious;
+    m_offset = m_pBlock ? m_pBlock->size : 0;
+    m_stats.capacity -= pBlock->size;
+    free(pBlock);
+}
+
+PoolAllocator::PoolAllocator(const char* name, size_t blockSize, size_t blocksPerPage)
+    : m_name(name), m_blockSize(blockSize ? alignUp(std::max(blockSize, sizeof(FreeBlock)), ALIGNMENT) : 0), m_blocksPerPage(blocksPerPage) {
+}
+
+PoolAllocator::~PoolAllocator() {
+    while (m_pPages) {
+        void* pNext = *static_cast<void**>(m_pPages);
+        free(m_pPages);
+        m_pPages = pNext;
+    }
+}
+
+void* PoolAllocator::Allocate(size_t size) {
+    if (m_blockSize == 0)
+        m_blockSize = alignUp(std::max(size, sizeof(FreeBlock)), ALIGNMENT);
+    if (size > m_blockSize)
+        return nullptr;
+
+    if (!m_pFreeList)
+        addPage();
+    FreeBlock* pBlock = m_pFreeList;
+    m_pFreeList = pBlock->pNext;
+    ++m_stats.allocations;
+    m_stats.bytesInUse += m_blockSize;
+    updatePeak(m_stats);
+    return pBlock;
+}
+
+void PoolAllocator::Free(void* pBlock) {
+    if (!pBlock)
+        return;
+    FreeBlock* pFree = static_cast<FreeBlock*>(pBlock);
+    pFree->pNext = m_pFreeList;
+    m_pFreeList = pFree;
+    m_stats.bytesInUse -= m_blockSize;
+}
+
+void PoolAllocator::addPage() {
+    const size_t header = alignUp(sizeof(void*), ALIGNMENT);
+    uint8_t* pPage = static_cast<uint8_t*>(malloc(header + m_blockSize * m_blocksPerPage));
+    if (!pPage)
+        throw std::bad_alloc();
+    *reinterpret_cast<void**>(pPage) = m_pPages;
+    m_pPages = pPage;
+    for (size_t i = m_blocksPerPage; i-- > 0;) {
+        FreeBlock* pBlock = reinterpret_cast<FreeBlock*>(pPage + header + i * m_blockSize);
+        pBlock->pNext = m_pFreeList;
+        m_pFreeList = pBlock;
+    }
+    m_stats.capacity += m_blockSize * m_blocksPerPage;
+    ++m_stats.heapAllocations;
+}
+
+// the size is kept in front of the data, free() does not tell it
+static constexpr size_t HEAP_HEADER = ALIGNMENT;
+
+void* HeapAllocator::Allocate(size_t size) {
+    uint8_t* pMemory = static_cast<uint8_t*>(malloc(HEAP_HEADER + size));
+    if (!pMemory)
+        return nullptr;
+    *reinterpret_cast<size_t*>(pMemory) = size;
+    ++m_allocations;
+    const size_t bytesInUse = m_bytesInUse += size;
+    size_t peak = m_peakBytes.load();
+    while (bytesInUse > peak && !m_peakBytes.compare_exchange_weak(peak, bytesInUse)) {
+    }
+    return pMemory + HEAP_HEADER;
+}
+
+void* HeapAllocator::Reallocate(void* pData, size_t size) {
+    if (!pData)
+        return Allocate(size);
+    void* pNewData = Allocate(size);
+    if (pNewData) {
+        const size_t oldSize = *reinterpret_cast<size_t*>(static_cast<uint8_t*>(pData) - HEAP_HEADER);
+        memcpy(pNewData, pData, std::min(oldSize, size));
+        Free(pData);
+    }
+    return pNewData;
+}
+
+void HeapAllocator::Free(void* pData) {
+    if (!pData)
+        return;
+    uint8_t* pMemory = static_cast<uint8_t*>(pData) - HEAP_HEADER;
+    m_bytesInUse -= *reinterpret_cast<size_t*>(pMemory);
+    free(pMemory);
+}
+
+AllocatorStats HeapAllocator::Stats() const {
+    AllocatorStats stats;
+    stats.allocations = m_allocations;
+    stats.heapAllocations = m_allocations;
+    stats.bytesInUse = m_bytesInUse;
+    stats.peakBytes = m_peakBytes;
+    stats.capacity = m_bytesInUse;
+    return stats;
+}
+
+LinearArena& GetFrameArena() {
+    static LinearArena s_arena("frame", FRAME_ARENA_CAPACITY);
+    return s_arena;
+}
+
+LinearArena& GetScratchArena() {
+    static thread_local LinearArena s_arena("scratch", SCRATCH_ARENA_CAPACITY);
+    return s_arena;
+}
+
+HeapAllocator& GetImageHeap() {
+    static HeapAllocator s_heap("image");
+    return s_heap;
+}
+
+static std::atomic<uint64_t> s_heapAllocationCount { 0 };
+
+uint64_t HeapAllocationCount() {
+    return s_heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void ReportAllocator(ostream& os, const char* name, const AllocatorStats& stats) {
+    os << "[Log] " << name << ": " << stats.allocations << " allocations, " << (stats.bytesInUse >> 10) << " KB in use, peak "
+       << (stats.peakBytes >> 10) << " KB, " << (stats.capacity >> 10) << " KB reserved in " << stats.heapAllocations << " heap blocks" << endl;
+}
+
+}  // namespace pbr
+
+// counts every allocation of the process, a steady frame is expected to make none
+void* operator new(size_t size) {
+    pbr::s_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pData = malloc(size ? size : 1))
+        return pData;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    pbr::s_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* pData) noexcept {
+    free(pData);
+}
+
+void operator delete[](void* pData) noexcept {
+    free(pData);
+}
+
+void operator delete(void* pData, size_t) noexcept {
+    free(pData);
+}
+
+void operator delete[](void* pData, size_t) noexcept {
+    free(pData);
+}
+
+void operator delete(void* pData, const std::nothrow_t&) noexcept {
+    free(pData);
+}
+
+void operator delete[](void* pData, const std::nothrow_t&) noexcept {
+    free(pData);
+}
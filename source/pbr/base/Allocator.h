@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "Prerequisites.h"
+
+namespace pbr {
+
+struct AllocatorStats {
+    size_t allocations = 0;  // since creation
+    size_t bytesInUse = 0;
+    size_t peakBytes = 0;
+    size_t capacity = 0;          // bytes reserved from the heap
+    size_t heapAllocations = 0;   // blocks requested from the heap
+};
+
+// Bump allocator, memory is given back all at once by Reset() or Rewind(). When the block runs out
+// the allocation spills into another heap block, the next Reset() replaces them with one block
+// that fits the peak so a steady workload stops touching the heap. Not thread safe.
+class LinearArena {
+   public:
+    struct Marker {
+        void* pBlock;
+        size_t offset;
+        size_t bytesInUse;
+    };
+
+    // 0 allocates the first block on first use
+    explicit LinearArena(const char* name, size_t capacity = 0);
+    ~LinearArena();
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template <typename T>
+    T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+    // null terminated copy
+    const char* Copy(const char* string);
+
+    Marker Mark() const { return { m_pBlock, m_offset, m_stats.bytesInUse }; }
+    // frees everything allocated after the marker, a marker of the empty arena resets it
+    void Rewind(const Marker& marker);
+    void Reset();
+
+    const char* Name() const { return m_name; }
+    const AllocatorStats& Stats() const { return m_stats; }
+
+   private:
+    struct Block;
+
+    void pushBlock(size_t size);
+    void popBlock();
+
+   private:
+    const char* m_name;
+    Block* m_pBlock = nullptr;  // newest
+    size_t m_offset = 0;        // in the newest block
+    size_t m_minCapacity;
+    AllocatorStats m_stats;
+};
+
+// Rewinds an arena when it goes out of scope
+class ArenaScope {
+   public:
+    explicit ArenaScope(LinearArena& arena)
+        : m_arena(arena), m_marker(arena.Mark()) {}
+    ~ArenaScope() { m_arena.Rewind(m_marker); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+   private:
+    LinearArena& m_arena;
+    LinearArena::Marker m_marker;
+};
+
+// Fixed size blocks carved out of pages, freed blocks are reused before the pool grows.
+// Pages are only returned to the heap when the pool is destroyed. Not thread safe.
+class PoolAllocator {
+   public:
+    // blockSize 0 takes the size of the first allocation, e.g. the node type a container rebinds to
+    explicit PoolAllocator(const char* name, size_t blockSize = 0, size_t blocksPerPage = 64);
+    ~PoolAllocator();
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    // null when the size does not fit a block
+    void* Allocate(size_t size);
+    void Free(void* pBlock);
+
+    const char* Name() const { return m_name; }
+    size_t BlockSize() const { return m_blockSize; }
+    const AllocatorStats& Stats() const { return m_stats; }
+
+   private:
+    struct FreeBlock {
+        FreeBlock* pNext;
+    };
+
+    void addPage();
+
+   private:
+    const char* m_name;
+    size_t m_blockSize;
+    size_t m_blocksPerPage;
+    FreeBlock* m_pFreeList = nullptr;
+    void* m_pPages = nullptr;  // intrusive list, the first pointer of a page links the next one
+    AllocatorStats m_stats;
+};
+
+// General purpose heap that counts what goes through it, e.g. the pixels of every Image.
+// Thread safe, jobs decode images in parallel.
+class HeapAllocator {
+   public:
+    explicit HeapAllocator(const char* name)
+        : m_name(name) {}
+
+    void* Allocate(size_t size);
+    void* Reallocate(void* pData, size_t size);
+    void Free(void* pData);
+
+    const char* Name() const { return m_name; }
+    AllocatorStats Stats() const;
+
+   private:
+    const char* m_name;
+    std::atomic<size_t> m_allocations { 0 };
+    std::atomic<size_t> m_bytesInUse { 0 };
+    std::atomic<size_t> m_peakBytes { 0 };
+};
+
+// STL allocator drawing from an arena, deallocate() is a no-op
+template <typename T>
+class ArenaAllocator {
+   public:
+    typedef T value_type;
+
+    ArenaAllocator(LinearArena& arena)
+        : m_pArena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : m_pArena(other.m_pArena) {}
+
+    T* allocate(size_t count) { return m_pArena->AllocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_pArena == other.m_pArena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_pArena != other.m_pArena; }
+
+   private:
+    LinearArena* m_pArena;
+
+    template <typename U>
+    friend class ArenaAllocator;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// STL allocator for node based containers, single nodes come from the pool, anything else from the heap
+template <typename T>
+class PoolStlAllocator {
+   public:
+    typedef T value_type;
+
+    PoolStlAllocator(PoolAllocator& pool)
+        : m_pPool(&pool) {}
+    template <typename U>
+    PoolStlAllocator(const PoolStlAllocator<U>& other)
+        : m_pPool(other.m_pPool) {}
+
+    T* allocate(size_t count) {
+        void* pBlock = count == 1 ? m_pPool->Allocate(sizeof(T)) : nullptr;
+        return static_cast<T*>(pBlock ? pBlock : ::operator new(sizeof(T) * count));
+    }
+    void deallocate(T* pData, size_t count) {
+        if (count == 1 && sizeof(T) <= m_pPool->BlockSize())
+            m_pPool->Free(pData);
+        else
+            ::operator delete(pData);
+    }
+
+    template <typename U>
+    bool operator==(const PoolStlAllocator<U>& other) const { return m_pPool == other.m_pPool; }
+    template <typename U>
+    bool operator!=(const PoolStlAllocator<U>& other) const { return m_pPool != other.m_pPool; }
+
+   private:
+    PoolAllocator* m_pPool;
+
+    template <typename U>
+    friend class PoolStlAllocator;
+};
+
+// transient data of the frame being rendered, reset when the next one starts. Render thread only
+extern LinearArena& GetFrameArena();
+// per thread, e.g. temporaries of a job, allocate under an ArenaScope
+extern LinearArena& GetScratchArena();
+extern HeapAllocator& GetImageHeap();
+
+// calls of the global operator new since the start of the process, from any thread
+extern uint64_t HeapAllocationCount();
+
+extern void ReportAllocator(ostream& os, const char* name, const AllocatorStats& stats);
+
+}  // namespace pbr
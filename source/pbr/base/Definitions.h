@@ -1,4 +1,6 @@
 #pragma once
+#include "Allocator.h"
+#include "Error.h"
 #include "Prerequisites.h"
 
 namespace pbr {
@@ -7,7 +9,9 @@ enum class DataType {
     UINT_8T,
     UINT_16T,
     UINT_32T,
+    FLOAT_16T,
     FLOAT_32T,
+    RGB9E5,  // RGB of a uint32_t, 9 bit mantissas and a shared exponent
 };
 
 struct Buffer {
@@ -15,22 +19,71 @@ struct Buffer {
     size_t sizeInByte;
 };
 
+// The pixels come from the image heap and are freed with the image unless Wrap() pointed it at
+// memory of someone else, e.g. a mapped readback buffer.
 struct Image {
-    int width, height;
-    int component;
-    DataType dataType;
-    Buffer buffer;
+    int width = 0, height = 0;
+    int component = 0;
+    DataType dataType = DataType::UINT_8T;
+    Buffer buffer = { nullptr, 0 };
+
+    Image() = default;
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&& other) noexcept { *this = std::move(other); }
+    Image& operator=(Image&& other) noexcept {
+        if (this != &other) {
+            Free();
+            width = other.width;
+            height = other.height;
+            component = other.component;
+            dataType = other.dataType;
+            buffer = other.buffer;
+            m_owned = other.m_owned;
+            other.buffer = { nullptr, 0 };
+            other.m_owned = false;
+        }
+        return *this;
+    }
+    ~Image() { Free(); }
+
+    void Allocate(size_t sizeInByte) {
+        void* pData = GetImageHeap().Allocate(sizeInByte);
+        if (!pData)
+            THROW_EXCEPTION("image: failed to allocate " + std::to_string(sizeInByte) + " bytes");
+        Adopt(pData, sizeInByte);
+    }
+    // takes over a buffer of the image heap
+    void Adopt(void* pData, size_t sizeInByte) {
+        Free();
+        buffer = { pData, sizeInByte };
+        m_owned = true;
+    }
+    void Wrap(void* pData, size_t sizeInByte) {
+        Free();
+        buffer = { pData, sizeInByte };
+    }
+    void Free() {
+        if (m_owned)
+            GetImageHeap().Free(buffer.pData);
+        buffer = { nullptr, 0 };
+        m_owned = false;
+    }
+
+   private:
+    bool m_owned = false;
 };
 
 enum class RenderApi { UNKNOWN,
                        OPENGL,
                        DIRECT3D11,
                        VULKAN,
-                       METAL };
+                       METAL,
+                       SOFTWARE };
 
 static const string& RenderApiToString(RenderApi api) {
-    static const string sTable[static_cast<int>(RenderApi::METAL) + 1] = {
-        "Unknown", "OpenGL", "Direct3d 11", "Vulkan", "Metal"
+    static const string sTable[static_cast<int>(RenderApi::SOFTWARE) + 1] = {
+        "Unknown", "OpenGL", "Direct3d 11", "Vulkan", "Metal", "Software"
     };
 
     return sTable[static_cast<int>(api)];
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace pbr {
+
+typedef uint16_t half_t;
+
+// IEEE 754 binary16 conversion, round to nearest even
+inline half_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    // NaN and infinity
+    if (exponent == 0xFFu)
+        return static_cast<half_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+
+    const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    // overflow, clamp to infinity
+    if (halfExponent >= 0x1F)
+        return static_cast<half_t>(sign | 0x7C00u);
+
+    // subnormal or zero
+    if (halfExponent <= 0) {
+        if (halfExponent < -10)
+            return static_cast<half_t>(sign);
+        mantissa |= 0x800000u;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t result = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (result & 1u)))
+            ++result;
+        return static_cast<half_t>(sign | result);
+    }
+
+    uint32_t result = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFFu;
+    // carry into the exponent is intended, it rounds up to the next power of two (or infinity)
+    if (remainder > 0x1000u || (remainder == 0x1000u && (result & 1u)))
+        ++result;
+    return static_cast<half_t>(sign | result);
+}
+
+inline float HalfToFloat(half_t value) {
+    const uint32_t sign = (static_cast<uint32_t>(value) & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // normalize subnormal
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x3FFu;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+}  // namespace pbr
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pbr {
+
+static constexpr uint64_t Fnv1a64Seed = 0xcbf29ce484222325ull;
+
+// FNV-1a, pass the previous result as seed to hash several blobs as one
+inline uint64_t Fnv1a64(const void* data, size_t size, uint64_t seed = Fnv1a64Seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t Fnv1a64(const std::string& str, uint64_t seed = Fnv1a64Seed) {
+    // include the terminator so "ab" + "c" and "a" + "bc" differ
+    return Fnv1a64(str.c_str(), str.size() + 1, seed);
+}
+
+}  // namespace pbr
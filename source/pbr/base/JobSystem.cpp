@@ -0,0 +1,321 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include "Platform.h"
+
+namespace pbr {
+
+// 0 on the main thread is resolved through m_mainThread, it can change hands
+static thread_local int t_workerIndex = -1;
+
+// a long bake would otherwise grow the trace without bound
+static constexpr size_t MAX_MARKERS_PER_WORKER = 1 << 16;
+
+JobSystem& JobSystem::GetSingleton() {
+    static JobSystem s_jobSystem;
+    return s_jobSystem;
+}
+
+void JobSystem::Initialize(int threadCount) {
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    // no pthreads in the web build, jobs run on the main thread when it waits for them
+    threadCount = 1;
+#endif
+    if (threadCount <= 0)
+        threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    m_mainThread = std::this_thread::get_id();
+    m_startTime = std::chrono::steady_clock::now();
+    m_queues.clear();
+    for (int i = 0; i < threadCount; ++i)
+        m_queues.emplace_back(new WorkQueue);
+    m_markers.assign(threadCount, vector<Marker>());
+    for (int i = 1; i < threadCount; ++i)
+        m_workers.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+void JobSystem::Finalize() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+    m_queues.clear();
+    m_mainThreadQueue.Clear();
+    m_queuedJobs = 0;
+    m_mainThreadJobs = 0;
+    m_quit = false;
+}
+
+void JobSystem::BindMainThread() {
+    m_mainThread = std::this_thread::get_id();
+}
+
+int JobSystem::CurrentWorker() const {
+    if (std::this_thread::get_id() == m_mainThread.load())
+        return 0;
+    return t_workerIndex;
+}
+
+void JobSystem::Schedule(const char* name, std::function<void()> function, JobCounter* pCounter, JobCounter* pDependency) {
+    Job job;
+    job.name = name;
+    job.function = std::move(function);
+    job.pCounter = pCounter;
+    submit(std::move(job), pDependency);
+    wakeAll();
+}
+
+void JobSystem::ScheduleOnMainThread(const char* name, std::function<void()> function, JobCounter* pCounter, JobCounter* pDependency) {
+    Job job;
+    job.name = name;
+    job.function = std::move(function);
+    job.pCounter = pCounter;
+    job.mainThread = true;
+    submit(std::move(job), pDependency);
+    wakeAll();
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    const int workerIndex = CurrentWorker();
+    while (!counter.IsDone()) {
+        Job job;
+        if (workerIndex == 0 && popMainThreadJob(job)) {
+            run(job, 0);
+            continue;
+        }
+        if (workerIndex >= 0 && popJob(workerIndex, job)) {
+            run(job, workerIndex);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [&] {
+            return counter.IsDone() || (workerIndex >= 0 && m_queuedJobs > 0) ||
+                   (workerIndex == 0 && m_mainThreadJobs > 0);
+        });
+    }
+    // the job that finished the counter lets go of it before the caller may destroy it
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        std::swap(exception, counter.m_exception);
+    }
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void JobSystem::RunMainThreadJobs() {
+    assert(CurrentWorker() == 0);
+    Job job;
+    while (popMainThreadJob(job))
+        run(job, 0);
+}
+
+void JobSystem::ParallelFor(const char* name, int count, const Task& task, int grainSize) {
+    if (count <= 0)
+        return;
+
+    if (grainSize <= 0)
+        grainSize = std::max(1, count / (ThreadCount() * 4));
+    const int batchCount = (count + grainSize - 1) / grainSize;
+
+    // threads outside the system have no worker index to hand to the task
+    const int workerIndex = CurrentWorker();
+    if (workerIndex >= 0 && (batchCount == 1 || m_workers.empty())) {
+        for (int i = 0; i < count; ++i)
+            task(i, workerIndex);
+        return;
+    }
+
+    JobCounter counter;
+    for (int batch = 0; batch < batchCount; ++batch) {
+        Job job;
+        job.name = name;
+        job.pTask = &task;
+        job.begin = batch * grainSize;
+        job.end = std::min(job.begin + grainSize, count);
+        job.pCounter = &counter;
+        counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+        push(std::move(job));
+    }
+    wakeAll();
+    Wait(counter);
+}
+
+void JobSystem::WriteTrace(ostream& os) const {
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    for (size_t workerIndex = 0; workerIndex < m_markers.size(); ++workerIndex) {
+        for (const Marker& marker : m_markers[workerIndex]) {
+            os << (first ? "\n" : ",\n") << "{\"name\":\"" << marker.name << "\",\"ph\":\"X\",\"ts\":" << marker.start
+               << ",\"dur\":" << marker.end - marker.start << ",\"pid\":0,\"tid\":" << workerIndex << "}";
+            first = false;
+        }
+    }
+    os << "\n]}\n";
+}
+
+void JobSystem::workerMain(int workerIndex) {
+    t_workerIndex = workerIndex;
+    for (;;) {
+        Job job;
+        if (popJob(workerIndex, job)) {
+            run(job, workerIndex);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_quit || m_queuedJobs > 0; });
+        if (m_quit)
+            return;
+    }
+}
+
+void JobSystem::submit(Job&& job, JobCounter* pDependency) {
+    if (job.pCounter)
+        job.pCounter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (pDependency) {
+        std::lock_guard<std::mutex> lock(pDependency->m_mutex);
+        if (!pDependency->IsDone()) {
+            pDependency->m_continuations.push_back(std::move(job));
+            return;
+        }
+    }
+    push(std::move(job));
+}
+
+// a worker keeps its own jobs, anything else spreads them over the queues
+void JobSystem::push(Job&& job) {
+    if (job.mainThread) {
+        std::lock_guard<std::mutex> lock(m_mainThreadQueue.mutex);
+        m_mainThreadQueue.Push(std::move(job));
+        ++m_mainThreadJobs;
+        return;
+    }
+
+    int workerIndex = CurrentWorker();
+    if (workerIndex < 0)
+        workerIndex = static_cast<int>(m_nextQueue++ % m_queues.size());
+    WorkQueue& queue = *m_queues[workerIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.Push(std::move(job));
+    ++m_queuedJobs;
+}
+
+// newest first from the own queue, it is still in cache, oldest first from the others,
+// those tend to be the biggest pieces of work
+bool JobSystem::popJob(int workerIndex, Job& job) {
+    const int queueCount = static_cast<int>(m_queues.size());
+    for (int i = 0; i < queueCount; ++i) {
+        WorkQueue& queue = *m_queues[(workerIndex + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count == 0)
+            continue;
+        if (i == 0)
+            queue.PopBack(job);
+        else
+            queue.PopFront(job);
+        --m_queuedJobs;
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::popMainThreadJob(Job& job) {
+    std::lock_guard<std::mutex> lock(m_mainThreadQueue.mutex);
+    if (m_mainThreadQueue.count == 0)
+        return false;
+    m_mainThreadQueue.PopFront(job);
+    --m_mainThreadJobs;
+    return true;
+}
+
+void JobSystem::run(Job& job, int workerIndex) {
+    const double start = m_profiling ? elapsedMicroseconds() : 0.0;
+    try {
+        if (job.pTask) {
+            for (int i = job.begin; i < job.end; ++i)
+                (*job.pTask)(i, workerIndex);
+        } else {
+            job.function();
+        }
+    } catch (...) {
+        // nothing up a worker's stack could catch it, the thread waiting for the counter rethrows it
+        if (!job.pCounter)
+            throw;
+        std::lock_guard<std::mutex> lock(job.pCounter->m_mutex);
+        if (!job.pCounter->m_exception)
+            job.pCounter->m_exception = std::current_exception();
+    }
+    if (m_profiling) {
+        vector<Marker>& markers = m_markers[workerIndex];
+        if (markers.size() < MAX_MARKERS_PER_WORKER)
+            markers.push_back({ job.name, start, elapsedMicroseconds() });
+    }
+
+    if (job.pCounter)
+        finish(*job.pCounter);
+}
+
+double JobSystem::elapsedMicroseconds() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+void JobSystem::finish(JobCounter& counter) {
+    vector<Job> continuations;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        done = counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (done)
+            continuations.swap(counter.m_continuations);
+    }
+    // the counter may be gone from here on
+    if (!done)
+        return;
+    for (Job& continuation : continuations)
+        push(std::move(continuation));
+    wakeAll();
+}
+
+void JobSystem::WorkQueue::Push(Job&& job) {
+    if (count == jobs.size()) {
+        vector<Job> grown(std::max<size_t>(64, jobs.size() * 2));
+        for (size_t i = 0; i < count; ++i)
+            grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+        jobs.swap(grown);
+        head = 0;
+    }
+    jobs[(head + count) % jobs.size()] = std::move(job);
+    ++count;
+}
+
+void JobSystem::WorkQueue::PopBack(Job& job) {
+    job = std::move(jobs[(head + count - 1) % jobs.size()]);
+    --count;
+}
+
+void JobSystem::WorkQueue::PopFront(Job& job) {
+    job = std::move(jobs[head]);
+    head = (head + 1) % jobs.size();
+    --count;
+}
+
+void JobSystem::WorkQueue::Clear() {
+    jobs.clear();
+    head = 0;
+    count = 0;
+}
+
+// waiters check their condition under the same mutex, a notify can't slip in between
+void JobSystem::wakeAll() {
+    { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+    m_wake.notify_all();
+}
+
+}  // namespace pbr
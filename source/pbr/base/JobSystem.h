@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Prerequisites.h"
+
+namespace pbr {
+
+class JobCounter;
+
+struct Job {
+    const char* name = "job";  // profiling marker
+    std::function<void()> function;
+    // a batch of ParallelFor runs (*pTask)(index, workerIndex) over [begin, end) instead, no closure to allocate
+    const std::function<void(int, int)>* pTask = nullptr;
+    int begin = 0;
+    int end = 0;
+    JobCounter* pCounter = nullptr;  // signaled when the job finished
+    bool mainThread = false;
+};
+
+// Number of unfinished jobs of a group. Jobs can wait for a counter or be scheduled to start
+// once it drops to zero. A counter must outlive the jobs it counts.
+class JobCounter {
+   public:
+    bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+   private:
+    std::atomic<int> m_pending { 0 };
+    std::mutex m_mutex;
+    vector<Job> m_continuations;  // jobs that depend on this counter
+    std::exception_ptr m_exception;  // the first one a counted job threw
+
+    friend class JobSystem;
+};
+
+// Scheduler shared by every CPU heavy subsystem. Each worker owns a double ended queue, it pushes and pops its
+// own jobs at the back and steals from the front of the others when it runs dry. The thread that owns
+// the graphics context is the main thread, it takes part as worker 0 whenever it waits, and is the only
+// one that runs main thread jobs.
+class JobSystem {
+   public:
+    // task(index, workerIndex), workerIndex is below ThreadCount() and addresses per thread scratch memory
+    typedef std::function<void(int, int)> Task;
+
+    static JobSystem& GetSingleton();
+
+    // 0 uses every hardware thread, the calling thread becomes the main thread
+    void Initialize(int threadCount = 0);
+    void Finalize();
+    // hands the main thread role to the calling thread, e.g. the render thread
+    void BindMainThread();
+    inline int ThreadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+    // index of the calling thread, -1 for threads that never run jobs
+    int CurrentWorker() const;
+
+    // the job starts once pDependency is done, pCounter may be null
+    void Schedule(const char* name, std::function<void()> function, JobCounter* pCounter, JobCounter* pDependency = nullptr);
+    // e.g. graphics API calls, run by RunMainThreadJobs() or while the main thread waits
+    void ScheduleOnMainThread(const char* name, std::function<void()> function, JobCounter* pCounter, JobCounter* pDependency = nullptr);
+    // runs other jobs until the counter is done, threads that aren't workers just block,
+    // rethrows the first exception of a counted job
+    void Wait(JobCounter& counter);
+    void RunMainThreadJobs();
+
+    // runs the task for every index in [0, count) and returns once all of them finished,
+    // grainSize 0 gives every thread a few batches
+    void ParallelFor(const char* name, int count, const Task& task, int grainSize = 0);
+
+    // records the start and end of every job until the trace is written
+    void EnableProfiling(bool enabled) { m_profiling = enabled; }
+    // chrome://tracing json
+    void WriteTrace(ostream& os) const;
+
+   private:
+    // ring buffer, it keeps its capacity so a steady stream of jobs stops allocating
+    struct WorkQueue {
+        std::mutex mutex;
+        vector<Job> jobs;
+        size_t head = 0;
+        size_t count = 0;
+
+        void Push(Job&& job);
+        void PopBack(Job& job);
+        void PopFront(Job& job);
+        void Clear();
+    };
+
+    struct Marker {
+        const char* name;
+        double start;  // us since Initialize()
+        double end;
+    };
+
+    JobSystem() = default;
+    void workerMain(int workerIndex);
+    void submit(Job&& job, JobCounter* pDependency);
+    void push(Job&& job);
+    bool popJob(int workerIndex, Job& job);
+    bool popMainThreadJob(Job& job);
+    void run(Job& job, int workerIndex);
+    void finish(JobCounter& counter);
+    double elapsedMicroseconds() const;
+    void wakeAll();
+
+   private:
+    vector<std::thread> m_workers;
+    vector<unique_ptr<WorkQueue>> m_queues;  // one per worker, the main thread included
+    WorkQueue m_mainThreadQueue;
+    std::atomic<std::thread::id> m_mainThread;
+    std::atomic<int> m_queuedJobs { 0 };  // in the worker queues
+    std::atomic<int> m_mainThreadJobs { 0 };
+    std::atomic<unsigned> m_nextQueue { 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+
+    bool m_profiling = false;
+    std::chrono::steady_clock::time_point m_startTime;
+    vector<vector<Marker>> m_markers;  // per worker, only written by it
+};
+
+}  // namespace pbr
@@ -2,12 +2,15 @@
 #define PLATFORM_WINDOWS    0
 #define PLATFORM_MACOS      1
 #define PLATFORM_EMSCRIPTEN 2
+#define PLATFORM_LINUX      3
 #if defined(__EMSCRIPTEN__)
 #define TARGET_PLATFORM PLATFORM_EMSCRIPTEN
 #elif defined(_WIN32)
 #define TARGET_PLATFORM PLATFORM_WINDOWS
 #elif defined(__APPLE__)
 #define TARGET_PLATFORM PLATFORM_MACOS
+#elif defined(__linux__)
+#define TARGET_PLATFORM PLATFORM_LINUX
 #else
 #error "Unsupported platform"
 #endif
@@ -22,4 +25,7 @@
 #elif TARGET_PLATFORM == PLATFORM_MACOS
 #define PBR_GL_VERSION_MAJOR 4
 #define PBR_GL_VERSION_MINOR 1
+#elif TARGET_PLATFORM == PLATFORM_LINUX
+#define PBR_GL_VERSION_MAJOR 4
+#define PBR_GL_VERSION_MINOR 5
 #endif
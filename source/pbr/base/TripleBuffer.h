@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include "Prerequisites.h"
+
+namespace pbr {
+
+// Hands values from one producer thread to one consumer thread without locks. The producer fills
+// its own slot and swaps it with the middle one, the consumer swaps the middle slot with its own
+// when it holds something newer. Neither side ever waits, the consumer only sees the latest value.
+template <typename T>
+class TripleBuffer {
+   public:
+    // producer side, fill the slot and Publish() it
+    T& WriteSlot() { return m_slots[m_write]; }
+    void Publish() {
+        const uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_write | FRESH), std::memory_order_acq_rel);
+        m_write = previous & INDEX_MASK;
+    }
+
+    // consumer side, true when a value was published since the last call, ReadSlot() then returns it
+    bool Acquire() {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        const uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_read), std::memory_order_acq_rel);
+        m_read = previous & INDEX_MASK;
+        return true;
+    }
+    const T& ReadSlot() const { return m_slots[m_read]; }
+
+   private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;  // the middle slot holds a value the consumer hasn't seen
+
+    array<T, 3> m_slots;
+    int m_write = 0;
+    int m_read = 1;
+    std::atomic<uint8_t> m_middle { 2 };
+};
+
+}  // namespace pbr
@@ -1,8 +1,14 @@
 #include "Application.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
+#include "FileSystem.h"
 #include "Globals.h"
+#include "ResourceRegistry.h"
+#include "Scene.h"
+#include "base/Allocator.h"
 #include "base/Config.h"
 #include "base/Error.h"
+#include "base/JobSystem.h"
 #include "base/Platform.h"
 
 #if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
@@ -29,8 +35,19 @@ void Application::Run(int argc, const char **argv) {
 #if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
     emscripten_set_main_loop(pbr::mainloop, 0, true);
 #else
-    while (!m_window->ShouldClose()) {
-        mainloop();
+    // --frames counts the frames that were drawn, not the idle iterations of --on-demand
+    if (g_renderThread) {
+        // the main thread only handles events, they wake it up
+        startRenderThread();
+        while (!m_window->ShouldClose() && (g_frameCount == 0 || m_renderedFrames < g_frameCount)) {
+            m_window->WaitEvents(idleTimeout);
+            update();
+        }
+        stopRenderThread();
+    } else {
+        while (!m_window->ShouldClose() && (g_frameCount == 0 || m_renderedFrames < g_frameCount)) {
+            mainloop();
+        }
     }
 #endif
 
@@ -40,12 +57,37 @@ void Application::Run(int argc, const char **argv) {
 void Application::initialize() {
     cout << "************* Debug Info *************\n";
 
+    if (g_headless && g_windowCreateInfo.renderApi != RenderApi::SOFTWARE && g_windowCreateInfo.renderApi != RenderApi::VULKAN)
+        THROW_EXCEPTION("option --headless needs the software or Vulkan renderer, not " + RenderApiToString(g_windowCreateInfo.renderApi));
+    if (g_pathTracing && g_windowCreateInfo.renderApi != RenderApi::SOFTWARE)
+        THROW_EXCEPTION("option --path-trace needs the software renderer, not " + RenderApiToString(g_windowCreateInfo.renderApi));
+    if (g_headless && g_renderOnDemand)
+        THROW_EXCEPTION("option --on-demand needs a window, nothing changes a headless frame");
+    if (g_headless && g_renderThread)
+        THROW_EXCEPTION("option --render-thread needs a window, a headless run has no events to handle");
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    if (g_renderThread)
+        THROW_EXCEPTION("option --render-thread is not supported by the web build");
+#endif
+    if (!g_assetUrl.empty() && g_windowCreateInfo.renderApi != RenderApi::OPENGL)
+        THROW_EXCEPTION("option --asset-url needs the OpenGL renderer, not " + RenderApiToString(g_windowCreateInfo.renderApi));
+    if (!g_assetUrl.empty() && g_virtualTexturing)
+        THROW_EXCEPTION("option --virtual-texturing pages maps from the local cache, it can't be combined with --asset-url");
+
+    JobSystem::GetSingleton().Initialize();
+    JobSystem::GetSingleton().EnableProfiling(!g_jobTracePath.empty());
+    if (!g_archivePath.empty()) {
+        FileSystem::GetSingleton().Mount(g_archivePath);
+        cout << "[Log] mounted archive " << g_archivePath << endl;
+    }
+
     m_window.reset(new Window());
     m_window->Initialize(g_windowCreateInfo);
     m_renderer.reset(Renderer::CreateRenderer(m_window.get()));
     m_renderer->Initialize();
     m_renderer->DumpGraphicsCardInfo();
     m_renderer->PrepareGpuResources();
+    ResourceRegistry::GetSingleton().Report(cout);
 
     // initialize camera
     mat4 transform = glm::translate(mat4(1.0f), vec3(0.0f, 0.0f, 10.0f));
@@ -53,37 +95,215 @@ void Application::initialize() {
     m_camera.SetAspect(-1.0f);  // force update
     m_camera.SetFov(glm::radians(60.0f));
     m_cameraController.SetCamera(&m_camera);
+
+    m_debugView = g_debug;
+    m_lightCount = g_lightCount;
+    m_renderedExtent = m_window->GetFrameBufferExtent();
+    // the first snapshot, a render thread starts drawing before the first event arrives
+    update();
 }
 
+// with --on-demand a frame is drawn only when the camera, the shading options or the window changed,
+// or the renderer is still refining a still image. Otherwise the last presented frame stays on screen
 void Application::Mainloop() {
-    m_window->PollEvents();
+    if (g_renderOnDemand && m_renderedVersion == m_version && !m_renderer->IsRefining())
+        m_window->WaitEvents(idleTimeout);
+    else
+        m_window->PollEvents();
+    update();
+    renderFrame();
+}
+
+void Application::update() {
     m_cameraController.Update(m_window.get());
     handleKeyInput();
-    m_renderer->Render(m_camera);
-    m_window->SwapBuffers();
+
+    if (m_camera.IsDirty())
+        ++m_cameraVersion;
+    if (m_camera.IsDirty() || m_window->IsDamaged())
+        ++m_version;
+    publishSnapshot();
     m_window->PostUpdate();
 }
 
+void Application::publishSnapshot() {
+    FrameSnapshot& snapshot = m_snapshots.WriteSlot();
+    snapshot.camera = m_camera;
+    snapshot.framebufferExtent = m_window->GetLatestFrameBufferExtent();
+    snapshot.debugView = m_debugView;
+    snapshot.lightCount = m_lightCount;
+    snapshot.version = m_version;
+    snapshot.cameraVersion = m_cameraVersion;
+    m_snapshots.Publish();
+
+    if (g_renderThread) {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            ++m_publishCount;
+        }
+        m_wake.notify_one();
+    }
+}
+
+bool Application::renderFrame() {
+    // e.g. uploads of assets decoded on the workers, they need the graphics context
+    JobSystem::GetSingleton().RunMainThreadJobs();
+
+    m_snapshots.Acquire();
+    const FrameSnapshot& snapshot = m_snapshots.ReadSlot();
+    if (g_renderOnDemand && snapshot.version == m_renderedVersion && !m_renderer->IsRefining()) {
+        m_renderer->FrameSkipped();
+        return false;
+    }
+
+    // the renderers read the shading options and the extent on this thread only
+    g_debug = snapshot.debugView;
+    g_lightCount = snapshot.lightCount;
+    const Extent2i& extent = snapshot.framebufferExtent;
+    if (extent.width != m_renderedExtent.width || extent.height != m_renderedExtent.height) {
+        m_window->SetFrameBufferExtent(extent);
+        m_renderer->Resize(extent);
+        m_renderedExtent = extent;
+    }
+    // a skipped snapshot may have been the one that moved the camera
+    Camera camera = snapshot.camera;
+    if (snapshot.cameraVersion != m_renderedCameraVersion)
+        camera.MarkDirty();
+    else
+        camera.ClearDirty();
+
+    // the previous frame's graph and temporaries are gone by now
+    GetFrameArena().Reset();
+    m_renderer->Render(camera);
+    m_window->SwapBuffers();
+    m_renderedVersion = snapshot.version;
+    m_renderedCameraVersion = snapshot.cameraVersion;
+    ++m_renderedFrames;
+    if (g_checkAllocations)
+        checkAllocations();
+
+    if (m_memoryReportRequested.exchange(false)) {
+        ResourceRegistry::GetSingleton().Report(cout);
+        // the report is not part of the frame
+        m_heapAllocations = HeapAllocationCount();
+    }
+    return true;
+}
+
+// the first frames compile shaders and grow the arenas, every frame after them should leave the heap alone.
+// The count covers operator new of every thread since the previous frame, not malloc of C libraries and drivers
+void Application::checkAllocations() {
+    const uint64_t heapAllocations = HeapAllocationCount();
+    if (m_renderedFrames > allocationWarmupFrames && heapAllocations != m_heapAllocations) {
+        cout << "[Warning] frame " << m_renderedFrames << " made " << heapAllocations - m_heapAllocations << " heap allocations" << endl;
+        ++m_allocatingFrames;
+    }
+    m_heapAllocations = HeapAllocationCount();
+}
+
+void Application::reportAllocators() const {
+    ReportAllocator(cout, GetFrameArena().Name(), GetFrameArena().Stats());
+    ReportAllocator(cout, GetImageHeap().Name(), GetImageHeap().Stats());
+    ReportAllocator(cout, "resource records", ResourceRegistry::GetSingleton().RecordStats());
+    const int checkedFrames = std::max(0, m_renderedFrames - allocationWarmupFrames);
+    cout << "[Log] " << m_allocatingFrames << " of " << checkedFrames << " frames after the first " << allocationWarmupFrames
+         << " made heap allocations" << endl;
+}
+
+void Application::startRenderThread() {
+    m_window->MakeContextCurrent(false);
+    m_stopRendering = false;
+    m_renderThread = std::thread([this]() { renderLoop(); });
+}
+
+void Application::stopRenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopRendering = true;
+    }
+    m_wake.notify_one();
+    m_renderThread.join();
+    // the renderer is finalized on the main thread
+    m_window->MakeContextCurrent(true);
+    JobSystem::GetSingleton().BindMainThread();
+}
+
+void Application::renderLoop() {
+    m_window->MakeContextCurrent(true);
+    // main thread jobs go where the graphics context is
+    JobSystem::GetSingleton().BindMainThread();
+    while (!m_stopRendering) {
+        uint64_t publishCount;
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            publishCount = m_publishCount;
+        }
+        if (renderFrame()) {
+            // the main thread may wait for events to count the last frame
+            if (g_frameCount > 0 && m_renderedFrames >= g_frameCount)
+                m_window->WakeUp();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, std::chrono::duration<double>(idleTimeout), [&]() {
+            return m_stopRendering || m_publishCount != publishCount;
+        });
+    }
+    m_window->MakeContextCurrent(false);
+}
+
 void Application::finalize() {
     m_renderer->Finalize();
     m_window->Finalize();
+    ResourceRegistry::GetSingleton().CheckLeaks(cout);
+    if (g_checkAllocations)
+        reportAllocators();
+
+    if (!g_jobTracePath.empty()) {
+        std::ofstream trace(g_jobTracePath);
+        if (!trace)
+            THROW_EXCEPTION("failed to write job trace '" + g_jobTracePath + "'");
+        JobSystem::GetSingleton().WriteTrace(trace);
+        cout << "[Log] job trace written to " << g_jobTracePath << endl;
+    }
+    JobSystem::GetSingleton().Finalize();
+    FileSystem::GetSingleton().Finalize();
 }
 
 void Application::handleKeyInput() {
+    const int debugView = m_debugView;
+    const int lightCount = m_lightCount;
+
     if (m_window->IsKeyDown(KEY_0))  // pbr
-        g_debug = 0;
+        m_debugView = 0;
     else if (m_window->IsKeyDown(KEY_1))  // albedo
-        g_debug = 1;
+        m_debugView = 1;
     else if (m_window->IsKeyDown(KEY_2))  // normal
-        g_debug = 2;
+        m_debugView = 2;
     else if (m_window->IsKeyDown(KEY_3))  // metallic
-        g_debug = 3;
+        m_debugView = 3;
     else if (m_window->IsKeyDown(KEY_4))  // roughness
-        g_debug = 4;
+        m_debugView = 4;
     else if (m_window->IsKeyDown(KEY_5))  // ao
-        g_debug = 5;
+        m_debugView = 5;
     else if (m_window->IsKeyDown(KEY_6))  // ao
-        g_debug = 6;
+        m_debugView = 6;
+
+    if (m_window->IsKeyDown(KEY_7))  // image based lighting only
+        m_lightCount = 0;
+    else if (m_window->IsKeyDown(KEY_8))  // image based lighting + point lights
+        m_lightCount = static_cast<int>(g_lights.size());
+
+    if (m_debugView != debugView || m_lightCount != lightCount)
+        ++m_version;
+
+    // print the GPU memory report once per key press, after the next frame on the render side
+    const bool memoryKeyDown = m_window->IsKeyDown(KEY_M);
+    if (memoryKeyDown && !m_memoryKeyDown) {
+        m_memoryReportRequested = true;
+        ++m_version;
+    }
+    m_memoryKeyDown = memoryKeyDown;
 }
 
 void Application::configureScene(int argc, const char **argv) {
@@ -94,10 +314,20 @@ void Application::configureScene(int argc, const char **argv) {
     string env = "stairs";
 #endif
 
-    if (argc > 1)
-        model = argv[1];
-    if (argc > 2)
-        env = argv[2];
+    // positional arguments are [model] [env], options start with --
+    vector<string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg.compare(0, 2, "--") == 0)
+            parseOption(arg);
+        else
+            positional.push_back(arg);
+    }
+
+    if (positional.size() > 0)
+        model = positional[0];
+    if (positional.size() > 1)
+        env = positional[1];
 
     if (model == "cerberus") {
         const mat4 scaling = glm::scale(mat4(1.0f), vec3(0.05f));
@@ -123,6 +353,90 @@ void Application::configureScene(int argc, const char **argv) {
     g_model_dir.append(model).push_back('/');
 }
 
+void Application::parseOption(const string &option) {
+    const size_t equal = option.find('=');
+    const string name = option.substr(0, equal);
+    const string value = equal == string::npos ? "" : option.substr(equal + 1);
+
+    if (name == "--precision") {
+        if (value == "full")
+            g_reducedPrecision = false;
+        else if (value == "reduced")
+            g_reducedPrecision = true;
+        else
+            THROW_EXCEPTION("option --precision expects 'full' or 'reduced', got '" + value + "'");
+    } else if (name == "--vram-budget") {
+        // in MB
+        const int budget = atoi(value.c_str());
+        if (budget <= 0)
+            THROW_EXCEPTION("option --vram-budget expects a size in MB, got '" + value + "'");
+        ResourceRegistry::GetSingleton().SetBudget(static_cast<size_t>(budget) << 20);
+    } else if (name == "--headless") {
+        g_headless = true;
+        // a single frame unless --frames says otherwise
+        if (g_frameCount == 0)
+            g_frameCount = 1;
+    } else if (name == "--frames") {
+        g_frameCount = atoi(value.c_str());
+        if (g_frameCount <= 0)
+            THROW_EXCEPTION("option --frames expects a positive number, got '" + value + "'");
+    } else if (name == "--output") {
+        if (value.empty())
+            THROW_EXCEPTION("option --output expects a png or hdr path");
+        g_outputPath = value;
+    } else if (name == "--path-trace") {
+        g_pathTracing = true;
+    } else if (name == "--spp") {
+        g_samplesPerFrame = atoi(value.c_str());
+        if (g_samplesPerFrame <= 0)
+            THROW_EXCEPTION("option --spp expects a positive number, got '" + value + "'");
+    } else if (name == "--depth-prepass") {
+        g_depthPrepass = true;
+    } else if (name == "--frame-budget") {
+        g_frameBudget = static_cast<float>(atof(value.c_str()));
+        if (g_frameBudget <= 0.0f)
+            THROW_EXCEPTION("option --frame-budget expects a frame time in ms, got '" + value + "'");
+    } else if (name == "--min-render-scale") {
+        g_minRenderScale = static_cast<float>(atof(value.c_str()));
+        if (g_minRenderScale <= 0.0f || g_minRenderScale > 1.0f)
+            THROW_EXCEPTION("option --min-render-scale expects a scale in (0, 1], got '" + value + "'");
+    } else if (name == "--on-demand") {
+        g_renderOnDemand = true;
+    } else if (name == "--render-thread") {
+        g_renderThread = true;
+    } else if (name == "--job-trace") {
+        if (value.empty())
+            THROW_EXCEPTION("option --job-trace expects a json path");
+        g_jobTracePath = value;
+    } else if (name == "--check-allocations") {
+        g_checkAllocations = true;
+    } else if (name == "--texture-budget") {
+        // in MB
+        const int budget = atoi(value.c_str());
+        if (budget <= 0)
+            THROW_EXCEPTION("option --texture-budget expects a size in MB, got '" + value + "'");
+        g_textureBudget = static_cast<size_t>(budget) << 20;
+    } else if (name == "--virtual-texturing") {
+        g_virtualTexturing = true;
+    } else if (name == "--archive") {
+        if (value.empty())
+            THROW_EXCEPTION("option --archive expects an archive path, see tool/packAssets");
+        g_archivePath = value;
+    } else if (name == "--no-meshlet-culling") {
+        g_meshletCulling = false;
+    } else if (name == "--asset-url") {
+        // empty loads everything up front again
+        g_assetUrl = value;
+    } else if (name == "--size") {
+        int width = 0, height = 0;
+        if (sscanf(value.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+            THROW_EXCEPTION("option --size expects <width>x<height>, got '" + value + "'");
+        g_windowCreateInfo.extent = Extent2i(width, height);
+        g_windowCreateInfo.windowScale = 0.0f;
+    } else
+        THROW_EXCEPTION("unknown option [" + option + "]");
+}
+
 #if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
 string g_env_map_path = DATA_DIR "preload/";
 #else
@@ -132,5 +446,34 @@ string g_env_map_path = DATA_DIR "env/";
 string g_model_dir = DATA_DIR "models/";
 mat4 g_transform = mat4(1.0f);
 int g_debug;
+int g_lightCount;
+// the web build mostly runs on mobile and integrated GPUs
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+bool g_reducedPrecision = true;
+#else
+bool g_reducedPrecision = false;
+#endif
+bool g_headless = false;
+int g_frameCount = 0;
+string g_outputPath;
+bool g_pathTracing = false;
+int g_samplesPerFrame = 1;
+bool g_depthPrepass = false;
+float g_frameBudget = 0.0f;
+float g_minRenderScale = 0.5f;
+bool g_renderOnDemand = false;
+bool g_renderThread = false;
+string g_jobTracePath;
+bool g_checkAllocations = false;
+size_t g_textureBudget = 0;
+bool g_virtualTexturing = false;
+string g_archivePath;
+bool g_meshletCulling = true;
+// the page is served next to the output of tool/webAssets
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+string g_assetUrl = "assets/";
+#else
+string g_assetUrl;
+#endif
 
 }  // namespace pbr
@@ -1,8 +1,14 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "Camera.h"
+#include "FrameSnapshot.h"
 #include "Renderer.h"
 #include "Utility.h"
 #include "Window.h"
+#include "base/TripleBuffer.h"
 
 namespace pbr {
 
@@ -14,10 +20,27 @@ class Application {
     static Application& GetSingleton();
 
    private:
+    // seconds an idle --on-demand loop sleeps before it checks on the renderer again
+    static constexpr double idleTimeout { 0.25 };
+    // frames --check-allocations lets pass before it expects no heap allocations
+    static constexpr int allocationWarmupFrames { 16 };
+
     Application();
     void initialize();
+    // update side, turns input into the next snapshot
+    void update();
     void handleKeyInput();
+    void publishSnapshot();
+    // render side, draws the latest snapshot, returns false when --on-demand had nothing to draw
+    bool renderFrame();
+    void checkAllocations();
+    void reportAllocators() const;
+    // --render-thread, the render thread owns the graphics context until it stops
+    void startRenderThread();
+    void stopRenderThread();
+    void renderLoop();
     void configureScene(int argc, const char** argv);
+    void parseOption(const string& option);
     void finalize();
 
    private:
@@ -25,6 +48,31 @@ class Application {
     unique_ptr<Renderer> m_renderer;
     Camera m_camera;
     CameraController m_cameraController;
+    bool m_memoryKeyDown = false;
+
+    // update side
+    int m_debugView = 0;
+    int m_lightCount = 0;
+    uint64_t m_version = 1;
+    uint64_t m_cameraVersion = 1;
+
+    TripleBuffer<FrameSnapshot> m_snapshots;
+
+    // render side
+    uint64_t m_renderedVersion = 0;
+    uint64_t m_renderedCameraVersion = 0;
+    Extent2i m_renderedExtent;
+    std::atomic<int> m_renderedFrames { 0 };
+    std::atomic<bool> m_memoryReportRequested { false };
+    uint64_t m_heapAllocations = 0;  // HeapAllocationCount() after the previous frame
+    int m_allocatingFrames = 0;
+
+    std::thread m_renderThread;
+    std::atomic<bool> m_stopRendering { false };
+    // wakes an idle render thread, the snapshots themselves are passed without locks
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    uint64_t m_publishCount = 0;
 };
 
 }  // namespace pbr
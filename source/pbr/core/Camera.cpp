@@ -35,6 +35,11 @@ mat4 Camera::ProjectionMatrixGl() const {
     return glm::perspective(m_fov, m_aspect, m_zNear, m_zFar);
 }
 
+// clip space y points down
+mat4 Camera::ProjectionMatrixVk() const {
+    return mat4({ 1, 0, 0, 0 }, { 0, -1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 }) * ProjectionMatrixD3d();
+}
+
 void CubeCamera::ViewMatricesGl(array<mat4, 6>& inMatrices) const {
     inMatrices = {
         glm::lookAt(vec3(0), vec3(1, 0, 0), vec3(0, -1, 0)),
@@ -66,9 +71,9 @@ vec3 CameraController::virtualPoint(const Extent2i& extent, const vec2& cursorPo
     coord = (coord - 0.5f) * vec2(2.0f, -2.0f);
     vec2 normalizedCoord = glm::normalize(coord);  // x in [-1, 1], y in [-1, 1], x^2 + y^2 in [0, 2]
     return vec3 {
-        coord.x / std::sqrtf(2.0f),
-        coord.y / std::sqrtf(2.0f),
-        std::sqrtf(1.0f - 0.5f * (coord.x * coord.x + coord.y * coord.y))
+        coord.x / std::sqrt(2.0f),
+        coord.y / std::sqrt(2.0f),
+        std::sqrt(1.0f - 0.5f * (coord.x * coord.x + coord.y * coord.y))
     };
 }
 
@@ -1,3 +1,4 @@
+#pragma once
 #include "base/Definitions.h"
 #include "base/Prerequisites.h"
 
@@ -13,6 +14,7 @@ class Camera {
     mat4 ViewMatrix() const;
     mat4 ProjectionMatrixD3d() const;
     mat4 ProjectionMatrixGl() const;
+    mat4 ProjectionMatrixVk() const;
     inline void SetTransformation(const mat4& transform) {
         m_transform = transform;
         m_dirty = true;
@@ -21,12 +23,15 @@ class Camera {
         m_aspect = aspect;
         m_dirty = true;
     }
+    inline float GetFov() const { return m_fov; }
+    inline float GetNear() const { return m_zNear; }
     inline void SetFov(float fov) {
         m_fov = fov;
         m_dirty = true;
     }
     inline bool IsDirty() const { return m_dirty; }
     inline void MarkDirty() { m_dirty = true; }
+    inline void ClearDirty() { m_dirty = false; }
 
    protected:
     mat4 m_transform;
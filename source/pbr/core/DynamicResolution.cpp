@@ -0,0 +1,68 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+#include "base/Error.h"
+
+namespace pbr {
+
+// weight of the newest frame in the moving average
+static constexpr float SMOOTHING = 0.1f;
+// frames measured at a scale before it changes, GPU timings arrive a few frames late
+static constexpr int SETTLE_FRAMES = 12;
+// the scale grows only while frames take less than this fraction of the budget
+static constexpr float HEADROOM = 0.85f;
+static constexpr float MAX_STEP = 0.1f;
+static constexpr float MIN_STEP = 0.01f;
+static constexpr int BLOCK_SIZE = 8;
+
+void DynamicResolution::Configure(float budget, float minScale, float maxScale) {
+    assert(minScale > 0.0f && minScale <= maxScale);
+    m_budget = budget;
+    m_minScale = minScale;
+    m_maxScale = maxScale;
+    m_scale = maxScale;
+    Reset();
+}
+
+void DynamicResolution::Reset() {
+    m_average = 0.0f;
+    m_sampleCount = 0;
+}
+
+void DynamicResolution::AddFrameTime(float milliseconds) {
+    if (!IsEnabled())
+        return;
+
+    m_average = m_sampleCount == 0 ? milliseconds : m_average + SMOOTHING * (milliseconds - m_average);
+    if (++m_sampleCount < SETTLE_FRAMES)
+        return;
+    if (m_average <= m_budget && m_average >= HEADROOM * m_budget)
+        return;
+
+    // aim between the budget and the headroom, the pixel count is the square of the scale
+    const float target = 0.5f * (1.0f + HEADROOM) * m_budget;
+    float scale = m_scale * std::sqrt(target / std::max(m_average, 0.001f));
+    scale = std::min(std::max(scale, m_scale - MAX_STEP), m_scale + MAX_STEP);
+    scale = std::min(std::max(scale, m_minScale), m_maxScale);
+    if (std::abs(scale - m_scale) < MIN_STEP)
+        return;
+
+#ifdef PBR_VERBOSE
+    cout << "[Log] render scale " << m_scale << " -> " << scale << ", frame time " << m_average << " ms" << endl;
+#endif
+    m_scale = scale;
+    Reset();
+}
+
+Extent2i DynamicResolution::ScaleExtent(const Extent2i& extent) const {
+    if (m_scale >= 1.0f)
+        return extent;
+    auto scale = [this](int size) {
+        int scaled = static_cast<int>(std::ceil(m_scale * size));
+        scaled = (scaled + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        return std::min(std::max(scaled, 1), size);
+    };
+    return Extent2i(scale(extent.width), scale(extent.height));
+}
+
+}  // namespace pbr
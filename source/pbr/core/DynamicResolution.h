@@ -0,0 +1,31 @@
+#pragma once
+#include "base/Definitions.h"
+
+namespace pbr {
+
+// Picks the scale of the internal render targets from measured frame times. The cost of a frame is
+// assumed to grow with its pixel count, the scale steps towards the one that fits the budget and
+// then waits until enough frames at the new size were measured before it moves again.
+class DynamicResolution {
+   public:
+    // budget in milliseconds, 0 keeps the scale at maxScale
+    void Configure(float budget, float minScale, float maxScale = 1.0f);
+    void AddFrameTime(float milliseconds);
+    // forget the measurements, e.g. after the window was resized
+    void Reset();
+
+    bool IsEnabled() const { return m_budget > 0.0f; }
+    float GetScale() const { return m_scale; }
+    // rounded up to whole blocks of pixels, a small change of the scale doesn't reallocate the targets
+    Extent2i ScaleExtent(const Extent2i& extent) const;
+
+   private:
+    float m_budget = 0.0f;
+    float m_minScale = 1.0f;
+    float m_maxScale = 1.0f;
+    float m_scale = 1.0f;
+    float m_average = 0.0f;
+    int m_sampleCount = 0;
+};
+
+}  // namespace pbr
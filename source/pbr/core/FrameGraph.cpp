@@ -0,0 +1,299 @@
+#include "FrameGraph.h"
+#include <algorithm>
+#include "base/Error.h"
+
+namespace pbr {
+
+template <typename Vector>
+static void addUnique(Vector& indices, int index) {
+    if (std::find(indices.begin(), indices.end(), index) == indices.end())
+        indices.push_back(index);
+}
+
+// every resource the pass writes, each once
+static ArenaVector<FrameGraphResource> passOutputs(const FrameGraph::Pass& pass, LinearArena& arena) {
+    ArenaVector<FrameGraphResource> outputs(pass.writes.begin(), pass.writes.end(), arena);
+    for (const FrameGraph::Attachment& color : pass.colors)
+        addUnique(outputs, color.resource);
+    if (pass.depth.resource != INVALID_FRAME_GRAPH_RESOURCE && !pass.depthReadOnly)
+        addUnique(outputs, pass.depth.resource);
+    return outputs;
+}
+
+static ArenaVector<FrameGraphResource> passInputs(const FrameGraph::Pass& pass, LinearArena& arena) {
+    ArenaVector<FrameGraphResource> inputs(pass.reads.begin(), pass.reads.end(), arena);
+    if (pass.depth.resource != INVALID_FRAME_GRAPH_RESOURCE && pass.depthReadOnly)
+        addUnique(inputs, pass.depth.resource);
+    return inputs;
+}
+
+FrameGraphResource FrameGraph::Builder::Create(const char* name, const FrameGraphTextureDesc& desc) {
+    Resource resource(m_graph.m_arena);
+    resource.name = m_graph.m_arena.Copy(name);
+    resource.desc = desc;
+    m_graph.m_resources.push_back(resource);
+    return static_cast<FrameGraphResource>(m_graph.m_resources.size() - 1);
+}
+
+void FrameGraph::Builder::Read(FrameGraphResource resource) {
+    addUnique(m_pass.reads, resource);
+    addUnique(m_graph.m_resources[resource].readers, m_passIndex);
+}
+
+void FrameGraph::Builder::Write(FrameGraphResource resource) {
+    addUnique(m_pass.writes, resource);
+    addUnique(m_graph.m_resources[resource].writers, m_passIndex);
+}
+
+void FrameGraph::Builder::SetColorTarget(FrameGraphResource resource, LoadOp load, int mipLevel, int layer) {
+    Attachment attachment;
+    attachment.resource = resource;
+    attachment.load = load;
+    attachment.mipLevel = mipLevel;
+    attachment.layer = layer;
+    m_pass.colors.push_back(attachment);
+    addUnique(m_graph.m_resources[resource].writers, m_passIndex);
+}
+
+void FrameGraph::Builder::SetDepthTarget(FrameGraphResource resource, LoadOp load, bool readOnly) {
+    m_pass.depth.resource = resource;
+    m_pass.depth.load = readOnly ? LoadOp::LOAD : load;
+    m_pass.depthReadOnly = readOnly;
+    if (readOnly)
+        addUnique(m_graph.m_resources[resource].readers, m_passIndex);
+    else
+        addUnique(m_graph.m_resources[resource].writers, m_passIndex);
+}
+
+FrameGraph::FrameGraph(LinearArena& arena)
+    : m_arena(arena), m_resources(arena), m_passes(arena), m_order(arena), m_physicalTextures(arena) {
+}
+
+FrameGraphResource FrameGraph::Import(const char* name, const FrameGraphTextureDesc& desc, uint64_t handle) {
+    Resource resource(m_arena);
+    resource.name = m_arena.Copy(name);
+    resource.desc = desc;
+    resource.imported = true;
+    resource.handle = handle;
+    m_resources.push_back(resource);
+    return static_cast<FrameGraphResource>(m_resources.size() - 1);
+}
+
+FrameGraph::Pass& FrameGraph::addPass(const char* name) {
+    m_passes.emplace_back(m_arena);
+    Pass& pass = m_passes.back();
+    pass.name = m_arena.Copy(name);
+    return pass;
+}
+
+void FrameGraph::Compile() {
+    cullPasses();
+    sortPasses();
+    resolveUsage();
+    assignPhysicalTextures();
+}
+
+// a pass survives when it has side effects, writes an imported texture
+// or writes a transient texture a surviving pass reads
+void FrameGraph::cullPasses() {
+    for (Pass& pass : m_passes)
+        pass.refCount = static_cast<int>(passOutputs(pass, m_arena).size());
+    for (Resource& resource : m_resources)
+        resource.refCount = static_cast<int>(resource.readers.size());
+
+    ArenaVector<FrameGraphResource> unreferenced(m_arena);
+    auto cull = [&](Pass& pass) {
+        pass.culled = true;
+        for (FrameGraphResource input : passInputs(pass, m_arena)) {
+            Resource& resource = m_resources[input];
+            if (--resource.refCount == 0 && !resource.imported)
+                unreferenced.push_back(input);
+        }
+    };
+
+    for (FrameGraphResource i = 0; i < static_cast<FrameGraphResource>(m_resources.size()); ++i)
+        if (m_resources[i].refCount == 0 && !m_resources[i].imported)
+            unreferenced.push_back(i);
+    for (Pass& pass : m_passes)
+        if (pass.refCount == 0 && !pass.sideEffect)
+            cull(pass);
+
+    while (!unreferenced.empty()) {
+        const Resource& resource = m_resources[unreferenced.back()];
+        unreferenced.pop_back();
+        for (int writer : resource.writers) {
+            Pass& pass = m_passes[writer];
+            if (!pass.culled && --pass.refCount == 0 && !pass.sideEffect)
+                cull(pass);
+        }
+    }
+}
+
+// a reader runs after every writer of the texture, writers keep the order they were added in,
+// ties are broken by the order of AddPass
+void FrameGraph::sortPasses() {
+    const int passCount = static_cast<int>(m_passes.size());
+    ArenaVector<ArenaVector<int>> successors(passCount, ArenaVector<int>(m_arena), m_arena);
+    ArenaVector<int> inDegree(passCount, 0, m_arena);
+    auto addEdge = [&](int from, int to) {
+        if (from == to || m_passes[from].culled || m_passes[to].culled)
+            return;
+        successors[from].push_back(to);
+        ++inDegree[to];
+    };
+    for (const Resource& resource : m_resources) {
+        for (size_t i = 1; i < resource.writers.size(); ++i)
+            addEdge(resource.writers[i - 1], resource.writers[i]);
+        for (int reader : resource.readers)
+            for (int writer : resource.writers)
+                addEdge(writer, reader);
+    }
+
+    m_order.clear();
+    ArenaVector<bool> scheduled(passCount, false, m_arena);
+    int remaining = 0;
+    for (const Pass& pass : m_passes)
+        remaining += pass.culled ? 0 : 1;
+    while (remaining > 0) {
+        int next = -1;
+        for (int i = 0; i < passCount && next < 0; ++i)
+            if (!m_passes[i].culled && !scheduled[i] && inDegree[i] == 0)
+                next = i;
+        if (next < 0)
+            THROW_EXCEPTION("FrameGraph: passes depend on each other in a cycle");
+        scheduled[next] = true;
+        m_order.push_back(next);
+        for (int successor : successors[next])
+            --inDegree[successor];
+        --remaining;
+    }
+}
+
+// the state of an imported texture before the graph is owned by the backend,
+// a transient texture is undefined on its first use and is cleared when the pass wants to load it
+void FrameGraph::resolveUsage() {
+    ArenaVector<ResourceUsage> current(m_resources.size(), ResourceUsage::UNDEFINED, m_arena);
+    for (int passIndex : m_order) {
+        Pass& pass = m_passes[passIndex];
+        pass.barriers.clear();
+        auto use = [&](FrameGraphResource resource, ResourceUsage usage, Attachment* pAttachment) {
+            const ResourceUsage before = current[resource];
+            const bool imported = m_resources[resource].imported;
+            if (pAttachment && !imported && before == ResourceUsage::UNDEFINED && pAttachment->load == LoadOp::LOAD)
+                pAttachment->load = LoadOp::CLEAR;
+            if (before != usage && !(imported && before == ResourceUsage::UNDEFINED))
+                pass.barriers.push_back({ resource, before, usage });
+            current[resource] = usage;
+        };
+        for (Attachment& color : pass.colors)
+            use(color.resource, ResourceUsage::COLOR_TARGET, &color);
+        if (pass.depth.resource != INVALID_FRAME_GRAPH_RESOURCE)
+            use(pass.depth.resource, pass.depthReadOnly ? ResourceUsage::DEPTH_READ : ResourceUsage::DEPTH_TARGET, &pass.depth);
+        for (FrameGraphResource read : pass.reads)
+            use(read, ResourceUsage::SHADER_READ, nullptr);
+        for (FrameGraphResource write : pass.writes)
+            use(write, ResourceUsage::WRITE, nullptr);
+    }
+}
+
+// transient textures with the same description share a physical texture
+// when one is last used before the other is first used
+void FrameGraph::assignPhysicalTextures() {
+    const size_t resourceCount = m_resources.size();
+    ArenaVector<int> firstUse(resourceCount, -1, m_arena);
+    ArenaVector<int> lastUse(resourceCount, -1, m_arena);
+    for (int position = 0; position < static_cast<int>(m_order.size()); ++position) {
+        const Pass& pass = m_passes[m_order[position]];
+        ArenaVector<FrameGraphResource> used = passOutputs(pass, m_arena);
+        for (FrameGraphResource input : passInputs(pass, m_arena))
+            addUnique(used, input);
+        for (FrameGraphResource resource : used) {
+            if (firstUse[resource] < 0)
+                firstUse[resource] = position;
+            lastUse[resource] = position;
+        }
+    }
+
+    m_physicalTextures.clear();
+    ArenaVector<bool> available(m_arena);
+    for (int position = 0; position < static_cast<int>(m_order.size()); ++position) {
+        for (size_t i = 0; i < resourceCount; ++i) {
+            Resource& resource = m_resources[i];
+            if (resource.imported || firstUse[i] != position)
+                continue;
+            resource.physical = -1;
+            for (size_t slot = 0; slot < m_physicalTextures.size() && resource.physical < 0; ++slot) {
+                if (available[slot] && m_physicalTextures[slot] == resource.desc)
+                    resource.physical = static_cast<int>(slot);
+            }
+            if (resource.physical < 0) {
+                m_physicalTextures.push_back(resource.desc);
+                available.push_back(false);
+                resource.physical = static_cast<int>(m_physicalTextures.size() - 1);
+            }
+            available[resource.physical] = false;
+        }
+        for (size_t i = 0; i < resourceCount; ++i) {
+            if (!m_resources[i].imported && lastUse[i] == position)
+                available[m_resources[i].physical] = true;
+        }
+    }
+}
+
+void FrameGraph::Dump(ostream& os) const {
+    int transientCount = 0;
+    for (const Resource& resource : m_resources)
+        transientCount += !resource.imported && resource.physical >= 0 ? 1 : 0;
+    os << "[Log] frame graph, " << m_order.size() << " of " << m_passes.size() << " passes, "
+       << transientCount << " transient textures in " << m_physicalTextures.size() << " physical textures\n";
+    for (int passIndex : m_order) {
+        const Pass& pass = m_passes[passIndex];
+        os << "  " << pass.name << "\n";
+        for (const Barrier& barrier : pass.barriers) {
+            os << "    " << m_resources[barrier.resource].name << ": " << ResourceUsageToString(barrier.before)
+               << " -> " << ResourceUsageToString(barrier.after) << "\n";
+        }
+    }
+    for (const Pass& pass : m_passes) {
+        if (pass.culled)
+            os << "  " << pass.name << " (culled)\n";
+    }
+}
+
+const char* TargetFormatToString(TargetFormat format) {
+    switch (format) {
+        case TargetFormat::RGBA8:
+            return "RGBA8";
+        case TargetFormat::RGBA16F:
+            return "RGBA16F";
+        case TargetFormat::RGB32F:
+            return "RGB32F";
+        case TargetFormat::R11G11B10F:
+            return "R11F_G11F_B10F";
+        case TargetFormat::DEPTH24:
+            return "DEPTH24";
+        default:
+            return "unknown";
+    }
+}
+
+const char* ResourceUsageToString(ResourceUsage usage) {
+    switch (usage) {
+        case ResourceUsage::UNDEFINED:
+            return "undefined";
+        case ResourceUsage::COLOR_TARGET:
+            return "color target";
+        case ResourceUsage::DEPTH_TARGET:
+            return "depth target";
+        case ResourceUsage::DEPTH_READ:
+            return "depth read";
+        case ResourceUsage::SHADER_READ:
+            return "shader read";
+        case ResourceUsage::WRITE:
+            return "write";
+        default:
+            return "unknown";
+    }
+}
+
+}  // namespace pbr
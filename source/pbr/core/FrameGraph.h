@@ -0,0 +1,179 @@
+#pragma once
+#include <new>
+#include <type_traits>
+#include "base/Allocator.h"
+
+namespace pbr {
+
+enum class TargetFormat {
+    RGBA8,
+    RGBA16F,
+    RGB32F,
+    R11G11B10F,
+    DEPTH24,
+};
+
+struct FrameGraphTextureDesc {
+    int width = 0;
+    int height = 0;
+    TargetFormat format = TargetFormat::RGBA8;
+    int layers = 1;  // 6 for cube maps
+    int mipLevels = 1;
+
+    bool operator==(const FrameGraphTextureDesc& other) const {
+        return width == other.width && height == other.height && format == other.format &&
+               layers == other.layers && mipLevels == other.mipLevels;
+    }
+};
+
+// index of a resource in its graph
+using FrameGraphResource = int;
+static constexpr FrameGraphResource INVALID_FRAME_GRAPH_RESOURCE = -1;
+
+enum class LoadOp {
+    LOAD,
+    CLEAR,
+    DONT_CARE,  // the pass covers every pixel
+};
+
+enum class ResourceUsage {
+    UNDEFINED,
+    COLOR_TARGET,
+    DEPTH_TARGET,
+    DEPTH_READ,  // depth test without writes
+    SHADER_READ,
+    WRITE,  // anything but rendering, e.g. mip generation
+};
+
+// Passes declare the textures they read and write, Compile() culls the passes nothing depends on,
+// orders the rest, resolves clears and the usage transitions between passes and assigns transient
+// textures whose lifetimes don't overlap to the same physical texture. The graph is rebuilt every
+// frame, a backend executes it and owns the physical textures. Everything the graph holds, names and
+// execute callbacks included, lives in an arena, e.g. the frame arena, and is never freed one by one.
+class FrameGraph {
+   public:
+    // a callable copied into the arena, its destructor never runs
+    class Execute {
+       public:
+        void operator()() const { m_pInvoke(m_pCallable); }
+        explicit operator bool() const { return m_pInvoke != nullptr; }
+
+       private:
+        void (*m_pInvoke)(const void*) = nullptr;
+        const void* m_pCallable = nullptr;
+
+        friend class FrameGraph;
+    };
+
+    struct Attachment {
+        FrameGraphResource resource = INVALID_FRAME_GRAPH_RESOURCE;
+        LoadOp load = LoadOp::LOAD;
+        int mipLevel = 0;
+        int layer = 0;  // cube face
+    };
+
+    struct Barrier {
+        FrameGraphResource resource;
+        ResourceUsage before;
+        ResourceUsage after;
+    };
+
+    struct Resource {
+        explicit Resource(LinearArena& arena)
+            : writers(arena), readers(arena) {}
+
+        const char* name = "";
+        FrameGraphTextureDesc desc;
+        bool imported = false;
+        uint64_t handle = 0;  // backend handle of an imported texture
+        int physical = -1;    // transient textures only
+        ArenaVector<int> writers;
+        ArenaVector<int> readers;
+        int refCount = 0;
+    };
+
+    struct Pass {
+        explicit Pass(LinearArena& arena)
+            : colors(arena), reads(arena), writes(arena), barriers(arena) {}
+
+        const char* name = "";
+        ArenaVector<Attachment> colors;
+        Attachment depth;
+        bool depthReadOnly = false;
+        ArenaVector<FrameGraphResource> reads;
+        ArenaVector<FrameGraphResource> writes;
+        bool sideEffect = false;
+        Execute execute;
+
+        // filled by Compile()
+        int refCount = 0;
+        bool culled = false;
+        ArenaVector<Barrier> barriers;
+    };
+
+    class Builder {
+       public:
+        // a transient texture, it only lives between its first and last use
+        FrameGraphResource Create(const char* name, const FrameGraphTextureDesc& desc);
+        void Read(FrameGraphResource resource);
+        void Write(FrameGraphResource resource);
+        void SetColorTarget(FrameGraphResource resource, LoadOp load = LoadOp::LOAD, int mipLevel = 0, int layer = 0);
+        void SetDepthTarget(FrameGraphResource resource, LoadOp load = LoadOp::LOAD, bool readOnly = false);
+        // never culled
+        void SetSideEffect() { m_pass.sideEffect = true; }
+
+       private:
+        Builder(FrameGraph& graph, Pass& pass, int passIndex)
+            : m_graph(graph), m_pass(pass), m_passIndex(passIndex) {}
+
+        FrameGraph& m_graph;
+        Pass& m_pass;
+        int m_passIndex;
+
+        friend class FrameGraph;
+    };
+
+    // the arena must not be reset while the graph is alive
+    explicit FrameGraph(LinearArena& arena = GetFrameArena());
+
+    FrameGraphResource Import(const char* name, const FrameGraphTextureDesc& desc, uint64_t handle);
+    // setup(Builder&) runs right away, execute() when the backend reaches the pass
+    template <typename Setup, typename Callable>
+    void AddPass(const char* name, Setup&& setup, Callable&& execute) {
+        typedef typename std::decay<Callable>::type Type;
+        static_assert(std::is_trivially_destructible<Type>::value, "FrameGraph: execute callbacks must not own anything");
+        Pass& pass = addPass(name);
+        pass.execute.m_pCallable = new (m_arena.Allocate(sizeof(Type), alignof(Type))) Type(std::forward<Callable>(execute));
+        pass.execute.m_pInvoke = [](const void* pCallable) { (*static_cast<const Type*>(pCallable))(); };
+        Builder builder(*this, pass, static_cast<int>(m_passes.size() - 1));
+        setup(builder);
+    }
+    void Compile();
+
+    const ArenaVector<int>& ExecutionOrder() const { return m_order; }
+    const Pass& GetPass(int index) const { return m_passes[index]; }
+    const Resource& GetResource(FrameGraphResource resource) const { return m_resources[resource]; }
+    // descriptions of the physical textures the transient ones are assigned to
+    const ArenaVector<FrameGraphTextureDesc>& PhysicalTextures() const { return m_physicalTextures; }
+
+    void Dump(ostream& os) const;
+
+   private:
+    Pass& addPass(const char* name);
+    void cullPasses();
+    void sortPasses();
+    void resolveUsage();
+    void assignPhysicalTextures();
+
+   private:
+    LinearArena& m_arena;
+    ArenaVector<Resource> m_resources;
+    ArenaVector<Pass> m_passes;
+    ArenaVector<int> m_order;
+    ArenaVector<FrameGraphTextureDesc> m_physicalTextures;
+};
+
+extern const char* TargetFormatToString(TargetFormat format);
+extern const char* ResourceUsageToString(ResourceUsage usage);
+
+}  // namespace pbr
@@ -0,0 +1,19 @@
+#pragma once
+#include "Camera.h"
+
+namespace pbr {
+
+// Everything a frame is rendered from, produced by the update thread and consumed by the render
+// thread. The model transform and the lights are fixed once the scene is configured.
+struct FrameSnapshot {
+    Camera camera;
+    Extent2i framebufferExtent;
+    int debugView = 0;
+    int lightCount = 0;
+    // bumped whenever the image changes, on-demand rendering draws a version once
+    uint64_t version = 0;
+    // bumped whenever the camera moves, the render thread may skip the snapshot that marked it dirty
+    uint64_t cameraVersion = 0;
+};
+
+}  // namespace pbr
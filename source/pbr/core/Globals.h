@@ -8,5 +8,42 @@ extern std::string g_env_map_path;
 extern std::string g_model_dir;
 extern mat4 g_transform;
 extern int g_debug;
+extern int g_lightCount;
+// mediump shading and packed float IBL textures, see --precision
+extern bool g_reducedPrecision;
+// no window, only the software and Vulkan renderers support it, see --headless
+extern bool g_headless;
+// frames to render before exiting, 0 runs until the window is closed
+extern int g_frameCount;
+// where a headless renderer writes its last frame, empty writes nothing
+extern std::string g_outputPath;
+// the software renderer path traces a reference instead of rasterizing, see --path-trace
+extern bool g_pathTracing;
+// path traced samples per pixel added every frame
+extern int g_samplesPerFrame;
+// the OpenGL renderer lays down depth before shading the model, see --depth-prepass
+extern bool g_depthPrepass;
+// frame time in ms the OpenGL renderer scales its resolution to meet, 0 renders at the window size
+extern float g_frameBudget;
+// lower bound of that scale, see --min-render-scale
+extern float g_minRenderScale;
+// draw only when something changed and sleep in between, see --on-demand
+extern bool g_renderOnDemand;
+// update on the main thread and render on another one, see --render-thread
+extern bool g_renderThread;
+// chrome://tracing file of the jobs that ran, see --job-trace
+extern std::string g_jobTracePath;
+// warn about every frame that allocates from the heap once the renderer warmed up, see --check-allocations
+extern bool g_checkAllocations;
+// bytes of material mips above the always resident tails the OpenGL renderer streams in, 0 is unlimited, see --texture-budget
+extern size_t g_textureBudget;
+// the OpenGL renderer pages the material maps through a fixed size atlas instead of streaming mips, see --virtual-texturing
+extern bool g_virtualTexturing;
+// files under the data directory are read from this archive first, see --archive
+extern std::string g_archivePath;
+// the OpenGL renderer draws only the meshlets of the model in view that face the eye, see --no-meshlet-culling
+extern bool g_meshletCulling;
+// the OpenGL renderer downloads the data directory from this mirror while the first frames are drawn, see --asset-url
+extern std::string g_assetUrl;
 
 }  // namespace pbr
@@ -9,6 +9,12 @@
 #if TARGET_PLATFORM == PLATFORM_MACOS
 #include "metal/MtRenderer.h"
 #endif
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+#include "software/SwRenderer.h"
+#endif
+#ifdef PBR_VULKAN_RENDERER
+#include "vulkan/VkRenderer.h"
+#endif
 
 namespace pbr {
 
@@ -26,6 +32,14 @@ Renderer* Renderer::CreateRenderer(const Window* pWindow) {
 #if TARGET_PLATFORM == PLATFORM_MACOS
         case RenderApi::METAL:
             return new mt::MtRenderer(pWindow);
+#endif
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+        case RenderApi::SOFTWARE:
+            return new sw::SwRenderer(pWindow);
+#endif
+#ifdef PBR_VULKAN_RENDERER
+        case RenderApi::VULKAN:
+            return new vk::VkRenderer(pWindow);
 #endif
         default:
             assert(0);
@@ -14,6 +14,8 @@ class Renderer {
     static constexpr int specularMapMipLevels { 7 };
     static constexpr int specularMapRes { 512 };
     static constexpr int brdfLUTImageRes { 512 };
+    static constexpr int prefilterSampleCount { 1024 };
+    static constexpr float maxReflectionLod { 4.0f };
 
     static Renderer* CreateRenderer(const Window* pWindow);
     virtual void Initialize() = 0;
@@ -21,6 +23,11 @@ class Renderer {
     virtual void PrepareGpuResources() = 0;
     virtual void Render(const Camera& camera) = 0;
     virtual void Resize(const Extent2i& extent) = 0;
+    // a progressive renderer improves a still image over several frames, e.g. path tracing or textures streaming in,
+    // rendering on demand keeps drawing while this returns true
+    virtual bool IsRefining() const { return false; }
+    // --on-demand had nothing to draw, the time until the next frame is idle rather than a frame time
+    virtual void FrameSkipped() {}
     virtual void Finalize() = 0;
     virtual ~Renderer() = default;
 
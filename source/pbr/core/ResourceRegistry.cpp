@@ -0,0 +1,123 @@
+#include "ResourceRegistry.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace pbr {
+
+static const char* formatSize(size_t sizeInByte, char (&buffer)[32]) {
+    if (sizeInByte >= (1u << 20))
+        snprintf(buffer, sizeof(buffer), "%.2f MB", sizeInByte / double(1u << 20));
+    else
+        snprintf(buffer, sizeof(buffer), "%.2f KB", sizeInByte / double(1u << 10));
+    return buffer;
+}
+
+const char* ResourceKindToString(ResourceKind kind) {
+    switch (kind) {
+        case ResourceKind::BUFFER:
+            return "buffer";
+        case ResourceKind::TEXTURE:
+            return "texture";
+        case ResourceKind::RENDERBUFFER:
+            return "renderbuffer";
+    }
+    return "unknown";
+}
+
+const char* ResourceCategoryToString(ResourceCategory category) {
+    static const char* sTable[static_cast<int>(ResourceCategory::COUNT)] = {
+        "geometry", "material", "environment", "lookup table", "render target", "staging"
+    };
+    return sTable[static_cast<int>(category)];
+}
+
+ResourceRegistry& ResourceRegistry::GetSingleton() {
+    static ResourceRegistry registry;
+    return registry;
+}
+
+void ResourceRegistry::Register(uint32_t id, const ResourceInfo& info) {
+    const size_t previousTotal = m_totalSize;
+    ResourceInfo& entry = m_resources[key(info.kind, id)];
+    m_totalSize -= entry.sizeInByte;
+    entry = info;
+    m_totalSize += entry.sizeInByte;
+
+    if (m_budget && previousTotal <= m_budget && m_totalSize > m_budget) {
+        char total[32], budget[32];
+        cout << "[Warning] GPU memory budget exceeded by " << ResourceKindToString(info.kind) << " \"" << info.name
+             << "\", " << formatSize(m_totalSize, total) << " of " << formatSize(m_budget, budget) << endl;
+    }
+}
+
+void ResourceRegistry::Unregister(ResourceKind kind, uint32_t id) {
+    auto it = m_resources.find(key(kind, id));
+    if (it == m_resources.end())
+        return;
+    m_totalSize -= it->second.sizeInByte;
+    m_resources.erase(it);
+}
+
+void ResourceRegistry::SetBudget(size_t sizeInByte) {
+    m_budget = sizeInByte;
+}
+
+size_t ResourceRegistry::CategorySize(ResourceCategory category) const {
+    size_t size = 0;
+    for (const auto& it : m_resources)
+        if (it.second.category == category)
+            size += it.second.sizeInByte;
+    return size;
+}
+
+void ResourceRegistry::Report(ostream& os) const {
+    char size[32];
+    os << "************* GPU Memory *************\n";
+    for (int i = 0; i < static_cast<int>(ResourceCategory::COUNT); ++i) {
+        const ResourceCategory category = static_cast<ResourceCategory>(i);
+        vector<const ResourceInfo*> resources;
+        for (const auto& it : m_resources)
+            if (it.second.category == category)
+                resources.push_back(&it.second);
+        if (resources.empty())
+            continue;
+
+        std::sort(resources.begin(), resources.end(), [](const ResourceInfo* a, const ResourceInfo* b) {
+            return a->sizeInByte > b->sizeInByte;
+        });
+        os << std::left << std::setw(16) << ResourceCategoryToString(category) << formatSize(CategorySize(category), size) << "\n";
+        for (const ResourceInfo* info : resources) {
+            os << "    " << std::left << std::setw(28) << info->name << std::setw(14) << ResourceKindToString(info->kind)
+               << std::setw(20) << info->format;
+            if (info->kind == ResourceKind::BUFFER)
+                os << std::setw(22) << "";
+            else
+                os << std::setw(22) << (std::to_string(info->width) + "x" + std::to_string(info->height) + "x" + std::to_string(info->layers) + ", " + std::to_string(info->mipLevels) + " mips");
+            os << formatSize(info->sizeInByte, size) << "\n";
+        }
+    }
+    os << std::left << std::setw(16) << "total" << formatSize(m_totalSize, size);
+    if (m_budget) {
+        char budget[32];
+        os << " of " << formatSize(m_budget, budget) << " budget";
+    }
+    os << std::right << endl;
+}
+
+size_t ResourceRegistry::CheckLeaks(ostream& os) const {
+    for (const auto& it : m_resources) {
+        const ResourceInfo& info = it.second;
+        os << "[Warning] " << ResourceKindToString(info.kind) << " \"" << info.name << "\" ("
+           << ResourceCategoryToString(info.category) << ") was not released" << endl;
+    }
+    return m_resources.size();
+}
+
+size_t ResourceRegistry::TextureSize(int width, int height, int layers, int mipLevels, size_t bytesPerTexel) {
+    size_t size = 0;
+    for (int mip = 0; mip < mipLevels; ++mip)
+        size += static_cast<size_t>(std::max(width >> mip, 1)) * static_cast<size_t>(std::max(height >> mip, 1));
+    return size * layers * bytesPerTexel;
+}
+
+}  // namespace pbr
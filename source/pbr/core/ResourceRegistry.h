@@ -0,0 +1,81 @@
+#pragma once
+#include <map>
+#include "base/Allocator.h"
+#include "base/Prerequisites.h"
+
+namespace pbr {
+
+enum class ResourceKind {
+    BUFFER,
+    TEXTURE,
+    RENDERBUFFER,
+};
+
+// subsystem that owns a resource, the report is grouped by it
+enum class ResourceCategory {
+    GEOMETRY,
+    MATERIAL,
+    ENVIRONMENT,
+    LOOKUP_TABLE,
+    RENDER_TARGET,
+    STAGING,  // upload memory
+    COUNT,
+};
+
+struct ResourceInfo {
+    ResourceKind kind;
+    ResourceCategory category;
+    string name;
+    string format;
+    int width = 0;
+    int height = 0;
+    int layers = 1;  // 6 for cube maps
+    int mipLevels = 1;
+    size_t sizeInByte = 0;
+};
+
+// Bookkeeping of the GPU memory a renderer allocates. Backends register every buffer, texture and
+// renderbuffer they create and unregister it when it is deleted, sizes are estimates from format
+// and dimensions, the driver may pad or compress.
+class ResourceRegistry {
+   public:
+    static ResourceRegistry& GetSingleton();
+
+    // registering an existing id replaces the entry, e.g. when a renderbuffer is reallocated
+    void Register(uint32_t id, const ResourceInfo& info);
+    void Unregister(ResourceKind kind, uint32_t id);
+
+    // warn whenever the total crosses the budget, 0 disables the check
+    void SetBudget(size_t sizeInByte);
+    size_t TotalSize() const { return m_totalSize; }
+    size_t CategorySize(ResourceCategory category) const;
+
+    void Report(ostream& os) const;
+    // lists the resources still registered, returns their number
+    size_t CheckLeaks(ostream& os) const;
+    const AllocatorStats& RecordStats() const { return m_recordPool.Stats(); }
+
+    // bytes of a texture with a full or partial mip chain
+    static size_t TextureSize(int width, int height, int layers, int mipLevels, size_t bytesPerTexel);
+
+   private:
+    ResourceRegistry() = default;
+
+    static uint64_t key(ResourceKind kind, uint32_t id) {
+        return (static_cast<uint64_t>(kind) << 32) | id;
+    }
+
+   private:
+    typedef std::pair<const uint64_t, ResourceInfo> Record;
+
+    // map nodes are all the same size, targets recreated on a resize reuse the freed ones
+    PoolAllocator m_recordPool { "resource records" };
+    std::map<uint64_t, ResourceInfo, std::less<uint64_t>, PoolStlAllocator<Record>> m_resources { m_recordPool };
+    size_t m_totalSize = 0;
+    size_t m_budget = 0;
+};
+
+extern const char* ResourceKindToString(ResourceKind kind);
+extern const char* ResourceCategoryToString(ResourceCategory category);
+
+}  // namespace pbr
@@ -1,6 +1,6 @@
 #include "Window.h"
 #include <GLFW/glfw3.h>
-#include "Application.h"
+#include "Globals.h"
 #include "base/Error.h"
 
 namespace pbr {
@@ -10,6 +10,14 @@ void Window::Initialize(const WindowCreateInfo& info) {
 
     m_renderApi = info.renderApi;
 
+    // render into memory only, there is no display to ask for a size
+    if (g_headless) {
+        if (info.extent.width <= 0 || info.extent.height <= 0)
+            THROW_EXCEPTION("headless rendering needs a frame size, see --size");
+        m_windowExtent = m_framebufferExtent = m_latestFramebufferExtent = info.extent;
+        return;
+    }
+
     glfwSetErrorCallback([](int error, const char* desc) {
         THROW_EXCEPTION(desc);
     });
@@ -32,10 +40,14 @@ void Window::Initialize(const WindowCreateInfo& info) {
         Extent2i extent { w, h };
         reinterpret_cast<pbr::Window*>(glfwGetWindowUserPointer(pWindow))->SetWindowExtent({ w, h });
     });
+    // the renderer is resized when the next frame is drawn, see Application::renderFrame
     glfwSetFramebufferSizeCallback(m_pWindow, [](GLFWwindow* pWindow, int w, int h) {
-        Extent2i extent { w, h };
-        reinterpret_cast<pbr::Window*>(glfwGetWindowUserPointer(pWindow))->SetFrameBufferExtent({ w, h });
-        Application::GetSingleton().GetRenderer()->Resize(extent);
+        pbr::Window* window = reinterpret_cast<pbr::Window*>(glfwGetWindowUserPointer(pWindow));
+        window->m_latestFramebufferExtent = Extent2i(w, h);
+        window->m_damaged = true;
+    });
+    glfwSetWindowRefreshCallback(m_pWindow, [](GLFWwindow* pWindow) {
+        reinterpret_cast<pbr::Window*>(glfwGetWindowUserPointer(pWindow))->m_damaged = true;
     });
 
     glfwSetMouseButtonCallback(m_pWindow, Window::mouseButtonCallback);
@@ -43,11 +55,13 @@ void Window::Initialize(const WindowCreateInfo& info) {
     glfwSetCursorPosCallback(m_pWindow, Window::mouseCursorCallback);
     glfwSetKeyCallback(m_pWindow, Window::keyCallback);
 
-    if (m_renderApi == RenderApi::OPENGL)
+    // the software renderer presents its framebuffer through OpenGL
+    if (m_renderApi == RenderApi::OPENGL || m_renderApi == RenderApi::SOFTWARE)
         glfwMakeContextCurrent(m_pWindow);
 
     glfwGetWindowSize(m_pWindow, &m_windowExtent.width, &m_windowExtent.height);
     glfwGetFramebufferSize(m_pWindow, &m_framebufferExtent.width, &m_framebufferExtent.height);
+    m_latestFramebufferExtent = m_framebufferExtent;
 
     // set cursor position
     double x, y;
@@ -56,30 +70,52 @@ void Window::Initialize(const WindowCreateInfo& info) {
 }
 
 void Window::Finalize() {
+    if (m_pWindow == nullptr)
+        return;
     glfwDestroyWindow(m_pWindow);
     glfwTerminate();
 }
 
 bool Window::ShouldClose() const {
-    return glfwWindowShouldClose(m_pWindow);
+    return m_pWindow && glfwWindowShouldClose(m_pWindow);
 }
 
 void Window::PollEvents() const {
-    glfwPollEvents();
+    if (m_pWindow)
+        glfwPollEvents();
+}
+
+void Window::WaitEvents(double timeout) const {
+    // the browser dispatches events between animation frames, the main loop can't block
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    if (m_pWindow)
+        glfwWaitEventsTimeout(timeout);
+#endif
+}
+
+void Window::MakeContextCurrent(bool current) const {
+    if (m_pWindow && (m_renderApi == RenderApi::OPENGL || m_renderApi == RenderApi::SOFTWARE))
+        glfwMakeContextCurrent(current ? m_pWindow : nullptr);
+}
+
+void Window::WakeUp() const {
+    if (m_pWindow)
+        glfwPostEmptyEvent();
 }
 
 void Window::PostUpdate() {
     m_scroll = 0;
+    m_damaged = false;
     m_lastFrameCursorPos = m_thisFrameCursorPos;
 }
 
 void Window::SwapBuffers() const {
-    if (m_renderApi == RenderApi::OPENGL)
+    if (m_pWindow && (m_renderApi == RenderApi::OPENGL || m_renderApi == RenderApi::SOFTWARE))
         glfwSwapBuffers(m_pWindow);
 }
 
 float Window::GetAspectRatio() const {
-    return static_cast<float>(m_framebufferExtent.width) / static_cast<float>(m_framebufferExtent.height);
+    return static_cast<float>(m_latestFramebufferExtent.width) / static_cast<float>(m_latestFramebufferExtent.height);
 }
 
 void Window::setWindowSizeFromCreateInfo(const WindowCreateInfo& info) {
@@ -101,10 +137,18 @@ void Window::setWindowHintFromCreateInfo(const WindowCreateInfo& info) {
 
     switch (info.renderApi) {
         case RenderApi::OPENGL:
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+        case RenderApi::SOFTWARE:
+#endif
             glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, PBR_GL_VERSION_MAJOR);
             glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, PBR_GL_VERSION_MINOR);
 #if PBR_GL_VERSION >= 430 && defined(PBR_DEBUG)
             glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+            // the OpenGL renderer leaves gamma to the backbuffer when it is sRGB capable
+            if (info.renderApi == RenderApi::OPENGL)
+                glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 #endif
             break;
 #if TARGET_PLATFORM == PLATFORM_WINDOWS
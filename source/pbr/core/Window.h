@@ -21,13 +21,22 @@ class Window {
     void Finalize();
     bool ShouldClose() const;
     void PollEvents() const;
+    // blocks until an event arrives or timeout seconds passed
+    void WaitEvents(double timeout) const;
     void PostUpdate();
     void SwapBuffers() const;
+    // the OpenGL context of the window moves to the calling thread, or is released by it
+    void MakeContextCurrent(bool current) const;
+    // makes a WaitEvents on the main thread return, safe to call from any thread
+    void WakeUp() const;
     float GetAspectRatio() const;
     inline RenderApi GetRenderApi() const { return m_renderApi; }
     inline GLFWwindow* GetInternalWindow() const { return m_pWindow; }
     inline const Extent2i& GetWindowExtent() const { return m_windowExtent; }
+    // the extent the renderer draws at, it follows the window when a frame applies a resize
     inline const Extent2i& GetFrameBufferExtent() const { return m_framebufferExtent; }
+    // the extent the window has now, only for the thread that handles the events
+    inline const Extent2i& GetLatestFrameBufferExtent() const { return m_latestFramebufferExtent; }
     inline void SetWindowExtent(const Extent2i& extent) { m_windowExtent = extent; }
     inline void SetFrameBufferExtent(const Extent2i& extent) { m_framebufferExtent = extent; }
     inline int IsButtonDown(GLFW_BUTTON button) const { return m_buttons[button]; }
@@ -35,6 +44,8 @@ class Window {
     inline const vec2& GetLastFrameCursorPos() const { return m_lastFrameCursorPos; }
     inline const vec2& GetThisFrameCursorPos() const { return m_thisFrameCursorPos; }
     inline double GetScroll() const { return m_scroll; }
+    // the window was resized or its contents were lost since the last PostUpdate
+    inline bool IsDamaged() const { return m_damaged; }
 
    private:
     void setWindowSizeFromCreateInfo(const WindowCreateInfo& info);
@@ -51,9 +62,11 @@ class Window {
     string m_windowTitle;
     Extent2i m_windowExtent = { 0, 0 };
     Extent2i m_framebufferExtent = { 0, 0 };
+    Extent2i m_latestFramebufferExtent = { 0, 0 };
     array<int, 3> m_buttons = { 0, 0, 0 };
     array<int, KEY_COUNT> m_keys;
     double m_scroll = 0;
+    bool m_damaged = false;
     vec2 m_lastFrameCursorPos;
     vec2 m_thisFrameCursorPos;
 };
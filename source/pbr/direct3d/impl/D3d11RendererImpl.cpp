@@ -3,6 +3,7 @@
 #include <iostream>
 #include "D3dDebug.h"
 #include "Utility.h"
+#include "base/Half.h"
 #include "core/Camera.h"
 #include "core/Globals.h"
 #include "core/Renderer.h"
@@ -218,23 +219,18 @@ void D3d11RendererImpl::PrepareGpuResources() {
     // load hdr texture
     auto envImage = utility::ReadHDRImage(g_env_map_path);
     createTexture2D(m_hdrSrv, envImage, DXGI_FORMAT_R32G32B32_FLOAT);
-    free(envImage.buffer.pData);
     // load brdf texture
     auto brdfImage = utility::ReadBrdfLUT(BRDF_LUT, Renderer::brdfLUTImageRes);
-    createTexture2D(m_brdfLUTSrv, brdfImage, DXGI_FORMAT_R32G32_FLOAT);
-    free(brdfImage.buffer.pData);
+    createTexture2D(m_brdfLUTSrv, brdfImage, DXGI_FORMAT_R16G16_FLOAT);
     // load albedo
     auto albedoMetallicImage = utility::ReadPng(g_model_dir + "AlbedoMetallic.png");
     createTexture2D(m_albedoMetallic, albedoMetallicImage, DXGI_FORMAT_R8G8B8A8_UNORM);
-    free(albedoMetallicImage.buffer.pData);
     // normal roughness
     auto normalRoughnessImage = utility::ReadPng(g_model_dir + "NormalRoughness.png");
     createTexture2D(m_normalRoughness, normalRoughnessImage, DXGI_FORMAT_R8G8B8A8_UNORM);
-    free(normalRoughnessImage.buffer.pData);
     // emissive ao
     auto emissiveAOImage = utility::ReadPng(g_model_dir + "EmissiveAO.png");
     createTexture2D(m_emissiveAO, emissiveAOImage, DXGI_FORMAT_R8G8B8A8_UNORM);
-    free(emissiveAOImage.buffer.pData);
 
     // constant buffer
     m_perFrameBuffer.Create(m_device);
@@ -689,6 +685,8 @@ void D3d11RendererImpl::createTexture2D(ComPtr<ID3D11ShaderResourceView>& srv, c
     textureData.SysMemPitch = image.width * image.component;
     if (image.dataType == DataType::FLOAT_32T)
         textureData.SysMemPitch *= sizeof(float);
+    else if (image.dataType == DataType::FLOAT_16T)
+        textureData.SysMemPitch *= sizeof(half_t);
     textureData.SysMemSlicePitch = image.height * textureData.SysMemPitch;
 
     ComPtr<ID3D11Texture2D> texture;
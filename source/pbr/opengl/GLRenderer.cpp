@@ -25,6 +25,14 @@ void GLRenderer::Resize(const Extent2i& extent) {
     impl->Resize(extent);
 }
 
+bool GLRenderer::IsRefining() const {
+    return impl->IsRefining();
+}
+
+void GLRenderer::FrameSkipped() {
+    impl->FrameSkipped();
+}
+
 void GLRenderer::Finalize() {
     impl->Finalize();
 }
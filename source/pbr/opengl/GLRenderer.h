@@ -15,6 +15,8 @@ class GLRenderer : public Renderer {
     virtual void PrepareGpuResources() override;
     virtual void Render(const Camera& camera) override;
     virtual void Resize(const Extent2i& extent) override;
+    virtual bool IsRefining() const override;
+    virtual void FrameSkipped() override;
     virtual void Finalize() override;
 
    private:
@@ -0,0 +1,142 @@
+#include "GLFrameGraph.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace gl {
+
+void FrameGraphExecutor::Initialize() {
+    glGenFramebuffers(1, &m_framebuffer);
+}
+
+void FrameGraphExecutor::Execute(const FrameGraph& graph) {
+    m_pGraph = &graph;
+    acquireTargets();
+
+    for (int passIndex : graph.ExecutionOrder()) {
+        const FrameGraph::Pass& pass = graph.GetPass(passIndex);
+        bindTargets(pass);
+        if (pass.execute)
+            pass.execute();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    releaseUnusedTargets();
+    m_pGraph = nullptr;
+}
+
+GLuint FrameGraphExecutor::GetTexture(FrameGraphResource resource) const {
+    const FrameGraph::Resource& info = m_pGraph->GetResource(resource);
+    if (info.imported)
+        return static_cast<GLuint>(info.handle);
+    assert(info.physical >= 0);
+    return m_physicalTextures[info.physical];
+}
+
+void FrameGraphExecutor::Finalize() {
+    for (PooledTarget& target : m_pool)
+        DestroyTexture(target.texture);
+    m_pool.clear();
+    glDeleteFramebuffers(1, &m_framebuffer);
+    m_framebuffer = 0;
+}
+
+void FrameGraphExecutor::acquireTargets() {
+    for (PooledTarget& target : m_pool)
+        target.used = false;
+
+    const ArenaVector<FrameGraphTextureDesc>& descs = m_pGraph->PhysicalTextures();
+    m_physicalTextures.resize(descs.size());
+    for (size_t i = 0; i < descs.size(); ++i) {
+        PooledTarget* pTarget = nullptr;
+        for (PooledTarget& target : m_pool) {
+            if (!target.used && target.desc == descs[i]) {
+                pTarget = &target;
+                break;
+            }
+        }
+        if (!pTarget) {
+            m_pool.emplace_back();
+            pTarget = &m_pool.back();
+            pTarget->desc = descs[i];
+            pTarget->texture = CreateRenderTarget(descs[i], "frame graph target");
+        }
+        pTarget->used = true;
+        m_physicalTextures[i] = pTarget->texture.handle;
+    }
+}
+
+void FrameGraphExecutor::releaseUnusedTargets() {
+    for (auto it = m_pool.begin(); it != m_pool.end();) {
+        if (it->used) {
+            ++it;
+            continue;
+        }
+        DestroyTexture(it->texture);
+        it = m_pool.erase(it);
+    }
+}
+
+void FrameGraphExecutor::attach(GLenum attachment, const FrameGraph::Attachment& target) {
+    if (target.resource == INVALID_FRAME_GRAPH_RESOURCE) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, 0, 0);
+        return;
+    }
+    const bool cubeMap = m_pGraph->GetResource(target.resource).desc.layers == 6;
+    const GLenum textarget = cubeMap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + target.layer : GL_TEXTURE_2D;
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textarget, GetTexture(target.resource), target.mipLevel);
+}
+
+// passes without attachments, e.g. mip generation, keep whatever is bound
+void FrameGraphExecutor::bindTargets(const FrameGraph::Pass& pass) {
+    const FrameGraph::Attachment& first = pass.colors.empty() ? pass.depth : pass.colors.front();
+    if (first.resource == INVALID_FRAME_GRAPH_RESOURCE)
+        return;
+
+    const FrameGraph::Resource& firstResource = m_pGraph->GetResource(first.resource);
+    if (firstResource.imported && firstResource.handle == 0) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+        const int colorCount = static_cast<int>(pass.colors.size());
+        array<GLenum, 4> drawBuffers;
+        assert(colorCount <= static_cast<int>(drawBuffers.size()));
+        for (int i = 0; i < colorCount; ++i) {
+            attach(GL_COLOR_ATTACHMENT0 + i, pass.colors[i]);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        for (int i = colorCount; i < m_attachedColors; ++i)
+            attach(GL_COLOR_ATTACHMENT0 + i, FrameGraph::Attachment());
+        m_attachedColors = colorCount;
+        attach(GL_DEPTH_ATTACHMENT, pass.depth);
+
+        // a depth only pass
+        if (colorCount == 0) {
+            drawBuffers[0] = GL_NONE;
+            glDrawBuffers(1, drawBuffers.data());
+        } else {
+            glDrawBuffers(colorCount, drawBuffers.data());
+        }
+#ifdef PBR_DEBUG
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            THROW_EXCEPTION("[frame graph] framebuffer of pass " + string(pass.name) + " is incomplete");
+#endif
+    }
+
+    const int width = std::max(firstResource.desc.width >> first.mipLevel, 1);
+    const int height = std::max(firstResource.desc.height >> first.mipLevel, 1);
+    glViewport(0, 0, width, height);
+
+    // glClear covers every color target, a pass clears all of them or none
+    GLbitfield clearMask = 0;
+    for (const FrameGraph::Attachment& color : pass.colors)
+        clearMask |= color.load == LoadOp::CLEAR ? GL_COLOR_BUFFER_BIT : 0;
+    if (pass.depth.resource != INVALID_FRAME_GRAPH_RESOURCE && pass.depth.load == LoadOp::CLEAR)
+        clearMask |= GL_DEPTH_BUFFER_BIT;
+    glDepthMask(GL_TRUE);
+    if (clearMask)
+        glClear(clearMask);
+    glDepthMask(pass.depthReadOnly ? GL_FALSE : GL_TRUE);
+}
+
+}  // namespace gl
+}  // namespace pbr
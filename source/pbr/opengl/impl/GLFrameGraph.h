@@ -0,0 +1,42 @@
+#pragma once
+#include "GLHelpers.h"
+#include "GLPrerequisites.h"
+#include "core/FrameGraph.h"
+
+namespace pbr {
+namespace gl {
+
+// Runs a compiled FrameGraph. Attachments are bound to a single framebuffer object before each pass,
+// passes that render into imported texture 0 use the default framebuffer. Physical textures are kept
+// across frames and deleted once a graph no longer asks for them, e.g. after a resize. OpenGL tracks
+// hazards itself, the usage transitions of the graph need no commands here.
+class FrameGraphExecutor {
+   public:
+    void Initialize();
+    void Execute(const FrameGraph& graph);
+    // handle of an imported or transient texture of the graph being executed
+    GLuint GetTexture(FrameGraphResource resource) const;
+    void Finalize();
+
+   private:
+    struct PooledTarget {
+        FrameGraphTextureDesc desc;
+        GLTexture texture;
+        bool used = false;
+    };
+
+    void acquireTargets();
+    void releaseUnusedTargets();
+    void bindTargets(const FrameGraph::Pass& pass);
+    void attach(GLenum attachment, const FrameGraph::Attachment& target);
+
+   private:
+    const FrameGraph* m_pGraph = nullptr;
+    vector<PooledTarget> m_pool;
+    vector<GLuint> m_physicalTextures;
+    GLuint m_framebuffer = 0;
+    int m_attachedColors = 0;
+};
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,120 @@
+#include "GLFramePacer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "GLHelpers.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace gl {
+
+// ns, the wait is retried until the GPU caught up
+static constexpr GLuint64 WAIT_TIMEOUT = 100000000;
+
+void FramePacer::Initialize(size_t regionSize) {
+    // regions are bound with glBindBufferRange, their offsets must be aligned
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_alignment = alignment;
+    m_regionSize = alignUp(regionSize);
+    const size_t size = m_regionSize * FRAMES_IN_FLIGHT;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+#if PBR_GL_VERSION >= 440
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+    m_pMapped = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+    if (!m_pMapped)
+        THROW_EXCEPTION("[frame pacer] failed to map the per frame buffer");
+#else
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+#endif
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    ResourceInfo info;
+    info.kind = ResourceKind::BUFFER;
+    info.category = ResourceCategory::STAGING;
+    info.name = "per frame constants";
+    info.format = "uniform";
+    info.sizeInByte = size;
+    ResourceRegistry::GetSingleton().Register(m_buffer, info);
+}
+
+void FramePacer::BeginFrame() {
+    m_offset = 0;
+    m_lastWait = 0.0f;
+    GLsync& fence = m_fences[m_frame];
+    if (!fence)
+        return;
+
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    // WebGL can't block on a fence, the browser orders glBufferSubData after the draws that read the region
+    glDeleteSync(fence);
+    fence = nullptr;
+#else
+    const auto start = std::chrono::steady_clock::now();
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        ++m_stalledFrames;
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence, 0, WAIT_TIMEOUT);
+        m_lastWait = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (status == GL_WAIT_FAILED)
+        THROW_EXCEPTION("[frame pacer] waiting for a frame fence failed");
+    glDeleteSync(fence);
+    fence = nullptr;
+    m_totalWait += m_lastWait;
+    m_maxWait = std::max(m_maxWait, m_lastWait);
+#endif
+}
+
+size_t FramePacer::Write(const void* pData, size_t size) {
+    if (m_offset + size > m_regionSize)
+        THROW_EXCEPTION("[frame pacer] the per frame region is full");
+    const size_t offset = m_frame * m_regionSize + m_offset;
+    if (m_pMapped) {
+        memcpy(m_pMapped + offset, pData, size);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, pData);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    // the next write starts at a bindable offset
+    m_offset += alignUp(size);
+    return offset;
+}
+
+void FramePacer::EndFrame() {
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frame = (m_frame + 1) % FRAMES_IN_FLIGHT;
+    ++m_frameCount;
+}
+
+void FramePacer::Report(ostream& os) const {
+    if (m_frameCount == 0)
+        return;
+    os << "[Log] frame pacing: the CPU waited " << m_totalWait << " ms on the GPU over " << m_frameCount << " frames, "
+       << m_stalledFrames << " frames waited, the longest " << m_maxWait << " ms" << endl;
+}
+
+void FramePacer::Finalize() {
+    for (GLsync& fence : m_fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (m_buffer) {
+#if PBR_GL_VERSION >= 440
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+#endif
+        DestroyBuffer(m_buffer);
+    }
+    m_pMapped = nullptr;
+}
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,49 @@
+#pragma once
+#include "GLPrerequisites.h"
+#include "base/Prerequisites.h"
+
+namespace pbr {
+namespace gl {
+
+// Lets the CPU run at most FRAMES_IN_FLIGHT frames ahead of the GPU. Every frame owns a region of one
+// uniform buffer for its dynamic data, BeginFrame() waits on the fence of the frame that used the region
+// last, so writing it never makes the driver stall or rename the buffer. The time spent waiting is what
+// the CPU lost to the GPU. The region is mapped persistently where the context has buffer storage,
+// elsewhere it is written with glBufferSubData.
+class FramePacer {
+   public:
+    static constexpr int FRAMES_IN_FLIGHT = 3;
+
+    void Initialize(size_t regionSize);
+    void BeginFrame();
+    // copies the data into the region of the current frame, returns its offset in Buffer()
+    size_t Write(const void* pData, size_t size);
+    void EndFrame();
+    GLuint Buffer() const { return m_buffer; }
+
+    // of the last frame, in milliseconds
+    float LastWait() const { return m_lastWait; }
+    void Report(ostream& os) const;
+    void Finalize();
+
+   private:
+    size_t alignUp(size_t size) const { return (size + m_alignment - 1) / m_alignment * m_alignment; }
+
+   private:
+    GLuint m_buffer = 0;
+    uint8_t* m_pMapped = nullptr;  // null without persistent mapping
+    size_t m_alignment = 256;  // of uniform buffer offsets
+    size_t m_regionSize = 0;
+    size_t m_offset = 0;  // in the current region
+    int m_frame = 0;      // region of the current frame
+    array<GLsync, FRAMES_IN_FLIGHT> m_fences = {};
+
+    float m_lastWait = 0.0f;
+    double m_totalWait = 0.0;
+    float m_maxWait = 0.0f;
+    int m_frameCount = 0;
+    int m_stalledFrames = 0;
+};
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,62 @@
+#include "GLGpuTimer.h"
+
+namespace pbr {
+namespace gl {
+
+void GpuTimer::Initialize() {
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    glGenQueries(QUERY_COUNT, m_queries.data());
+    m_supported = true;
+#endif
+}
+
+void GpuTimer::Begin() {
+    m_timing = m_supported && m_pendingCount < QUERY_COUNT;
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    if (m_timing)
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+#endif
+}
+
+void GpuTimer::End() {
+    if (!m_timing)
+        return;
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    glEndQuery(GL_TIME_ELAPSED);
+#endif
+    m_next = (m_next + 1) % QUERY_COUNT;
+    ++m_pendingCount;
+    m_timing = false;
+}
+
+bool GpuTimer::Poll(float& milliseconds) {
+    if (m_pendingCount == 0)
+        return false;
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    const GLuint query = m_queries[(m_next - m_pendingCount + QUERY_COUNT) % QUERY_COUNT];
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    milliseconds = static_cast<float>(nanoseconds * 1e-6);
+    --m_pendingCount;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void GpuTimer::Finalize() {
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    if (m_supported)
+        glDeleteQueries(QUERY_COUNT, m_queries.data());
+#endif
+    m_queries = {};
+    m_pendingCount = 0;
+    m_supported = false;
+}
+
+}  // namespace gl
+}  // namespace pbr
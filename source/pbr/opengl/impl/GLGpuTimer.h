@@ -0,0 +1,32 @@
+#pragma once
+#include "GLPrerequisites.h"
+#include "base/Prerequisites.h"
+
+namespace pbr {
+namespace gl {
+
+// GPU time of whole frames from GL_TIME_ELAPSED queries. A result is read once the driver has it,
+// a few frames later, so the CPU never waits for the GPU. OpenGL ES has no timer queries.
+class GpuTimer {
+   public:
+    static constexpr int QUERY_COUNT = 4;
+
+    void Initialize();
+    bool IsSupported() const { return m_supported; }
+    // frames started while every query is still in flight are not timed
+    void Begin();
+    void End();
+    // the oldest finished frame, false when none has finished since the last call
+    bool Poll(float& milliseconds);
+    void Finalize();
+
+   private:
+    array<GLuint, QUERY_COUNT> m_queries = {};
+    int m_next = 0;
+    int m_pendingCount = 0;
+    bool m_timing = false;
+    bool m_supported = false;
+};
+
+}  // namespace gl
+}  // namespace pbr
@@ -5,26 +5,109 @@
 namespace pbr {
 namespace gl {
 
-GLTexture CreateTexture(const Image& image, GLenum internalFormat) {
-    GLenum imageFormat;
+// three channel formats are padded to four by most drivers
+static void describeFormat(GLenum internalFormat, const char*& name, size_t& bytesPerTexel) {
+    switch (internalFormat) {
+        case GL_RGBA:
+        case GL_RGBA8:
+            name = "RGBA8";
+            bytesPerTexel = 4;
+            break;
+        case GL_RGB:
+        case GL_RGB8:
+            name = "RGB8";
+            bytesPerTexel = 4;
+            break;
+        case GL_RG16F:
+            name = "RG16F";
+            bytesPerTexel = 4;
+            break;
+        case GL_RGB16F:
+            name = "RGB16F";
+            bytesPerTexel = 8;
+            break;
+        case GL_RGBA16F:
+            name = "RGBA16F";
+            bytesPerTexel = 8;
+            break;
+        case GL_R11F_G11F_B10F:
+            name = "R11F_G11F_B10F";
+            bytesPerTexel = 4;
+            break;
+        case GL_RGB9_E5:
+            name = "RGB9_E5";
+            bytesPerTexel = 4;
+            break;
+        case GL_RGB32F:
+            name = "RGB32F";
+            bytesPerTexel = 16;
+            break;
+        case GL_RGBA32F:
+            name = "RGBA32F";
+            bytesPerTexel = 16;
+            break;
+        case GL_DEPTH_COMPONENT24:
+            name = "DEPTH24";
+            bytesPerTexel = 4;
+            break;
+        default:
+            name = "unknown";
+            bytesPerTexel = 4;
+            break;
+    }
+}
+
+static int fullMipChain(int width, int height) {
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+void RegisterTexture(const GLTexture& texture, GLenum internalFormat, ResourceCategory category, const char* name,
+                     int width, int height, int layers, int mipLevels) {
+    size_t bytesPerTexel;
+    ResourceInfo info;
+    const char* format;
+    describeFormat(internalFormat, format, bytesPerTexel);
+    info.kind = ResourceKind::TEXTURE;
+    info.category = category;
+    info.name = name;
+    info.format = format;
+    info.width = width;
+    info.height = height;
+    info.layers = layers;
+    info.mipLevels = mipLevels;
+    info.sizeInByte = ResourceRegistry::TextureSize(width, height, layers, mipLevels, bytesPerTexel);
+    ResourceRegistry::GetSingleton().Register(texture.handle, info);
+}
+
+void GetTransferFormat(const Image& image, GLenum& format, GLenum& dataType) {
+    if (image.dataType == DataType::RGB9E5) {
+        format = GL_RGB;
+        dataType = GL_UNSIGNED_INT_5_9_9_9_REV;
+        return;
+    }
     switch (image.component) {
         case 4:
-            imageFormat = GL_RGBA;
+            format = GL_RGBA;
             break;
         case 3:
-            imageFormat = GL_RGB;
+            format = GL_RGB;
             break;
         case 2:
-            imageFormat = GL_RG;
+            format = GL_RG;
             break;
         case 1:
-            imageFormat = GL_RED;
+            format = GL_RED;
             break;
         default:
             THROW_EXCEPTION("[texture] Unsupported image format, image has component " + std::to_string(image.component));
     }
-    GLenum dataType;
     switch (image.dataType) {
+        case DataType::FLOAT_16T:
+            dataType = GL_HALF_FLOAT;
+            break;
         case DataType::FLOAT_32T:
             dataType = GL_FLOAT;
             break;
@@ -34,20 +117,25 @@ GLTexture CreateTexture(const Image& image, GLenum internalFormat) {
         default:
             THROW_EXCEPTION("[texture] Unsupported image format, image invalid data type");
     }
+}
+
+GLTexture CreateTextureStorage(const Image& image, GLenum internalFormat, ResourceCategory category, const char* name, bool mipmap) {
+    GLenum imageFormat, dataType;
+    GetTransferFormat(image, imageFormat, dataType);
     GLTexture texture;
     texture.type = GL_TEXTURE_2D;
     glGenTextures(1, &texture.handle);
     glBindTexture(texture.type, texture.handle);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, imageFormat, dataType, image.buffer.pData);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, imageFormat, dataType, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    RegisterTexture(texture, internalFormat, category, name, image.width, image.height, 1, mipmap ? fullMipChain(image.width, image.height) : 1);
     return texture;
 }
 
-GLTexture CreateEmptyCubeMap(int size, int mipmap) {
+GLTexture CreateEmptyCubeMap(const char* name, int size, int mipmap, bool reducedPrecision) {
     GLTexture cubeTexture;
     cubeTexture.type = GL_TEXTURE_CUBE_MAP;
     glGenTextures(1, &cubeTexture.handle);
@@ -59,7 +147,13 @@ GLTexture CreateEmptyCubeMap(int size, int mipmap) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
                     mipmap > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 
+    // radiance is never negative, the packed float format is 4 bytes per texel instead of 12 (16 on the web)
+    // and is color renderable on desktop and with EXT_color_buffer_float
     for (int i = 0; i < 6; ++i) {
+        if (reducedPrecision) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R11F_G11F_B10F, size, size, 0, GL_RGB, GL_FLOAT, 0);
+            continue;
+        }
 #if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, 0);
 #else
@@ -70,9 +164,92 @@ GLTexture CreateEmptyCubeMap(int size, int mipmap) {
     if (mipmap)
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    const GLenum fullPrecisionFormat = GL_RGBA32F;
+#else
+    const GLenum fullPrecisionFormat = GL_RGB32F;
+#endif
+    RegisterTexture(cubeTexture, reducedPrecision ? GL_R11F_G11F_B10F : fullPrecisionFormat, ResourceCategory::ENVIRONMENT, name,
+                    size, size, 6, mipmap ? fullMipChain(size, size) : 1);
     return cubeTexture;
 }
 
+GLTexture CreateRenderTarget(const FrameGraphTextureDesc& desc, const char* name) {
+    GLenum internalFormat, format, dataType;
+    switch (desc.format) {
+        case TargetFormat::RGBA8:
+            internalFormat = GL_RGBA8, format = GL_RGBA, dataType = GL_UNSIGNED_BYTE;
+            break;
+        case TargetFormat::RGBA16F:
+            internalFormat = GL_RGBA16F, format = GL_RGBA, dataType = GL_HALF_FLOAT;
+            break;
+        case TargetFormat::RGB32F:
+            internalFormat = GL_RGB32F, format = GL_RGB, dataType = GL_FLOAT;
+            break;
+        case TargetFormat::R11G11B10F:
+            internalFormat = GL_R11F_G11F_B10F, format = GL_RGB, dataType = GL_FLOAT;
+            break;
+        case TargetFormat::DEPTH24:
+            internalFormat = GL_DEPTH_COMPONENT24, format = GL_DEPTH_COMPONENT, dataType = GL_UNSIGNED_INT;
+            break;
+        default:
+            THROW_EXCEPTION("[texture] Unsupported render target format");
+    }
+    if (desc.layers != 1)
+        THROW_EXCEPTION("[texture] render targets are 2D textures");
+
+    GLTexture texture;
+    texture.type = GL_TEXTURE_2D;
+    glGenTextures(1, &texture.handle);
+    glBindTexture(GL_TEXTURE_2D, texture.handle);
+    for (int mipLevel = 0; mipLevel < desc.mipLevels; ++mipLevel) {
+        const int width = std::max(desc.width >> mipLevel, 1);
+        const int height = std::max(desc.height >> mipLevel, 1);
+        glTexImage2D(GL_TEXTURE_2D, mipLevel, internalFormat, width, height, 0, format, dataType, 0);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // depth isn't filterable in OpenGL ES, a linear filter would leave the texture incomplete
+    const GLint filter = desc.format == TargetFormat::DEPTH24 ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.mipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, desc.mipLevels - 1);
+    RegisterTexture(texture, internalFormat, ResourceCategory::RENDER_TARGET, name, desc.width, desc.height, 1, desc.mipLevels);
+    return texture;
+}
+
+void DestroyTexture(GLTexture& texture) {
+    if (texture.handle == 0)
+        return;
+    ResourceRegistry::GetSingleton().Unregister(ResourceKind::TEXTURE, texture.handle);
+    glDeleteTextures(1, &texture.handle);
+    texture.handle = 0;
+}
+
+GLuint CreateBuffer(GLenum target, const void* data, size_t sizeInByte, ResourceCategory category, const char* name) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferData(target, sizeInByte, data, GL_STATIC_DRAW);
+
+    ResourceInfo info;
+    info.kind = ResourceKind::BUFFER;
+    info.category = category;
+    info.name = name;
+    info.format = target == GL_ELEMENT_ARRAY_BUFFER ? "index" : "vertex";
+    info.sizeInByte = sizeInByte;
+    ResourceRegistry::GetSingleton().Register(buffer, info);
+    return buffer;
+}
+
+void DestroyBuffer(GLuint& buffer) {
+    if (buffer == 0)
+        return;
+    ResourceRegistry::GetSingleton().Unregister(ResourceKind::BUFFER, buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
 void GlslProgram::use() const {
     glUseProgram(m_handle);
 }
@@ -82,6 +259,12 @@ void GlslProgram::destroy() {
     m_handle = 0;
 }
 
+void GlslProgram::bindUniformBlock(const char* name, GLuint binding) const {
+    const GLuint index = glGetUniformBlockIndex(m_handle, name);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_handle, index, binding);
+}
+
 GLint GlslProgram::getUniformLocation(const char* name) const {
     GLint location = glGetUniformLocation(m_handle, name);
     // if (location == INVALID_UNIFORM_LOCATION)
@@ -114,42 +297,48 @@ void GlslProgram::setUniform(GLint location, const mat4& val) const {
 }
 
 GLuint GlslProgram::createShaderFromString(const string& source, GLenum type) {
-    const int MAX_LOG_SIZE = 512;
     GLuint handle = glCreateShader(type);
     const char* sources[] = { source.c_str() };
     glShaderSource(handle, 1, sources, NULL);
     glCompileShader(handle);
+    checkCompileStatus(handle);
+    return handle;
+}
+
+void GlslProgram::checkCompileStatus(GLuint shaderHandle) {
+    const int MAX_LOG_SIZE = 512;
     int success;
     char log[MAX_LOG_SIZE];
-    glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shaderHandle, GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(handle, MAX_LOG_SIZE, NULL, log);
+        glGetShaderInfoLog(shaderHandle, MAX_LOG_SIZE, NULL, log);
         log[MAX_LOG_SIZE - 1] = '\0';  // prevent overflow
         string error("glsl: Failed to compile shader\n");
         error.append(log).pop_back();  // remove new line
         THROW_EXCEPTION(error);
     }
-
-    return handle;
 }
 
-GlslProgram GlslProgram::create(GLuint vertHandle, GLuint fragHandle) {
-    GLuint handle = glCreateProgram();
-    glAttachShader(handle, vertHandle);
-    glAttachShader(handle, fragHandle);
-    glLinkProgram(handle);
-
+void GlslProgram::checkLinkStatus(GLuint programHandle) {
     const int MAX_LOG_SIZE = 512;
     int success;
     char log[MAX_LOG_SIZE];
-    glGetProgramiv(handle, GL_LINK_STATUS, &success);
+    glGetProgramiv(programHandle, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(handle, MAX_LOG_SIZE, NULL, log);
+        glGetProgramInfoLog(programHandle, MAX_LOG_SIZE, NULL, log);
         log[MAX_LOG_SIZE - 1] = '\0';  // prevent overflow
         string error("glsl: Failed to link program\n");
         error.append(log).pop_back();  // remove new line
         THROW_EXCEPTION(error);
     }
+}
+
+GlslProgram GlslProgram::create(GLuint vertHandle, GLuint fragHandle) {
+    GLuint handle = glCreateProgram();
+    glAttachShader(handle, vertHandle);
+    glAttachShader(handle, fragHandle);
+    glLinkProgram(handle);
+    checkLinkStatus(handle);
 
     glDeleteShader(vertHandle);
     glDeleteShader(fragHandle);
@@ -2,6 +2,8 @@
 #include "GLPrerequisites.h"
 #include "base/Definitions.h"
 #include "base/Error.h"
+#include "core/FrameGraph.h"
+#include "core/ResourceRegistry.h"
 
 namespace pbr {
 namespace gl {
@@ -14,18 +16,29 @@ struct PerDrawData {
 };
 
 struct GLTexture {
-    GLenum type;
-    GLuint handle;
+    GLenum type = 0;
+    GLuint handle = 0;
 };
 
-struct GLFramebuffer {
-    GLuint fbo = 0;
-    GLuint rbo = 0;
-};
-
-extern GLTexture CreateTexture(const Image& image, GLenum internalFormat);
-
-extern GLTexture CreateEmptyCubeMap(int size, int mipmap = 0);
+// resources created by the helpers below are recorded in the ResourceRegistry,
+// release them with the matching Destroy* function
+// level 0 of a texture the size of the image, the texels are left undefined, see TextureUploader,
+// without mipmap the texture is registered with that level only
+extern GLTexture CreateTextureStorage(const Image& image, GLenum internalFormat, ResourceCategory category, const char* name, bool mipmap = true);
+// format and type of the image's texels for glTex(Sub)Image2D
+extern void GetTransferFormat(const Image& image, GLenum& format, GLenum& dataType);
+
+// reducedPrecision allocates GL_R11F_G11F_B10F instead of 32-bit floats
+extern GLTexture CreateEmptyCubeMap(const char* name, int size, int mipmap = 0, bool reducedPrecision = false);
+// a 2D texture a frame graph renders into, registered as RENDER_TARGET
+extern GLTexture CreateRenderTarget(const FrameGraphTextureDesc& desc, const char* name);
+extern void DestroyTexture(GLTexture& texture);
+// records a texture created elsewhere, registering it again updates the entry, e.g. when levels are streamed
+extern void RegisterTexture(const GLTexture& texture, GLenum internalFormat, ResourceCategory category, const char* name,
+                            int width, int height, int layers, int mipLevels);
+
+extern GLuint CreateBuffer(GLenum target, const void* data, size_t sizeInByte, ResourceCategory category, const char* name);
+extern void DestroyBuffer(GLuint& buffer);
 
 class GlslProgram {
    public:
@@ -34,6 +47,8 @@ class GlslProgram {
    public:
     static GlslProgram create(GLuint vertHandle, GLuint fragHandle);
     static GLuint createShaderFromString(const string& source, GLenum type);
+    static void checkCompileStatus(GLuint shaderHandle);
+    static void checkLinkStatus(GLuint programHandle);
 
     void use() const;
     void setUniform(GLint location, const int& val) const;
@@ -43,6 +58,8 @@ class GlslProgram {
     void setUniform(GLint location, const vec4& val) const;
     void setUniform(GLint location, const mat4& val) const;
     GLint getUniformLocation(const char* name) const;
+    // skipped when the program has no such block
+    void bindUniformBlock(const char* name, GLuint binding) const;
 
     template <typename T>
     void setUniform(const char* name, const T& val) {
@@ -65,6 +82,8 @@ class GlslProgram {
 
    private:
     GLuint m_handle = 0;
+
+    friend class ProgramCache;
 };
 
 #if PBR_GL_VERSION >= 430 && defined(PBR_DEBUG)
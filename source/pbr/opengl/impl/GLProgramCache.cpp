@@ -0,0 +1,197 @@
+#include "GLProgramCache.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include "base/Error.h"
+#include "base/Hash.h"
+using std::ifstream;
+using std::ios;
+using std::ofstream;
+
+namespace pbr {
+namespace gl {
+
+namespace {
+
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+constexpr uint32_t PROGRAM_BINARY_MAGIC = 0x50524250;  // 'PBRP'
+constexpr uint32_t PROGRAM_BINARY_VERSION = 1;
+
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+typedef void(APIENTRY* PFN_MaxShaderCompilerThreads)(GLuint count);
+#endif
+
+}  // namespace
+
+void ProgramCache::Initialize(const string& cacheDir) {
+    m_cacheDir = cacheDir;
+    m_driverString.clear();
+    m_driverString.append(reinterpret_cast<const char*>(glGetString(GL_VENDOR))).push_back('\n');
+    m_driverString.append(reinterpret_cast<const char*>(glGetString(GL_RENDERER))).push_back('\n');
+    m_driverString.append(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    // WebGL exposes no program binaries; on desktop drivers may still report zero formats (e.g. macOS)
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount > 0) {
+        std::error_code error;
+        std::filesystem::create_directories(m_cacheDir, error);
+        m_binaryEnabled = !error;
+    }
+
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        auto maxShaderCompilerThreads = reinterpret_cast<PFN_MaxShaderCompilerThreads>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if (maxShaderCompilerThreads) {
+            // let the driver pick the thread count
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+            m_parallelCompile = true;
+        }
+    }
+#endif
+
+#ifdef PBR_VERBOSE
+    cout << "[Log] program binary cache " << (m_binaryEnabled ? "enabled" : "disabled")
+         << ", parallel shader compile " << (m_parallelCompile ? "enabled" : "disabled") << endl;
+#endif
+}
+
+void ProgramCache::Request(GlslProgram& program, const string& vertSource, const string& fragSource, const char* debugName) {
+    const uint64_t key = computeKey(vertSource, fragSource);
+    if (m_binaryEnabled && loadBinary(program, key, debugName))
+        return;
+
+    SHADER_COMPILING_START_INFO(debugName);
+    PendingProgram pending;
+    pending.pProgram = &program;
+    pending.key = key;
+    pending.debugName = debugName;
+
+    const char* vertSources[] = { vertSource.c_str() };
+    pending.vertHandle = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertHandle, 1, vertSources, NULL);
+    glCompileShader(pending.vertHandle);
+
+    const char* fragSources[] = { fragSource.c_str() };
+    pending.fragHandle = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.fragHandle, 1, fragSources, NULL);
+    glCompileShader(pending.fragHandle);
+
+    // link right away without querying any status, so the driver does not have to block
+    pending.handle = glCreateProgram();
+    glAttachShader(pending.handle, pending.vertHandle);
+    glAttachShader(pending.handle, pending.fragHandle);
+    if (m_binaryEnabled)
+        glProgramParameteri(pending.handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(pending.handle);
+
+    program.m_handle = pending.handle;
+    m_pending.push_back(pending);
+}
+
+void ProgramCache::Finish() {
+    for (const PendingProgram& pending : m_pending) {
+        GLint linked = GL_FALSE;
+        glGetProgramiv(pending.handle, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // report the compile error if there is one, it is more useful than the link log
+            GlslProgram::checkCompileStatus(pending.vertHandle);
+            GlslProgram::checkCompileStatus(pending.fragHandle);
+            GlslProgram::checkLinkStatus(pending.handle);
+        }
+        SHADER_COMPILING_END_INFO(pending.debugName);
+
+        glDetachShader(pending.handle, pending.vertHandle);
+        glDetachShader(pending.handle, pending.fragHandle);
+        glDeleteShader(pending.vertHandle);
+        glDeleteShader(pending.fragHandle);
+
+        if (m_binaryEnabled)
+            storeBinary(pending.handle, pending.key);
+    }
+
+    m_pending.clear();
+}
+
+uint64_t ProgramCache::computeKey(const string& vertSource, const string& fragSource) const {
+    uint64_t key = Fnv1a64(m_driverString);
+    key = Fnv1a64(vertSource, key);
+    key = Fnv1a64(fragSource, key);
+    return key;
+}
+
+string ProgramCache::cachePath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return m_cacheDir + name;
+}
+
+bool ProgramCache::loadBinary(GlslProgram& program, uint64_t key, [[maybe_unused]] const char* debugName) const {
+    ifstream file(cachePath(key), ios::binary | ios::ate);
+    if (!file.is_open())
+        return false;
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    ProgramBinaryHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() || header.magic != PROGRAM_BINARY_MAGIC || header.version != PROGRAM_BINARY_VERSION || header.key != key)
+        return false;
+    // a truncated or corrupt entry is compiled again rather than trusted with the allocation
+    if (header.length == 0 || header.length > fileSize - static_cast<std::streamoff>(sizeof(header)))
+        return false;
+
+    vector<char> binary(header.length);
+    file.read(binary.data(), header.length);
+    if (!file.good())
+        return false;
+
+    GLuint handle = glCreateProgram();
+    glProgramBinary(handle, header.format, binary.data(), static_cast<GLsizei>(header.length));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // driver rejected the binary, fall back to source and overwrite the entry
+        glDeleteProgram(handle);
+        return false;
+    }
+
+#ifdef PBR_VERBOSE
+    cout << "[Log] " << debugName << " loaded from program cache" << endl;
+#endif
+    program.m_handle = handle;
+    return true;
+}
+
+void ProgramCache::storeBinary(GLuint handle, uint64_t key) const {
+    GLint length = 0;
+    glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(handle, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header;
+    header.magic = PROGRAM_BINARY_MAGIC;
+    header.version = PROGRAM_BINARY_VERSION;
+    header.key = key;
+    header.format = format;
+    header.length = static_cast<uint32_t>(length);
+
+    // a failed write only costs a recompile next launch
+    ofstream file(cachePath(key), ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+}
+
+}  // namespace gl
+}  // namespace pbr
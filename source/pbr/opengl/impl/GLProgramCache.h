@@ -0,0 +1,42 @@
+#pragma once
+#include "GLHelpers.h"
+#include "GLPrerequisites.h"
+
+namespace pbr {
+namespace gl {
+
+// Links programs from source or from a binary stored by a previous run.
+// Source compiles are only issued by Request(), their status is not queried until Finish(),
+// so drivers that compile in the background (KHR_parallel_shader_compile) overlap the work
+// with whatever the caller does in between, e.g. loading assets.
+class ProgramCache {
+   public:
+    void Initialize(const string& cacheDir);
+    void Request(GlslProgram& program, const string& vertSource, const string& fragSource, const char* debugName);
+    void Finish();
+
+   private:
+    struct PendingProgram {
+        GlslProgram* pProgram;
+        GLuint handle;
+        GLuint vertHandle;
+        GLuint fragHandle;
+        uint64_t key;
+        const char* debugName;
+    };
+
+    uint64_t computeKey(const string& vertSource, const string& fragSource) const;
+    string cachePath(uint64_t key) const;
+    bool loadBinary(GlslProgram& program, uint64_t key, const char* debugName) const;
+    void storeBinary(GLuint handle, uint64_t key) const;
+
+   private:
+    string m_cacheDir;
+    string m_driverString;
+    bool m_binaryEnabled = false;
+    bool m_parallelCompile = false;
+    vector<PendingProgram> m_pending;
+};
+
+}  // namespace gl
+}  // namespace pbr
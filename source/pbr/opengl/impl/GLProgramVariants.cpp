@@ -0,0 +1,105 @@
+#include "GLProgramVariants.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace gl {
+
+uint64_t PbrModelVariant::Key() const {
+    uint64_t key = 0;
+    key |= static_cast<uint64_t>(debugView & 0xF);
+    key |= static_cast<uint64_t>(lightCount & 0xFF) << 4;
+    key |= static_cast<uint64_t>(iblMode) << 12;
+    key |= static_cast<uint64_t>(albedoMetallicMap) << 16;
+    key |= static_cast<uint64_t>(normalRoughnessMap) << 17;
+    key |= static_cast<uint64_t>(emissiveAOMap) << 18;
+    key |= static_cast<uint64_t>(virtualTexture) << 19;
+    return key;
+}
+
+string PbrModelVariant::Defines() const {
+    string defines;
+    defines.append("#define DEBUG_VIEW ").append(std::to_string(debugView)).push_back('\n');
+    defines.append("#define LIGHT_COUNT ").append(std::to_string(lightCount)).push_back('\n');
+    defines.append("#define IBL_MODE ").append(std::to_string(static_cast<uint32_t>(iblMode))).push_back('\n');
+    defines.append("#define HAS_ALBEDO_METALLIC_MAP ").append(albedoMetallicMap ? "1" : "0").push_back('\n');
+    defines.append("#define HAS_NORMAL_ROUGHNESS_MAP ").append(normalRoughnessMap ? "1" : "0").push_back('\n');
+    defines.append("#define HAS_EMISSIVE_AO_MAP ").append(emissiveAOMap ? "1" : "0").push_back('\n');
+    defines.append("#define VIRTUAL_TEXTURE ").append(virtualTexture ? "1" : "0").push_back('\n');
+    return defines;
+}
+
+void ProgramVariants::Initialize(ProgramCache* pCache, const string& vertSource, const string& fragSource, const string& commonDefines, const char* debugName, SetupFunc setup) {
+    m_pCache = pCache;
+    m_vertSource = vertSource;
+    m_fragSource = fragSource;
+    m_commonDefines = commonDefines;
+    m_debugName = debugName;
+    m_setup = setup;
+}
+
+void ProgramVariants::Prepare(uint64_t key, const string& defines) {
+    request(key, defines);
+}
+
+GlslProgram& ProgramVariants::Get(uint64_t key, const string& defines) {
+    Variant& variant = request(key, defines);
+    if (!variant.ready) {
+        m_pCache->Finish();
+        if (m_setup)
+            m_setup(variant.program);
+        variant.ready = true;
+    }
+    return variant.program;
+}
+
+GlslProgram* ProgramVariants::Find(uint64_t key) {
+    auto it = m_variants.find(key);
+    return it != m_variants.end() && it->second.ready ? &it->second.program : nullptr;
+}
+
+void ProgramVariants::Destroy() {
+    for (auto& it : m_variants)
+        it.second.program.destroy();
+    m_variants.clear();
+}
+
+ProgramVariants::Variant& ProgramVariants::request(uint64_t key, const string& defines) {
+    auto it = m_variants.find(key);
+    if (it != m_variants.end())
+        return it->second;
+
+    // unordered_map nodes do not move, the cache may keep a pointer to the program until Finish()
+    Variant& variant = m_variants[key];
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), " [%llx]", static_cast<unsigned long long>(key));
+    variant.debugName = m_debugName + suffix;
+    const string allDefines = m_commonDefines + defines;
+    m_pCache->Request(variant.program,
+                      InjectDefines(m_vertSource, allDefines),
+                      InjectDefines(m_fragSource, allDefines),
+                      variant.debugName.c_str());
+    return variant;
+}
+
+string ProgramVariants::InjectDefines(const string& source, const string& defines) {
+    if (defines.empty())
+        return source;
+
+    const size_t version = source.find("#version");
+    if (version == string::npos)
+        return defines + source;
+
+    const size_t lineEnd = source.find('\n', version);
+    if (lineEnd == string::npos)
+        THROW_EXCEPTION("glsl: #version directive is not followed by a new line");
+
+    string result;
+    result.reserve(source.size() + defines.size());
+    result.append(source, 0, lineEnd + 1);
+    result.append(defines);
+    result.append(source, lineEnd + 1, string::npos);
+    return result;
+}
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,68 @@
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include "GLHelpers.h"
+#include "GLProgramCache.h"
+
+namespace pbr {
+namespace gl {
+
+// Feature set of pbr_model.frag, every combination is compiled into its own program
+// so the shaded path carries no runtime branches.
+struct PbrModelVariant {
+    enum class IblMode : uint32_t {
+        NONE = 0,
+        SPLIT_SUM = 1,
+    };
+
+    int debugView = 0;  // 0 shaded, 1 - 6 see g_debug
+    int lightCount = 0;
+    IblMode iblMode = IblMode::SPLIT_SUM;
+    bool albedoMetallicMap = true;
+    bool normalRoughnessMap = true;
+    bool emissiveAOMap = true;
+    bool virtualTexture = false;  // the maps are page atlases, see GLVirtualTexture.h
+
+    uint64_t Key() const;
+    string Defines() const;
+};
+
+// Lazily compiled set of programs sharing one vertex/fragment source pair.
+class ProgramVariants {
+   public:
+    typedef std::function<void(GlslProgram&)> SetupFunc;
+
+    // commonDefines are shared by all variants
+    void Initialize(ProgramCache* pCache, const string& vertSource, const string& fragSource, const string& commonDefines, const char* debugName, SetupFunc setup);
+    // issue compilation without waiting for it
+    void Prepare(uint64_t key, const string& defines);
+    // returns a linked program, compiling it on first use
+    GlslProgram& Get(uint64_t key, const string& defines);
+    // a variant that is already linked, null otherwise. Unlike Get() it builds no defines
+    GlslProgram* Find(uint64_t key);
+    void Destroy();
+
+    // insert #define lines after the #version directive
+    static string InjectDefines(const string& source, const string& defines);
+
+   private:
+    struct Variant {
+        GlslProgram program;
+        string debugName;
+        bool ready = false;
+    };
+
+    Variant& request(uint64_t key, const string& defines);
+
+   private:
+    ProgramCache* m_pCache = nullptr;
+    string m_vertSource;
+    string m_fragSource;
+    string m_commonDefines;
+    string m_debugName;
+    SetupFunc m_setup;
+    std::unordered_map<uint64_t, Variant> m_variants;
+};
+
+}  // namespace gl
+}  // namespace pbr
@@ -1,10 +1,14 @@
 #include "GLRendererImpl.h"
+#include "FileSystem.h"
 #include "GLPrerequisites.h"
 #include "Mesh.h"
+#include "MeshCodec.h"
 #include "Paths.h"
 #include "Scene.h"
+#include "ShEnvironment.h"
 #include "Utility.h"
 #include "base/Error.h"
+#include "base/JobSystem.h"
 #include "core/Globals.h"
 #include "core/Renderer.h"
 
@@ -15,6 +19,63 @@
 namespace pbr {
 namespace gl {
 
+// strength of the sharpening after the upscale of a reduced resolution frame
+static constexpr float UPSCALE_SHARPNESS = 0.5f;
+// a 2k RGBA8 material arrives in two frames, the ring keeps four frames of uploads in flight
+static constexpr size_t UPLOAD_RING_SIZE = 32 << 20;
+static constexpr size_t UPLOAD_FRAME_BUDGET = 8 << 20;
+// uniform buffer binding of the PerFrameBuffer block
+static constexpr GLuint PER_FRAME_BINDING = 0;
+// faces of the cube maps lit by the spherical harmonics ambient until the environment arrived
+static constexpr int SH_CUBE_MAP_RES = 16;
+
+// the order streamed assets download in, lower first, the picture of the first frames needs them in this order
+enum FetchPriority {
+    FETCH_PREVIEW,      // the spherical harmonics ambient and the coarse model
+    FETCH_MATERIALS,    // the containers of the maps with their mip tails
+    FETCH_DETAIL,       // the brdf lut and the full model
+    FETCH_ENVIRONMENT,  // the hdr the environment maps are baked from
+};
+
+// std140 layout of PerFrameBuffer in pbr_model.vert
+struct PerFrameConstants {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    int tonemap;
+    float sharpness;
+    float padding[2];
+};
+static_assert(sizeof(PerFrameConstants) == 160, "PerFrameConstants does not match the std140 block");
+
+// only the bake samples the equirectangular map, four cube map faces span its equator, so it needs no
+// more texels across than they have. Half floats or shared exponents with reduced precision, no mips,
+// the bake samples level 0
+static Image readEnvironment() {
+    return utility::ReadHDRImage(g_env_map_path, g_reducedPrecision ? HdrFormat::RGB9E5 : HdrFormat::FLOAT16, 4 * Renderer::cubeMapRes);
+}
+
+static GLTexture createEnvironmentTexture(TextureUploader& uploader, Image&& image) {
+    return uploader.CreateTexture(std::move(image), g_reducedPrecision ? GL_RGB9_E5 : GL_RGB16F, ResourceCategory::ENVIRONMENT, "equirectangular map", false);
+}
+
+// the uniform names are formatted on the stack, no string per light
+static void setLightUniforms(GlslProgram& program) {
+    char name[32];
+    for (size_t i = 0; i < g_lights.size(); ++i) {
+        snprintf(name, sizeof(name), "u_lights[%zu].position", i);
+        program.setUniform(name, g_lights[i].position);
+        snprintf(name, sizeof(name), "u_lights[%zu].color", i);
+        program.setUniform(name, g_lights[i].color);
+    }
+}
+
+// the cache keeps one directory per model
+static string textureCachePath(const char* map, const char* extension) {
+    const string modelDir = g_model_dir.substr(0, g_model_dir.size() - 1);
+    return string(TEXTURE_CACHE_DIR) + modelDir.substr(modelDir.find_last_of('/') + 1) + "/" + map + extension;
+}
+
 GLRendererImpl::GLRendererImpl(const Window* pWindow)
     : m_pWindow(pWindow) {
 }
@@ -41,6 +102,21 @@ void GLRendererImpl::Initialize() {
     glFrontFace(GL_CW);
     glDepthFunc(GL_LEQUAL);
     // glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    GLint encoding = GL_LINEAR;
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    m_srgbFramebuffer = encoding == GL_SRGB;
+#endif
+
+    m_frameGraph.Initialize();
+    m_gpuTimer.Initialize();
+    m_textureUploader.Initialize(UPLOAD_RING_SIZE, UPLOAD_FRAME_BUDGET);
+    if (!g_assetUrl.empty())
+        m_assetFetcher.Initialize(g_assetUrl);
+    m_textureStreamer.Initialize(&m_textureUploader, g_textureBudget, g_assetUrl.empty() ? nullptr : &m_assetFetcher);
+    m_framePacer.Initialize(sizeof(PerFrameConstants));
+    m_dynamicResolution.Configure(g_frameBudget, g_minRenderScale);
 }
 
 void GLRendererImpl::DumpGraphicsCardInfo() {
@@ -51,11 +127,179 @@ void GLRendererImpl::DumpGraphicsCardInfo() {
 }
 
 void GLRendererImpl::Render(const Camera& camera) {
-    // set viewport
+    m_framePacer.BeginFrame();
+    updateRenderScale();
+    m_gpuTimer.Begin();
+
     const Extent2i& extent = m_pWindow->GetFrameBufferExtent();
-    glViewport(0, 0, extent.width, extent.height);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // the scene is rendered at the dynamic resolution, the tonemap pass upscales it to the window
+    const Extent2i renderExtent = m_dynamicResolution.ScaleExtent(extent);
+    const bool upscaled = renderExtent.width != extent.width || renderExtent.height != extent.height;
+    uploadPerFrameConstants(camera, upscaled);
+    // a fetched mesh replaces the model, cull the one that is drawn this frame
+    if (!g_assetUrl.empty())
+        m_assetFetcher.Update();
+    if (g_meshletCulling && m_model.indexCount != 0)
+        m_meshletCuller.Cull(camera.ProjectionMatrixGl() * camera.ViewMatrix(), g_transform, vec3(camera.GetViewPos()), m_visibleRanges);
+    if (g_virtualTexturing) {
+        const mat4 viewProjection = camera.ProjectionMatrixGl() * camera.ViewMatrix();
+        if (viewProjection != m_lastViewProjection) {
+            m_virtualTexture.ViewChanged();
+            m_lastViewProjection = viewProjection;
+        }
+        m_virtualTexture.Update();
+    } else {
+        streamMaterials(camera, renderExtent);
+    }
+    m_textureUploader.Update();
+    // the hdr of a streamed environment arrives over several frames, it is baked once all of it was uploaded
+    if (m_hdrTexture.handle != 0 && !m_environmentBaked && !m_textureUploader.IsPending(m_hdrTexture.handle)) {
+        bakeEnvironmentMaps();
+        bindTextures();
+    }
+    FrameGraph graph;
+    // handle 0 is the default framebuffer
+    const FrameGraphResource backbuffer = graph.Import("backbuffer", { extent.width, extent.height, TargetFormat::RGBA8 }, 0);
+    const FrameGraphTextureDesc depthDesc = { renderExtent.width, renderExtent.height, TargetFormat::DEPTH24 };
+    const FrameGraphTextureDesc hdrDesc = { renderExtent.width, renderExtent.height, g_reducedPrecision ? TargetFormat::R11G11B10F : TargetFormat::RGBA16F };
+    FrameGraphResource sceneDepth = INVALID_FRAME_GRAPH_RESOURCE;
+    FrameGraphResource hdrColor = INVALID_FRAME_GRAPH_RESOURCE;
+
+    // nothing reads the target, the pages it names arrive a few frames later
+    const FrameGraphTextureDesc feedbackDesc = { std::max(1, renderExtent.width / VirtualTexture::FEEDBACK_SCALE),
+                                                 std::max(1, renderExtent.height / VirtualTexture::FEEDBACK_SCALE), TargetFormat::RGBA8 };
+    if (g_virtualTexturing) {
+        graph.AddPass(
+            "vt feedback", [&](FrameGraph::Builder& builder) {
+                builder.SetColorTarget(builder.Create("vt feedback", feedbackDesc), LoadOp::CLEAR);
+                builder.SetDepthTarget(builder.Create("vt feedback depth", { feedbackDesc.width, feedbackDesc.height, TargetFormat::DEPTH24 }), LoadOp::CLEAR);
+                builder.SetSideEffect();
+            },
+            [&]() { drawFeedback(feedbackDesc.width, feedbackDesc.height); });
+    }
+    // the model pass then shades only the fragments that are visible
+    if (g_depthPrepass) {
+        graph.AddPass(
+            "depth prepass", [&](FrameGraph::Builder& builder) {
+                sceneDepth = builder.Create("scene depth", depthDesc);
+                builder.SetDepthTarget(sceneDepth, LoadOp::CLEAR);
+            },
+            [&]() { drawDepth(); });
+    }
+    graph.AddPass(
+        "model", [&](FrameGraph::Builder& builder) {
+            hdrColor = builder.Create("hdr color", hdrDesc);
+            builder.SetColorTarget(hdrColor, LoadOp::CLEAR);
+            if (sceneDepth == INVALID_FRAME_GRAPH_RESOURCE) {
+                sceneDepth = builder.Create("scene depth", depthDesc);
+                builder.SetDepthTarget(sceneDepth, LoadOp::CLEAR);
+            } else {
+                builder.SetDepthTarget(sceneDepth, LoadOp::LOAD, true);
+            }
+        },
+        [&]() {
+            if (g_depthPrepass)
+                glDepthFunc(GL_EQUAL);
+            drawModel();
+            glDepthFunc(GL_LEQUAL);
+        });
+    // drawn last, only where the model left the far plane
+    graph.AddPass(
+        "background", [&](FrameGraph::Builder& builder) {
+            builder.SetColorTarget(hdrColor);
+            builder.SetDepthTarget(sceneDepth, LoadOp::LOAD, true);
+        },
+        [&]() { drawBackground(); });
+    graph.AddPass(
+        "tonemap", [&](FrameGraph::Builder& builder) {
+            builder.Read(hdrColor);
+            builder.Read(sceneDepth);
+            builder.SetColorTarget(backbuffer, LoadOp::DONT_CARE);
+        },
+        [&]() { drawTonemap(hdrColor, sceneDepth); });
+
+    graph.Compile();
+    m_frameGraph.Execute(graph);
+    m_gpuTimer.End();
+    m_framePacer.EndFrame();
+}
+
+// the debug views of the model are copied without tonemapping or gamma, upscaled targets are sharpened
+void GLRendererImpl::uploadPerFrameConstants(const Camera& camera, bool upscaled) {
+    PerFrameConstants constants = {};
+    constants.view = camera.ViewMatrix();
+    constants.projection = camera.ProjectionMatrixGl();
+    constants.viewPos = camera.GetViewPos();
+    constants.tonemap = g_debug == 0 ? 1 : 0;
+    constants.sharpness = upscaled ? UPSCALE_SHARPNESS : 0.0f;
+    const size_t offset = m_framePacer.Write(&constants, sizeof(constants));
+    glBindBufferRange(GL_UNIFORM_BUFFER, PER_FRAME_BINDING, m_framePacer.Buffer(), offset, sizeof(constants));
+}
+
+// the closest point of the model's bounding sphere decides, a pixel there spans the most UV
+void GLRendererImpl::streamMaterials(const Camera& camera, const Extent2i& renderExtent) {
+    const float distance = glm::length(vec3(camera.GetViewPos()) - m_modelFootprint.center) - m_modelFootprint.radius;
+    const float pixelSize = 2.0f * std::max(distance, camera.GetNear()) * std::tan(0.5f * camera.GetFov()) / renderExtent.height;
+    const float uvPerPixel = m_modelFootprint.uvDensity * pixelSize;
+    for (const GLTexture* pTexture : { &m_albedoMetallicTexture, &m_normalRoughnessTexture, &m_emissiveAOTexture })
+        m_textureStreamer.Touch(pTexture->handle, uvPerPixel);
+    m_textureStreamer.Update();
+}
+
+void GLRendererImpl::updateRenderScale() {
+    if (!m_dynamicResolution.IsEnabled())
+        return;
 
+    if (m_gpuTimer.IsSupported()) {
+        float milliseconds;
+        while (m_gpuTimer.Poll(milliseconds))
+            m_dynamicResolution.AddFrameTime(milliseconds);
+        return;
+    }
+
+    // the interval includes waiting for vsync, only frames over the budget are detected.
+    // the application reports idle --on-demand iterations, see FrameSkipped()
+    const double now = glfwGetTime();
+    if (m_lastFrameStart > 0.0)
+        m_dynamicResolution.AddFrameTime(static_cast<float>(1000.0 * (now - m_lastFrameStart)));
+    m_lastFrameStart = now;
+}
+
+void GLRendererImpl::drawDepth() {
+    if (m_model.indexCount == 0)
+        return;
+    m_depthProgram.use();
+    drawModelTriangles();
+}
+
+void GLRendererImpl::drawModelTriangles() {
+    glBindVertexArray(m_model.vao);
+    if (!g_meshletCulling) {
+        glDrawElements(GL_TRIANGLES, m_model.indexCount, GL_UNSIGNED_INT, 0);
+        return;
+    }
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    // WebGL has no multi draw, neighboring meshlets are merged into few ranges
+    for (const TriangleRange& range : m_visibleRanges)
+        glDrawElements(GL_TRIANGLES, 3 * range.count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(sizeof(uvec3) * range.first));
+#else
+    m_drawCounts.clear();
+    m_drawOffsets.clear();
+    for (const TriangleRange& range : m_visibleRanges) {
+        m_drawCounts.push_back(3 * range.count);
+        m_drawOffsets.push_back(reinterpret_cast<const void*>(sizeof(uvec3) * range.first));
+    }
+    glMultiDrawElements(GL_TRIANGLES, m_drawCounts.data(), GL_UNSIGNED_INT, m_drawOffsets.data(), static_cast<GLsizei>(m_drawCounts.size()));
+#endif
+}
+
+void GLRendererImpl::drawFeedback(int width, int height) {
+    m_feedbackProgram.use();
+    drawModelTriangles();
+    m_virtualTexture.ReadFeedback(width, height);
+}
+
+void GLRendererImpl::drawModel() {
     // draw spheres
 #if 0
     m_pbrProgram.use();
@@ -71,86 +315,288 @@ void GLRendererImpl::Render(const Camera& camera) {
     const int size = 5;
     glDrawElementsInstanced(GL_TRIANGLES, m_sphere.indexCount, GL_UNSIGNED_INT, 0, size * size);
 #endif
-    // draw model
-    m_pbrModelProgram.use();
-    m_pbrModelProgram.setUniform("u_debug", g_debug);
-    if (camera.IsDirty()) {
-        m_pbrModelProgram.setUniform("u_per_frame.view", camera.ViewMatrix());
-        m_pbrModelProgram.setUniform("u_per_frame.projection", camera.ProjectionMatrixGl());
-        m_pbrModelProgram.setUniform("u_view_pos", camera.GetViewPos());
-    }
+    // a streamed model that didn't arrive yet
+    if (m_model.indexCount == 0)
+        return;
+    PbrModelVariant variant = m_pbrModelVariant;
+    variant.debugView = g_debug;
+    variant.lightCount = g_lightCount;
+    if (!materialsUploaded())
+        variant.albedoMetallicMap = variant.normalRoughnessMap = variant.emissiveAOMap = false;
+    // the defines are only built for a variant that was never drawn
+    GlslProgram* pModelProgram = m_pbrModelVariants.Find(variant.Key());
+    GlslProgram& modelProgram = pModelProgram ? *pModelProgram : m_pbrModelVariants.Get(variant.Key(), variant.Defines());
+    modelProgram.use();
+    drawModelTriangles();
+}
 
-    glBindVertexArray(m_model.vao);
-    glDrawElements(GL_TRIANGLES, m_model.indexCount, GL_UNSIGNED_INT, 0);
+bool GLRendererImpl::materialsUploaded() const {
+    if (g_virtualTexturing)
+        return m_virtualTexture.IsReady();
+    // a streamed map is opened when its container arrived
+    auto uploaded = [this](bool used, const GLTexture& texture) {
+        return !used || (texture.handle && m_textureStreamer.IsResident(texture.handle));
+    };
+    return uploaded(m_pbrModelVariant.albedoMetallicMap, m_albedoMetallicTexture) &&
+           uploaded(m_pbrModelVariant.normalRoughnessMap, m_normalRoughnessTexture) &&
+           uploaded(m_pbrModelVariant.emissiveAOMap, m_emissiveAOTexture);
+}
 
-    // draw cube map
+void GLRendererImpl::drawBackground() {
     m_backgroundProgram.use();
-    if (camera.IsDirty()) {
-        m_backgroundProgram.setUniform("u_per_frame.view", camera.ViewMatrix());
-        m_backgroundProgram.setUniform("u_per_frame.projection", camera.ProjectionMatrixGl());
-    }
 
     glBindVertexArray(m_cube.vao);
     glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
 }
 
-void GLRendererImpl::Resize(const Extent2i& extent) {
+void GLRendererImpl::drawTonemap(FrameGraphResource hdrColor, FrameGraphResource sceneDepth) {
+    m_tonemapProgram.use();
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, m_frameGraph.GetTexture(hdrColor));
+    // the background is left at the far plane, it is tonemapped under a debug view too
+    glActiveTexture(GL_TEXTURE10);
+    glBindTexture(GL_TEXTURE_2D, m_frameGraph.GetTexture(sceneDepth));
+
+    glDisable(GL_DEPTH_TEST);
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    // a debug view copies the model as it is, tonemap.frag encodes the background then
+    if (m_srgbFramebuffer && g_debug == 0)
+        glEnable(GL_FRAMEBUFFER_SRGB);
+#endif
+    glBindVertexArray(m_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+#if TARGET_PLATFORM != PLATFORM_EMSCRIPTEN
+    glDisable(GL_FRAMEBUFFER_SRGB);
+#endif
+    glEnable(GL_DEPTH_TEST);
+}
+
+// frame times of the old size say nothing about the new one
+void GLRendererImpl::Resize(const Extent2i&) {
+    m_dynamicResolution.Reset();
 }
 
 void GLRendererImpl::Finalize() {
     // delete resources
     m_pbrProgram.destroy();
-    m_pbrModelProgram.destroy();
+    m_pbrModelVariants.Destroy();
     m_backgroundProgram.destroy();
-    glDeleteTextures(1, &m_hdrTexture.handle);
+    m_depthProgram.destroy();
+    m_feedbackProgram.destroy();
+    m_tonemapProgram.destroy();
+    DestroyTexture(m_hdrTexture);
+    DestroyTexture(m_brdfLUTTexture);
+    DestroyTexture(m_cubeMapTexture);
+    DestroyTexture(m_irradianceTexture);
+    DestroyTexture(m_specularTexture);
+    DestroyTexture(m_albedoMetallicTexture);
+    DestroyTexture(m_normalRoughnessTexture);
+    DestroyTexture(m_emissiveAOTexture);
+    m_frameGraph.Finalize();
+    m_gpuTimer.Finalize();
+    // the callbacks of the chunks refer to the streamer
+    m_assetFetcher.Report(cout);
+    m_assetFetcher.Finalize();
+    m_textureStreamer.Report(cout);
+    m_textureStreamer.Finalize();
+    m_virtualTexture.Report(cout);
+    m_virtualTexture.Finalize();
+    m_textureUploader.Finalize();
+    m_framePacer.Report(cout);
+    m_framePacer.Finalize();
+    m_meshletCuller.Report(cout);
     clearGeometries();
 }
 
 void GLRendererImpl::PrepareGpuResources() {
-    // compile shaders
+    // compile shaders, the status is checked after the assets are loaded
+    m_programCache.Initialize(SHADER_CACHE_DIR);
+    if (!g_assetUrl.empty()) {
+        prepareStreamedResources();
+        return;
+    }
+    m_pbrModelVariant.albedoMetallicMap = utility::FileExists(g_model_dir + "AlbedoMetallic.png");
+    m_pbrModelVariant.normalRoughnessMap = utility::FileExists(g_model_dir + "NormalRoughness.png");
+    m_pbrModelVariant.emissiveAOMap = utility::FileExists(g_model_dir + "EmissiveAO.png");
+    m_pbrModelVariant.virtualTexture = g_virtualTexturing;
     compileShaders();
 
+    // decode the environment and build missing mip chains on the workers while the geometry is loaded,
+    // the textures are created on this thread
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+    JobCounter decoded;
+    Image envImage;
+    const string amPath = textureCachePath("AlbedoMetallic", ".mips");
+    const string normalRoughnessPath = textureCachePath("NormalRoughness", ".mips");
+    const string emissiveAOPath = textureCachePath("EmissiveAO", ".mips");
+    // virtual texturing pages the mip chains
+    const array<string, VirtualTexture::LAYER_COUNT> pagePaths = {
+        m_pbrModelVariant.albedoMetallicMap && g_virtualTexturing ? textureCachePath("AlbedoMetallic", ".pages") : string(),
+        m_pbrModelVariant.normalRoughnessMap && g_virtualTexturing ? textureCachePath("NormalRoughness", ".pages") : string(),
+        m_pbrModelVariant.emissiveAOMap && g_virtualTexturing ? textureCachePath("EmissiveAO", ".pages") : string(),
+    };
+    // the shaders decode the emissive color from sRGB, its mips are averaged in linear light
+    auto buildMaps = [](const string& pngPath, const string& mipChainPath, const string& pagePath, uint32_t srgbMask = 0) {
+        MipChainFile::Build(pngPath, mipChainPath, kernels::MipFilter::BOX, srgbMask);
+        if (!pagePath.empty())
+            PageFile::Build(mipChainPath, pagePath);
+    };
+    if (m_pbrModelVariant.albedoMetallicMap)
+        jobSystem.Schedule("build albedo metallic mips", [&] { buildMaps(g_model_dir + "AlbedoMetallic.png", amPath, pagePaths[VirtualTexture::ALBEDO_METALLIC]); }, &decoded);
+    if (m_pbrModelVariant.normalRoughnessMap)
+        jobSystem.Schedule("build normal roughness mips", [&] { buildMaps(g_model_dir + "NormalRoughness.png", normalRoughnessPath, pagePaths[VirtualTexture::NORMAL_ROUGHNESS]); }, &decoded);
+    if (m_pbrModelVariant.emissiveAOMap)
+        jobSystem.Schedule("build emissive ao mips", [&] { buildMaps(g_model_dir + "EmissiveAO.png", emissiveAOPath, pagePaths[VirtualTexture::EMISSIVE_AO], kernels::SRGB_RGB); }, &decoded);
+    jobSystem.Schedule("decode environment", [&] { envImage = readEnvironment(); }, &decoded);
+
     // buffer
     createGeometries();
 
-    // albedo metallic
-    auto amImage = utility::ReadPng(g_model_dir + "AlbedoMetallic.png");
-    m_albedoMetallicTexture = CreateTexture(amImage, GL_RGBA);
-    free(amImage.buffer.pData);
-
-    // normal roughness
-    auto normalRoughnessImage = utility::ReadPng(g_model_dir + "NormalRoughness.png");
-    m_normalRoughnessTexture = CreateTexture(normalRoughnessImage, GL_RGBA);
-    free(normalRoughnessImage.buffer.pData);
-
-    // emissive ao
-    auto emissiveAO = utility::ReadPng(g_model_dir + "EmissiveAO.png");
-    m_emissiveAOTexture = CreateTexture(emissiveAO, GL_RGBA);
-    free(emissiveAO.buffer.pData);
-
-    // load hdr texture
-    auto envImage = utility::ReadHDRImage(g_env_map_path);
-    m_hdrTexture = CreateTexture(envImage, GL_RGB32F);
-    free(envImage.buffer.pData);
-    // load brdf texture
+    jobSystem.Wait(decoded);
+
+    // the bake samples the environment, the materials stream in while the first frames are drawn
     auto brdfImage = utility::ReadBrdfLUT(BRDF_LUT, Renderer::brdfLUTImageRes);
-    m_brdfLUTTexture = CreateTexture(brdfImage, GL_RG16F);
-    free(brdfImage.buffer.pData);
+    m_brdfLUTTexture = m_textureUploader.CreateTexture(std::move(brdfImage), GL_RG16F, ResourceCategory::LOOKUP_TABLE, "brdf lut");
+    m_hdrTexture = createEnvironmentTexture(m_textureUploader, std::move(envImage));
+    m_textureUploader.Finish(m_hdrTexture.handle);
+
+    if (g_virtualTexturing) {
+        m_virtualTexture.Initialize(&m_textureUploader, pagePaths);
+    } else {
+        if (m_pbrModelVariant.albedoMetallicMap)
+            m_albedoMetallicTexture = m_textureStreamer.Open(amPath, GL_RGBA, ResourceCategory::MATERIAL, "albedo metallic");
+        if (m_pbrModelVariant.normalRoughnessMap)
+            m_normalRoughnessTexture = m_textureStreamer.Open(normalRoughnessPath, GL_RGBA, ResourceCategory::MATERIAL, "normal roughness");
+        if (m_pbrModelVariant.emissiveAOMap)
+            m_emissiveAOTexture = m_textureStreamer.Open(emissiveAOPath, GL_RGBA, ResourceCategory::MATERIAL, "emissive ao");
+    }
+
+    // wait for shaders
+    m_programCache.Finish();
 
     // convert HDR equirectuangular environment map to cubemap equivalent
     calculateCubemapMatrices();
-    createFramebuffer();
-    createCubeMap();
-    createIrradianceMap();
-    createPrefilteredMap();
+    // on WebGL the hdr may not fit the ring, Render() bakes it once the rest was uploaded
+    if (!m_textureUploader.IsPending(m_hdrTexture.handle))
+        bakeEnvironmentMaps();
 
     // upload constant buffers
     uploadConstantUniforms();
 }
 
-void GLRendererImpl::createFramebuffer() {
-    glGenFramebuffers(1, &m_framebuffer.fbo);
-    glGenRenderbuffers(1, &m_framebuffer.rbo);
+// Nothing is loaded up front, the first frames are drawn while the assets download. The spherical harmonics
+// ambient and the coarse model come first, the maps start with their mip tails and the streamer downloads
+// the finer levels when the view needs them, the environment maps are baked once the hdr arrived. Every
+// download is released once it was uploaded.
+void GLRendererImpl::prepareStreamedResources() {
+    // which maps the model has is only known when their containers arrive or fail to,
+    // the model is drawn without them until then
+    m_pbrModelVariant.albedoMetallicMap = m_pbrModelVariant.normalRoughnessMap = m_pbrModelVariant.emissiveAOMap = true;
+    m_pbrModelVariant.virtualTexture = false;
+    compileShaders();
+    createGeometries();
+
+    const string shPath = g_env_map_path.substr(0, g_env_map_path.find_last_of('.')) + ".sh";
+    m_assetFetcher.Fetch(shPath, FETCH_PREVIEW, [this, shPath](bool succeeded) {
+        if (succeeded && !m_environmentBaked)
+            createShEnvironmentMaps(ShEnvironment::Read(shPath));
+        FileSystem::GetSingleton().Remove(shPath);
+    });
+    const string lodPath = g_model_dir + "model.lod.mesh";
+    m_assetFetcher.Fetch(lodPath, FETCH_PREVIEW, [this, lodPath](bool succeeded) {
+        if (succeeded && !m_modelComplete) {
+            const FileData data = FileSystem::GetSingleton().Read(lodPath);
+            createModel(MeshCodec::Decode(data.Data(), data.Size()));
+        }
+        FileSystem::GetSingleton().Remove(lodPath);
+    });
+
+    auto fetchMap = [this](const char* map, bool PbrModelVariant::*pUsed, GLTexture GLRendererImpl::*pTexture, const char* name) {
+        const string path = textureCachePath(map, ".mips");
+        m_assetFetcher.Fetch(path, FETCH_MATERIALS, [this, path, pUsed, pTexture, name](bool succeeded) {
+            // the container stays, the streamer reads its tail and the chunk offsets from it
+            m_pbrModelVariant.*pUsed = succeeded;
+            if (succeeded) {
+                this->*pTexture = m_textureStreamer.Open(path, GL_RGBA, ResourceCategory::MATERIAL, name);
+                bindTextures();
+            }
+        });
+    };
+    fetchMap("AlbedoMetallic", &PbrModelVariant::albedoMetallicMap, &GLRendererImpl::m_albedoMetallicTexture, "albedo metallic");
+    fetchMap("NormalRoughness", &PbrModelVariant::normalRoughnessMap, &GLRendererImpl::m_normalRoughnessTexture, "normal roughness");
+    fetchMap("EmissiveAO", &PbrModelVariant::emissiveAOMap, &GLRendererImpl::m_emissiveAOTexture, "emissive ao");
+
+    // the specular term is black without the lut
+    m_assetFetcher.Fetch(BRDF_LUT, FETCH_DETAIL, [this](bool succeeded) {
+        if (!succeeded)
+            THROW_EXCEPTION("[asset streaming] Failed to download '" BRDF_LUT "'");
+        m_brdfLUTTexture = m_textureUploader.CreateTexture(utility::ReadBrdfLUT(BRDF_LUT, Renderer::brdfLUTImageRes), GL_RG16F, ResourceCategory::LOOKUP_TABLE, "brdf lut");
+        FileSystem::GetSingleton().Remove(BRDF_LUT);
+        bindTextures();
+    });
+    const string meshPath = g_model_dir + "model.mesh";
+    m_assetFetcher.Fetch(meshPath, FETCH_DETAIL, [this, meshPath](bool succeeded) {
+        if (!succeeded)
+            THROW_EXCEPTION("[asset streaming] Failed to download '" + meshPath + "'");
+        const FileData data = FileSystem::GetSingleton().Read(meshPath);
+        createModel(MeshCodec::Decode(data.Data(), data.Size()));
+        FileSystem::GetSingleton().Remove(meshPath);
+        m_modelComplete = true;
+    });
+    m_assetFetcher.Fetch(g_env_map_path, FETCH_ENVIRONMENT, [this](bool succeeded) {
+        if (!succeeded)
+            THROW_EXCEPTION("[asset streaming] Failed to download '" + g_env_map_path + "'");
+        // Render() bakes it once it was uploaded
+        m_hdrTexture = createEnvironmentTexture(m_textureUploader, readEnvironment());
+        FileSystem::GetSingleton().Remove(g_env_map_path);
+    });
+
+    m_programCache.Finish();
+    calculateCubemapMatrices();
+    uploadConstantUniforms();
+}
+
+// the background and the specular map show the radiance, the irradiance map its convolution
+void GLRendererImpl::createShEnvironmentMaps(const ShEnvironment& environment) {
+    // 32 bit floats are RGBA on the web
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+    const int component = g_reducedPrecision ? 3 : 4;
+#else
+    const int component = 3;
+#endif
+    auto createCubeMap = [&](const char* name, bool radiance) {
+        GLTexture texture = CreateEmptyCubeMap(name, SH_CUBE_MAP_RES, radiance ? 1 : 0, g_reducedPrecision);
+        vector<float> texels(SH_CUBE_MAP_RES * SH_CUBE_MAP_RES * component, 1.0f);
+        for (int face = 0; face < 6; ++face) {
+            for (int y = 0; y < SH_CUBE_MAP_RES; ++y) {
+                for (int x = 0; x < SH_CUBE_MAP_RES; ++x) {
+                    // the major axis and the face orientation of the GL cube map layout
+                    const float s = 2.0f * (x + 0.5f) / SH_CUBE_MAP_RES - 1.0f;
+                    const float t = 2.0f * (y + 0.5f) / SH_CUBE_MAP_RES - 1.0f;
+                    const vec3 directions[6] = { vec3(1.0f, -t, -s), vec3(-1.0f, -t, s), vec3(s, 1.0f, t),
+                                                 vec3(s, -1.0f, -t), vec3(s, -t, 1.0f), vec3(-s, -t, -1.0f) };
+                    const vec3 direction = glm::normalize(directions[face]);
+                    const vec3 color = radiance ? environment.Radiance(direction) : environment.Irradiance(direction);
+                    float* pTexel = &texels[(y * SH_CUBE_MAP_RES + x) * component];
+                    pTexel[0] = color.x;
+                    pTexel[1] = color.y;
+                    pTexel[2] = color.z;
+                }
+            }
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, SH_CUBE_MAP_RES, SH_CUBE_MAP_RES,
+                            component == 4 ? GL_RGBA : GL_RGB, GL_FLOAT, texels.data());
+        }
+        if (radiance)
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        return texture;
+    };
+    DestroyTexture(m_cubeMapTexture);
+    DestroyTexture(m_irradianceTexture);
+    DestroyTexture(m_specularTexture);
+    m_cubeMapTexture = createCubeMap("sh environment map", true);
+    m_irradianceTexture = createCubeMap("sh irradiance map", false);
+    m_specularTexture = createCubeMap("sh prefiltered map", true);
+    bindTextures();
 }
 
 void GLRendererImpl::calculateCubemapMatrices() {
@@ -159,108 +605,121 @@ void GLRendererImpl::calculateCubemapMatrices() {
     cubeCamera.ViewMatricesGl(m_cubeMapViews);
 }
 
-void GLRendererImpl::createCubeMap() {
-    m_cubeMapTexture = CreateEmptyCubeMap(Renderer::cubeMapRes, true);
-    m_convertProgram.use();
-    m_convertProgram.setUniform("u_env_map", 0);
-    m_convertProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_hdrTexture.handle);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_framebuffer.rbo);
-
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Renderer::cubeMapRes, Renderer::cubeMapRes);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_framebuffer.rbo);
-
-    glViewport(0, 0, Renderer::cubeMapRes, Renderer::cubeMapRes);
-    for (int i = 0; i < 6; ++i) {
-        m_convertProgram.setUniform("u_per_frame.view", m_cubeMapViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_cubeMapTexture.handle, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glBindVertexArray(m_cube.vao);
-        glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
-    }
-
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture.handle);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    glFinish();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void GLRendererImpl::bakeEnvironmentMaps() {
+    // replaces the spherical harmonics maps of a streamed environment
+    DestroyTexture(m_cubeMapTexture);
+    DestroyTexture(m_irradianceTexture);
+    DestroyTexture(m_specularTexture);
+    m_environmentBaked = true;
+    const TargetFormat format = g_reducedPrecision ? TargetFormat::R11G11B10F : TargetFormat::RGB32F;
+    int cubeMapMipLevels = 1;
+    while ((Renderer::cubeMapRes >> cubeMapMipLevels) > 0)
+        ++cubeMapMipLevels;
+    m_cubeMapTexture = CreateEmptyCubeMap("environment map", Renderer::cubeMapRes, true, g_reducedPrecision);
+    m_irradianceTexture = CreateEmptyCubeMap("irradiance map", Renderer::irradianceMapRes, 0, g_reducedPrecision);
+    m_specularTexture = CreateEmptyCubeMap("prefiltered map", Renderer::specularMapRes, Renderer::specularMapMipLevels, g_reducedPrecision);
+
+    FrameGraph graph;
+    // only sampled, the description doesn't matter
+    const FrameGraphResource equirectangular = graph.Import("equirectangular map", FrameGraphTextureDesc(), m_hdrTexture.handle);
+    const FrameGraphResource cubeMap = graph.Import("environment map", { Renderer::cubeMapRes, Renderer::cubeMapRes, format, 6, cubeMapMipLevels }, m_cubeMapTexture.handle);
+    const FrameGraphResource irradianceMap = graph.Import("irradiance map", { Renderer::irradianceMapRes, Renderer::irradianceMapRes, format, 6, 1 }, m_irradianceTexture.handle);
+    const FrameGraphResource specularMap = graph.Import("prefiltered map", { Renderer::specularMapRes, Renderer::specularMapRes, format, 6, Renderer::specularMapMipLevels }, m_specularTexture.handle);
+    addCubeMapPasses(graph, equirectangular, cubeMap);
+    addIrradianceMapPasses(graph, cubeMap, irradianceMap);
+    addPrefilteredMapPasses(graph, cubeMap, specularMap);
+    graph.Compile();
+#ifdef PBR_VERBOSE
+    graph.Dump(cout);
+#endif
+    m_frameGraph.Execute(graph);
 
     m_convertProgram.destroy();
+    m_irradianceProgram.destroy();
+    m_prefilterProgram.destroy();
+    // only the cube map is sampled from now on
+    DestroyTexture(m_hdrTexture);
 }
 
-void GLRendererImpl::createIrradianceMap() {
-    m_irradianceTexture = CreateEmptyCubeMap(Renderer::irradianceMapRes);
-    m_irradianceProgram.use();
-    m_irradianceProgram.setUniform("u_env_map", 0);
-    m_irradianceProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture.handle);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_framebuffer.rbo);
-
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Renderer::irradianceMapRes, Renderer::irradianceMapRes);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_framebuffer.rbo);
-
-    glViewport(0, 0, Renderer::irradianceMapRes, Renderer::irradianceMapRes);
-
-    for (int i = 0; i < 6; ++i) {
-        m_irradianceProgram.setUniform("u_per_frame.view", m_cubeMapViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_irradianceTexture.handle, 0);
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindVertexArray(m_cube.vao);
-        glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
+// every face covers the whole target, none of them is cleared
+void GLRendererImpl::addCubeMapPasses(FrameGraph& graph, FrameGraphResource equirectangular, FrameGraphResource cubeMap) {
+    for (int face = 0; face < 6; ++face) {
+        graph.AddPass(
+            ("environment map face " + std::to_string(face)).c_str(), [&](FrameGraph::Builder& builder) {
+                builder.Read(equirectangular);
+                builder.SetColorTarget(cubeMap, LoadOp::DONT_CARE, 0, face);
+            },
+            [this, equirectangular, face]() {
+                m_convertProgram.use();
+                m_convertProgram.setUniform("u_env_map", 0);
+                m_convertProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
+                m_convertProgram.setUniform("u_per_frame.view", m_cubeMapViews[face]);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, m_frameGraph.GetTexture(equirectangular));
+                glBindVertexArray(m_cube.vao);
+                glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
+            });
     }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    m_irradianceProgram.destroy();
+    graph.AddPass(
+        "environment map mips", [&](FrameGraph::Builder& builder) { builder.Write(cubeMap); },
+        [this, cubeMap]() {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, m_frameGraph.GetTexture(cubeMap));
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        });
 }
 
-void GLRendererImpl::createPrefilteredMap() {
-    m_specularTexture = CreateEmptyCubeMap(Renderer::specularMapRes, Renderer::specularMapMipLevels);
-    m_prefilterProgram.use();
-    m_prefilterProgram.setUniform("u_env_map", 0);
-    m_prefilterProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture.handle);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer.fbo);
-
-    unsigned int mipSize = Renderer::specularMapRes;
-    for (int mipLevel = 0; mipLevel < Renderer::specularMapMipLevels; ++mipLevel, mipSize = mipSize >> 1) {
-        glBindRenderbuffer(GL_RENDERBUFFER, m_framebuffer.rbo);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipSize, mipSize);
-        glViewport(0, 0, mipSize, mipSize);
-
-        float roughness = float(mipLevel) / float(Renderer::specularMapMipLevels - 1.0f);
-        m_prefilterProgram.setUniform("u_roughness", roughness);
-        for (int i = 0; i < 6; ++i) {
-            m_prefilterProgram.setUniform("u_per_frame.view", m_cubeMapViews[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_specularTexture.handle, mipLevel);
+void GLRendererImpl::addIrradianceMapPasses(FrameGraph& graph, FrameGraphResource cubeMap, FrameGraphResource irradianceMap) {
+    for (int face = 0; face < 6; ++face) {
+        graph.AddPass(
+            ("irradiance map face " + std::to_string(face)).c_str(), [&](FrameGraph::Builder& builder) {
+                builder.Read(cubeMap);
+                builder.SetColorTarget(irradianceMap, LoadOp::DONT_CARE, 0, face);
+            },
+            [this, cubeMap, face]() {
+                m_irradianceProgram.use();
+                m_irradianceProgram.setUniform("u_env_map", 0);
+                m_irradianceProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
+                m_irradianceProgram.setUniform("u_per_frame.view", m_cubeMapViews[face]);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, m_frameGraph.GetTexture(cubeMap));
+                glBindVertexArray(m_cube.vao);
+                glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
+            });
+    }
+}
 
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glBindVertexArray(m_cube.vao);
-            glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
+void GLRendererImpl::addPrefilteredMapPasses(FrameGraph& graph, FrameGraphResource cubeMap, FrameGraphResource specularMap) {
+    for (int mipLevel = 0; mipLevel < Renderer::specularMapMipLevels; ++mipLevel) {
+        const float roughness = float(mipLevel) / float(Renderer::specularMapMipLevels - 1.0f);
+        for (int face = 0; face < 6; ++face) {
+            graph.AddPass(
+                ("prefiltered map mip " + std::to_string(mipLevel) + " face " + std::to_string(face)).c_str(),
+                [&](FrameGraph::Builder& builder) {
+                    builder.Read(cubeMap);
+                    builder.SetColorTarget(specularMap, LoadOp::DONT_CARE, mipLevel, face);
+                },
+                [this, cubeMap, roughness, face]() {
+                    m_prefilterProgram.use();
+                    m_prefilterProgram.setUniform("u_env_map", 0);
+                    m_prefilterProgram.setUniform("u_per_frame.projection", m_cubeMapPerspective);
+                    m_prefilterProgram.setUniform("u_roughness", roughness);
+                    m_prefilterProgram.setUniform("u_per_frame.view", m_cubeMapViews[face]);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_CUBE_MAP, m_frameGraph.GetTexture(cubeMap));
+                    glBindVertexArray(m_cube.vao);
+                    glDrawElements(GL_TRIANGLES, m_cube.indexCount, GL_UNSIGNED_INT, 0);
+                });
         }
     }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    m_prefilterProgram.destroy();
 }
 
 // shaders
 void GLRendererImpl::createShaderProgram(GlslProgram& program, string const& vertSource, string const& fragSource, char const* debugName) {
-    SHADER_COMPILING_START_INFO(debugName);
-    GLuint vertexShaderHandle = GlslProgram::createShaderFromString(vertSource, GL_VERTEX_SHADER);
-    GLuint fragmentShaderHandle = GlslProgram::createShaderFromString(fragSource, GL_FRAGMENT_SHADER);
-    SHADER_COMPILING_END_INFO(debugName);
-    program = GlslProgram::create(vertexShaderHandle, fragmentShaderHandle);
+    m_programCache.Request(program, vertSource, fragSource, debugName);
+}
+
+static string reducedPrecisionDefine() {
+    return g_reducedPrecision ? "#define REDUCED_PRECISION 1\n" : "#define REDUCED_PRECISION 0\n";
 }
 
 void GLRendererImpl::compileShaders() {
@@ -284,7 +743,17 @@ void GLRendererImpl::compileShaders() {
         string vertSource = utility::ReadAsciiFile(GLSL_DIR "pbr_model.vert");
         string fragSource = utility::ReadAsciiFile(GLSL_DIR "pbr_model.frag");
 #endif
-        createShaderProgram(m_pbrModelProgram, vertSource, fragSource, "PBR Model Program");
+        string commonDefines = "#define MAX_REFLECTION_LOD " + std::to_string(Renderer::maxReflectionLod) + "\n";
+        commonDefines.append(reducedPrecisionDefine());
+        m_pbrModelVariants.Initialize(&m_programCache, vertSource, fragSource, commonDefines, "PBR Model Program",
+                                      [this](GlslProgram& program) { setupPbrModelProgram(program); });
+        // start compiling the variants of the first frames, without maps while they stream in and with them
+        PbrModelVariant variant = m_pbrModelVariant;
+        variant.debugView = g_debug;
+        variant.lightCount = g_lightCount;
+        m_pbrModelVariants.Prepare(variant.Key(), variant.Defines());
+        variant.albedoMetallicMap = variant.normalRoughnessMap = variant.emissiveAOMap = false;
+        m_pbrModelVariants.Prepare(variant.Key(), variant.Defines());
     }
     // convert cubemap
     {
@@ -317,6 +786,10 @@ void GLRendererImpl::compileShaders() {
         string vertSource = utility::ReadAsciiFile(GLSL_DIR "cubemap.vert");
         string fragSource = utility::ReadAsciiFile(GLSL_DIR "prefilter.frag");
 #endif
+        string defines;
+        defines.append("#define SAMPLE_COUNT ").append(std::to_string(Renderer::prefilterSampleCount)).append("u\n");
+        defines.append("#define ENV_MAP_RESOLUTION ").append(std::to_string(Renderer::cubeMapRes)).append(".0\n");
+        fragSource = ProgramVariants::InjectDefines(fragSource, defines);
         createShaderProgram(m_prefilterProgram, vertSource, fragSource, "Prefilter Program");
     }
     // background
@@ -328,8 +801,46 @@ void GLRendererImpl::compileShaders() {
         string vertSource = utility::ReadAsciiFile(GLSL_DIR "background.vert");
         string fragSource = utility::ReadAsciiFile(GLSL_DIR "background.frag");
 #endif
+        fragSource = ProgramVariants::InjectDefines(fragSource, reducedPrecisionDefine());
         createShaderProgram(m_backgroundProgram, vertSource, fragSource, "Background Program");
     }
+    // depth prepass
+    if (g_depthPrepass) {
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        string vertSource = string(generated::pbr_model_vert_c_str);
+        string fragSource = string(generated::depth_frag_c_str);
+#else
+        string vertSource = utility::ReadAsciiFile(GLSL_DIR "pbr_model.vert");
+        string fragSource = utility::ReadAsciiFile(GLSL_DIR "depth.frag");
+#endif
+        createShaderProgram(m_depthProgram, vertSource, fragSource, "Depth Program");
+    }
+    // virtual texture feedback
+    if (g_virtualTexturing) {
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        string vertSource = string(generated::pbr_model_vert_c_str);
+        string fragSource = string(generated::vt_feedback_frag_c_str);
+#else
+        string vertSource = utility::ReadAsciiFile(GLSL_DIR "pbr_model.vert");
+        string fragSource = utility::ReadAsciiFile(GLSL_DIR "vt_feedback.frag");
+#endif
+        fragSource = ProgramVariants::InjectDefines(fragSource, "#define FEEDBACK_SCALE " + std::to_string(VirtualTexture::FEEDBACK_SCALE) + ".0\n");
+        createShaderProgram(m_feedbackProgram, vertSource, fragSource, "Feedback Program");
+    }
+    // tonemap
+    {
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        string vertSource = string(generated::tonemap_vert_c_str);
+        string fragSource = string(generated::tonemap_frag_c_str);
+#else
+        string vertSource = utility::ReadAsciiFile(GLSL_DIR "tonemap.vert");
+        string fragSource = utility::ReadAsciiFile(GLSL_DIR "tonemap.frag");
+#endif
+        string defines = reducedPrecisionDefine();
+        defines.append(m_srgbFramebuffer ? "#define SRGB_FRAMEBUFFER 1\n" : "#define SRGB_FRAMEBUFFER 0\n");
+        fragSource = ProgramVariants::InjectDefines(fragSource, defines);
+        createShaderProgram(m_tonemapProgram, vertSource, fragSource, "Tonemap Program");
+    }
 }
 
 void GLRendererImpl::createGeometries() {
@@ -339,12 +850,9 @@ void GLRendererImpl::createGeometries() {
         m_cube.indexCount = static_cast<uint32_t>(3 * cube.indices.size());
         glGenVertexArrays(1, &m_cube.vao);
         glBindVertexArray(m_cube.vao);
-        glGenBuffers(2, &m_cube.vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_cube.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indices.size() * sizeof(uvec3), cube.indices.data(), GL_STATIC_DRAW);
+        m_cube.ebo = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, cube.indices.data(), cube.indices.size() * sizeof(uvec3), ResourceCategory::GEOMETRY, "cube indices");
         // vertices
-        glBindBuffer(GL_ARRAY_BUFFER, m_cube.vbo);
-        glBufferData(GL_ARRAY_BUFFER, cube.vertices.size() * sizeof(vec3), cube.vertices.data(), GL_STATIC_DRAW);
+        m_cube.vbo = CreateBuffer(GL_ARRAY_BUFFER, cube.vertices.data(), cube.vertices.size() * sizeof(vec3), ResourceCategory::GEOMETRY, "cube vertices");
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), 0);
         glEnableVertexAttribArray(0);
     }
@@ -354,83 +862,104 @@ void GLRendererImpl::createGeometries() {
         m_sphere.indexCount = static_cast<uint32_t>(3 * sphere.indices.size());
         glGenVertexArrays(1, &m_sphere.vao);
         glBindVertexArray(m_sphere.vao);
-        glGenBuffers(2, &m_sphere.vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sphere.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere.indices.size() * sizeof(uvec3), sphere.indices.data(), GL_STATIC_DRAW);
+        m_sphere.ebo = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere.indices.data(), sphere.indices.size() * sizeof(uvec3), ResourceCategory::GEOMETRY, "sphere indices");
         // vertices
-        glBindBuffer(GL_ARRAY_BUFFER, m_sphere.vbo);
-        glBufferData(GL_ARRAY_BUFFER, sphere.vertices.size() * sizeof(Vertex), sphere.vertices.data(), GL_STATIC_DRAW);
+        m_sphere.vbo = CreateBuffer(GL_ARRAY_BUFFER, sphere.vertices.data(), sphere.vertices.size() * sizeof(Vertex), ResourceCategory::GEOMETRY, "sphere vertices");
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
         glEnableVertexAttribArray(1);
     }
-    {
-        // load model
-        auto model = utility::LoadModel(g_model_dir.c_str());
-
-        m_model.indexCount = static_cast<uint32_t>(3 * model.indices.size());
-        glGenVertexArrays(1, &m_model.vao);
-        glBindVertexArray(m_model.vao);
-        glGenBuffers(2, &m_model.vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_model.ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indices.size() * sizeof(uvec3), model.indices.data(), GL_STATIC_DRAW);
-        // vertices
-        glBindBuffer(GL_ARRAY_BUFFER, m_model.vbo);
-        glBufferData(GL_ARRAY_BUFFER, model.vertices.size() * sizeof(TexturedVertex), model.vertices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, position));
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, uv));
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, normal));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, tangent));
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, bitangent));
-        glEnableVertexAttribArray(4);
+    // a streamed model arrives later
+    if (g_assetUrl.empty())
+        createModel(utility::LoadModel(g_model_dir.c_str()));
+    glGenVertexArrays(1, &m_emptyVao);
+}
+
+// replaces the model drawn so far, e.g. the coarse one of a streamed model
+void GLRendererImpl::createModel(TexturedMesh&& model) {
+    glDeleteVertexArrays(1, &m_model.vao);
+    DestroyBuffer(m_model.vbo);
+    DestroyBuffer(m_model.ebo);
+    m_modelFootprint = MeasureUvFootprint(model, g_transform);
+    if (g_meshletCulling) {
+        if (model.meshlets.empty())
+            BuildMeshlets(model);
+        m_meshletCuller.Initialize(model.meshlets);
+        // the ranges of the old model don't index the new one
+        m_visibleRanges.clear();
+        // a frame culls and draws without allocating
+        m_visibleRanges.reserve(model.meshlets.size());
+        m_drawCounts.reserve(model.meshlets.size());
+        m_drawOffsets.reserve(model.meshlets.size());
     }
+
+    m_model.indexCount = static_cast<uint32_t>(3 * model.indices.size());
+    glGenVertexArrays(1, &m_model.vao);
+    glBindVertexArray(m_model.vao);
+    m_model.ebo = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, model.indices.data(), model.indices.size() * sizeof(uvec3), ResourceCategory::GEOMETRY, "model indices");
+    // vertices
+    m_model.vbo = CreateBuffer(GL_ARRAY_BUFFER, model.vertices.data(), model.vertices.size() * sizeof(TexturedVertex), ResourceCategory::GEOMETRY, "model vertices");
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, tangent));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)offsetof(TexturedVertex, bitangent));
+    glEnableVertexAttribArray(4);
 }
 
 void GLRendererImpl::clearGeometries() {
-    glDeleteVertexArrays(1, &m_sphere.vao);
-    glDeleteVertexArrays(2, &m_sphere.vbo);
+    for (PerDrawData* pDrawData : { &m_cube, &m_sphere, &m_model }) {
+        glDeleteVertexArrays(1, &pDrawData->vao);
+        pDrawData->vao = 0;
+        DestroyBuffer(pDrawData->vbo);
+        DestroyBuffer(pDrawData->ebo);
+    }
+    glDeleteVertexArrays(1, &m_emptyVao);
+    m_emptyVao = 0;
 }
 
 void GLRendererImpl::uploadConstantUniforms() {
     m_pbrProgram.use();
     // lighting
-    for (size_t i = 0; i < g_lights.size(); ++i) {
-        const string light = "u_lights[" + std::to_string(i) + "].";
-        m_pbrProgram.setUniform(light + "position", g_lights[i].position);
-        m_pbrProgram.setUniform(light + "color", g_lights[i].color);
-    }
+    setLightUniforms(m_pbrProgram);
 
     // textures
     m_pbrProgram.setUniform("u_irradiance_map", 1);
     m_pbrProgram.setUniform("u_specular_map", 2);
     m_pbrProgram.setUniform("u_brdf_lut", 3);
 
-    m_pbrModelProgram.use();
-    // lighting
-    for (size_t i = 0; i < g_lights.size(); ++i) {
-        const string light = "u_lights[" + std::to_string(i) + "].";
-        m_pbrModelProgram.setUniform(light + "position", g_lights[i].position);
-        m_pbrModelProgram.setUniform(light + "color", g_lights[i].color);
+    m_backgroundProgram.use();
+    m_backgroundProgram.setUniform("u_env_map", 0);
+    m_backgroundProgram.bindUniformBlock("PerFrameBuffer", PER_FRAME_BINDING);
+
+    if (g_depthPrepass) {
+        m_depthProgram.use();
+        m_depthProgram.setUniform("u_per_draw.transform", g_transform);
+        m_depthProgram.bindUniformBlock("PerFrameBuffer", PER_FRAME_BINDING);
     }
 
-    m_pbrModelProgram.setUniform("u_per_draw.transform", g_transform);
+    if (g_virtualTexturing) {
+        m_feedbackProgram.use();
+        m_feedbackProgram.setUniform("u_per_draw.transform", g_transform);
+        m_feedbackProgram.bindUniformBlock("PerFrameBuffer", PER_FRAME_BINDING);
+        m_virtualTexture.SetUniforms(m_feedbackProgram);
+    }
 
-    // textures
-    m_pbrModelProgram.setUniform("u_irradiance_map", 1);
-    m_pbrModelProgram.setUniform("u_specular_map", 2);
-    m_pbrModelProgram.setUniform("u_brdf_lut", 3);
-    m_pbrModelProgram.setUniform("u_albedoMetallic", 4);
-    m_pbrModelProgram.setUniform("u_normalRoughness", 5);
-    m_pbrModelProgram.setUniform("u_emissiveAO", 6);
+    m_tonemapProgram.use();
+    m_tonemapProgram.setUniform("u_hdr_color", 7);
+    m_tonemapProgram.setUniform("u_scene_depth", 10);
+    m_tonemapProgram.bindUniformBlock("PerFrameBuffer", PER_FRAME_BINDING);
 
-    m_backgroundProgram.use();
-    m_backgroundProgram.setUniform("u_env_map", 0);
+    bindTextures();
+}
 
+// again whenever a streamed texture replaced one
+void GLRendererImpl::bindTextures() {
     glActiveTexture(GL_TEXTURE0);  // background
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMapTexture.handle);
 
@@ -443,14 +972,43 @@ void GLRendererImpl::uploadConstantUniforms() {
     glActiveTexture(GL_TEXTURE3);  // brdf
     glBindTexture(GL_TEXTURE_2D, m_brdfLUTTexture.handle);
 
+    // the atlases take the place of the maps
     glActiveTexture(GL_TEXTURE4);  // albedo + metallic
-    glBindTexture(GL_TEXTURE_2D, m_albedoMetallicTexture.handle);
+    glBindTexture(GL_TEXTURE_2D, g_virtualTexturing ? m_virtualTexture.Atlas(VirtualTexture::ALBEDO_METALLIC) : m_albedoMetallicTexture.handle);
 
     glActiveTexture(GL_TEXTURE5);  // normal + roughness
-    glBindTexture(GL_TEXTURE_2D, m_normalRoughnessTexture.handle);
+    glBindTexture(GL_TEXTURE_2D, g_virtualTexturing ? m_virtualTexture.Atlas(VirtualTexture::NORMAL_ROUGHNESS) : m_normalRoughnessTexture.handle);
 
     glActiveTexture(GL_TEXTURE6);  // emissive + ao
-    glBindTexture(GL_TEXTURE_2D, m_emissiveAOTexture.handle);
+    glBindTexture(GL_TEXTURE_2D, g_virtualTexturing ? m_virtualTexture.Atlas(VirtualTexture::EMISSIVE_AO) : m_emissiveAOTexture.handle);
+
+    // textures 7 and 10 are the hdr color and depth targets, bound by the tonemap pass, texture 8 is the one the
+    // uploader writes to
+    if (g_virtualTexturing) {
+        glActiveTexture(GL_TEXTURE9);  // page table
+        glBindTexture(GL_TEXTURE_2D, m_virtualTexture.PageTable());
+    }
+}
+
+// called once for every pbr model variant when it is first used,
+// uniforms a variant compiled out are skipped by setUniform
+void GLRendererImpl::setupPbrModelProgram(GlslProgram& program) {
+    program.use();
+    // lighting
+    setLightUniforms(program);
+
+    program.setUniform("u_per_draw.transform", g_transform);
+    program.bindUniformBlock("PerFrameBuffer", PER_FRAME_BINDING);
+
+    // textures
+    program.setUniform("u_irradiance_map", 1);
+    program.setUniform("u_specular_map", 2);
+    program.setUniform("u_brdf_lut", 3);
+    program.setUniform("u_albedoMetallic", 4);
+    program.setUniform("u_normalRoughness", 5);
+    program.setUniform("u_emissiveAO", 6);
+    program.setUniform("u_page_table", 9);
+    m_virtualTexture.SetUniforms(program);
 }
 
 }  // namespace gl
@@ -1,7 +1,20 @@
 #pragma once
+#include "AssetFetcher.h"
+#include "GLFrameGraph.h"
+#include "GLFramePacer.h"
+#include "GLGpuTimer.h"
 #include "GLHelpers.h"
 #include "GLPrerequisites.h"
+#include "GLProgramCache.h"
+#include "GLProgramVariants.h"
+#include "GLTextureStreamer.h"
+#include "GLTextureUploader.h"
+#include "GLVirtualTexture.h"
+#include "Mesh.h"
+#include "MeshletCuller.h"
+#include "ShEnvironment.h"
 #include "core/Camera.h"
+#include "core/DynamicResolution.h"
 #include "core/Window.h"
 
 namespace pbr {
@@ -15,31 +28,84 @@ class GLRendererImpl {
     void PrepareGpuResources();
     void Render(const Camera& camera);
     void Resize(const Extent2i& extent);
+    // textures are still streaming in or assets downloading
+    bool IsRefining() const {
+        return m_textureUploader.PendingBytes() > 0 || m_textureStreamer.IsStreaming() || m_virtualTexture.IsStreaming() || m_assetFetcher.IsBusy();
+    }
+    // the next frame starts a new interval of the frame timing without timer queries
+    void FrameSkipped() { m_lastFrameStart = 0.0; }
     void Finalize();
 
    private:
-    void createFramebuffer();
     void compileShaders();
+    // PrepareGpuResources() with --asset-url, the downloads are started and the first frame is drawn right away
+    void prepareStreamedResources();
+    void createShEnvironmentMaps(const ShEnvironment& environment);
     void uploadConstantUniforms();
+    void bindTextures();
+    void setupPbrModelProgram(GlslProgram& program);
     void createGeometries();
+    // builds the meshlets a raw model doesn't have yet
+    void createModel(TexturedMesh&& model);
     void clearGeometries();
-    void createCubeMap();
-    void createIrradianceMap();
-    void createPrefilteredMap();
+    // renders the environment, irradiance and prefiltered maps in one frame graph
+    void bakeEnvironmentMaps();
+    void addCubeMapPasses(FrameGraph& graph, FrameGraphResource equirectangular, FrameGraphResource cubeMap);
+    void addIrradianceMapPasses(FrameGraph& graph, FrameGraphResource cubeMap, FrameGraphResource irradianceMap);
+    void addPrefilteredMapPasses(FrameGraph& graph, FrameGraphResource cubeMap, FrameGraphResource specularMap);
+    void uploadPerFrameConstants(const Camera& camera, bool upscaled);
+    // asks the streamer for the material levels the model needs at this distance and resolution
+    void streamMaterials(const Camera& camera, const Extent2i& renderExtent);
+    void drawDepth();
+    // the meshlets of the model that survived culling this frame, or all of it
+    void drawModelTriangles();
+    // writes the virtual pages the model needs and reads them back
+    void drawFeedback(int width, int height);
+    // the model is drawn without its maps until all of their mip tails arrived
+    bool materialsUploaded() const;
+    void drawModel();
+    void drawBackground();
+    void drawTonemap(FrameGraphResource hdrColor, FrameGraphResource sceneDepth);
+    // feeds the frame times that arrived since the last frame to the resolution controller
+    void updateRenderScale();
     void calculateCubemapMatrices();
     void createShaderProgram(GlslProgram& program, string const& vertSource, string const& fragSource, char const* debugName);
 
    private:
     const Window* m_pWindow;
+    FrameGraphExecutor m_frameGraph;
+    GpuTimer m_gpuTimer;
+    AssetFetcher m_assetFetcher;  // only with g_assetUrl
+    TextureUploader m_textureUploader;
+    TextureStreamer m_textureStreamer;
+    VirtualTexture m_virtualTexture;  // only with g_virtualTexturing
+    mat4 m_lastViewProjection;
+    FramePacer m_framePacer;
+    DynamicResolution m_dynamicResolution;
+    double m_lastFrameStart = 0.0;  // frames are timed on the CPU when there are no timer queries
+    ProgramCache m_programCache;
     GlslProgram m_pbrProgram;
-    GlslProgram m_pbrModelProgram;
+    ProgramVariants m_pbrModelVariants;
+    PbrModelVariant m_pbrModelVariant;
     GlslProgram m_convertProgram;
     GlslProgram m_irradianceProgram;
     GlslProgram m_prefilterProgram;
     GlslProgram m_backgroundProgram;
+    GlslProgram m_depthProgram;     // only with g_depthPrepass
+    GlslProgram m_feedbackProgram;  // only with g_virtualTexturing
+    GlslProgram m_tonemapProgram;
+    bool m_srgbFramebuffer = false;
+    GLuint m_emptyVao = 0;  // fullscreen passes generate their vertices
     PerDrawData m_sphere;
     PerDrawData m_cube;
     PerDrawData m_model;
+    MeshletCuller m_meshletCuller;  // only with g_meshletCulling
+    vector<TriangleRange> m_visibleRanges;
+    vector<GLsizei> m_drawCounts;
+    vector<const void*> m_drawOffsets;
+    bool m_modelComplete = false;     // a streamed model replaced its coarse level of detail
+    bool m_environmentBaked = false;  // the hdr replaced the spherical harmonics ambient
+    UvFootprint m_modelFootprint;
     GLTexture m_hdrTexture;
     GLTexture m_brdfLUTTexture;
     GLTexture m_cubeMapTexture;
@@ -48,7 +114,6 @@ class GLRendererImpl {
     GLTexture m_albedoMetallicTexture;
     GLTexture m_normalRoughnessTexture;
     GLTexture m_emissiveAOTexture;
-    GLFramebuffer m_framebuffer;
 
     mat4 m_cubeMapPerspective;
     array<mat4, 6> m_cubeMapViews;
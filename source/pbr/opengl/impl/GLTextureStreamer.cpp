@@ -0,0 +1,228 @@
+#include "GLTextureStreamer.h"
+#include <cmath>
+#include "FileSystem.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace gl {
+
+// the unit the uploader binds to, no shader samples it
+static constexpr GLenum STREAM_TEXTURE_UNIT = GL_TEXTURE8;
+// levels that start reading in one frame, the neediest textures first
+static constexpr int MAX_READS_PER_FRAME = 4;
+
+void TextureStreamer::Initialize(TextureUploader* pUploader, size_t budget, AssetFetcher* pFetcher) {
+    m_pUploader = pUploader;
+    m_budget = budget;
+    m_pFetcher = pFetcher;
+}
+
+GLTexture TextureStreamer::Open(const string& path, GLenum internalFormat, ResourceCategory category, const char* name) {
+    unique_ptr<StreamedTexture> pStreamed = std::make_unique<StreamedTexture>();
+    StreamedTexture& streamed = *pStreamed;
+    MipChainFile& file = streamed.file;
+    file.Open(path);
+    if (file.Component() != 4)
+        THROW_EXCEPTION("[texture streaming] '" + path + "' is not RGBA");
+    streamed.internalFormat = internalFormat;
+    streamed.category = category;
+    streamed.name = name;
+    int tailLevel = file.LevelCount() - 1;
+    while (tailLevel > 0 && file.Width(tailLevel - 1) <= MIP_TAIL_SIZE && file.Height(tailLevel - 1) <= MIP_TAIL_SIZE)
+        --tailLevel;
+    streamed.tailLevel = streamed.baseLevel = streamed.wantedLevel = tailLevel;
+
+    GLTexture& texture = streamed.texture;
+    texture.type = GL_TEXTURE_2D;
+    glGenTextures(1, &texture.handle);
+    glActiveTexture(STREAM_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, texture.handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.LevelCount() - 1);
+    for (int level = tailLevel; level < file.LevelCount(); ++level) {
+        m_residentSize += file.LevelSize(level);
+        m_pUploader->UploadLevel(texture.handle, level, internalFormat, file.ReadLevel(level));
+    }
+    setBaseLevel(streamed, tailLevel);
+    ++m_streamingCount;
+
+    m_textures.push_back(std::move(pStreamed));
+    return texture;
+}
+
+void TextureStreamer::Touch(GLuint texture, float uvPerPixel) {
+    StreamedTexture* pStreamed = find(texture);
+    if (!pStreamed)
+        return;
+    // texels of level 0 a pixel spans, each level halves them
+    const float texelsPerPixel = uvPerPixel * static_cast<float>(std::max(pStreamed->file.Width(0), pStreamed->file.Height(0)));
+    int level = texelsPerPixel > 1.0f ? static_cast<int>(std::log2(texelsPerPixel)) : 0;
+    level = std::min(level, pStreamed->tailLevel);
+    // several draws of a texture need the finest of their levels
+    if (pStreamed->lastUsed == m_frame)
+        level = std::min(level, pStreamed->wantedLevel);
+    pStreamed->wantedLevel = level;
+    pStreamed->lastUsed = m_frame;
+}
+
+void TextureStreamer::Update() {
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+    for (unique_ptr<StreamedTexture>& pStreamed : m_textures) {
+        StreamedTexture& streamed = *pStreamed;
+        switch (streamed.state) {
+            case State::TAIL:
+                if (!m_pUploader->IsPending(streamed.texture.handle)) {
+                    streamed.state = State::RESIDENT;
+                    --m_streamingCount;
+                }
+                break;
+            case State::READING:
+                // a single thread reads when it waits
+                if (streamed.read.IsDone() || jobSystem.ThreadCount() == 1) {
+                    // rethrows a failed read
+                    jobSystem.Wait(streamed.read);
+                    m_pUploader->UploadLevel(streamed.texture.handle, streamed.loadingLevel, streamed.internalFormat, std::move(streamed.loaded));
+                    streamed.state = State::UPLOADING;
+                }
+                break;
+            case State::UPLOADING:
+                if (!m_pUploader->IsPending(streamed.texture.handle)) {
+                    setBaseLevel(streamed, streamed.loadingLevel);
+                    streamed.loadingLevel = -1;
+                    streamed.state = State::RESIDENT;
+                    --m_streamingCount;
+                    ++m_levelsLoaded;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (int i = 0; i < MAX_READS_PER_FRAME; ++i) {
+        StreamedTexture* pNext = nullptr;
+        for (unique_ptr<StreamedTexture>& pStreamed : m_textures) {
+            const StreamedTexture& streamed = *pStreamed;
+            if (streamed.state != State::RESIDENT || streamed.lastUsed != m_frame || streamed.wantedLevel >= streamed.baseLevel)
+                continue;
+            if (!pNext || streamed.baseLevel - streamed.wantedLevel > pNext->baseLevel - pNext->wantedLevel)
+                pNext = pStreamed.get();
+        }
+        // the budget is full of levels the view needs, the texture stays blurrier than asked for
+        if (!pNext || !makeRoom(pNext->file.LevelSize(pNext->baseLevel - 1), pNext))
+            break;
+        startRead(*pNext);
+    }
+    ++m_frame;
+}
+
+bool TextureStreamer::IsResident(GLuint texture) const {
+    const StreamedTexture* pStreamed = find(texture);
+    return !pStreamed || pStreamed->state != State::TAIL;
+}
+
+void TextureStreamer::Report(ostream& os) const {
+    if (m_textures.empty())
+        return;
+    os << "[Log] texture streaming: " << m_levelsLoaded << " levels streamed in, " << m_levelsEvicted << " evicted, "
+       << (m_residentSize >> 20) << " MB resident";
+    if (m_budget)
+        os << ", " << (m_streamedSize >> 20) << " MB of the " << (m_budget >> 20) << " MB budget in use";
+    os << endl;
+}
+
+void TextureStreamer::Finalize() {
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+    for (unique_ptr<StreamedTexture>& pStreamed : m_textures)
+        jobSystem.Wait(pStreamed->read);
+    m_textures.clear();
+    m_residentSize = m_streamedSize = 0;
+    m_streamingCount = 0;
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::find(GLuint texture) const {
+    for (const unique_ptr<StreamedTexture>& pStreamed : m_textures) {
+        if (pStreamed->texture.handle == texture)
+            return pStreamed.get();
+    }
+    return nullptr;
+}
+
+void TextureStreamer::setBaseLevel(StreamedTexture& streamed, int level) {
+    streamed.baseLevel = level;
+    glActiveTexture(STREAM_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, streamed.texture.handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    const MipChainFile& file = streamed.file;
+    RegisterTexture(streamed.texture, streamed.internalFormat, streamed.category, streamed.name.c_str(),
+                    file.Width(level), file.Height(level), 1, file.LevelCount() - level);
+}
+
+bool TextureStreamer::makeRoom(size_t size, const StreamedTexture* pRequester) {
+    if (m_budget == 0)
+        return true;
+    while (m_streamedSize + size > m_budget) {
+        StreamedTexture* pVictim = nullptr;
+        for (unique_ptr<StreamedTexture>& pStreamed : m_textures) {
+            const StreamedTexture& streamed = *pStreamed;
+            if (pStreamed.get() == pRequester || streamed.state != State::RESIDENT || streamed.baseLevel >= streamed.tailLevel)
+                continue;
+            if (streamed.lastUsed == m_frame && streamed.baseLevel >= streamed.wantedLevel)
+                continue;
+            if (!pVictim || streamed.lastUsed < pVictim->lastUsed)
+                pVictim = pStreamed.get();
+        }
+        if (!pVictim)
+            return false;
+
+        const int level = pVictim->baseLevel;
+        setBaseLevel(*pVictim, level + 1);
+        // outside of the sampled range a 0x0 level releases its memory
+        glTexImage2D(GL_TEXTURE_2D, level, pVictim->internalFormat, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        m_streamedSize -= pVictim->file.LevelSize(level);
+        m_residentSize -= pVictim->file.LevelSize(level);
+        ++m_levelsEvicted;
+    }
+    return true;
+}
+
+void TextureStreamer::startRead(StreamedTexture& streamed) {
+    streamed.loadingLevel = streamed.baseLevel - 1;
+    const size_t size = streamed.file.LevelSize(streamed.loadingLevel);
+    m_streamedSize += size;
+    m_residentSize += size;
+    ++m_streamingCount;
+    const MipChainFile& file = streamed.file;
+    if (!m_pFetcher || !file.IsChunk(streamed.loadingLevel) || FileSystem::GetSingleton().Exists(file.ChunkPath(streamed.loadingLevel))) {
+        scheduleRead(streamed);
+        return;
+    }
+
+    streamed.state = State::FETCHING;
+    StreamedTexture* pStreamed = &streamed;
+    const int priority = FETCH_PRIORITY + file.LevelCount() - 1 - streamed.loadingLevel;
+    m_pFetcher->Fetch(file.ChunkPath(streamed.loadingLevel), priority, [this, pStreamed](bool succeeded) {
+        if (!succeeded)
+            THROW_EXCEPTION("[texture streaming] Failed to download '" + pStreamed->file.ChunkPath(pStreamed->loadingLevel) + "'");
+        scheduleRead(*pStreamed);
+    });
+}
+
+void TextureStreamer::scheduleRead(StreamedTexture& streamed) {
+    streamed.state = State::READING;
+    StreamedTexture* pStreamed = &streamed;
+    const bool fetched = m_pFetcher != nullptr;
+    JobSystem::GetSingleton().Schedule("read mip level", [pStreamed, fetched] {
+        const MipChainFile& file = pStreamed->file;
+        pStreamed->loaded = file.ReadLevel(pStreamed->loadingLevel);
+        // the download is inflated, an evicted level is downloaded again
+        if (fetched && file.IsChunk(pStreamed->loadingLevel))
+            FileSystem::GetSingleton().Remove(file.ChunkPath(pStreamed->loadingLevel));
+    }, &streamed.read);
+}
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,90 @@
+#pragma once
+#include "GLHelpers.h"
+#include "GLPrerequisites.h"
+#include "AssetFetcher.h"
+#include "GLTextureUploader.h"
+#include "MipChain.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+namespace gl {
+
+// Keeps the mip levels of material textures resident that the view needs. Every texture streams from
+// a pre-mipped container, the levels up to MIP_TAIL_SIZE arrive with it and never leave. Finer levels
+// are read on a worker and uploaded one at a time, coarse to fine, and GL_TEXTURE_BASE_LEVEL keeps the
+// sampler on the levels that are complete. When the finer levels exceed the budget, the finest level
+// of the least recently drawn texture is dropped first, a texture drawn this frame only gives up
+// levels finer than it needs. The chunks of a split container are downloaded when their level is
+// needed, coarse ones first.
+class TextureStreamer {
+   public:
+    static constexpr int MIP_TAIL_SIZE = 128;
+    // of the coarsest chunk, AssetFetcher starts everything with a lower priority first
+    static constexpr int FETCH_PRIORITY = 8;
+
+    // budget in bytes of the levels above the tails, 0 keeps every level the view asks for,
+    // chunks are only downloaded with a fetcher
+    void Initialize(TextureUploader* pUploader, size_t budget, AssetFetcher* pFetcher = nullptr);
+    // the container must exist, see MipChainFile::Build, the tail is queued for upload right away
+    GLTexture Open(const string& path, GLenum internalFormat, ResourceCategory category, const char* name);
+    // the texture is drawn this frame, uvPerPixel is the UV extent of a pixel where it is closest to the camera
+    void Touch(GLuint texture, float uvPerPixel);
+    // retires finished levels and starts reading the next ones, called once per frame after Touch()
+    void Update();
+    // false while the tail of the texture is uploading
+    bool IsResident(GLuint texture) const;
+    // levels are being read or uploaded
+    bool IsStreaming() const { return m_streamingCount > 0; }
+    size_t ResidentSize() const { return m_residentSize; }
+    void Report(ostream& os) const;
+    // waits for the reads, the textures belong to the caller
+    void Finalize();
+
+   private:
+    enum class State {
+        TAIL,       // the mip tail is uploading
+        RESIDENT,   // every level from baseLevel on can be sampled
+        FETCHING,   // the chunk of loadingLevel is downloading
+        READING,    // loadingLevel is read on a worker
+        UPLOADING,  // loadingLevel is with the uploader
+    };
+
+    struct StreamedTexture {
+        GLTexture texture;
+        GLenum internalFormat;
+        ResourceCategory category;
+        string name;
+        MipChainFile file;
+        State state = State::TAIL;
+        int tailLevel = 0;     // coarsest level that is streamed
+        int baseLevel = 0;     // finest level that can be sampled
+        int wantedLevel = 0;   // finest level the view needs
+        int loadingLevel = -1;
+        uint64_t lastUsed = 0;  // frame of the last Touch()
+        Image loaded;
+        JobCounter read;
+    };
+
+    StreamedTexture* find(GLuint texture) const;
+    void setBaseLevel(StreamedTexture& streamed, int level);
+    // evicts levels until size more bytes fit the budget, pRequester is never evicted
+    bool makeRoom(size_t size, const StreamedTexture* pRequester);
+    void startRead(StreamedTexture& streamed);
+    void scheduleRead(StreamedTexture& streamed);
+
+   private:
+    TextureUploader* m_pUploader = nullptr;
+    AssetFetcher* m_pFetcher = nullptr;
+    size_t m_budget = 0;
+    size_t m_residentSize = 0;  // tails included
+    size_t m_streamedSize = 0;  // of the levels above the tails, the ones in flight included
+    uint64_t m_frame = 1;
+    int m_streamingCount = 0;
+    int m_levelsLoaded = 0;
+    int m_levelsEvicted = 0;
+    // JobCounter can't move, the records stay where they were created
+    vector<unique_ptr<StreamedTexture>> m_textures;
+};
+
+}  // namespace gl
+}  // namespace pbr
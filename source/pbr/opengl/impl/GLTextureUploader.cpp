@@ -0,0 +1,244 @@
+#include "GLTextureUploader.h"
+#include <algorithm>
+#include <cstring>
+#include "base/Error.h"
+
+namespace pbr {
+namespace gl {
+
+// ring offsets of glTexSubImage2D must be a multiple of the texel size, this covers every format
+static constexpr size_t SLICE_ALIGNMENT = 16;
+// no shader samples it, the bindings of the renderer stay as they are
+static constexpr GLenum UPLOAD_TEXTURE_UNIT = GL_TEXTURE8;
+// ns, a wait for a full ring is retried until the GPU caught up
+static constexpr GLuint64 WAIT_TIMEOUT = 100000000;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static size_t bytesPerTexel(const Image& image) {
+    switch (image.dataType) {
+        case DataType::FLOAT_16T:
+            return 2 * image.component;
+        case DataType::FLOAT_32T:
+            return 4 * image.component;
+        case DataType::RGB9E5:
+            return 4;
+        default:
+            return image.component;
+    }
+}
+
+void TextureUploader::Initialize(size_t ringSize, size_t frameBudget) {
+    m_ringSize = ringSize;
+    m_frameBudget = frameBudget;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+#if PBR_GL_VERSION >= 440
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, flags);
+    m_pMapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, flags));
+    if (!m_pMapped)
+        THROW_EXCEPTION("[texture upload] failed to map the staging ring");
+#else
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, GL_STREAM_DRAW);
+#endif
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    ResourceInfo info;
+    info.kind = ResourceKind::BUFFER;
+    info.category = ResourceCategory::STAGING;
+    info.name = "texture upload ring";
+    info.format = "pixel unpack";
+    info.sizeInByte = ringSize;
+    ResourceRegistry::GetSingleton().Register(m_buffer, info);
+}
+
+GLTexture TextureUploader::CreateTexture(Image&& image, GLenum internalFormat, ResourceCategory category, const char* name, bool mipmap) {
+    GLTexture texture = CreateTextureStorage(image, internalFormat, category, name, mipmap);
+    Request request;
+    request.texture = texture.handle;
+    request.generateMipmap = mipmap;
+    queue(std::move(request), std::move(image), name);
+    return texture;
+}
+
+void TextureUploader::UploadLevel(GLuint texture, int level, GLenum internalFormat, Image&& image) {
+    Request request;
+    request.texture = texture;
+    request.level = level;
+    request.generateMipmap = false;
+    GetTransferFormat(image, request.format, request.dataType);
+    glActiveTexture(UPLOAD_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, level, internalFormat, image.width, image.height, 0, request.format, request.dataType, nullptr);
+    queue(std::move(request), std::move(image), "a streamed level");
+}
+
+void TextureUploader::Update() {
+    retire(false);
+    size_t budget = m_frameBudget;
+    while (!m_requests.empty() && budget > 0) {
+        if (!uploadRows(m_requests.front(), budget))
+            break;
+        if (m_requests.front().image.buffer.pData == nullptr)
+            m_requests.pop_front();
+    }
+    fence();
+}
+
+void TextureUploader::Finish(GLuint texture) {
+    while (!m_requests.empty() && (texture == 0 || IsPending(texture))) {
+        // slices of the frame budget, the GPU copies one while the next is written
+        size_t budget = m_frameBudget;
+        if (!uploadRows(m_requests.front(), budget)) {
+            fence();
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+            // WebGL can't block on a fence, Update() uploads the rest over the next frames
+            break;
+#else
+            retire(true);
+            continue;
+#endif
+        }
+        if (m_requests.front().image.buffer.pData == nullptr)
+            m_requests.pop_front();
+    }
+    fence();
+}
+
+bool TextureUploader::IsPending(GLuint texture) const {
+    for (const Request& request : m_requests) {
+        if (request.texture == texture)
+            return true;
+    }
+    return false;
+}
+
+void TextureUploader::UploadRegion(GLuint texture, int x, int y, Image&& image) {
+    Request request;
+    request.texture = texture;
+    request.x = x;
+    request.y = y;
+    request.generateMipmap = false;
+    queue(std::move(request), std::move(image), "a region");
+}
+
+void TextureUploader::queue(Request&& request, Image&& image, const char* name) {
+    GetTransferFormat(image, request.format, request.dataType);
+    request.rowSize = static_cast<size_t>(image.width) * bytesPerTexel(image);
+    if (request.rowSize > m_ringSize)
+        THROW_EXCEPTION("[texture upload] a row of " + string(name) + " does not fit the staging ring");
+    m_pendingBytes += request.rowSize * image.height;
+    request.image = std::move(image);
+    m_requests.push_back(std::move(request));
+    ++m_queuedCount;
+}
+
+void TextureUploader::Finalize() {
+    m_requests.clear();
+    for (const Fence& fence : m_fences)
+        glDeleteSync(fence.sync);
+    m_fences.clear();
+    if (m_buffer) {
+#if PBR_GL_VERSION >= 440
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
+        DestroyBuffer(m_buffer);
+    }
+    m_pMapped = nullptr;
+    m_head = m_inFlight = m_unfenced = m_pendingBytes = 0;
+    m_queuedCount = m_completedCount = 0;
+}
+
+// copies as many rows as the budget and the free ring space allow, the last one frees the image
+bool TextureUploader::uploadRows(Request& request, size_t& budget) {
+    const Image& image = request.image;
+    const int remainingRows = image.height - request.nextRow;
+    const size_t maxBytes = std::min(budget, m_ringSize);
+    const int rows = std::max(1, std::min(remainingRows, static_cast<int>(maxBytes / request.rowSize)));
+    const size_t size = rows * request.rowSize;
+    size_t offset;
+    if (!allocate(size, offset))
+        return false;
+
+    const uint8_t* pSource = static_cast<const uint8_t*>(image.buffer.pData) + request.nextRow * request.rowSize;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    if (m_pMapped)
+        memcpy(m_pMapped + offset, pSource, size);
+    else
+        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, size, pSource);
+    // rows are tightly packed, e.g. RGB8 of an odd width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(UPLOAD_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, request.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, request.level, request.x, request.y + request.nextRow, image.width, rows, request.format, request.dataType,
+                    reinterpret_cast<const void*>(offset));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    request.nextRow += rows;
+    budget -= std::min(budget, size);
+    m_pendingBytes -= size;
+    if (request.nextRow == image.height) {
+        if (request.generateMipmap)
+            glGenerateMipmap(GL_TEXTURE_2D);
+        request.image.Free();
+        ++m_completedCount;
+    }
+    return true;
+}
+
+// the space in use is one contiguous run behind the head, a slice that doesn't fit before the end
+// of the ring skips to the start and the skipped bytes are freed along with it
+bool TextureUploader::allocate(size_t size, size_t& offset) {
+    if (m_inFlight == 0)
+        m_head = 0;
+    size_t start = alignUp(m_head, SLICE_ALIGNMENT);
+    if (start + size > m_ringSize)
+        start = 0;
+    const size_t skipped = (start >= m_head ? start - m_head : m_ringSize - m_head + start);
+    if (m_inFlight + skipped + size > m_ringSize)
+        return false;
+    offset = start;
+    m_head = start + size;
+    m_inFlight += skipped + size;
+    m_unfenced += skipped + size;
+    return true;
+}
+
+void TextureUploader::fence() {
+    if (m_unfenced == 0)
+        return;
+    m_fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_unfenced });
+    m_unfenced = 0;
+}
+
+void TextureUploader::retire(bool wait) {
+    while (!m_fences.empty()) {
+        const Fence& fence = m_fences.front();
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        // the largest timeout of WebGL is 0, Finish() never waits there
+        const GLenum status = glClientWaitSync(fence.sync, 0, 0);
+#else
+        GLenum status = glClientWaitSync(fence.sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence.sync, 0, WAIT_TIMEOUT);
+#endif
+        if (status == GL_WAIT_FAILED)
+            THROW_EXCEPTION("[texture upload] waiting for a fence failed");
+        if (status == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(fence.sync);
+        m_inFlight -= fence.size;
+        m_fences.pop_front();
+        // the fences behind it are signaled or close, only the oldest one is waited for
+        wait = false;
+    }
+}
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,84 @@
+#pragma once
+#include <deque>
+#include "GLHelpers.h"
+#include "GLPrerequisites.h"
+
+namespace pbr {
+namespace gl {
+
+// Streams texels into textures through a ring of pixel unpack buffer memory. Rows are copied into the
+// ring and glTexSubImage2D reads them from there, a fence per batch tells when the space can be reused,
+// so neither side waits for the other. A frame uploads up to a byte budget, bigger textures arrive over
+// several frames and get their mip chain once the last row is in, streamed levels bring their own. The
+// ring is mapped persistently where the context has buffer storage, elsewhere, e.g. WebGL, the rows are
+// written with glBufferSubData.
+class TextureUploader {
+   public:
+    void Initialize(size_t ringSize, size_t frameBudget);
+    // allocates the texture and queues the image, the uploader keeps the texels until they are copied,
+    // no mipmap for formats glGenerateMipmap can't render, e.g. GL_RGB9_E5
+    GLTexture CreateTexture(Image&& image, GLenum internalFormat, ResourceCategory category, const char* name, bool mipmap = true);
+    // defines one level of an existing texture and queues its texels, the other levels are left alone
+    void UploadLevel(GLuint texture, int level, GLenum internalFormat, Image&& image);
+    // queues texels for a rectangle of level 0 that starts at x, y
+    void UploadRegion(GLuint texture, int x, int y, Image&& image);
+    // requests complete in the order they were queued, the last one queued is complete once
+    // IsComplete() of the ticket taken after it returns true
+    uint64_t Ticket() const { return m_queuedCount; }
+    bool IsComplete(uint64_t ticket) const { return m_completedCount >= ticket; }
+    // uploads up to the frame budget, called once per frame
+    void Update();
+    // uploads everything queued up to and including the texture, 0 for all of it, waits for the GPU
+    // whenever the ring is full. WebGL can't wait, it stops there and IsPending() tells when Update()
+    // uploaded the rest
+    void Finish(GLuint texture = 0);
+    // true until the texture has all of its texels and mips
+    bool IsPending(GLuint texture) const;
+    size_t PendingBytes() const { return m_pendingBytes; }
+    void Finalize();
+
+   private:
+    struct Request {
+        GLuint texture;
+        Image image;
+        GLenum format;
+        GLenum dataType;
+        size_t rowSize;
+        int level = 0;
+        int x = 0;
+        int y = 0;
+        bool generateMipmap = true;  // after the last row, textures created in one piece only
+        int nextRow = 0;
+    };
+
+    // bytes of the ring the GPU may still read until the fence signals
+    struct Fence {
+        GLsync sync;
+        size_t size;
+    };
+
+    void queue(Request&& request, Image&& image, const char* name);
+    // false when the ring is full
+    bool uploadRows(Request& request, size_t& budget);
+    bool allocate(size_t size, size_t& offset);
+    void fence();
+    // frees the ring space of signaled fences, wait blocks until the oldest one signaled
+    void retire(bool wait);
+
+   private:
+    GLuint m_buffer = 0;
+    uint8_t* m_pMapped = nullptr;  // null without persistent mapping
+    size_t m_ringSize = 0;
+    size_t m_frameBudget = 0;
+    size_t m_head = 0;       // next write position
+    size_t m_inFlight = 0;   // bytes behind the head the GPU may still read
+    size_t m_unfenced = 0;   // of those, written since the last fence
+    size_t m_pendingBytes = 0;
+    uint64_t m_queuedCount = 0;
+    uint64_t m_completedCount = 0;
+    std::deque<Request> m_requests;
+    std::deque<Fence> m_fences;
+};
+
+}  // namespace gl
+}  // namespace pbr
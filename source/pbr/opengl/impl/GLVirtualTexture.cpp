@@ -0,0 +1,466 @@
+#include "GLVirtualTexture.h"
+#include <algorithm>
+#include <cstring>
+#include "base/Error.h"
+
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+// WebGL 2 getBufferSubData(), the GLES 3 headers don't declare it
+extern "C" void glGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void* pData);
+#endif
+
+namespace pbr {
+namespace gl {
+
+// the unit the uploader binds to, no shader samples it
+static constexpr GLenum VIRTUAL_TEXTURE_UNIT = GL_TEXTURE8;
+// page reads on the workers at once
+static constexpr int MAX_READS_IN_FLIGHT = 16;
+// pages handed to the uploader in one frame, the three maps of eight pages take 1.8 MB of its budget
+static constexpr int MAX_UPLOADS_PER_FRAME = 8;
+
+static const char* const LAYER_NAMES[VirtualTexture::LAYER_COUNT] = {
+    "albedo metallic atlas",
+    "normal roughness atlas",
+    "emissive ao atlas",
+};
+
+// RGBA8 texel of the page table: atlas slot x, y and the level of the page that is resident there
+static uint32_t packEntry(int slot, int level) {
+    const uint32_t x = slot % VirtualTexture::ATLAS_PAGES;
+    const uint32_t y = slot / VirtualTexture::ATLAS_PAGES;
+    return x | (y << 8) | (static_cast<uint32_t>(level) << 16) | 0xFF000000u;
+}
+
+void VirtualTexture::Initialize(TextureUploader* pUploader, const array<string, LAYER_COUNT>& pageFilePaths) {
+    m_pUploader = pUploader;
+    for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+        if (pageFilePaths[layer].empty())
+            continue;
+        m_files[layer].Open(pageFilePaths[layer]);
+        m_hasLayer[layer] = true;
+        if (!m_pLayout)
+            m_pLayout = &m_files[layer];
+        else if (m_files[layer].Width() != m_pLayout->Width() || m_files[layer].Height() != m_pLayout->Height())
+            THROW_EXCEPTION("[virtual texture] '" + pageFilePaths[layer] + "' differs in size from the other maps");
+    }
+    if (!m_pLayout)
+        return;
+
+    const int atlasSize = ATLAS_PAGES * PageFile::SLOT_SIZE;
+    glActiveTexture(VIRTUAL_TEXTURE_UNIT);
+    for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+        if (!m_hasLayer[layer])
+            continue;
+        GLTexture& atlas = m_atlases[layer];
+        atlas.type = GL_TEXTURE_2D;
+        glGenTextures(1, &atlas.handle);
+        glBindTexture(GL_TEXTURE_2D, atlas.handle);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        RegisterTexture(atlas, GL_RGBA8, ResourceCategory::MATERIAL, LAYER_NAMES[layer], atlasSize, atlasSize, 1, 1);
+    }
+
+    // a level of the table per paged level, sampled with the level a pixel needs
+    const int levelCount = m_pLayout->LevelCount();
+    m_pageTable.type = GL_TEXTURE_2D;
+    glGenTextures(1, &m_pageTable.handle);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable.handle);
+    m_tableLevels.resize(levelCount);
+    for (int level = 0; level < levelCount; ++level) {
+        m_tableLevels[level].assign(static_cast<size_t>(m_pLayout->PagesX(level)) * m_pLayout->PagesY(level), 0);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, m_pLayout->PagesX(level), m_pLayout->PagesY(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    RegisterTexture(m_pageTable, GL_RGBA8, ResourceCategory::LOOKUP_TABLE, "page table", m_pLayout->PagesX(0), m_pLayout->PagesY(0), 1, levelCount);
+
+    m_slots.resize(ATLAS_PAGES * ATLAS_PAGES);
+    m_cache.reset(new CachedPage[CPU_CACHE_PAGES]);
+    m_cacheMemory.resize(CPU_CACHE_PAGES * LAYER_COUNT * PageFile::PageBytes());
+    m_residentPages.reserve(m_slots.size());
+    m_cachedPages.reserve(CPU_CACHE_PAGES);
+
+    for (Readback& readback : m_readbacks)
+        glGenBuffers(1, &readback.buffer);
+
+    // the coarsest level is read here and never leaves
+    const int top = levelCount - 1;
+    for (int y = 0; y < m_pLayout->PagesY(top); ++y) {
+        for (int x = 0; x < m_pLayout->PagesX(top); ++x) {
+            int cacheIndex, slot;
+            if (!allocateCachedPage(cacheIndex) || !allocateSlot(slot))
+                THROW_EXCEPTION("[virtual texture] the coarsest level does not fit the atlas");
+            const uint32_t page = pageId(top, x, y);
+            for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+                if (m_hasLayer[layer])
+                    m_files[layer].ReadPage(top, x, y, cachedTexels(cacheIndex, layer));
+            }
+            CachedPage& cached = m_cache[cacheIndex];
+            cached.page = page;
+            cached.state = CacheState::READY;
+            m_cachedPages[page] = cacheIndex;
+            upload(page, cacheIndex, slot);
+            m_slots[slot].pinned = true;
+        }
+    }
+}
+
+void VirtualTexture::SetUniforms(GlslProgram& program) const {
+    if (!m_pLayout)
+        return;
+    program.setUniform("u_vt.pages", vec2(m_pLayout->PagesX(0), m_pLayout->PagesY(0)));
+    program.setUniform("u_vt.max_level", static_cast<float>(m_pLayout->LevelCount() - 1));
+    program.setUniform("u_vt.page_size", static_cast<float>(PageFile::PAGE_SIZE));
+    program.setUniform("u_vt.border", static_cast<float>(PageFile::BORDER));
+    program.setUniform("u_vt.atlas_size", static_cast<float>(ATLAS_PAGES * PageFile::SLOT_SIZE));
+}
+
+void VirtualTexture::ReadFeedback(int width, int height) {
+    const size_t size = static_cast<size_t>(width) * height * 4;
+    Readback& readback = m_readbacks[m_nextReadback];
+    // the GPU is still behind, the newer feedback replaces it
+    if (readback.fence)
+        glDeleteSync(readback.fence);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (size > readback.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        readback.capacity = size;
+        ResourceInfo info;
+        info.kind = ResourceKind::BUFFER;
+        info.category = ResourceCategory::STAGING;
+        info.name = "virtual texture feedback";
+        info.format = "pixel pack";
+        info.sizeInByte = size;
+        ResourceRegistry::GetSingleton().Register(readback.buffer, info);
+    }
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.width = width;
+    readback.height = height;
+    m_nextReadback = (m_nextReadback + 1) % static_cast<int>(m_readbacks.size());
+}
+
+void VirtualTexture::Update() {
+    if (!m_pLayout)
+        return;
+    pollReadbacks();
+
+    bool busy = false;
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+    for (int i = 0; i < CPU_CACHE_PAGES; ++i) {
+        CachedPage& cached = m_cache[i];
+        // a single thread reads when it waits
+        if (cached.state == CacheState::READING && (cached.read.IsDone() || jobSystem.ThreadCount() == 1)) {
+            // rethrows a failed read
+            jobSystem.Wait(cached.read);
+            cached.state = CacheState::READY;
+            --m_readingPages;
+            ++m_pagesRead;
+            busy = true;
+        }
+    }
+    for (AtlasSlot& slot : m_slots) {
+        if (slot.page != INVALID_PAGE && !slot.ready && m_pUploader->IsComplete(slot.ticket)) {
+            slot.ready = true;
+            m_tableDirty = true;
+            --m_uploadingPages;
+            busy = true;
+        }
+    }
+
+    busy = processRequests() || busy;
+    busy = busy || m_readingPages > 0 || m_uploadingPages > 0;
+    m_idleUpdates = busy ? 0 : m_idleUpdates + 1;
+
+    if (m_tableDirty)
+        updatePageTable();
+}
+
+bool VirtualTexture::IsReady() const {
+    for (const AtlasSlot& slot : m_slots) {
+        if (slot.pinned && !slot.ready)
+            return false;
+    }
+    return true;
+}
+
+// a feedback takes up to a frame per frame in flight to arrive
+bool VirtualTexture::IsStreaming() const {
+    return m_pLayout && m_idleUpdates <= static_cast<int>(m_readbacks.size());
+}
+
+void VirtualTexture::Report(ostream& os) const {
+    if (!m_pLayout)
+        return;
+    const size_t atlasSize = static_cast<size_t>(ATLAS_PAGES) * PageFile::SLOT_SIZE;
+    os << "[Log] virtual texturing: " << m_pagesRead << " pages read, " << m_pagesUploaded << " uploaded, "
+       << m_slotEvictions << " evicted from the atlas, " << (atlasSize * atlasSize * 4 >> 20) << " MB atlas per map" << endl;
+}
+
+void VirtualTexture::Finalize() {
+    if (m_cache) {
+        JobSystem& jobSystem = JobSystem::GetSingleton();
+        for (int i = 0; i < CPU_CACHE_PAGES; ++i)
+            jobSystem.Wait(m_cache[i].read);
+    }
+    for (Readback& readback : m_readbacks) {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        if (readback.capacity)
+            DestroyBuffer(readback.buffer);
+        else if (readback.buffer)
+            glDeleteBuffers(1, &readback.buffer);
+        readback.buffer = 0;
+        readback.capacity = 0;
+    }
+    for (GLTexture& atlas : m_atlases) {
+        if (atlas.handle)
+            DestroyTexture(atlas);
+    }
+    if (m_pageTable.handle)
+        DestroyTexture(m_pageTable);
+    m_slots.clear();
+    m_residentPages.clear();
+    m_cache.reset();
+    m_cacheMemory = vector<uint8_t>();
+    m_cachedPages.clear();
+    m_requests.clear();
+    m_tableLevels.clear();
+    m_pLayout = nullptr;
+}
+
+void VirtualTexture::request(uint32_t page) {
+    int x = pageX(page), y = pageY(page);
+    for (int level = pageLevel(page); level < m_pLayout->LevelCount(); ++level, x /= 2, y /= 2) {
+        const uint32_t id = pageId(level, x, y);
+        auto resident = m_residentPages.find(id);
+        if (resident != m_residentPages.end()) {
+            AtlasSlot& slot = m_slots[resident->second];
+            // already seen in this feedback, so were its ancestors
+            if (slot.lastUsed == m_feedbackCount)
+                return;
+            slot.lastUsed = m_feedbackCount;
+            if (slot.ready)
+                return;
+            continue;
+        }
+        auto cached = m_cachedPages.find(id);
+        if (cached != m_cachedPages.end()) {
+            if (m_cache[cached->second].lastUsed == m_feedbackCount)
+                return;
+            m_cache[cached->second].lastUsed = m_feedbackCount;
+        }
+        m_requests.push_back(id);
+    }
+}
+
+void VirtualTexture::parseFeedback(const uint8_t* pTexels, int width, int height) {
+    ++m_feedbackCount;
+    m_requests.clear();
+    uint32_t previous = INVALID_PAGE;
+    for (int i = 0; i < width * height; ++i, pTexels += 4) {
+        // blue holds the level plus one, 0 where no model was drawn
+        const int level = pTexels[2] - 1;
+        if (level < 0 || level >= m_pLayout->LevelCount() || pTexels[0] >= m_pLayout->PagesX(level) || pTexels[1] >= m_pLayout->PagesY(level))
+            continue;
+        // neighbouring pixels mostly need the same page
+        const uint32_t page = pageId(level, pTexels[0], pTexels[1]);
+        if (page == previous)
+            continue;
+        previous = page;
+        request(page);
+    }
+    // the level is in the top bits, in descending order the coarse pages come first
+    std::sort(m_requests.begin(), m_requests.end(), std::greater<uint32_t>());
+    m_requests.erase(std::unique(m_requests.begin(), m_requests.end()), m_requests.end());
+}
+
+void VirtualTexture::pollReadbacks() {
+    // the oldest first, the newest one that arrived is parsed last
+    for (size_t i = 0; i < m_readbacks.size(); ++i) {
+        Readback& readback = m_readbacks[(m_nextReadback + i) % m_readbacks.size()];
+        if (!readback.fence)
+            continue;
+        const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if (status == GL_WAIT_FAILED)
+            THROW_EXCEPTION("[virtual texture] waiting for a feedback fence failed");
+        if (status == GL_TIMEOUT_EXPIRED)
+            continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        const size_t size = static_cast<size_t>(readback.width) * readback.height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+#if TARGET_PLATFORM == PLATFORM_EMSCRIPTEN
+        // WebGL can't map a buffer, the signaled fence keeps the copy from stalling
+        m_feedbackTexels.resize(size);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, size, m_feedbackTexels.data());
+        parseFeedback(m_feedbackTexels.data(), readback.width, readback.height);
+#else
+        const void* pTexels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (pTexels) {
+            parseFeedback(static_cast<const uint8_t*>(pTexels), readback.width, readback.height);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+#endif
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+bool VirtualTexture::processRequests() {
+    int uploads = 0;
+    bool started = false;
+    for (uint32_t page : m_requests) {
+        if (m_residentPages.count(page))
+            continue;
+        auto cached = m_cachedPages.find(page);
+        if (cached != m_cachedPages.end()) {
+            if (m_cache[cached->second].state != CacheState::READY || uploads == MAX_UPLOADS_PER_FRAME)
+                continue;
+            int slot;
+            // every slot holds a page this view needs, the finer ones wait
+            if (!allocateSlot(slot))
+                break;
+            upload(page, cached->second, slot);
+            ++uploads;
+            started = true;
+            continue;
+        }
+        int cacheIndex;
+        if (m_readingPages == MAX_READS_IN_FLIGHT || !allocateCachedPage(cacheIndex))
+            continue;
+        startRead(page, cacheIndex);
+        started = true;
+    }
+    return started;
+}
+
+bool VirtualTexture::allocateSlot(int& slot) {
+    slot = -1;
+    for (int i = 0; i < static_cast<int>(m_slots.size()); ++i) {
+        const AtlasSlot& candidate = m_slots[i];
+        if (candidate.page == INVALID_PAGE) {
+            slot = i;
+            break;
+        }
+        if (candidate.pinned || !candidate.ready || candidate.lastUsed == m_feedbackCount)
+            continue;
+        if (slot < 0 || candidate.lastUsed < m_slots[slot].lastUsed)
+            slot = i;
+    }
+    if (slot < 0)
+        return false;
+
+    AtlasSlot& victim = m_slots[slot];
+    if (victim.page != INVALID_PAGE) {
+        m_residentPages.erase(victim.page);
+        m_tableDirty = true;
+        ++m_slotEvictions;
+    }
+    victim = AtlasSlot();
+    return true;
+}
+
+// pages that are read or that the last feedback asked for and aren't in the atlas yet stay
+bool VirtualTexture::allocateCachedPage(int& index) {
+    index = -1;
+    for (int i = 0; i < CPU_CACHE_PAGES; ++i) {
+        const CachedPage& candidate = m_cache[i];
+        if (candidate.state == CacheState::EMPTY) {
+            index = i;
+            break;
+        }
+        if (candidate.state == CacheState::READING)
+            continue;
+        if (candidate.lastUsed == m_feedbackCount && !m_residentPages.count(candidate.page))
+            continue;
+        if (index < 0 || candidate.lastUsed < m_cache[index].lastUsed)
+            index = i;
+    }
+    if (index < 0)
+        return false;
+
+    CachedPage& cached = m_cache[index];
+    if (cached.page != INVALID_PAGE)
+        m_cachedPages.erase(cached.page);
+    cached.page = INVALID_PAGE;
+    cached.state = CacheState::EMPTY;
+    return true;
+}
+
+void VirtualTexture::startRead(uint32_t page, int cacheIndex) {
+    CachedPage& cached = m_cache[cacheIndex];
+    cached.page = page;
+    cached.state = CacheState::READING;
+    cached.lastUsed = m_feedbackCount;
+    m_cachedPages[page] = cacheIndex;
+    ++m_readingPages;
+    JobSystem::GetSingleton().Schedule("read virtual page", [this, page, cacheIndex] {
+        for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+            if (m_hasLayer[layer])
+                m_files[layer].ReadPage(pageLevel(page), pageX(page), pageY(page), cachedTexels(cacheIndex, layer));
+        }
+    }, &cached.read);
+}
+
+// the uploader copies from its own image, the cache entry can be reused right away
+void VirtualTexture::upload(uint32_t page, int cacheIndex, int slot) {
+    AtlasSlot& target = m_slots[slot];
+    target.page = page;
+    target.lastUsed = m_feedbackCount;
+    target.ready = false;
+    m_residentPages[page] = slot;
+    const int x = slot % ATLAS_PAGES * PageFile::SLOT_SIZE;
+    const int y = slot / ATLAS_PAGES * PageFile::SLOT_SIZE;
+    for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+        if (!m_hasLayer[layer])
+            continue;
+        Image image;
+        image.width = image.height = PageFile::SLOT_SIZE;
+        image.component = 4;
+        image.dataType = DataType::UINT_8T;
+        image.Allocate(PageFile::PageBytes());
+        memcpy(image.buffer.pData, cachedTexels(cacheIndex, layer), PageFile::PageBytes());
+        m_pUploader->UploadRegion(m_atlases[layer].handle, x, y, std::move(image));
+    }
+    target.ticket = m_pUploader->Ticket();
+    ++m_uploadingPages;
+    ++m_pagesUploaded;
+}
+
+// coarse to fine, a page without a resident copy points where its parent does
+void VirtualTexture::updatePageTable() {
+    m_tableDirty = false;
+    const int levelCount = m_pLayout->LevelCount();
+    glActiveTexture(VIRTUAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable.handle);
+    for (int level = levelCount - 1; level >= 0; --level) {
+        const int pagesX = m_pLayout->PagesX(level);
+        const int pagesY = m_pLayout->PagesY(level);
+        vector<uint32_t>& entries = m_tableLevels[level];
+        for (int y = 0; y < pagesY; ++y) {
+            for (int x = 0; x < pagesX; ++x) {
+                auto resident = m_residentPages.find(pageId(level, x, y));
+                uint32_t& entry = entries[y * pagesX + x];
+                if (resident != m_residentPages.end() && m_slots[resident->second].ready)
+                    entry = packEntry(resident->second, level);
+                else if (level + 1 < levelCount)
+                    entry = m_tableLevels[level + 1][(y / 2) * m_pLayout->PagesX(level + 1) + x / 2];
+                else
+                    entry = 0;
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, pagesX, pagesY, GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+    }
+}
+
+}  // namespace gl
+}  // namespace pbr
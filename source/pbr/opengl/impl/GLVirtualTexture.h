@@ -0,0 +1,137 @@
+#pragma once
+#include <unordered_map>
+#include "GLFramePacer.h"
+#include "GLHelpers.h"
+#include "GLPrerequisites.h"
+#include "GLTextureUploader.h"
+#include "PageFile.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+namespace gl {
+
+// Virtual texturing of the material maps. The maps share one page table, a virtual page is
+// resident in the same slot of a fixed size atlas per map, so GPU memory does not depend on the
+// size of the maps. A low resolution feedback pass writes the page every pixel needs, its
+// readback arrives a few frames later and requests the missing pages coarse to fine. Pages are
+// read from the page files on the workers into a CPU cache, uploaded into the least recently used
+// atlas slot, and the page table maps every virtual page to its finest resident ancestor. The
+// coarsest level stays resident, a page is never missing.
+class VirtualTexture {
+   public:
+    enum Layer {
+        ALBEDO_METALLIC,
+        NORMAL_ROUGHNESS,
+        EMISSIVE_AO,
+        LAYER_COUNT,
+    };
+
+    static constexpr int ATLAS_PAGES = 16;  // per side
+    static constexpr int CPU_CACHE_PAGES = 256;
+    // the feedback target is this many times smaller than the render target on each side
+    static constexpr int FEEDBACK_SCALE = 8;
+
+    // an empty path leaves the layer out, every page file must have the same size.
+    // the coarsest level is queued for upload right away
+    void Initialize(TextureUploader* pUploader, const array<string, LAYER_COUNT>& pageFilePaths);
+    GLuint Atlas(Layer layer) const { return m_atlases[layer].handle; }
+    GLuint PageTable() const { return m_pageTable.handle; }
+    // the layout uniforms of pbr_model.frag and vt_feedback.frag
+    void SetUniforms(GlslProgram& program) const;
+    // copies the feedback target that is bound to the framebuffer
+    void ReadFeedback(int width, int height);
+    // parses the feedback that arrived, finishes reads and uploads and starts new ones, refreshes
+    // the page table, called once per frame before drawing
+    void Update();
+    // the next feedback may ask for other pages, IsStreaming() stays true until it was parsed
+    void ViewChanged() { m_idleUpdates = 0; }
+    // false until the coarsest level arrived
+    bool IsReady() const;
+    bool IsStreaming() const;
+    void Report(ostream& os) const;
+    void Finalize();
+
+   private:
+    enum class CacheState {
+        EMPTY,
+        READING,
+        READY,
+    };
+
+    struct CachedPage {
+        uint32_t page = INVALID_PAGE;
+        CacheState state = CacheState::EMPTY;
+        uint64_t lastUsed = 0;
+        JobCounter read;
+    };
+
+    struct AtlasSlot {
+        uint32_t page = INVALID_PAGE;
+        uint64_t lastUsed = 0;
+        uint64_t ticket = 0;  // of the upload
+        bool ready = false;
+        bool pinned = false;  // coarsest level
+    };
+
+    struct Readback {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    static constexpr uint32_t INVALID_PAGE = ~0u;
+
+    static uint32_t pageId(int level, int x, int y) { return (static_cast<uint32_t>(level) << 28) | (y << 14) | x; }
+    static int pageLevel(uint32_t page) { return page >> 28; }
+    static int pageX(uint32_t page) { return page & 0x3FFF; }
+    static int pageY(uint32_t page) { return (page >> 14) & 0x3FFF; }
+
+    // adds the page and its ancestors that aren't resident to the requests
+    void request(uint32_t page);
+    void parseFeedback(const uint8_t* pTexels, int width, int height);
+    void pollReadbacks();
+    // starts the reads and uploads the requests are waiting for, returns false when there were none
+    bool processRequests();
+    // false when every slot holds a page the last feedback needed
+    bool allocateSlot(int& slot);
+    bool allocateCachedPage(int& index);
+    void startRead(uint32_t page, int cacheIndex);
+    void upload(uint32_t page, int cacheIndex, int slot);
+    void updatePageTable();
+    uint8_t* cachedTexels(int index, int layer) { return m_cacheMemory.data() + (static_cast<size_t>(index) * LAYER_COUNT + layer) * PageFile::PageBytes(); }
+
+   private:
+    TextureUploader* m_pUploader = nullptr;
+    array<PageFile, LAYER_COUNT> m_files;
+    array<bool, LAYER_COUNT> m_hasLayer = {};
+    array<GLTexture, LAYER_COUNT> m_atlases;
+    GLTexture m_pageTable;
+    const PageFile* m_pLayout = nullptr;  // the first layer, all of them have its size
+
+    uint64_t m_feedbackCount = 1;  // parsed so far, pages and slots are stamped with it
+    vector<AtlasSlot> m_slots;
+    std::unordered_map<uint32_t, int> m_residentPages;  // page to atlas slot, uploading ones included
+    unique_ptr<CachedPage[]> m_cache;
+    vector<uint8_t> m_cacheMemory;
+    std::unordered_map<uint32_t, int> m_cachedPages;  // page to cache index
+    vector<uint32_t> m_requests;                      // of the last feedback, coarse to fine
+    vector<vector<uint32_t>> m_tableLevels;           // CPU copy of the page table
+    bool m_tableDirty = false;
+
+    // a feedback has arrived once its own fence signals, one per frame in flight
+    array<Readback, FramePacer::FRAMES_IN_FLIGHT> m_readbacks;
+    int m_nextReadback = 0;
+    vector<uint8_t> m_feedbackTexels;  // WebGL copies the feedback out of the buffer
+    int m_readingPages = 0;
+    int m_uploadingPages = 0;
+    int m_idleUpdates = 0;  // in a row without a read or upload in flight or started
+
+    int m_pagesRead = 0;
+    int m_pagesUploaded = 0;
+    int m_slotEvictions = 0;
+};
+
+}  // namespace gl
+}  // namespace pbr
@@ -0,0 +1,41 @@
+#include "SwRenderer.h"
+#include "impl/SwRendererImpl.h"
+
+namespace pbr {
+namespace sw {
+
+SwRenderer::SwRenderer(const Window* pWindow)
+    : Renderer(pWindow)
+    , impl(std::make_unique<SwRendererImpl>(pWindow)) {
+}
+
+void SwRenderer::Initialize() {
+    impl->Initialize();
+}
+
+void SwRenderer::DumpGraphicsCardInfo() {
+    impl->DumpGraphicsCardInfo();
+}
+
+void SwRenderer::Render(const Camera& camera) {
+    impl->Render(camera);
+}
+
+void SwRenderer::Resize(const Extent2i& extent) {
+    impl->Resize(extent);
+}
+
+bool SwRenderer::IsRefining() const {
+    return impl->IsRefining();
+}
+
+void SwRenderer::Finalize() {
+    impl->Finalize();
+}
+
+void SwRenderer::PrepareGpuResources() {
+    impl->PrepareGpuResources();
+}
+
+}  // namespace sw
+}  // namespace pbr
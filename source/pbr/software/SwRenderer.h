@@ -0,0 +1,26 @@
+#pragma once
+#include "base/Prerequisites.h"
+#include "core/Renderer.h"
+
+namespace pbr {
+namespace sw {
+
+class SwRendererImpl;
+
+class SwRenderer : public Renderer {
+   public:
+    SwRenderer(const Window* pWindow);
+    virtual void Initialize() override;
+    virtual void DumpGraphicsCardInfo() override;
+    virtual void PrepareGpuResources() override;
+    virtual void Render(const Camera& camera) override;
+    virtual void Resize(const Extent2i& extent) override;
+    virtual bool IsRefining() const override;
+    virtual void Finalize() override;
+
+   private:
+    unique_ptr<SwRendererImpl> impl;
+};
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,389 @@
+#include "SwBvh.h"
+#include <algorithm>
+#include <cmath>
+#include "SwSimd.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace sw {
+
+// SAH costs relative to one ray/triangle test
+static constexpr float traversalCost = 1.0f;
+static constexpr int stackSize = 256;
+
+float Bvh::Box::HalfArea() const {
+    const vec3 d = max - min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void Bvh::Build(const vector<vec3>& positions, const vector<uvec3>& indices) {
+    m_nodes.clear();
+    m_leaves.clear();
+    if (indices.empty())
+        return;
+
+    m_pPositions = &positions;
+    m_pIndices = &indices;
+    const size_t count = indices.size();
+    m_boxes.resize(count);
+    m_centroids.resize(count);
+    m_order.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        Box box;
+        box.Expand(positions[indices[i].x]);
+        box.Expand(positions[indices[i].y]);
+        box.Expand(positions[indices[i].z]);
+        m_boxes[i] = box;
+        m_centroids[i] = 0.5f * (box.min + box.max);
+        m_order[i] = static_cast<uint32_t>(i);
+    }
+
+    m_buildNodes.reserve(2 * count / WIDTH + 1);
+    buildRecursive(0, static_cast<int>(count));
+    m_nodes.reserve(m_buildNodes.size() / 2 + 1);
+    m_leaves.reserve(m_buildNodes.size() / 2 + 1);
+    int depth = 0;
+    collapse(0, 1, depth);
+    if (depth * (WIDTH - 1) + 1 > stackSize)
+        THROW_EXCEPTION("bvh: tree of depth " + std::to_string(depth) + " overflows the traversal stack");
+
+    vector<BuildNode>().swap(m_buildNodes);
+    vector<Box>().swap(m_boxes);
+    vector<vec3>().swap(m_centroids);
+    vector<uint32_t>().swap(m_order);
+    m_pPositions = nullptr;
+    m_pIndices = nullptr;
+}
+
+int Bvh::buildRecursive(int first, int count) {
+    const int index = static_cast<int>(m_buildNodes.size());
+    m_buildNodes.emplace_back();
+
+    Box bounds, centroidBounds;
+    for (int i = first; i < first + count; ++i) {
+        bounds.Expand(m_boxes[m_order[i]]);
+        centroidBounds.Expand(m_centroids[m_order[i]]);
+    }
+    m_buildNodes[index].bounds = bounds;
+
+    // binned SAH over all three axes, a split puts bins [0, bestBin] to the left
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestBin = -1;
+    for (int axis = 0; axis < 3 && count > 1; ++axis) {
+        const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        const float scale = BIN_COUNT / extent;
+        Box binBoxes[BIN_COUNT];
+        int binCounts[BIN_COUNT] = {};
+        for (int i = first; i < first + count; ++i) {
+            const uint32_t triangle = m_order[i];
+            const int bin = std::min(static_cast<int>((m_centroids[triangle][axis] - centroidBounds.min[axis]) * scale), BIN_COUNT - 1);
+            binBoxes[bin].Expand(m_boxes[triangle]);
+            ++binCounts[bin];
+        }
+
+        float rightAreas[BIN_COUNT];
+        int rightCounts[BIN_COUNT];
+        Box accumulated;
+        int accumulatedCount = 0;
+        for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+            accumulated.Expand(binBoxes[bin]);
+            accumulatedCount += binCounts[bin];
+            rightAreas[bin] = accumulatedCount ? accumulated.HalfArea() : 0.0f;
+            rightCounts[bin] = accumulatedCount;
+        }
+
+        accumulated = Box();
+        accumulatedCount = 0;
+        for (int bin = 0; bin < BIN_COUNT - 1; ++bin) {
+            accumulated.Expand(binBoxes[bin]);
+            accumulatedCount += binCounts[bin];
+            if (accumulatedCount == 0 || rightCounts[bin + 1] == 0)
+                continue;
+            const float cost = accumulatedCount * accumulated.HalfArea() + rightCounts[bin + 1] * rightAreas[bin + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    const float area = bounds.HalfArea();
+    const bool splitPays = bestAxis >= 0 && traversalCost * area + bestCost < count * area;
+    if (count <= WIDTH && !splitPays) {
+        m_buildNodes[index].first = first;
+        m_buildNodes[index].count = count;
+        return index;
+    }
+
+    int middle = first + count / 2;
+    if (bestAxis >= 0) {
+        const float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+        const float minimum = centroidBounds.min[bestAxis];
+        auto it = std::partition(m_order.begin() + first, m_order.begin() + first + count, [&](uint32_t triangle) {
+            return std::min(static_cast<int>((m_centroids[triangle][bestAxis] - minimum) * scale), BIN_COUNT - 1) <= bestBin;
+        });
+        middle = static_cast<int>(it - m_order.begin());
+    }
+    // coincident centroids, split the range in half
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    const int left = buildRecursive(first, middle - first);
+    const int right = buildRecursive(middle, first + count - middle);
+    m_buildNodes[index].left = left;
+    m_buildNodes[index].right = right;
+    return index;
+}
+
+int32_t Bvh::collapse(int buildNode, int depth, int& maxDepth) {
+    maxDepth = std::max(maxDepth, depth);
+
+    // pull grandchildren up, always opening the largest inner child
+    int children[WIDTH] = { buildNode };
+    int count = 1;
+    if (m_buildNodes[buildNode].count == 0) {
+        children[0] = m_buildNodes[buildNode].left;
+        children[1] = m_buildNodes[buildNode].right;
+        count = 2;
+        while (count < WIDTH) {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < count; ++i) {
+                const BuildNode& child = m_buildNodes[children[i]];
+                if (child.count == 0 && child.bounds.HalfArea() > bestArea) {
+                    best = i;
+                    bestArea = child.bounds.HalfArea();
+                }
+            }
+            if (best < 0)
+                break;
+            const BuildNode& opened = m_buildNodes[children[best]];
+            children[best] = opened.left;
+            children[count++] = opened.right;
+        }
+    }
+
+    const int32_t index = static_cast<int32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    int32_t links[WIDTH];
+    for (int i = 0; i < count; ++i) {
+        const BuildNode& child = m_buildNodes[children[i]];
+        links[i] = child.count ? createLeaf(child) : collapse(children[i], depth + 1, maxDepth);
+    }
+
+    Node& node = m_nodes[index];
+    for (int i = 0; i < WIDTH; ++i) {
+        const Box& box = m_buildNodes[children[std::min(i, count - 1)]].bounds;
+        for (int axis = 0; axis < 3; ++axis) {
+            node.bounds[axis][i] = box.min[axis];
+            node.bounds[axis + 3][i] = box.max[axis];
+        }
+        node.child[i] = i < count ? links[i] : 0;
+    }
+    node.childCount = count;
+    return index;
+}
+
+int32_t Bvh::createLeaf(const BuildNode& node) {
+    const int32_t index = static_cast<int32_t>(m_leaves.size());
+    Leaf& leaf = m_leaves.emplace_back();
+    for (int i = 0; i < WIDTH; ++i) {
+        vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+        uint32_t triangle = 0xFFFFFFFF;
+        if (i < node.count) {
+            triangle = m_order[node.first + i];
+            const uvec3& face = (*m_pIndices)[triangle];
+            v0 = (*m_pPositions)[face.x];
+            e1 = (*m_pPositions)[face.y] - v0;
+            e2 = (*m_pPositions)[face.z] - v0;
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            leaf.v0[axis][i] = v0[axis];
+            leaf.e1[axis][i] = e1[axis];
+            leaf.e2[axis][i] = e2[axis];
+        }
+        leaf.triangle[i] = triangle;
+    }
+    return ~index;
+}
+
+// slab test of the four child boxes, returns the mask of hit children and their entry distances
+static inline int intersectBoxes(const float (&bounds)[6][Bvh::WIDTH], int childCount, const vec3& origin, const vec3& invDir, float tMin, float tMax, float* tNear) {
+#if PBR_SW_SSE
+    const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    const __m128 ix = _mm_set1_ps(invDir.x), iy = _mm_set1_ps(invDir.y), iz = _mm_set1_ps(invDir.z);
+    const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[0]), ox), ix);
+    const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[1]), oy), iy);
+    const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[2]), oz), iz);
+    const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[3]), ox), ix);
+    const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[4]), oy), iy);
+    const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[5]), oz), iz);
+    const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(tMin)));
+    __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_max_ps(t0z, t1z));
+    // widen the exit by the rounding error of the slab distances so grazing rays are not lost
+    exit = _mm_min_ps(_mm_mul_ps(exit, _mm_set1_ps(1.0000004f)), _mm_set1_ps(tMax));
+    _mm_storeu_ps(tNear, enter);
+    return _mm_movemask_ps(_mm_cmple_ps(enter, exit)) & ((1 << childCount) - 1);
+#else
+    int mask = 0;
+    for (int i = 0; i < childCount; ++i) {
+        float enter = tMin;
+        float exit = FLT_MAX;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float t0 = (bounds[axis][i] - origin[axis]) * invDir[axis];
+            const float t1 = (bounds[axis + 3][i] - origin[axis]) * invDir[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        exit = std::min(exit * 1.0000004f, tMax);
+        tNear[i] = enter;
+        if (enter <= exit)
+            mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Moller-Trumbore against the four triangles of a leaf, returns the mask of hits in (tMin, tMax)
+static inline int intersectTriangles(const float (&v0)[3][Bvh::WIDTH], const float (&e1)[3][Bvh::WIDTH], const float (&e2)[3][Bvh::WIDTH], const Ray& ray, float tMax, float* t, float* b1, float* b2) {
+#if PBR_SW_SSE
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 e1x = _mm_load_ps(e1[0]), e1y = _mm_load_ps(e1[1]), e1z = _mm_load_ps(e1[2]);
+    const __m128 e2x = _mm_load_ps(e2[0]), e2y = _mm_load_ps(e2[1]), e2z = _mm_load_ps(e2[2]);
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    const __m128 tx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(v0[0]));
+    const __m128 ty = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(v0[1]));
+    const __m128 tz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(v0[2]));
+    const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    const __m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    // unused lanes have a zero determinant, their NaN barycentrics fail the comparisons as well
+    const __m128 zero = _mm_setzero_ps();
+    __m128 valid = _mm_cmpneq_ps(det, zero);
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(distance, _mm_set1_ps(ray.tMin)));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(distance, _mm_set1_ps(tMax)));
+    _mm_storeu_ps(t, distance);
+    _mm_storeu_ps(b1, u);
+    _mm_storeu_ps(b2, v);
+    return _mm_movemask_ps(valid);
+#else
+    int mask = 0;
+    for (int i = 0; i < Bvh::WIDTH; ++i) {
+        const vec3 edge1(e1[0][i], e1[1][i], e1[2][i]);
+        const vec3 edge2(e2[0][i], e2[1][i], e2[2][i]);
+        const vec3 p = glm::cross(ray.direction, edge2);
+        const float det = glm::dot(edge1, p);
+        if (det == 0.0f)
+            continue;
+        const float invDet = 1.0f / det;
+        const vec3 s = ray.origin - vec3(v0[0][i], v0[1][i], v0[2][i]);
+        const float u = glm::dot(s, p) * invDet;
+        const vec3 q = glm::cross(s, edge1);
+        const float v = glm::dot(ray.direction, q) * invDet;
+        const float distance = glm::dot(edge2, q) * invDet;
+        t[i] = distance;
+        b1[i] = u;
+        b2[i] = v;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > ray.tMin && distance < tMax)
+            mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+template <bool ANY_HIT>
+bool Bvh::traverse(const Ray& ray, Hit& hit) const {
+    if (m_nodes.empty())
+        return false;
+
+    // axis parallel rays get a huge but finite slope, 0 * inf would be NaN
+    vec3 invDir;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float d = ray.direction[axis];
+        invDir[axis] = 1.0f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+    }
+
+    struct Entry {
+        int32_t link;
+        float tNear;
+    };
+    Entry stack[stackSize];
+    int size = 0;
+    stack[size++] = { 0, ray.tMin };
+    float tMax = ray.tMax;
+    bool found = false;
+
+    while (size > 0) {
+        const Entry entry = stack[--size];
+        if (entry.tNear > tMax)
+            continue;
+
+        if (entry.link >= 0) {
+            const Node& node = m_nodes[entry.link];
+            float tNear[WIDTH];
+            const int mask = intersectBoxes(node.bounds, node.childCount, ray.origin, invDir, ray.tMin, tMax, tNear);
+
+            // push the farthest child first so the nearest one is visited next
+            int order[WIDTH];
+            int count = 0;
+            for (int child = 0; child < WIDTH; ++child) {
+                if (!(mask & (1 << child)))
+                    continue;
+                int i = count++;
+                for (; i > 0 && tNear[order[i - 1]] < tNear[child]; --i)
+                    order[i] = order[i - 1];
+                order[i] = child;
+            }
+            for (int i = 0; i < count; ++i)
+                stack[size++] = { node.child[order[i]], tNear[order[i]] };
+            continue;
+        }
+
+        const Leaf& leaf = m_leaves[~entry.link];
+        float t[WIDTH], b1[WIDTH], b2[WIDTH];
+        const int mask = intersectTriangles(leaf.v0, leaf.e1, leaf.e2, ray, tMax, t, b1, b2);
+        if (!mask)
+            continue;
+        if (ANY_HIT)
+            return true;
+        for (int i = 0; i < WIDTH; ++i) {
+            if ((mask & (1 << i)) && t[i] < tMax) {
+                tMax = t[i];
+                hit.t = t[i];
+                hit.b1 = b1[i];
+                hit.b2 = b2[i];
+                hit.triangle = leaf.triangle[i];
+            }
+        }
+        found = true;
+    }
+    return found;
+}
+
+bool Bvh::Intersect(const Ray& ray, Hit& hit) const {
+    return traverse<false>(ray, hit);
+}
+
+bool Bvh::Occluded(const Ray& ray) const {
+    Hit hit;
+    return traverse<true>(ray, hit);
+}
+
+}  // namespace sw
+}  // namespace pbr
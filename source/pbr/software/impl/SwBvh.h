@@ -0,0 +1,102 @@
+#pragma once
+#include <cfloat>
+#include "base/Prerequisites.h"
+
+namespace pbr {
+namespace sw {
+
+struct Ray {
+    vec3 origin;
+    vec3 direction;
+    float tMin = 0.0f;
+    float tMax = FLT_MAX;
+};
+
+struct Hit {
+    float t = FLT_MAX;
+    // barycentric weights of the second and third vertex
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    uint32_t triangle = 0xFFFFFFFF;
+};
+
+// Four-wide bounding volume hierarchy over a triangle list. A binned SAH build produces a binary
+// tree with leaves of at most four triangles, which is collapsed into nodes of four children whose
+// boxes are tested against a ray at once. Leaf triangles are stored in the same SoA layout so a
+// leaf is a single four-wide ray/triangle test. Triangles are two sided.
+class Bvh {
+   public:
+    static constexpr int WIDTH = 4;
+    static constexpr int BIN_COUNT = 16;
+
+    void Build(const vector<vec3>& positions, const vector<uvec3>& indices);
+    // closest hit in (ray.tMin, ray.tMax)
+    bool Intersect(const Ray& ray, Hit& hit) const;
+    // any hit in (ray.tMin, ray.tMax)
+    bool Occluded(const Ray& ray) const;
+
+    inline size_t NodeCount() const { return m_nodes.size(); }
+    inline size_t LeafCount() const { return m_leaves.size(); }
+    inline size_t SizeInByte() const { return m_nodes.size() * sizeof(Node) + m_leaves.size() * sizeof(Leaf); }
+
+   private:
+    struct alignas(16) Node {
+        float bounds[6][WIDTH];  // min x, y, z and max x, y, z of every child
+        int32_t child[WIDTH];    // index of a node, or ~index of a leaf
+        int32_t childCount;
+    };
+
+    struct alignas(16) Leaf {
+        float v0[3][WIDTH];
+        float e1[3][WIDTH];
+        float e2[3][WIDTH];
+        uint32_t triangle[WIDTH];  // unused lanes have zero edges and never hit
+    };
+
+    struct Box {
+        vec3 min = vec3(FLT_MAX);
+        vec3 max = vec3(-FLT_MAX);
+
+        inline void Expand(const vec3& p) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        inline void Expand(const Box& box) {
+            min = glm::min(min, box.min);
+            max = glm::max(max, box.max);
+        }
+        float HalfArea() const;
+    };
+
+    // binary tree of the build, a leaf has a count
+    struct BuildNode {
+        Box bounds;
+        int left = -1;
+        int right = -1;
+        int first = 0;
+        int count = 0;
+    };
+
+    int buildRecursive(int first, int count);
+    // depth counts the four-wide levels, the traversal stack must hold three entries per level
+    int32_t collapse(int buildNode, int depth, int& maxDepth);
+    int32_t createLeaf(const BuildNode& node);
+
+    template <bool ANY_HIT>
+    bool traverse(const Ray& ray, Hit& hit) const;
+
+   private:
+    vector<Node> m_nodes;
+    vector<Leaf> m_leaves;
+
+    // build state, released once the tree is collapsed
+    vector<BuildNode> m_buildNodes;
+    vector<Box> m_boxes;
+    vector<vec3> m_centroids;
+    vector<uint32_t> m_order;
+    const vector<vec3>* m_pPositions = nullptr;
+    const vector<uvec3>* m_pIndices = nullptr;
+};
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,101 @@
+#include "SwEnvironment.h"
+#include <algorithm>
+#include <cmath>
+#include "base/Error.h"
+
+namespace pbr {
+namespace sw {
+
+// u = phi / 2pi + 0.5 and v = theta / pi with theta measured from +Y, to_cubemap.frag flips v
+static inline vec3 directionFromUv(float u, float v, float& sinTheta) {
+    const float phi = (u - 0.5f) * 2.0f * Pi;
+    const float theta = v * Pi;
+    sinTheta = std::sin(theta);
+    return vec3(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi));
+}
+
+static inline vec2 uvFromDirection(const vec3& d) {
+    return vec2(std::atan2(d.z, d.x) / (2.0f * Pi) + 0.5f, std::acos(glm::clamp(d.y, -1.0f, 1.0f)) / Pi);
+}
+
+void EnvironmentLight::Create(const Image& image) {
+    if (image.dataType != DataType::FLOAT_32T || image.component < 3)
+        THROW_EXCEPTION("software: environment map expects a float RGB image");
+
+    m_width = image.width;
+    m_height = image.height;
+    const float* texels = reinterpret_cast<const float*>(image.buffer.pData);
+    m_texels.resize(static_cast<size_t>(m_width) * m_height);
+    for (size_t i = 0; i < m_texels.size(); ++i)
+        m_texels[i] = vec3(texels[i * image.component], texels[i * image.component + 1], texels[i * image.component + 2]);
+
+    // rows near the poles cover less solid angle
+    m_rowCdf.assign(m_height + 1, 0.0f);
+    m_columnCdfs.assign(static_cast<size_t>(m_width + 1) * m_height, 0.0f);
+    m_pdfs.assign(m_texels.size(), 0.0f);
+    for (int y = 0; y < m_height; ++y) {
+        const float sinTheta = std::sin((y + 0.5f) * Pi / m_height);
+        float* cdf = m_columnCdfs.data() + static_cast<size_t>(y) * (m_width + 1);
+        for (int x = 0; x < m_width; ++x) {
+            const vec3& c = m_texels[static_cast<size_t>(y) * m_width + x];
+            const float weight = (0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z) * sinTheta;
+            m_pdfs[static_cast<size_t>(y) * m_width + x] = weight;
+            cdf[x + 1] = cdf[x] + weight;
+        }
+        m_rowCdf[y + 1] = m_rowCdf[y] + cdf[m_width];
+    }
+
+    const float total = m_rowCdf[m_height];
+    if (total <= 0.0f)
+        THROW_EXCEPTION("software: environment map is black");
+    const float density = static_cast<float>(m_width) * m_height / total;
+    for (float& pdf : m_pdfs)
+        pdf *= density;
+}
+
+vec3 EnvironmentLight::Radiance(const vec3& direction) const {
+    const vec2 uv = uvFromDirection(direction);
+    const float x = uv.x * m_width - 0.5f;
+    const float y = uv.y * m_height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const int x0 = (static_cast<int>(fx) % m_width + m_width) % m_width;
+    const int y0 = (static_cast<int>(fy) % m_height + m_height) % m_height;
+    const int x1 = (x0 + 1) % m_width;
+    const int y1 = (y0 + 1) % m_height;
+    auto texel = [&](int tx, int ty) { return m_texels[static_cast<size_t>(ty) * m_width + tx]; };
+    const vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), x - fx);
+    const vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), x - fx);
+    return glm::mix(top, bottom, y - fy);
+}
+
+int EnvironmentLight::sampleCdf(const float* cdf, int count, float u, float& offset) {
+    const float target = u * cdf[count];
+    const int index = std::clamp(static_cast<int>(std::upper_bound(cdf, cdf + count + 1, target) - cdf) - 1, 0, count - 1);
+    const float width = cdf[index + 1] - cdf[index];
+    offset = width > 0.0f ? glm::clamp((target - cdf[index]) / width, 0.0f, 0.99999994f) : 0.5f;
+    return index;
+}
+
+vec3 EnvironmentLight::Sample(const vec2& u, float& pdf) const {
+    float dy, dx;
+    const int y = sampleCdf(m_rowCdf.data(), m_height, u.y, dy);
+    const int x = sampleCdf(m_columnCdfs.data() + static_cast<size_t>(y) * (m_width + 1), m_width, u.x, dx);
+
+    float sinTheta;
+    const vec3 direction = directionFromUv((x + dx) / m_width, (y + dy) / m_height, sinTheta);
+    // the map from the unit square to the sphere has a jacobian of 2 pi^2 sin(theta)
+    pdf = sinTheta > 0.0f ? m_pdfs[static_cast<size_t>(y) * m_width + x] / (2.0f * Pi * Pi * sinTheta) : 0.0f;
+    return direction;
+}
+
+float EnvironmentLight::Pdf(const vec3& direction) const {
+    const vec2 uv = uvFromDirection(direction);
+    const int x = std::min(static_cast<int>(uv.x * m_width), m_width - 1);
+    const int y = std::min(static_cast<int>(uv.y * m_height), m_height - 1);
+    const float sinTheta = std::sqrt(std::max(1.0f - direction.y * direction.y, 0.0f));
+    return sinTheta > 0.0f ? m_pdfs[static_cast<size_t>(y) * m_width + x] / (2.0f * Pi * Pi * sinTheta) : 0.0f;
+}
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,33 @@
+#pragma once
+#include "base/Definitions.h"
+
+namespace pbr {
+namespace sw {
+
+// The equirectangular environment image as a light at infinity. Lookups use the mapping of
+// to_cubemap.frag, directions are importance sampled proportional to luminance times solid angle
+// from a piecewise constant distribution over the texels.
+class EnvironmentLight {
+   public:
+    // float RGB image of utility::ReadHDRImage
+    void Create(const Image& image);
+    inline bool IsValid() const { return !m_texels.empty(); }
+    vec3 Radiance(const vec3& direction) const;
+    // direction for u in [0, 1)^2 and its solid angle density
+    vec3 Sample(const vec2& u, float& pdf) const;
+    float Pdf(const vec3& direction) const;
+
+   private:
+    static int sampleCdf(const float* cdf, int count, float u, float& offset);
+
+   private:
+    int m_width = 0;
+    int m_height = 0;
+    vector<vec3> m_texels;
+    vector<float> m_rowCdf;      // m_height + 1 entries
+    vector<float> m_columnCdfs;  // m_width + 1 entries per row
+    vector<float> m_pdfs;        // density over the unit square per texel
+};
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,196 @@
+#include "SwIbl.h"
+#include <cmath>
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+namespace sw {
+
+// the same wrapping as the GL texture, repeat in both directions
+static vec3 sampleEquirectangular(const Image& image, const vec2& uv) {
+    const float* texels = reinterpret_cast<const float*>(image.buffer.pData);
+    const int component = image.component;
+    const float x = uv.x * image.width - 0.5f;
+    const float y = uv.y * image.height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const int x0 = (static_cast<int>(fx) % image.width + image.width) % image.width;
+    const int y0 = (static_cast<int>(fy) % image.height + image.height) % image.height;
+    const int x1 = (x0 + 1) % image.width;
+    const int y1 = (y0 + 1) % image.height;
+    auto texel = [&](int tx, int ty) {
+        const float* p = texels + (static_cast<size_t>(ty) * image.width + tx) * component;
+        return vec3(p[0], p[1], p[2]);
+    };
+    const vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), x - fx);
+    const vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), x - fx);
+    return glm::mix(top, bottom, y - fy);
+}
+
+static inline vec2 texelCenter(int x, int y, int size) {
+    return vec2((x + 0.5f) / size, (y + 0.5f) / size);
+}
+
+void EquirectangularToCubeMap(const Image& image, CubeMap& cubeMap) {
+    if (image.dataType != DataType::FLOAT_32T || image.component < 3)
+        THROW_EXCEPTION("software: environment map expects a float RGB image");
+
+    const vec2 invAtan(0.1591f, 0.3183f);
+    const int size = cubeMap.Size();
+    JobSystem::GetSingleton().ParallelFor("cube map", 6 * size, [&](int row, int) {
+        const int face = row / size;
+        const int y = row % size;
+        vec3* texels = cubeMap.Face(face) + y * size;
+        for (int x = 0; x < size; ++x) {
+            const vec3 v = glm::normalize(CubeMap::TexelDirection(face, texelCenter(x, y, size)));
+            vec2 uv = vec2(std::atan2(v.z, v.x), std::asin(v.y)) * invAtan + 0.5f;
+            uv.y = 1.0f - uv.y;
+            texels[x] = sampleEquirectangular(image, uv);
+        }
+    });
+    cubeMap.GenerateMips();
+}
+
+// solid angle of a texel at st on a face of the given size
+static float texelSolidAngle(const vec2& st, int size) {
+    const float u = 2.0f * st.x - 1.0f;
+    const float v = 2.0f * st.y - 1.0f;
+    const float texelArea = 4.0f / (static_cast<float>(size) * size);
+    return texelArea / std::pow(1.0f + u * u + v * v, 1.5f);
+}
+
+static void shBasis(const vec3& d, float (&basis)[9]) {
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * d.y;
+    basis[2] = 0.488603f * d.z;
+    basis[3] = 0.488603f * d.x;
+    basis[4] = 1.092548f * d.x * d.y;
+    basis[5] = 1.092548f * d.y * d.z;
+    basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    basis[7] = 1.092548f * d.x * d.z;
+    basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+void ConvolveIrradiance(const CubeMap& envMap, CubeMap& irradianceMap) {
+    // the projection only keeps the lowest frequencies, a 32x32 face is plenty
+    int mip = 0;
+    while (mip + 1 < envMap.MipLevels() && envMap.Size(mip + 1) >= 32)
+        ++mip;
+
+    const int size = envMap.Size(mip);
+    vec3 coefficients[9];
+    for (vec3& coefficient : coefficients)
+        coefficient = vec3(0.0f);
+    for (int face = 0; face < 6; ++face) {
+        const vec3* texels = envMap.Face(face, mip);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const vec2 st = texelCenter(x, y, size);
+                const vec3 d = glm::normalize(CubeMap::TexelDirection(face, st));
+                float basis[9];
+                shBasis(d, basis);
+                const vec3 radiance = texels[y * size + x] * texelSolidAngle(st, size);
+                for (int i = 0; i < 9; ++i)
+                    coefficients[i] += radiance * basis[i];
+            }
+        }
+    }
+
+    // cosine lobe convolution (pi, 2pi/3, pi/4 per band), then the division by pi
+    const float bands[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    for (int i = 0; i < 9; ++i)
+        coefficients[i] *= bands[i];
+
+    const int outSize = irradianceMap.Size();
+    JobSystem::GetSingleton().ParallelFor("irradiance", 6, [&](int face, int) {
+        vec3* texels = irradianceMap.Face(face);
+        for (int y = 0; y < outSize; ++y) {
+            for (int x = 0; x < outSize; ++x) {
+                const vec3 n = glm::normalize(CubeMap::TexelDirection(face, texelCenter(x, y, outSize)));
+                float basis[9];
+                shBasis(n, basis);
+                vec3 irradiance(0.0f);
+                for (int i = 0; i < 9; ++i)
+                    irradiance += coefficients[i] * basis[i];
+                texels[y * outSize + x] = glm::max(irradiance, vec3(0.0f));
+            }
+        }
+    });
+}
+
+static float radicalInverse(uint32_t bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+void PrefilterSpecular(const CubeMap& envMap, CubeMap& specularMap, int sampleCount) {
+    struct Sample {
+        vec3 direction;  // tangent space, the normal is +z
+        float weight;    // NdotL
+        float lod;
+    };
+
+    const float envSize = static_cast<float>(envMap.Size());
+    const float saTexel = 4.0f * Pi / (6.0f * envSize * envSize);
+    const int mipLevels = specularMap.MipLevels();
+    for (int mip = 0; mip < mipLevels; ++mip) {
+        const float roughness = mipLevels > 1 ? static_cast<float>(mip) / (mipLevels - 1) : 0.0f;
+        const int size = specularMap.Size(mip);
+
+        // with N = V = R the sample set does not depend on the texel, only its frame does
+        vector<Sample> samples;
+        float totalWeight = 0.0f;
+        if (roughness == 0.0f) {
+            samples.push_back({ vec3(0.0f, 0.0f, 1.0f), 1.0f, 0.0f });
+            totalWeight = 1.0f;
+        } else {
+            const float a = roughness * roughness;
+            const float a2 = a * a;
+            for (int i = 0; i < sampleCount; ++i) {
+                const float phi = TwoPi * i / sampleCount;
+                const float xi = radicalInverse(static_cast<uint32_t>(i));
+                const float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a2 - 1.0f) * xi));
+                const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                const vec3 H(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+                // L = reflect(-V, H) with V = +z
+                const vec3 L = 2.0f * cosTheta * H - vec3(0.0f, 0.0f, 1.0f);
+                if (L.z <= 0.0f)
+                    continue;
+
+                const float denom = cosTheta * cosTheta * (a2 - 1.0f) + 1.0f;
+                const float D = a2 / (Pi * denom * denom);
+                const float pdf = D * 0.25f + 0.0001f;
+                const float saSample = 1.0f / (sampleCount * pdf + 0.0001f);
+                const float lod = std::max(0.5f * std::log2(saSample / saTexel), 0.0f);
+                samples.push_back({ L, L.z, lod });
+                totalWeight += L.z;
+            }
+        }
+
+        JobSystem::GetSingleton().ParallelFor("prefilter", 6 * size, [&](int row, int) {
+            const int face = row / size;
+            const int y = row % size;
+            vec3* texels = specularMap.Face(face, mip) + y * size;
+            for (int x = 0; x < size; ++x) {
+                const vec3 N = glm::normalize(CubeMap::TexelDirection(face, texelCenter(x, y, size)));
+                const vec3 up = std::abs(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+                const vec3 tangent = glm::normalize(glm::cross(up, N));
+                const vec3 bitangent = glm::cross(N, tangent);
+
+                vec3 color(0.0f);
+                for (const Sample& sample : samples) {
+                    const vec3 L = tangent * sample.direction.x + bitangent * sample.direction.y + N * sample.direction.z;
+                    color += envMap.Sample(L, sample.lod) * sample.weight;
+                }
+                texels[x] = color / totalWeight;
+            }
+        });
+    }
+}
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,22 @@
+#pragma once
+#include "SwTexture.h"
+
+namespace pbr {
+namespace sw {
+
+// CPU counterparts of to_cubemap.frag, irradiance.frag and prefilter.frag, the output cube maps
+// are created by the caller with their final size and mip count.
+
+// samples the equirectangular image into every mip 0 texel and box filters the chain
+extern void EquirectangularToCubeMap(const Image& image, CubeMap& cubeMap);
+
+// cosine convolution divided by pi as irradiance.frag stores it, evaluated from a third order
+// spherical harmonics projection instead of integrating the hemisphere per texel
+extern void ConvolveIrradiance(const CubeMap& envMap, CubeMap& irradianceMap);
+
+// GGX prefiltering with roughness mip / (mips - 1), the source mip of each sample is chosen
+// from its pdf like prefilter.frag so a few samples per texel do not alias
+extern void PrefilterSpecular(const CubeMap& envMap, CubeMap& specularMap, int sampleCount);
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,335 @@
+#include "SwPathTracer.h"
+#include <cmath>
+#include "Scene.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+namespace sw {
+
+// bounces before russian roulette may end a path
+static constexpr int minBounces = 3;
+// GGX with roughness 0 is a delta distribution, clamp it so BRDF sampling and evaluation agree
+static constexpr float minRoughness = 0.03f;
+
+static inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// PCG random numbers, seeded per pixel and sample so images do not depend on the thread count
+class PathTracer::Random {
+   public:
+    explicit Random(uint32_t seed)
+        : m_state(seed) {}
+
+    inline float Next() {
+        m_state = m_state * 747796405u + 2891336453u;
+        uint32_t word = ((m_state >> ((m_state >> 28u) + 4u)) ^ m_state) * 277803737u;
+        word = (word >> 22u) ^ word;
+        return static_cast<float>(word >> 8) * (1.0f / 16777216.0f);
+    }
+    inline vec2 Next2() {
+        const float u = Next();
+        return vec2(u, Next());
+    }
+
+   private:
+    uint32_t m_state;
+};
+
+struct PathTracer::Material {
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    vec3 F0;
+    vec3 emission;
+    vec3 N;
+    float specularProbability;  // chance of sampling the GGX lobe instead of the diffuse one
+};
+
+static inline float luminance(const vec3& c) {
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+static inline float powerHeuristic(float pdf, float otherPdf) {
+    const float a = pdf * pdf;
+    return a / (a + otherPdf * otherPdf);
+}
+
+// orthonormal basis around n, Duff et al. 2017
+static inline void basis(const vec3& n, vec3& t, vec3& b) {
+    const float sign = std::copysign(1.0f, n.z);
+    const float a = -1.0f / (sign + n.z);
+    const float c = n.x * n.y * a;
+    t = vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+// f(V, L) * (N dot L) of the light loop in pbr_model.frag
+vec3 PathTracer::evaluateBrdf(const Material& m, const vec3& V, const vec3& L) {
+    const float NdotL = glm::dot(m.N, L);
+    const float NdotV = glm::dot(m.N, V);
+    if (NdotL <= 0.0f || NdotV <= 0.0f)
+        return vec3(0.0f);
+
+    const vec3 H = glm::normalize(V + L);
+    const float NDF = DistributionGGX(m.N, H, m.roughness);
+    const float G = GeometrySmith(NdotV, NdotL, m.roughness);
+    const vec3 F = FresnelSchlick(glm::clamp(glm::dot(H, V), 0.0f, 1.0f), m.F0);
+    const vec3 specular = NDF * G * F / std::max(4.0f * NdotV * NdotL, 0.001f);
+    const vec3 kD = (vec3(1.0f) - F) * (1.0f - m.metallic);
+    return (kD * m.albedo / Pi + specular) * NdotL;
+}
+
+// mixture of cosine weighted and GGX half vector sampling
+float PathTracer::brdfPdf(const Material& m, const vec3& V, const vec3& L) {
+    const float NdotL = glm::dot(m.N, L);
+    if (NdotL <= 0.0f)
+        return 0.0f;
+    const vec3 H = glm::normalize(V + L);
+    const float VdotH = std::max(glm::dot(V, H), 1e-6f);
+    const float specularPdf = DistributionGGX(m.N, H, m.roughness) * std::max(glm::dot(m.N, H), 0.0f) / (4.0f * VdotH);
+    const float diffusePdf = NdotL / Pi;
+    return m.specularProbability * specularPdf + (1.0f - m.specularProbability) * diffusePdf;
+}
+
+bool PathTracer::sampleBrdf(const Material& m, const vec3& V, float lobe, const vec2& u, vec3& L) {
+    vec3 t, b;
+    basis(m.N, t, b);
+    const float phi = 2.0f * Pi * u.x;
+    if (lobe < m.specularProbability) {
+        // the same distribution as importanceSampleGGX in prefilter.frag
+        const float a = m.roughness * m.roughness;
+        const float cosTheta = std::sqrt((1.0f - u.y) / (1.0f + (a * a - 1.0f) * u.y));
+        const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+        const vec3 H = t * (sinTheta * std::cos(phi)) + b * (sinTheta * std::sin(phi)) + m.N * cosTheta;
+        L = glm::reflect(-V, H);
+    } else {
+        const float r = std::sqrt(u.y);
+        L = t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + m.N * std::sqrt(std::max(1.0f - u.y, 0.0f));
+    }
+    return glm::dot(m.N, L) > 0.0f;
+}
+
+// pushes a ray origin off the surface, on the side of the outgoing direction
+static inline vec3 offsetOrigin(const vec3& position, const vec3& normal) {
+    const float scale = 1.0f + std::max(std::max(std::abs(position.x), std::abs(position.y)), std::abs(position.z));
+    return position + normal * (1e-4f * scale);
+}
+
+void PathTracer::Initialize(const TexturedMesh& mesh, const mat4& transform) {
+    const glm::mat3 rotation(transform);
+    m_vertices.resize(mesh.vertices.size());
+    vector<vec3> positions(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        const TexturedVertex& in = mesh.vertices[i];
+        TexturedVertex& out = m_vertices[i];
+        out.position = vec3(transform * vec4(in.position, 1.0f));
+        out.uv = in.uv;
+        out.normal = glm::normalize(rotation * in.normal);
+        out.tangent = glm::normalize(rotation * in.tangent);
+        out.bitangent = glm::normalize(rotation * in.bitangent);
+        positions[i] = out.position;
+    }
+    m_indices = mesh.indices;
+    m_bvh.Build(positions, m_indices);
+}
+
+void PathTracer::SetEnvironment(const Image& image) {
+    m_environment.Create(image);
+    Reset();
+}
+
+void PathTracer::Resize(int width, int height) {
+    m_width = std::max(width, 0);
+    m_height = std::max(height, 0);
+    m_accumulation.resize(static_cast<size_t>(m_width) * m_height);
+    Reset();
+}
+
+void PathTracer::Reset() {
+    std::fill(m_accumulation.begin(), m_accumulation.end(), vec3(0.0f));
+    m_sampleCount = 0;
+}
+
+void PathTracer::Render(const ShadingContext& context, const PixelRays& rays, int samplesPerPixel, uint32_t* framebuffer) {
+    const int tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    const float invSampleCount = 1.0f / (m_sampleCount + samplesPerPixel);
+
+    // tiles differ a lot in cost, they are handed out one by one
+    JobSystem::GetSingleton().ParallelFor("path trace tile", tilesX * tilesY, [&](int tile, int) {
+        const int tileX = (tile % tilesX) * TILE_SIZE;
+        const int tileY = (tile / tilesX) * TILE_SIZE;
+        const int endX = std::min(tileX + TILE_SIZE, m_width);
+        const int endY = std::min(tileY + TILE_SIZE, m_height);
+        uint64_t rayCount = 0;
+        for (int y = tileY; y < endY; ++y) {
+            for (int x = tileX; x < endX; ++x) {
+                const size_t pixel = static_cast<size_t>(y) * m_width + x;
+                vec3 sum(0.0f);
+                for (int s = 0; s < samplesPerPixel; ++s) {
+                    Random random(hash(static_cast<uint32_t>(pixel) ^ hash(static_cast<uint32_t>(m_sampleCount + s) + 0x9e3779b9u)));
+                    const vec2 jitter = random.Next2();
+                    Ray ray;
+                    ray.origin = context.viewPos;
+                    ray.direction = glm::normalize(rays.origin + rays.dx * (x + jitter.x - 0.5f) + rays.dy * (y + jitter.y - 0.5f));
+                    const vec3 radiance = tracePath(context, ray, random, rayCount);
+                    // a NaN or inf would stick to the pixel for the rest of the accumulation
+                    if (std::isfinite(radiance.x + radiance.y + radiance.z))
+                        sum += radiance;
+                }
+                m_accumulation[pixel] += sum;
+                framebuffer[pixel] = PackColor(Tonemap(m_accumulation[pixel] * invSampleCount));
+            }
+        }
+        m_rayCount += rayCount;
+    }, 1);
+    m_sampleCount += samplesPerPixel;
+}
+
+void PathTracer::AverageRadiance(vector<float>& rgb) const {
+    const float invSampleCount = m_sampleCount ? 1.0f / m_sampleCount : 0.0f;
+    rgb.resize(m_accumulation.size() * 3);
+    for (size_t i = 0; i < m_accumulation.size(); ++i) {
+        rgb[3 * i + 0] = m_accumulation[i].x * invSampleCount;
+        rgb[3 * i + 1] = m_accumulation[i].y * invSampleCount;
+        rgb[3 * i + 2] = m_accumulation[i].z * invSampleCount;
+    }
+}
+
+PathTracer::Material PathTracer::fetchMaterial(const ShadingContext& context, const Hit& hit, const vec3& V, vec3& position, vec3& geometricNormal) const {
+    const uvec3& face = m_indices[hit.triangle];
+    const TexturedVertex& v0 = m_vertices[face.x];
+    const TexturedVertex& v1 = m_vertices[face.y];
+    const TexturedVertex& v2 = m_vertices[face.z];
+    const float b0 = 1.0f - hit.b1 - hit.b2;
+    position = v0.position * b0 + v1.position * hit.b1 + v2.position * hit.b2;
+    const vec2 uv = v0.uv * b0 + v1.uv * hit.b1 + v2.uv * hit.b2;
+
+    // triangles are two sided, face the geometric normal towards the viewer
+    geometricNormal = glm::normalize(glm::cross(v1.position - v0.position, v2.position - v0.position));
+    if (glm::dot(geometricNormal, V) < 0.0f)
+        geometricNormal = -geometricNormal;
+
+    const vec4 albedoMetallic = context.pAlbedoMetallic ? context.pAlbedoMetallic->Sample(uv) : vec4(0.8f, 0.8f, 0.8f, 0.0f);
+    const vec4 normalRoughness = context.pNormalRoughness ? context.pNormalRoughness->Sample(uv) : vec4(0.5f, 0.5f, 1.0f, 0.5f);
+    // the baked ambient occlusion is what the path tracer computes, only the emissive part is used
+    const vec3 emissive = context.pEmissiveAO ? vec3(context.pEmissiveAO->Sample(uv)) : vec3(0.0f);
+
+    Material m;
+    m.albedo = vec3(albedoMetallic);
+    m.metallic = albedoMetallic.w;
+    m.roughness = std::max(normalRoughness.w, minRoughness);
+    m.F0 = glm::mix(vec3(0.04f), m.albedo, m.metallic);
+    m.emission = glm::pow(emissive, vec3(2.2f));
+
+    const vec3 normal = v0.normal * b0 + v1.normal * hit.b1 + v2.normal * hit.b2;
+    if (context.pNormalRoughness) {
+        const vec3 tangent = v0.tangent * b0 + v1.tangent * hit.b1 + v2.tangent * hit.b2;
+        const vec3 bitangent = v0.bitangent * b0 + v1.bitangent * hit.b1 + v2.bitangent * hit.b2;
+        const vec3 n = 2.0f * vec3(normalRoughness) - 1.0f;
+        m.N = glm::normalize(tangent * n.x + bitangent * n.y + normal * n.z);
+    } else
+        m.N = glm::normalize(normal);
+    // a shading normal facing away from the viewer would make the surface black
+    if (!(glm::dot(m.N, V) > 1e-4f))
+        m.N = geometricNormal;
+
+    const float specular = luminance(FresnelSchlick(glm::dot(m.N, V), m.F0));
+    const float diffuse = luminance(m.albedo) * (1.0f - m.metallic) * (1.0f - specular);
+    m.specularProbability = specular / (specular + diffuse);
+    return m;
+}
+
+vec3 PathTracer::tracePath(const ShadingContext& context, Ray ray, Random& random, uint64_t& rayCount) const {
+    vec3 radiance(0.0f);
+    vec3 throughput(1.0f);
+    float lastBrdfPdf = 0.0f;
+
+    for (int bounce = 0;; ++bounce) {
+        Hit hit;
+        ++rayCount;
+        if (!m_bvh.Intersect(ray, hit)) {
+            const vec3 environment = m_environment.Radiance(ray.direction);
+            const float weight = bounce ? powerHeuristic(lastBrdfPdf, m_environment.Pdf(ray.direction)) : 1.0f;
+            radiance += throughput * environment * weight;
+            break;
+        }
+
+        const vec3 V = -ray.direction;
+        vec3 position, geometricNormal;
+        const Material m = fetchMaterial(context, hit, V, position, geometricNormal);
+        radiance += throughput * m.emission;
+        if (bounce == MAX_BOUNCES)
+            break;
+
+        const vec3 origin = offsetOrigin(position, geometricNormal);
+
+        // environment light
+        float environmentPdf;
+        const vec3 L = m_environment.Sample(random.Next2(), environmentPdf);
+        if (environmentPdf > 0.0f && glm::dot(L, geometricNormal) > 0.0f) {
+            const vec3 f = evaluateBrdf(m, V, L);
+            if (f.x + f.y + f.z > 0.0f) {
+                Ray shadow;
+                shadow.origin = origin;
+                shadow.direction = L;
+                ++rayCount;
+                if (!m_bvh.Occluded(shadow)) {
+                    const float weight = powerHeuristic(environmentPdf, brdfPdf(m, V, L));
+                    radiance += throughput * f * m_environment.Radiance(L) * (weight / environmentPdf);
+                }
+            }
+        }
+
+        // point lights of the scene
+        for (int i = 0; i < context.lightCount; ++i) {
+            const Light& light = g_lights[i];
+            const vec3 delta = light.position - position;
+            const float distance = glm::length(delta);
+            const vec3 toLight = delta / distance;
+            if (glm::dot(toLight, geometricNormal) <= 0.0f)
+                continue;
+            const vec3 f = evaluateBrdf(m, V, toLight);
+            if (f.x + f.y + f.z <= 0.0f)
+                continue;
+            Ray shadow;
+            shadow.origin = origin;
+            shadow.direction = toLight;
+            shadow.tMax = distance * 0.999f;
+            ++rayCount;
+            if (!m_bvh.Occluded(shadow))
+                radiance += throughput * f * light.color / (distance * distance);
+        }
+
+        // continue the path by sampling the BRDF
+        const float lobe = random.Next();
+        vec3 next;
+        if (!sampleBrdf(m, V, lobe, random.Next2(), next) || glm::dot(next, geometricNormal) <= 0.0f)
+            break;
+        lastBrdfPdf = brdfPdf(m, V, next);
+        if (lastBrdfPdf <= 0.0f)
+            break;
+        throughput *= evaluateBrdf(m, V, next) / lastBrdfPdf;
+
+        if (bounce + 1 >= minBounces) {
+            const float survival = std::min(std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.95f);
+            if (random.Next() >= survival)
+                break;
+            throughput /= survival;
+        }
+
+        ray.origin = origin;
+        ray.direction = next;
+        ray.tMax = FLT_MAX;
+    }
+    return radiance;
+}
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include "Mesh.h"
+#include "SwBvh.h"
+#include "SwEnvironment.h"
+#include "SwShading.h"
+
+namespace pbr {
+namespace sw {
+
+// Reference for the split sum image based lighting of pbr_model.frag. A unidirectional path tracer
+// over the same mesh, material maps and environment image with the BRDF of the analytic light loop.
+// The environment is importance sampled and weighted against BRDF sampling with the power heuristic,
+// the point lights are sampled directly. Samples accumulate until Reset().
+class PathTracer {
+   public:
+    static constexpr int TILE_SIZE = 16;
+    static constexpr int MAX_BOUNCES = 8;
+
+    // moves the mesh to world space and builds the BVH
+    void Initialize(const TexturedMesh& mesh, const mat4& transform);
+    void SetEnvironment(const Image& image);
+    void Resize(int width, int height);
+    void Reset();
+    // adds samplesPerPixel samples to every pixel and writes the tonemapped average to the framebuffer,
+    // context supplies the material maps, the view position and the light count
+    void Render(const ShadingContext& context, const PixelRays& rays, int samplesPerPixel, uint32_t* framebuffer);
+    // linear float RGB average, the first row is the top of the image
+    void AverageRadiance(vector<float>& rgb) const;
+
+    inline const Bvh& GetBvh() const { return m_bvh; }
+    inline int SampleCount() const { return m_sampleCount; }
+    inline uint64_t RayCount() const { return m_rayCount; }
+
+   private:
+    class Random;
+    struct Material;
+
+    static vec3 evaluateBrdf(const Material& m, const vec3& V, const vec3& L);
+    static float brdfPdf(const Material& m, const vec3& V, const vec3& L);
+    static bool sampleBrdf(const Material& m, const vec3& V, float lobe, const vec2& u, vec3& L);
+    vec3 tracePath(const ShadingContext& context, Ray ray, Random& random, uint64_t& rayCount) const;
+    Material fetchMaterial(const ShadingContext& context, const Hit& hit, const vec3& V, vec3& position, vec3& geometricNormal) const;
+
+   private:
+    Bvh m_bvh;
+    EnvironmentLight m_environment;
+    vector<TexturedVertex> m_vertices;  // world space
+    vector<uvec3> m_indices;
+
+    int m_width = 0;
+    int m_height = 0;
+    vector<vec3> m_accumulation;  // radiance sums
+    int m_sampleCount = 0;
+    std::atomic<uint64_t> m_rayCount { 0 };
+};
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,286 @@
+#include "SwRasterizer.h"
+#include <cmath>
+#include "SwSimd.h"
+#include "base/JobSystem.h"
+
+namespace pbr {
+namespace sw {
+
+// triangles per setup chunk, small enough to balance, large enough to amortize the bins
+static constexpr int TRIANGLES_PER_CHUNK = 2048;
+
+const char* Rasterizer::InstructionSet() {
+#if PBR_SW_SSE
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void Rasterizer::Resize(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_tileCountX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileCountY = (height + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+void Rasterizer::Setup(const vector<ClipVertex>& vertices, const vector<uvec3>& indices) {
+    m_pVertices = &vertices;
+    m_clippedVertices.clear();
+
+    const int triangleCount = static_cast<int>(indices.size());
+    const int chunkCount = glm::clamp((triangleCount + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK, 1, MAX_CHUNK_COUNT - 1);
+    m_chunks.resize(chunkCount + 1);
+    for (Chunk& chunk : m_chunks) {
+        chunk.triangles.clear();
+        chunk.nearClipped.clear();
+        chunk.bins.resize(TileCount());
+        for (auto& bin : chunk.bins)
+            bin.clear();
+    }
+
+    JobSystem::GetSingleton().ParallelFor("bin triangles", chunkCount, [&](int chunkIndex, int) {
+        Chunk& chunk = m_chunks[chunkIndex];
+        const int begin = static_cast<int>(static_cast<int64_t>(triangleCount) * chunkIndex / chunkCount);
+        const int end = static_cast<int>(static_cast<int64_t>(triangleCount) * (chunkIndex + 1) / chunkCount);
+        for (int i = begin; i < end; ++i) {
+            const uvec3& indices3 = indices[i];
+            const uint32_t vertex[3] = { indices3.x, indices3.y, indices3.z };
+            const vec4 clip[3] = { vertices[vertex[0]].clip, vertices[vertex[1]].clip, vertices[vertex[2]].clip };
+
+            // trivially reject triangles outside of one frustum plane
+            uint32_t outside = 0x3F;
+            uint32_t behindNear = 0;
+            for (const vec4& c : clip) {
+                const uint32_t code = (c.x < -c.w) | (c.x > c.w) << 1 | (c.y < -c.w) << 2 |
+                                      (c.y > c.w) << 3 | (c.z < -c.w) << 4 | (c.z > c.w) << 5;
+                outside &= code;
+                behindNear |= code & 0x10;
+            }
+            if (outside)
+                continue;
+            if (behindNear) {
+                chunk.nearClipped.push_back(i);
+                continue;
+            }
+            setupTriangle(chunk, vertex, clip);
+        }
+    });
+
+    // near plane clipping is rare, it runs serially into the last chunk
+    Chunk& clippedChunk = m_chunks.back();
+    for (int i = 0; i < chunkCount; ++i)
+        for (uint32_t triangle : m_chunks[i].nearClipped)
+            clipTriangle(clippedChunk, indices[triangle]);
+}
+
+void Rasterizer::setupTriangle(Chunk& chunk, const uint32_t (&vertex)[3], const vec4 (&clip)[3]) const {
+    Triangle triangle;
+    for (int i = 0; i < 3; ++i) {
+        const float invW = 1.0f / clip[i].w;
+        triangle.x[i] = (0.5f + 0.5f * clip[i].x * invW) * m_width;
+        triangle.y[i] = (0.5f - 0.5f * clip[i].y * invW) * m_height;
+        triangle.z[i] = 0.5f + 0.5f * clip[i].z * invW;
+        triangle.invW[i] = invW;
+        triangle.vertex[i] = vertex[i];
+    }
+
+    const float* x = triangle.x;
+    const float* y = triangle.y;
+    // with y down, clockwise front faces have a positive area, this culls back faces and degenerates
+    const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f))
+        return;
+
+    const float minX = std::min(x[0], std::min(x[1], x[2]));
+    const float maxX = std::max(x[0], std::max(x[1], x[2]));
+    const float minY = std::min(y[0], std::min(y[1], y[2]));
+    const float maxY = std::max(y[0], std::max(y[1], y[2]));
+    if (maxX < 0.0f || maxY < 0.0f || minX > m_width || minY > m_height)
+        return;
+
+    triangle.minX = static_cast<int>(std::max(minX, 0.0f));
+    triangle.minY = static_cast<int>(std::max(minY, 0.0f));
+    triangle.maxX = std::min(static_cast<int>(maxX), m_width - 1);
+    triangle.maxY = std::min(static_cast<int>(maxY), m_height - 1);
+
+    triangle.invArea = 1.0f / area;
+    triangle.dB1dx = (y[2] - y[0]) * triangle.invArea;
+    triangle.dB1dy = (x[0] - x[2]) * triangle.invArea;
+    triangle.dB2dx = (y[0] - y[1]) * triangle.invArea;
+    triangle.dB2dy = (x[1] - x[0]) * triangle.invArea;
+
+    const uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+    chunk.triangles.push_back(triangle);
+    for (int tileY = triangle.minY / TILE_SIZE; tileY <= triangle.maxY / TILE_SIZE; ++tileY)
+        for (int tileX = triangle.minX / TILE_SIZE; tileX <= triangle.maxX / TILE_SIZE; ++tileX)
+            chunk.bins[tileY * m_tileCountX + tileX].push_back(index);
+}
+
+static ClipVertex lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+    ClipVertex v;
+    v.clip = glm::mix(a.clip, b.clip, t);
+    v.position = glm::mix(a.position, b.position, t);
+    v.uv = glm::mix(a.uv, b.uv, t);
+    v.normal = glm::mix(a.normal, b.normal, t);
+    v.tangent = glm::mix(a.tangent, b.tangent, t);
+    v.bitangent = glm::mix(a.bitangent, b.bitangent, t);
+    return v;
+}
+
+void Rasterizer::clipTriangle(Chunk& chunk, const uvec3& triangle) {
+    // Sutherland-Hodgman against z = -w, a triangle becomes at most a quad
+    const uint32_t input[3] = { triangle.x, triangle.y, triangle.z };
+    uint32_t polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const ClipVertex& current = (*m_pVertices)[input[i]];
+        const ClipVertex& next = (*m_pVertices)[input[(i + 1) % 3]];
+        const float dCurrent = current.clip.z + current.clip.w;
+        const float dNext = next.clip.z + next.clip.w;
+        if (dCurrent >= 0.0f)
+            polygon[count++] = input[i];
+        if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+            m_clippedVertices.push_back(lerp(current, next, dCurrent / (dCurrent - dNext)));
+            polygon[count++] = CLIPPED_VERTEX | static_cast<uint32_t>(m_clippedVertices.size() - 1);
+        }
+    }
+
+    for (int i = 1; i + 1 < count; ++i) {
+        const uint32_t vertex[3] = { polygon[0], polygon[i], polygon[i + 1] };
+        const vec4 clip[3] = { GetVertex(vertex[0]).clip, GetVertex(vertex[1]).clip, GetVertex(vertex[2]).clip };
+        setupTriangle(chunk, vertex, clip);
+    }
+}
+
+void Rasterizer::RasterizeTile(int tile, TileBuffer& buffer) const {
+    const int tileX = (tile % m_tileCountX) * TILE_SIZE;
+    const int tileY = (tile / m_tileCountX) * TILE_SIZE;
+    std::fill(std::begin(buffer.depth), std::end(buffer.depth), 1.0f);
+    std::fill(std::begin(buffer.triangle), std::end(buffer.triangle), EMPTY);
+
+    // chunks hold consecutive ranges of the index buffer, walking them in order keeps submission order
+    for (size_t chunkIndex = 0; chunkIndex < m_chunks.size(); ++chunkIndex) {
+        const Chunk& chunk = m_chunks[chunkIndex];
+        for (uint32_t index : chunk.bins[tile]) {
+            const uint32_t id = static_cast<uint32_t>(chunkIndex << TRIANGLE_INDEX_BITS) | index;
+            rasterizeTriangle(chunk.triangles[index], id, tileX, tileY, buffer);
+        }
+    }
+}
+
+void Rasterizer::rasterizeTriangle(const Triangle& triangle, uint32_t id, int tileX, int tileY, TileBuffer& buffer) const {
+    // pixel range relative to the tile
+    const int x0 = std::max(triangle.minX, tileX) - tileX;
+    const int x1 = std::min(triangle.maxX, tileX + TILE_SIZE - 1) - tileX;
+    const int y0 = std::max(triangle.minY, tileY) - tileY;
+    const int y1 = std::min(triangle.maxY, tileY + TILE_SIZE - 1) - tileY;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // E(x, y) = A * x + (B * y + C) with x, y relative to the first pixel center of the tile. The
+    // constant is formed in double from the same end point for both windings of an edge, so
+    // neighbors evaluate exactly negated values and the top-left rule leaves no gaps or overlaps
+    static const int edges[3][2] = { { 1, 2 }, { 2, 0 }, { 0, 1 } };
+    const double originX = tileX + 0.5;
+    const double originY = tileY + 0.5;
+    float A[3], B[3], C[3];
+    bool topLeft[3];
+    for (int k = 0; k < 3; ++k) {
+        const int a = edges[k][0];
+        const int b = edges[k][1];
+        A[k] = triangle.y[a] - triangle.y[b];
+        B[k] = triangle.x[b] - triangle.x[a];
+        const bool aFirst = triangle.x[a] < triangle.x[b] || (triangle.x[a] == triangle.x[b] && triangle.y[a] < triangle.y[b]);
+        const int r = aFirst ? a : b;
+        C[k] = static_cast<float>(A[k] * (originX - triangle.x[r]) + B[k] * (originY - triangle.y[r]));
+        // pixels centered exactly on a shared edge belong to the triangle to its right or below
+        topLeft[k] = A[k] > 0.0f || (A[k] == 0.0f && B[k] > 0.0f);
+    }
+
+    const float invArea = triangle.invArea;
+    const float z0 = triangle.z[0];
+    const float dz1 = triangle.z[1] - z0;
+    const float dz2 = triangle.z[2] - z0;
+
+#if PBR_SW_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 columnMin = _mm_set1_ps(static_cast<float>(x0));
+    const __m128 columnMax = _mm_set1_ps(static_cast<float>(x1));
+    const __m128 invAreaV = _mm_set1_ps(invArea);
+    const __m128 z0V = _mm_set1_ps(z0);
+    const __m128 dz1V = _mm_set1_ps(dz1);
+    const __m128 dz2V = _mm_set1_ps(dz2);
+    const __m128i idV = _mm_set1_epi32(static_cast<int>(id));
+    __m128 AV[3], topLeftV[3];
+    for (int k = 0; k < 3; ++k) {
+        AV[k] = _mm_set1_ps(A[k]);
+        topLeftV[k] = _mm_castsi128_ps(_mm_set1_epi32(topLeft[k] ? -1 : 0));
+    }
+
+    // 4 pixel groups start at a multiple of 4 so the tile rows are loaded aligned
+    const int groupX0 = x0 & ~3;
+    for (int y = y0; y <= y1; ++y) {
+        __m128 row[3];
+        for (int k = 0; k < 3; ++k)
+            row[k] = _mm_set1_ps(B[k] * y + C[k]);
+
+        for (int x = groupX0; x <= x1; x += 4) {
+            const __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(column, columnMin), _mm_cmple_ps(column, columnMax));
+            __m128 e[3];
+            for (int k = 0; k < 3; ++k) {
+                // evaluated directly instead of stepping, stepping would round differently per triangle
+                e[k] = _mm_add_ps(_mm_mul_ps(AV[k], column), row[k]);
+                const __m128 edge = _mm_or_ps(_mm_cmpgt_ps(e[k], zero), _mm_and_ps(_mm_cmpeq_ps(e[k], zero), topLeftV[k]));
+                inside = _mm_and_ps(inside, edge);
+            }
+
+            if (_mm_movemask_ps(inside)) {
+                const int offset = y * TILE_SIZE + x;
+                const __m128 b1 = _mm_mul_ps(e[1], invAreaV);
+                const __m128 b2 = _mm_mul_ps(e[2], invAreaV);
+                const __m128 z = _mm_add_ps(z0V, _mm_add_ps(_mm_mul_ps(b1, dz1V), _mm_mul_ps(b2, dz2V)));
+                const __m128 depth = _mm_load_ps(buffer.depth + offset);
+                const __m128 pass = _mm_and_ps(inside, _mm_cmple_ps(z, depth));
+                if (_mm_movemask_ps(pass)) {
+                    const __m128i passI = _mm_castps_si128(pass);
+                    __m128i* triangleP = reinterpret_cast<__m128i*>(buffer.triangle + offset);
+                    _mm_store_ps(buffer.depth + offset, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, depth)));
+                    _mm_store_si128(triangleP, _mm_or_si128(_mm_and_si128(passI, idV), _mm_andnot_si128(passI, _mm_load_si128(triangleP))));
+                    _mm_store_ps(buffer.b1 + offset, _mm_or_ps(_mm_and_ps(pass, b1), _mm_andnot_ps(pass, _mm_load_ps(buffer.b1 + offset))));
+                    _mm_store_ps(buffer.b2 + offset, _mm_or_ps(_mm_and_ps(pass, b2), _mm_andnot_ps(pass, _mm_load_ps(buffer.b2 + offset))));
+                }
+            }
+        }
+    }
+#else
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            float e[3];
+            bool inside = true;
+            for (int k = 0; k < 3; ++k) {
+                e[k] = A[k] * x + (B[k] * y + C[k]);
+                inside = inside && (e[k] > 0.0f || (e[k] == 0.0f && topLeft[k]));
+            }
+            if (!inside)
+                continue;
+
+            const int offset = y * TILE_SIZE + x;
+            const float b1 = e[1] * invArea;
+            const float b2 = e[2] * invArea;
+            const float z = z0 + b1 * dz1 + b2 * dz2;
+            if (z <= buffer.depth[offset]) {
+                buffer.depth[offset] = z;
+                buffer.triangle[offset] = id;
+                buffer.b1[offset] = b1;
+                buffer.b2[offset] = b2;
+            }
+        }
+    }
+#endif
+}
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,101 @@
+#pragma once
+#include "base/Prerequisites.h"
+
+namespace pbr {
+namespace sw {
+
+// post transform vertex, the attributes are the outputs of pbr_model.vert
+struct ClipVertex {
+    vec4 clip;
+    vec3 position;
+    vec2 uv;
+    vec3 normal;
+    vec3 tangent;
+    vec3 bitangent;
+};
+
+// Tile based rasterizer producing a visibility buffer. Triangles are clipped against the near
+// plane, set up and binned into screen tiles in parallel chunks, then every tile is rasterized
+// by one thread, in submission order, with the GL state of the renderer: clockwise front faces,
+// back faces culled, depth test LEQUAL.
+class Rasterizer {
+   public:
+    static constexpr int TILE_SIZE = 64;
+    static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+
+    // screen space triangle, y points down and pixel centers are at .5
+    struct Triangle {
+        float x[3];
+        float y[3];
+        float z[3];  // window depth in [0, 1]
+        float invW[3];
+        float invArea;
+        // screen space barycentrics of vertex 1 and 2 change by these per pixel
+        float dB1dx, dB1dy;
+        float dB2dx, dB2dy;
+        uint32_t vertex[3];
+        int minX, minY, maxX, maxY;
+    };
+
+    // per thread tile memory, one visible triangle and its barycentrics per pixel
+    struct TileBuffer {
+        alignas(16) float depth[TILE_SIZE * TILE_SIZE];
+        alignas(16) uint32_t triangle[TILE_SIZE * TILE_SIZE];
+        alignas(16) float b1[TILE_SIZE * TILE_SIZE];
+        alignas(16) float b2[TILE_SIZE * TILE_SIZE];
+    };
+
+    // instruction set of the edge functions
+    static const char* InstructionSet();
+
+    void Resize(int width, int height);
+    inline int TileCountX() const { return m_tileCountX; }
+    inline int TileCount() const { return m_tileCountX * m_tileCountY; }
+
+    // clips, sets up and bins the triangles, the vertices must outlive the rasterization
+    void Setup(const vector<ClipVertex>& vertices, const vector<uvec3>& indices);
+    void RasterizeTile(int tile, TileBuffer& buffer) const;
+
+    inline const Triangle& GetTriangle(uint32_t id) const {
+        return m_chunks[id >> TRIANGLE_INDEX_BITS].triangles[id & TRIANGLE_INDEX_MASK];
+    }
+    inline const ClipVertex& GetVertex(uint32_t index) const {
+        return index & CLIPPED_VERTEX ? m_clippedVertices[index & ~CLIPPED_VERTEX] : (*m_pVertices)[index];
+    }
+    inline size_t TriangleCount() const {
+        size_t count = 0;
+        for (const Chunk& chunk : m_chunks)
+            count += chunk.triangles.size();
+        return count;
+    }
+
+   private:
+    // triangle ids are the chunk in the high bits and the index in the chunk in the low bits
+    static constexpr int TRIANGLE_INDEX_BITS = 24;
+    static constexpr uint32_t TRIANGLE_INDEX_MASK = (1u << TRIANGLE_INDEX_BITS) - 1;
+    static constexpr int MAX_CHUNK_COUNT = 255;
+    static constexpr uint32_t CLIPPED_VERTEX = 0x80000000u;
+
+    struct Chunk {
+        vector<Triangle> triangles;
+        vector<vector<uint32_t>> bins;  // per tile, indices into triangles
+        vector<uint32_t> nearClipped;   // first indices of the triangles crossing the near plane
+    };
+
+    void setupTriangle(Chunk& chunk, const uint32_t (&vertex)[3], const vec4 (&clip)[3]) const;
+    void clipTriangle(Chunk& chunk, const uvec3& triangle);
+    void rasterizeTriangle(const Triangle& triangle, uint32_t id, int tileX, int tileY, TileBuffer& buffer) const;
+
+   private:
+    int m_width = 0;
+    int m_height = 0;
+    int m_tileCountX = 0;
+    int m_tileCountY = 0;
+    const vector<ClipVertex>* m_pVertices = nullptr;
+    vector<ClipVertex> m_clippedVertices;
+    // the last chunk takes the triangles created by near plane clipping
+    vector<Chunk> m_chunks;
+};
+
+}  // namespace sw
+}  // namespace pbr
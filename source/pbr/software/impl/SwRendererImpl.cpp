@@ -0,0 +1,339 @@
+#include "SwRendererImpl.h"
+#include <glad/glad.h>
+#include <chrono>
+#include "Paths.h"
+#include "Scene.h"
+#include "SwIbl.h"
+#include "Utility.h"
+#include "base/Error.h"
+#include "base/JobSystem.h"
+#include "core/Globals.h"
+#include "core/Renderer.h"
+#include "core/ResourceRegistry.h"
+
+namespace pbr {
+namespace sw {
+
+// fewer samples than prefilter.frag, the pdf based source mip keeps the result smooth
+static constexpr int prefilterSampleCount = 128;
+static constexpr int verticesPerTask = 4096;
+// samples per pixel after which a still path traced view counts as converged
+static constexpr int refinedSampleCount = 1024;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+SwRendererImpl::SwRendererImpl(const Window* pWindow)
+    : m_pWindow(pWindow) {
+}
+
+void SwRendererImpl::Initialize() {
+    for (int i = 0; i < JobSystem::GetSingleton().ThreadCount(); ++i)
+        m_tileBuffers.emplace_back(new Rasterizer::TileBuffer);
+
+    if (!g_headless) {
+        if (gladLoadGL() == 0)
+            THROW_EXCEPTION("GLAD: Failed to load glad functions");
+        glGenFramebuffers(1, &m_presentFramebuffer);
+    }
+
+    Resize(m_pWindow->GetFrameBufferExtent());
+}
+
+void SwRendererImpl::DumpGraphicsCardInfo() {
+    if (g_pathTracing)
+        cout << "Path tracer:       software, " << Rasterizer::InstructionSet() << " BVH traversal" << endl;
+    else
+        cout << "Rasterizer:        software, " << Rasterizer::InstructionSet() << " edge functions" << endl;
+    cout << "Threads:           " << JobSystem::GetSingleton().ThreadCount() << endl;
+    if (!g_headless)
+        cout << "Presenting with:   " << glGetString(GL_RENDERER) << endl;
+}
+
+void SwRendererImpl::PrepareGpuResources() {
+    m_model = utility::LoadModel(g_model_dir.c_str());
+    m_vertices.resize(m_model.vertices.size());
+    loadMaterial();
+
+    if (g_pathTracing) {
+        const auto start = std::chrono::steady_clock::now();
+        m_pathTracer.Initialize(m_model, g_transform);
+        const Bvh& bvh = m_pathTracer.GetBvh();
+        cout << "[Log] BVH of " << m_model.indices.size() << " triangles built in " << static_cast<int>(millisecondsSince(start))
+             << " ms, " << bvh.NodeCount() << " nodes, " << bvh.LeafCount() << " leaves, " << (bvh.SizeInByte() >> 10) << " KB" << endl;
+    }
+
+    auto brdfImage = utility::ReadBrdfLUT(BRDF_LUT, Renderer::brdfLUTImageRes);
+    m_brdfLUT.Create(brdfImage);
+
+    createEnvironment();
+}
+
+void SwRendererImpl::loadMaterial() {
+    struct {
+        const char* file;
+        Texture2D* pTexture;
+    } maps[] = {
+        { "AlbedoMetallic.png", &m_albedoMetallic },
+        { "NormalRoughness.png", &m_normalRoughness },
+        { "EmissiveAO.png", &m_emissiveAO },
+    };
+
+    JobSystem& jobSystem = JobSystem::GetSingleton();
+    JobCounter loaded;
+    for (const auto& map : maps) {
+        const string path = g_model_dir + map.file;
+        if (!utility::FileExists(path))
+            continue;
+        Texture2D* pTexture = map.pTexture;
+        jobSystem.Schedule("decode material", [path, pTexture] {
+            auto image = utility::ReadPng(path);
+            pTexture->Create(image);
+        }, &loaded);
+    }
+    jobSystem.Wait(loaded);
+}
+
+void SwRendererImpl::createEnvironment() {
+    const auto start = std::chrono::steady_clock::now();
+
+    auto envImage = utility::ReadHDRImage(g_env_map_path);
+    // the path tracer samples the image itself, the prefiltered maps are only needed to rasterize
+    if (g_pathTracing) {
+        m_pathTracer.SetEnvironment(envImage);
+        return;
+    }
+
+    m_envMap.Create(Renderer::cubeMapRes);
+    EquirectangularToCubeMap(envImage, m_envMap);
+    envImage.Free();
+
+    m_irradianceMap.Create(Renderer::irradianceMapRes, 1);
+    ConvolveIrradiance(m_envMap, m_irradianceMap);
+
+    m_specularMap.Create(Renderer::specularMapRes, Renderer::specularMapMipLevels);
+    PrefilterSpecular(m_envMap, m_specularMap, prefilterSampleCount);
+
+    cout << "[Log] image based lighting prepared in " << static_cast<int>(millisecondsSince(start)) << " ms" << endl;
+}
+
+void SwRendererImpl::Render(const Camera& camera) {
+    if (m_extent.width <= 0 || m_extent.height <= 0)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    ShadingContext context;
+    context.pAlbedoMetallic = m_albedoMetallic.IsValid() ? &m_albedoMetallic : nullptr;
+    context.pNormalRoughness = m_normalRoughness.IsValid() ? &m_normalRoughness : nullptr;
+    context.pEmissiveAO = m_emissiveAO.IsValid() ? &m_emissiveAO : nullptr;
+    context.pEnvMap = &m_envMap;
+    context.pIrradianceMap = &m_irradianceMap;
+    context.pSpecularMap = &m_specularMap;
+    context.pBrdfLUT = &m_brdfLUT;
+    context.viewPos = vec3(camera.GetViewPos());
+    context.debugView = g_debug;
+    context.lightCount = g_lightCount;
+
+    const mat4 view = camera.ViewMatrix();
+    const mat4 projection = camera.ProjectionMatrixGl();
+    if (g_pathTracing)
+        pathTrace(context, view, projection);
+    else
+        rasterize(context, view, projection);
+
+    m_renderTime += millisecondsSince(start);
+    ++m_renderedFrames;
+
+    if (!g_headless)
+        present();
+}
+
+bool SwRendererImpl::IsRefining() const {
+    return g_pathTracing && m_pathTracer.SampleCount() < refinedSampleCount;
+}
+
+void SwRendererImpl::rasterize(const ShadingContext& context, const mat4& view, const mat4& projection) {
+    transformVertices(projection * view);
+    m_rasterizer.Setup(m_vertices, m_model.indices);
+
+    const PixelRays rays = PixelRays::FromView(view, projection, m_extent);
+    JobSystem::GetSingleton().ParallelFor("raster tile", m_rasterizer.TileCount(), [&](int tile, int workerIndex) {
+        Rasterizer::TileBuffer& buffer = *m_tileBuffers[workerIndex];
+        m_rasterizer.RasterizeTile(tile, buffer);
+        shadeTile(tile, buffer, context, rays);
+    }, 1);
+}
+
+void SwRendererImpl::pathTrace(const ShadingContext& context, const mat4& view, const mat4& projection) {
+    const mat4 viewProjection = projection * view;
+    if (viewProjection != m_pathTracedViewProjection || context.lightCount != m_pathTracedLightCount) {
+        m_pathTracer.Reset();
+        m_pathTracedViewProjection = viewProjection;
+        m_pathTracedLightCount = context.lightCount;
+    }
+    m_pathTracer.Render(context, PixelRays::FromView(view, projection, m_extent), g_samplesPerFrame, m_framebuffer.data());
+}
+
+void SwRendererImpl::transformVertices(const mat4& viewProjection) {
+    const mat4& transform = g_transform;
+    const glm::mat3 rotation(transform);
+    const int count = static_cast<int>(m_model.vertices.size());
+    JobSystem::GetSingleton().ParallelFor("transform vertices", count, [&](int i, int) {
+        const TexturedVertex& in = m_model.vertices[i];
+        ClipVertex& out = m_vertices[i];
+        const vec4 worldPosition = transform * vec4(in.position, 1.0f);
+        out.clip = viewProjection * worldPosition;
+        out.position = vec3(worldPosition);
+        out.uv = in.uv;
+        out.tangent = glm::normalize(rotation * in.tangent);
+        out.bitangent = glm::normalize(rotation * in.bitangent);
+        out.normal = glm::normalize(rotation * in.normal);
+    }, verticesPerTask);
+}
+
+void SwRendererImpl::shadeTile(int tile, const Rasterizer::TileBuffer& buffer, const ShadingContext& context, const PixelRays& rays) {
+    const int tileX = (tile % m_rasterizer.TileCountX()) * Rasterizer::TILE_SIZE;
+    const int tileY = (tile / m_rasterizer.TileCountX()) * Rasterizer::TILE_SIZE;
+    const int width = std::min(Rasterizer::TILE_SIZE, m_extent.width - tileX);
+    const int height = std::min(Rasterizer::TILE_SIZE, m_extent.height - tileY);
+
+    for (int y = 0; y < height; ++y) {
+        uint32_t* row = m_framebuffer.data() + static_cast<size_t>(tileY + y) * m_extent.width + tileX;
+        for (int x = 0; x < width; ++x) {
+            const int offset = y * Rasterizer::TILE_SIZE + x;
+            const uint32_t id = buffer.triangle[offset];
+            if (id == Rasterizer::EMPTY) {
+                const vec3 direction = rays.origin + rays.dx * static_cast<float>(tileX + x) + rays.dy * static_cast<float>(tileY + y);
+                row[x] = PackColor(ShadeBackground(context, direction));
+                continue;
+            }
+
+            // perspective correct barycentrics
+            const Rasterizer::Triangle& triangle = m_rasterizer.GetTriangle(id);
+            const float b1 = buffer.b1[offset];
+            const float b2 = buffer.b2[offset];
+            float w0 = (1.0f - b1 - b2) * triangle.invW[0];
+            float w1 = b1 * triangle.invW[1];
+            float w2 = b2 * triangle.invW[2];
+            const float invSum = 1.0f / (w0 + w1 + w2);
+            w0 *= invSum;
+            w1 *= invSum;
+            w2 *= invSum;
+
+            const ClipVertex& v0 = m_rasterizer.GetVertex(triangle.vertex[0]);
+            const ClipVertex& v1 = m_rasterizer.GetVertex(triangle.vertex[1]);
+            const ClipVertex& v2 = m_rasterizer.GetVertex(triangle.vertex[2]);
+            SurfacePoint surface;
+            surface.position = v0.position * w0 + v1.position * w1 + v2.position * w2;
+            surface.uv = v0.uv * w0 + v1.uv * w1 + v2.uv * w2;
+            surface.tangent = v0.tangent * w0 + v1.tangent * w1 + v2.tangent * w2;
+            surface.bitangent = v0.bitangent * w0 + v1.bitangent * w1 + v2.bitangent * w2;
+            surface.normal = v0.normal * w0 + v1.normal * w1 + v2.normal * w2;
+            row[x] = PackColor(ShadePbrModel(context, surface));
+        }
+    }
+}
+
+void SwRendererImpl::Resize(const Extent2i& extent) {
+    m_extent = extent;
+    m_rasterizer.Resize(extent.width, extent.height);
+    m_pathTracer.Resize(extent.width, extent.height);
+    m_framebuffer.assign(static_cast<size_t>(std::max(extent.width, 0)) * std::max(extent.height, 0), 0);
+    if (!g_headless)
+        resizePresentTexture();
+}
+
+void SwRendererImpl::resizePresentTexture() {
+    ResourceRegistry& registry = ResourceRegistry::GetSingleton();
+    if (m_presentTexture) {
+        registry.Unregister(ResourceKind::TEXTURE, m_presentTexture);
+        glDeleteTextures(1, &m_presentTexture);
+        m_presentTexture = 0;
+    }
+    if (m_extent.width <= 0 || m_extent.height <= 0)
+        return;
+
+    glGenTextures(1, &m_presentTexture);
+    glBindTexture(GL_TEXTURE_2D, m_presentTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_extent.width, m_extent.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_presentFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_presentTexture, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    ResourceInfo info;
+    info.kind = ResourceKind::TEXTURE;
+    info.category = ResourceCategory::RENDER_TARGET;
+    info.name = "software framebuffer";
+    info.format = "GL_RGBA8";
+    info.width = m_extent.width;
+    info.height = m_extent.height;
+    info.sizeInByte = ResourceRegistry::TextureSize(m_extent.width, m_extent.height, 1, 1, 4);
+    registry.Register(m_presentTexture, info);
+}
+
+void SwRendererImpl::present() {
+    const int width = m_extent.width;
+    const int height = m_extent.height;
+    glBindTexture(GL_TEXTURE_2D, m_presentTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m_framebuffer.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_presentFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    // rows are stored top down, GL counts them from the bottom
+    glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void SwRendererImpl::writeOutput() {
+    Image image;
+    image.width = m_extent.width;
+    image.height = m_extent.height;
+    const bool hdr = g_outputPath.size() > 4 && g_outputPath.compare(g_outputPath.size() - 4, 4, ".hdr") == 0;
+    if (hdr) {
+        // unclamped linear radiance for comparisons, only the path tracer keeps it
+        if (!g_pathTracing) {
+            cout << "[Warning] only --path-trace writes hdr images, " << g_outputPath << " is skipped" << endl;
+            return;
+        }
+        vector<float> radiance;
+        m_pathTracer.AverageRadiance(radiance);
+        image.component = 3;
+        image.dataType = DataType::FLOAT_32T;
+        image.Wrap(radiance.data(), radiance.size() * sizeof(float));
+        utility::WriteHdr(g_outputPath, image);
+    } else {
+        image.component = 4;
+        image.dataType = DataType::UINT_8T;
+        image.Wrap(m_framebuffer.data(), m_framebuffer.size() * sizeof(uint32_t));
+        utility::WritePng(g_outputPath, image);
+    }
+    cout << "[Log] last frame written to " << g_outputPath << endl;
+}
+
+void SwRendererImpl::Finalize() {
+    if (m_renderedFrames > 0)
+        cout << "[Log] rendered " << m_renderedFrames << " frames at " << m_extent.width << "x" << m_extent.height << ", "
+             << m_renderTime / m_renderedFrames << " ms per frame" << endl;
+    if (g_pathTracing && m_pathTracer.SampleCount() > 0)
+        cout << "[Log] path traced " << m_pathTracer.SampleCount() << " samples per pixel, "
+             << m_pathTracer.RayCount() / (m_renderTime * 1000.0) << " Mrays/s" << endl;
+
+    if (!g_outputPath.empty() && !m_framebuffer.empty())
+        writeOutput();
+
+    if (m_presentTexture) {
+        ResourceRegistry::GetSingleton().Unregister(ResourceKind::TEXTURE, m_presentTexture);
+        glDeleteTextures(1, &m_presentTexture);
+        m_presentTexture = 0;
+    }
+    if (m_presentFramebuffer) {
+        glDeleteFramebuffers(1, &m_presentFramebuffer);
+        m_presentFramebuffer = 0;
+    }
+}
+
+}  // namespace sw
+}  // namespace pbr
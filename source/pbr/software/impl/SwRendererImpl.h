@@ -0,0 +1,65 @@
+#pragma once
+#include "Mesh.h"
+#include "SwPathTracer.h"
+#include "SwRasterizer.h"
+#include "SwShading.h"
+#include "SwTexture.h"
+#include "core/Camera.h"
+#include "core/Window.h"
+
+namespace pbr {
+namespace sw {
+
+class SwRendererImpl {
+   public:
+    SwRendererImpl(const Window* pWindow);
+    void Initialize();
+    void DumpGraphicsCardInfo();
+    void PrepareGpuResources();
+    void Render(const Camera& camera);
+    void Resize(const Extent2i& extent);
+    bool IsRefining() const;
+    void Finalize();
+
+   private:
+    void loadMaterial();
+    void createEnvironment();
+    void rasterize(const ShadingContext& context, const mat4& view, const mat4& projection);
+    void pathTrace(const ShadingContext& context, const mat4& view, const mat4& projection);
+    void transformVertices(const mat4& viewProjection);
+    void shadeTile(int tile, const Rasterizer::TileBuffer& buffer, const ShadingContext& context, const PixelRays& rays);
+    void writeOutput();
+    void resizePresentTexture();
+    void present();
+
+   private:
+    const Window* m_pWindow;
+    Rasterizer m_rasterizer;
+    vector<unique_ptr<Rasterizer::TileBuffer>> m_tileBuffers;  // one per thread
+    TexturedMesh m_model;
+    vector<ClipVertex> m_vertices;
+    Texture2D m_albedoMetallic;
+    Texture2D m_normalRoughness;
+    Texture2D m_emissiveAO;
+    CubeMap m_envMap;
+    CubeMap m_irradianceMap;
+    CubeMap m_specularMap;
+    BrdfLUT m_brdfLUT;
+    // --path-trace, the accumulation restarts whenever the view or the lights change
+    PathTracer m_pathTracer;
+    mat4 m_pathTracedViewProjection = mat4(0.0f);
+    int m_pathTracedLightCount = -1;
+
+    Extent2i m_extent;
+    vector<uint32_t> m_framebuffer;  // RGBA8, the first row is the top of the image
+
+    int m_renderedFrames = 0;
+    double m_renderTime = 0.0;  // ms
+
+    // the framebuffer is blit to the window through OpenGL, unused when headless
+    uint32_t m_presentTexture = 0;
+    uint32_t m_presentFramebuffer = 0;
+};
+
+}  // namespace sw
+}  // namespace pbr
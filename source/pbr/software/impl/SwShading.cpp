@@ -0,0 +1,141 @@
+#include "SwShading.h"
+#include <cmath>
+#include "Scene.h"
+#include "core/Renderer.h"
+
+namespace pbr {
+namespace sw {
+
+// NDF(n, h, alpha) = alpha^2 / (pi * ((n dot h)^2 * (alpha^2 - 1) + 1)^2)
+float DistributionGGX(const vec3& N, const vec3& H, float roughness) {
+    const float a = roughness * roughness;
+    const float a2 = a * a;
+    const float NdotH = std::max(glm::dot(N, H), 0.0f);
+    float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+    denom = Pi * denom * denom;
+    return a2 / denom;
+}
+
+// G_SchlickGGX(n, v, k) = dot(n, v) / (dot(n, v)(1 - k) + k)
+static float geometrySchlickGGX(float NdotV, float roughness) {
+    const float r = roughness + 1.0f;
+    const float k = (r * r) / 8.0f;
+    return NdotV / (NdotV * (1.0f - k) + k);
+}
+
+float GeometrySmith(float NdotV, float NdotL, float roughness) {
+    return geometrySchlickGGX(NdotV, roughness) * geometrySchlickGGX(NdotL, roughness);
+}
+
+vec3 FresnelSchlick(float cosTheta, const vec3& F0) {
+    return F0 + (1.0f - F0) * std::pow(1.0f - cosTheta, 5.0f);
+}
+
+static vec3 fresnelSchlickRoughness(float cosTheta, const vec3& F0, float roughness) {
+    return F0 + glm::max(vec3(1.0f - roughness) - F0, vec3(0.0f)) * std::pow(1.0f - cosTheta, 5.0f);
+}
+
+vec3 Tonemap(vec3 color) {
+    color = color / (color + 1.0f);
+    return glm::pow(color, vec3(1.0f / 2.2f));
+}
+
+vec3 ShadePbrModel(const ShadingContext& context, const SurfacePoint& surface) {
+    const vec4 albedoMetallic = context.pAlbedoMetallic ? context.pAlbedoMetallic->Sample(surface.uv) : vec4(0.8f, 0.8f, 0.8f, 0.0f);
+    const vec4 normalRoughness = context.pNormalRoughness ? context.pNormalRoughness->Sample(surface.uv) : vec4(0.5f, 0.5f, 1.0f, 0.5f);
+    const vec4 emissiveAO = context.pEmissiveAO ? context.pEmissiveAO->Sample(surface.uv) : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    const vec3 albedo(albedoMetallic);
+    const float metallic = albedoMetallic.w;
+    const float roughness = normalRoughness.w;
+    const float ao = emissiveAO.w;
+    const vec3 emissive(emissiveAO);
+
+    vec3 N;
+    if (context.pNormalRoughness) {
+        const vec3 n = 2.0f * vec3(normalRoughness) - 1.0f;
+        N = glm::normalize(surface.tangent * n.x + surface.bitangent * n.y + surface.normal * n.z);
+    } else
+        N = glm::normalize(surface.normal);
+
+    const vec3 V = glm::normalize(context.viewPos - surface.position);
+    const vec3 R = glm::reflect(-V, N);
+
+    switch (context.debugView) {
+        case 1:
+            return albedo;
+        case 2:
+            return N;
+        case 3:
+            return vec3(metallic);
+        case 4:
+            return vec3(roughness);
+        case 5:
+            return vec3(ao);
+        case 6:
+            return emissive;
+        default:
+            break;
+    }
+
+    const vec3 F0 = glm::mix(vec3(0.04f), albedo, metallic);
+    const float NdotV = glm::clamp(glm::dot(N, V), 0.0f, 1.0f);
+
+    vec3 Lo(0.0f);
+    for (int i = 0; i < context.lightCount; ++i) {
+        const Light& light = g_lights[i];
+        const vec3 delta = light.position - surface.position;
+        const vec3 L = glm::normalize(delta);
+        const vec3 H = glm::normalize(V + L);
+        const float distance = glm::length(delta);
+        const vec3 radiance = light.color / (distance * distance);
+
+        const float NDF = DistributionGGX(N, H, roughness);
+        const float NdotL = std::max(glm::dot(N, L), 0.0f);
+        const float G = GeometrySmith(std::max(glm::dot(N, V), 0.0f), NdotL, roughness);
+        const vec3 F = FresnelSchlick(glm::clamp(glm::dot(H, V), 0.0f, 1.0f), F0);
+        const float denom = 4.0f * std::max(glm::dot(N, V), 0.0f) * NdotL;
+        const vec3 specular = NDF * G * F / std::max(denom, 0.001f);
+
+        const vec3 kD = (vec3(1.0f) - F) * (1.0f - metallic);
+        Lo += (kD * albedo / Pi + specular) * radiance * NdotL;
+    }
+
+    // image based ambient lighting
+    const vec3 F = fresnelSchlickRoughness(NdotV, F0, roughness);
+    const vec3 kD = (vec3(1.0f) - F) * (1.0f - metallic);
+    const vec3 irradiance = context.pIrradianceMap->Sample(N, 0.0f);
+    const vec3 diffuse = irradiance * albedo;
+
+    const vec3 prefilteredColor = context.pSpecularMap->Sample(R, roughness * Renderer::maxReflectionLod);
+    const vec2 brdf = context.pBrdfLUT->Sample(vec2(NdotV, 1.0f - roughness));
+    const vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
+    const vec3 ambient = (kD * diffuse + specular) * ao;
+
+    return Tonemap(ambient + Lo + glm::pow(emissive, vec3(2.2f)));
+}
+
+vec3 ShadeBackground(const ShadingContext& context, const vec3& direction) {
+    return Tonemap(context.pEnvMap->Sample(direction, 0.0f));
+}
+
+PixelRays PixelRays::FromView(const mat4& view, const mat4& projection, const Extent2i& extent) {
+    const float invWidth = 1.0f / extent.width;
+    const float invHeight = 1.0f / extent.height;
+    const vec3 right = vec3(view[0][0], view[1][0], view[2][0]) / projection[0][0];
+    const vec3 up = vec3(view[0][1], view[1][1], view[2][1]) / projection[1][1];
+    const vec3 forward = -vec3(view[0][2], view[1][2], view[2][2]);
+    PixelRays rays;
+    rays.origin = forward + right * (invWidth - 1.0f) + up * (1.0f - invHeight);
+    rays.dx = right * (2.0f * invWidth);
+    rays.dy = up * (-2.0f * invHeight);
+    return rays;
+}
+
+uint32_t PackColor(const vec3& color) {
+    const vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return static_cast<uint32_t>(c.x) | (static_cast<uint32_t>(c.y) << 8) | (static_cast<uint32_t>(c.z) << 16) | 0xFF000000u;
+}
+
+}  // namespace sw
+}  // namespace pbr
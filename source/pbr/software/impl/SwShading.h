@@ -0,0 +1,56 @@
+#pragma once
+#include "SwTexture.h"
+
+namespace pbr {
+namespace sw {
+
+// inputs of pbr_model.frag that stay constant during a frame
+struct ShadingContext {
+    // null when the model comes without the map
+    const Texture2D* pAlbedoMetallic = nullptr;
+    const Texture2D* pNormalRoughness = nullptr;
+    const Texture2D* pEmissiveAO = nullptr;
+    const CubeMap* pEnvMap = nullptr;
+    const CubeMap* pIrradianceMap = nullptr;
+    const CubeMap* pSpecularMap = nullptr;
+    const BrdfLUT* pBrdfLUT = nullptr;
+    vec3 viewPos;
+    int debugView = 0;
+    int lightCount = 0;
+};
+
+// interpolated outputs of pbr_model.vert
+struct SurfacePoint {
+    vec3 position;
+    vec2 uv;
+    vec3 tangent;
+    vec3 bitangent;
+    vec3 normal;
+};
+
+// world space direction through the first pixel center and its change per pixel, background.vert
+// only keeps the rotation of the view
+struct PixelRays {
+    vec3 origin;
+    vec3 dx;
+    vec3 dy;
+
+    static PixelRays FromView(const mat4& view, const mat4& projection, const Extent2i& extent);
+};
+
+// terms of the analytic light loop in pbr_model.frag
+extern float DistributionGGX(const vec3& N, const vec3& H, float roughness);
+extern float GeometrySmith(float NdotV, float NdotL, float roughness);
+extern vec3 FresnelSchlick(float cosTheta, const vec3& F0);
+// Reinhard and gamma 2.2
+extern vec3 Tonemap(vec3 color);
+
+// pbr_model.frag, returns the tonemapped and gamma corrected color
+extern vec3 ShadePbrModel(const ShadingContext& context, const SurfacePoint& surface);
+// background.frag
+extern vec3 ShadeBackground(const ShadingContext& context, const vec3& direction);
+// RGBA8 with opaque alpha, the byte order of the framebuffer
+extern uint32_t PackColor(const vec3& color);
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,9 @@
+#pragma once
+
+// SSE2 is part of x86-64, other targets take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PBR_SW_SSE 1
+#include <emmintrin.h>
+#else
+#define PBR_SW_SSE 0
+#endif
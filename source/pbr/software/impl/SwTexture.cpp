@@ -0,0 +1,196 @@
+#include "SwTexture.h"
+#include <cmath>
+#include "ImageKernels.h"
+#include "base/Error.h"
+
+namespace pbr {
+namespace sw {
+
+static const float* unormTable() {
+    static float sTable[256];
+    static bool sInitialized = false;
+    if (!sInitialized) {
+        for (int i = 0; i < 256; ++i)
+            sTable[i] = i / 255.0f;
+        sInitialized = true;
+    }
+    return sTable;
+}
+
+static inline vec4 unpackUnorm(uint32_t texel) {
+    static const float* sTable = unormTable();
+    return vec4(sTable[texel & 0xFF], sTable[(texel >> 8) & 0xFF], sTable[(texel >> 16) & 0xFF], sTable[texel >> 24]);
+}
+
+static inline int wrap(int i, int size) {
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+void Texture2D::Create(const Image& image) {
+    if (image.dataType != DataType::UINT_8T || (image.component != 3 && image.component != 4))
+        THROW_EXCEPTION("software: texture expects an 8 bit RGB or RGBA image");
+
+    m_width = image.width;
+    m_height = image.height;
+    m_texels.resize(static_cast<size_t>(m_width) * m_height);
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(image.buffer.pData);
+    for (size_t i = 0; i < m_texels.size(); ++i, src += image.component) {
+        const uint32_t alpha = image.component == 4 ? src[3] : 0xFF;
+        m_texels[i] = src[0] | (src[1] << 8) | (src[2] << 16) | (alpha << 24);
+    }
+}
+
+vec4 Texture2D::Sample(const vec2& uv) const {
+    const float x = uv.x * m_width - 0.5f;
+    const float y = uv.y * m_height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float tx = x - fx;
+    const float ty = y - fy;
+    const int x0 = wrap(static_cast<int>(fx), m_width);
+    const int y0 = wrap(static_cast<int>(fy), m_height);
+    const int x1 = x0 + 1 == m_width ? 0 : x0 + 1;
+    const int y1 = y0 + 1 == m_height ? 0 : y0 + 1;
+    const uint32_t* row0 = m_texels.data() + y0 * m_width;
+    const uint32_t* row1 = m_texels.data() + y1 * m_width;
+    const vec4 top = glm::mix(unpackUnorm(row0[x0]), unpackUnorm(row0[x1]), tx);
+    const vec4 bottom = glm::mix(unpackUnorm(row1[x0]), unpackUnorm(row1[x1]), tx);
+    return glm::mix(top, bottom, ty);
+}
+
+void CubeMap::Create(int size, int mipLevels) {
+    m_size = size;
+    m_mipLevels = mipLevels;
+    if (m_mipLevels == 0)
+        while ((size >> m_mipLevels) > 0)
+            ++m_mipLevels;
+
+    m_faces.assign(6 * m_mipLevels, {});
+    for (int mip = 0; mip < m_mipLevels; ++mip)
+        for (int face = 0; face < 6; ++face)
+            m_faces[mip * 6 + face].resize(static_cast<size_t>(Size(mip)) * Size(mip));
+}
+
+vec3 CubeMap::Sample(const vec3& direction, float lod) const {
+    vec2 st;
+    const int face = DirectionToFace(direction, st);
+    lod = glm::clamp(lod, 0.0f, static_cast<float>(m_mipLevels - 1));
+    const int mip = static_cast<int>(lod);
+    const float t = lod - mip;
+    const vec3 color = sampleBilinear(face, mip, st);
+    if (t == 0.0f)
+        return color;
+    return glm::mix(color, sampleBilinear(face, mip + 1, st), t);
+}
+
+vec3 CubeMap::sampleBilinear(int face, int mip, const vec2& st) const {
+    const int size = Size(mip);
+    const float x = glm::clamp(st.x * size - 0.5f, 0.0f, size - 1.0f);
+    const float y = glm::clamp(st.y * size - 0.5f, 0.0f, size - 1.0f);
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const int x1 = std::min(x0 + 1, size - 1);
+    const int y1 = std::min(y0 + 1, size - 1);
+    const float tx = x - x0;
+    const float ty = y - y0;
+    const vec3* texels = Face(face, mip);
+    const vec3 top = glm::mix(texels[y0 * size + x0], texels[y0 * size + x1], tx);
+    const vec3 bottom = glm::mix(texels[y1 * size + x0], texels[y1 * size + x1], tx);
+    return glm::mix(top, bottom, ty);
+}
+
+void CubeMap::GenerateMips() {
+    for (int mip = 1; mip < m_mipLevels; ++mip) {
+        const int size = Size(mip);
+        const int srcSize = Size(mip - 1);
+        for (int face = 0; face < 6; ++face) {
+            const vec3* src = Face(face, mip - 1);
+            vec3* dst = Face(face, mip);
+            for (int y = 0; y < size; ++y) {
+                const vec3* row0 = src + std::min(2 * y, srcSize - 1) * srcSize;
+                const vec3* row1 = src + std::min(2 * y + 1, srcSize - 1) * srcSize;
+                for (int x = 0; x < size; ++x) {
+                    const int x0 = std::min(2 * x, srcSize - 1);
+                    const int x1 = std::min(2 * x + 1, srcSize - 1);
+                    dst[y * size + x] = 0.25f * (row0[x0] + row0[x1] + row1[x0] + row1[x1]);
+                }
+            }
+        }
+    }
+}
+
+size_t CubeMap::SizeInByte() const {
+    size_t size = 0;
+    for (const auto& face : m_faces)
+        size += face.size() * sizeof(vec3);
+    return size;
+}
+
+// cube map face selection of the OpenGL specification, major axis and sc, tc per face
+int CubeMap::DirectionToFace(const vec3& d, vec2& st) {
+    const vec3 a = glm::abs(d);
+    int face;
+    float sc, tc, ma;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = d.x >= 0.0f ? 0 : 1;
+        sc = d.x >= 0.0f ? -d.z : d.z;
+        tc = -d.y;
+        ma = a.x;
+    } else if (a.y >= a.z) {
+        face = d.y >= 0.0f ? 2 : 3;
+        sc = d.x;
+        tc = d.y >= 0.0f ? d.z : -d.z;
+        ma = a.y;
+    } else {
+        face = d.z >= 0.0f ? 4 : 5;
+        sc = d.z >= 0.0f ? d.x : -d.x;
+        tc = -d.y;
+        ma = a.z;
+    }
+    st = vec2(0.5f * (sc / ma + 1.0f), 0.5f * (tc / ma + 1.0f));
+    return face;
+}
+
+vec3 CubeMap::TexelDirection(int face, const vec2& st) {
+    const float sc = 2.0f * st.x - 1.0f;
+    const float tc = 2.0f * st.y - 1.0f;
+    switch (face) {
+        case 0:
+            return vec3(1.0f, -tc, -sc);
+        case 1:
+            return vec3(-1.0f, -tc, sc);
+        case 2:
+            return vec3(sc, 1.0f, tc);
+        case 3:
+            return vec3(sc, -1.0f, -tc);
+        case 4:
+            return vec3(sc, -tc, 1.0f);
+        default:
+            return vec3(-sc, -tc, -1.0f);
+    }
+}
+
+void BrdfLUT::Create(const Image& image) {
+    if (image.dataType != DataType::FLOAT_16T || image.component != 2 || image.width != image.height)
+        THROW_EXCEPTION("software: brdf lut expects a square half float RG image");
+
+    m_size = image.width;
+    m_texels.resize(static_cast<size_t>(m_size) * m_size);
+    kernels::HalfToFloat(reinterpret_cast<const half_t*>(image.buffer.pData), &m_texels[0].x, 2 * m_texels.size());
+}
+
+vec2 BrdfLUT::Sample(const vec2& uv) const {
+    const float x = glm::clamp(uv.x * m_size - 0.5f, 0.0f, m_size - 1.0f);
+    const float y = glm::clamp(uv.y * m_size - 0.5f, 0.0f, m_size - 1.0f);
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const int x1 = std::min(x0 + 1, m_size - 1);
+    const int y1 = std::min(y0 + 1, m_size - 1);
+    const vec2 top = glm::mix(m_texels[y0 * m_size + x0], m_texels[y0 * m_size + x1], x - x0);
+    const vec2 bottom = glm::mix(m_texels[y1 * m_size + x0], m_texels[y1 * m_size + x1], x - x0);
+    return glm::mix(top, bottom, y - y0);
+}
+
+}  // namespace sw
+}  // namespace pbr
@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include "base/Definitions.h"
+
+namespace pbr {
+namespace sw {
+
+// RGBA8 texture filtered bilinearly with repeat wrapping. The GL renderer samples the material
+// textures with GL_LINEAR minification, so level 0 is all there is.
+class Texture2D {
+   public:
+    // 8 bit images with 3 or 4 components
+    void Create(const Image& image);
+    inline bool IsValid() const { return !m_texels.empty(); }
+    vec4 Sample(const vec2& uv) const;
+    inline size_t SizeInByte() const { return m_texels.size() * sizeof(uint32_t); }
+
+   private:
+    int m_width = 0;
+    int m_height = 0;
+    vector<uint32_t> m_texels;
+};
+
+// Float RGB cube map with mips, faces follow the GL order and orientation (+X, -X, +Y, -Y, +Z, -Z).
+// Like GL without GL_TEXTURE_CUBE_MAP_SEAMLESS, texels are not filtered across face edges.
+class CubeMap {
+   public:
+    // 0 mip levels creates the full chain
+    void Create(int size, int mipLevels = 0);
+    inline int Size(int mip = 0) const { return std::max(m_size >> mip, 1); }
+    inline int MipLevels() const { return m_mipLevels; }
+    inline vec3* Face(int face, int mip = 0) { return m_faces[mip * 6 + face].data(); }
+    inline const vec3* Face(int face, int mip = 0) const { return m_faces[mip * 6 + face].data(); }
+    vec3 Sample(const vec3& direction, float lod) const;
+    // box filter every level from the one above, as glGenerateMipmap does
+    void GenerateMips();
+    size_t SizeInByte() const;
+
+    // face of a direction, st in [0, 1] on that face
+    static int DirectionToFace(const vec3& direction, vec2& st);
+    // unnormalized direction through st of a face
+    static vec3 TexelDirection(int face, const vec2& st);
+
+   private:
+    vec3 sampleBilinear(int face, int mip, const vec2& st) const;
+
+   private:
+    int m_size = 0;
+    int m_mipLevels = 0;
+    vector<vector<vec3>> m_faces;  // [mip * 6 + face]
+};
+
+// Two channel lookup table filtered bilinearly with clamping, the split sum BRDF LUT.
+class BrdfLUT {
+   public:
+    // the half float image of utility::ReadBrdfLUT
+    void Create(const Image& image);
+    vec2 Sample(const vec2& uv) const;
+
+   private:
+    int m_size = 0;
+    vector<vec2> m_texels;
+};
+
+}  // namespace sw
+}  // namespace pbr
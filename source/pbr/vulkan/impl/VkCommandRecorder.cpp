@@ -0,0 +1,134 @@
+#include "VkCommandRecorder.h"
+#include <algorithm>
+
+namespace pbr {
+namespace vk {
+
+void CommandRecorder::Initialize(const DeviceContext& context, int framesInFlight, int threadCount) {
+    m_device = context.device;
+    if (threadCount <= 0)
+        threadCount = std::min(static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)), MAX_THREADS);
+
+    m_pools.resize(threadCount);
+    for (vector<FramePool>& framePools : m_pools) {
+        framePools.resize(framesInFlight);
+        for (FramePool& framePool : framePools) {
+            VkCommandPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+            createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            createInfo.queueFamilyIndex = context.queueFamily;
+            VK_THROW_IF_FAILED(vkCreateCommandPool(m_device, &createInfo, nullptr, &framePool.pool), "Failed to create command pool");
+        }
+    }
+
+    m_quit = false;
+    for (int i = 0; i < threadCount; ++i)
+        m_workers.emplace_back(&CommandRecorder::workerMain, this, i);
+}
+
+void CommandRecorder::Finalize() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    // destroying a pool frees its command buffers
+    for (vector<FramePool>& framePools : m_pools)
+        for (FramePool& framePool : framePools)
+            vkDestroyCommandPool(m_device, framePool.pool, nullptr);
+    m_pools.clear();
+}
+
+void CommandRecorder::BeginFrame(int frameIndex) {
+    m_frameIndex = frameIndex;
+    // the owning worker resets the pool, command pools are externally synchronized
+    for (vector<FramePool>& framePools : m_pools)
+        framePools[frameIndex].resetPending = true;
+}
+
+void CommandRecorder::Record(const VkCommandBufferInheritanceInfo& inheritance, const vector<Task>& tasks, vector<VkCommandBuffer>& commandBuffers) {
+    commandBuffers.assign(tasks.size(), VK_NULL_HANDLE);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pInheritance = &inheritance;
+        m_pTasks = &tasks;
+        m_pCommandBuffers = &commandBuffers;
+        m_error = nullptr;
+        m_busyWorkers = ThreadCount();
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_pTasks = nullptr;
+    if (m_error)
+        std::rethrow_exception(m_error);
+}
+
+void CommandRecorder::workerMain(int threadIndex) {
+    uint64_t generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+            if (m_quit)
+                return;
+            generation = m_generation;
+        }
+
+        try {
+            recordTasks(threadIndex);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busyWorkers;
+        }
+        m_done.notify_one();
+    }
+}
+
+void CommandRecorder::recordTasks(int threadIndex) {
+    FramePool& framePool = m_pools[threadIndex][m_frameIndex];
+    if (framePool.resetPending) {
+        VK_THROW_IF_FAILED(vkResetCommandPool(m_device, framePool.pool, 0), "Failed to reset command pool");
+        framePool.usedCount = 0;
+        framePool.resetPending = false;
+    }
+
+    const vector<Task>& tasks = *m_pTasks;
+    for (size_t i = threadIndex; i < tasks.size(); i += m_pools.size()) {
+        VkCommandBuffer commandBuffer = acquireCommandBuffer(framePool);
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = m_pInheritance;
+        VK_THROW_IF_FAILED(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Failed to begin secondary command buffer");
+        tasks[i](commandBuffer);
+        VK_THROW_IF_FAILED(vkEndCommandBuffer(commandBuffer), "Failed to end secondary command buffer");
+        // every task writes its own slot
+        (*m_pCommandBuffers)[i] = commandBuffer;
+    }
+}
+
+VkCommandBuffer CommandRecorder::acquireCommandBuffer(FramePool& framePool) {
+    if (framePool.usedCount == framePool.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocateInfo.commandPool = framePool.pool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocateInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VK_THROW_IF_FAILED(vkAllocateCommandBuffers(m_device, &allocateInfo, &commandBuffer), "Failed to allocate secondary command buffer");
+        framePool.commandBuffers.push_back(commandBuffer);
+    }
+    return framePool.commandBuffers[framePool.usedCount++];
+}
+
+}  // namespace vk
+}  // namespace pbr
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "VkHelpers.h"
+
+namespace pbr {
+namespace vk {
+
+// Records secondary command buffers on a fixed set of worker threads. Every worker owns one
+// command pool per frame in flight, a pool is only reset by its owner once the fence of its
+// frame signalled, so pools are never shared between threads or with the GPU.
+class CommandRecorder {
+   public:
+    static constexpr int MAX_THREADS = 4;
+    typedef std::function<void(VkCommandBuffer)> Task;
+
+    // 0 uses up to MAX_THREADS hardware threads
+    void Initialize(const DeviceContext& context, int framesInFlight, int threadCount = 0);
+    void Finalize();
+    inline int ThreadCount() const { return static_cast<int>(m_workers.size()); }
+
+    // the fence of frameIndex must have signalled
+    void BeginFrame(int frameIndex);
+    // task i is recorded by worker i % ThreadCount() into its own secondary command buffer that
+    // continues the render pass of inheritance, the buffers are returned in task order
+    void Record(const VkCommandBufferInheritanceInfo& inheritance, const vector<Task>& tasks, vector<VkCommandBuffer>& commandBuffers);
+
+   private:
+    struct FramePool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        vector<VkCommandBuffer> commandBuffers;
+        size_t usedCount = 0;
+        bool resetPending = false;
+    };
+
+    void workerMain(int threadIndex);
+    void recordTasks(int threadIndex);
+    VkCommandBuffer acquireCommandBuffer(FramePool& framePool);
+
+   private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    vector<std::thread> m_workers;
+    vector<vector<FramePool>> m_pools;  // [thread][frame]
+    int m_frameIndex = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const VkCommandBufferInheritanceInfo* m_pInheritance = nullptr;
+    const vector<Task>* m_pTasks = nullptr;
+    vector<VkCommandBuffer>* m_pCommandBuffers = nullptr;
+    std::exception_ptr m_error;
+    int m_busyWorkers = 0;
+    uint64_t m_generation = 0;
+    bool m_quit = false;
+};
+
+}  // namespace vk
+}  // namespace pbr
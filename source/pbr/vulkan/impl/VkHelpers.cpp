@@ -0,0 +1,327 @@
+#include "VkHelpers.h"
+#include <atomic>
+#include <cstring>
+#include "Paths.h"
+#include "Utility.h"
+
+namespace pbr {
+namespace vk {
+
+// vulkan handles are 64-bit, the registry keys are not
+static uint32_t nextResourceId() {
+    static std::atomic<uint32_t> sNextId { 1 };
+    return sNextId++;
+}
+
+const char* ResultToString(VkResult result) {
+    switch (result) {
+        case VK_SUCCESS:
+            return "VK_SUCCESS";
+        case VK_NOT_READY:
+            return "VK_NOT_READY";
+        case VK_TIMEOUT:
+            return "VK_TIMEOUT";
+        case VK_INCOMPLETE:
+            return "VK_INCOMPLETE";
+        case VK_ERROR_OUT_OF_HOST_MEMORY:
+            return "VK_ERROR_OUT_OF_HOST_MEMORY";
+        case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+            return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+        case VK_ERROR_INITIALIZATION_FAILED:
+            return "VK_ERROR_INITIALIZATION_FAILED";
+        case VK_ERROR_DEVICE_LOST:
+            return "VK_ERROR_DEVICE_LOST";
+        case VK_ERROR_MEMORY_MAP_FAILED:
+            return "VK_ERROR_MEMORY_MAP_FAILED";
+        case VK_ERROR_LAYER_NOT_PRESENT:
+            return "VK_ERROR_LAYER_NOT_PRESENT";
+        case VK_ERROR_EXTENSION_NOT_PRESENT:
+            return "VK_ERROR_EXTENSION_NOT_PRESENT";
+        case VK_ERROR_FEATURE_NOT_PRESENT:
+            return "VK_ERROR_FEATURE_NOT_PRESENT";
+        case VK_ERROR_INCOMPATIBLE_DRIVER:
+            return "VK_ERROR_INCOMPATIBLE_DRIVER";
+        case VK_ERROR_FORMAT_NOT_SUPPORTED:
+            return "VK_ERROR_FORMAT_NOT_SUPPORTED";
+        case VK_ERROR_SURFACE_LOST_KHR:
+            return "VK_ERROR_SURFACE_LOST_KHR";
+        case VK_SUBOPTIMAL_KHR:
+            return "VK_SUBOPTIMAL_KHR";
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            return "VK_ERROR_OUT_OF_DATE_KHR";
+        default:
+            return "unknown VkResult";
+    }
+}
+
+size_t FormatSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+const char* FormatToString(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            return "RGBA8";
+        case VK_FORMAT_B8G8R8A8_UNORM:
+            return "BGRA8";
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return "BGRA8 sRGB";
+        case VK_FORMAT_R16G16_SFLOAT:
+            return "RG16F";
+        case VK_FORMAT_D32_SFLOAT:
+            return "DEPTH32F";
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return "RGBA16F";
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return "RGBA32F";
+        default:
+            return "unknown";
+    }
+}
+
+uint32_t FindMemoryType(const DeviceContext& context, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    const VkPhysicalDeviceMemoryProperties& memory = context.memoryProperties;
+    for (uint32_t i = 0; i < memory.memoryTypeCount; ++i) {
+        if ((typeBits & (1u << i)) && (memory.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+    THROW_EXCEPTION("Vulkan: no memory type with the requested properties");
+}
+
+static VkDeviceMemory allocateMemory(const DeviceContext& context, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties) {
+    VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = FindMemoryType(context, requirements.memoryTypeBits, properties);
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkAllocateMemory(context.device, &allocateInfo, nullptr, &memory), "Failed to allocate memory");
+    return memory;
+}
+
+VulkanBuffer CreateBuffer(const DeviceContext& context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, ResourceCategory category, const char* name) {
+    VulkanBuffer buffer;
+    buffer.size = size;
+
+    VkBufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    createInfo.size = size;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_THROW_IF_FAILED(vkCreateBuffer(context.device, &createInfo, nullptr, &buffer.handle), "Failed to create buffer");
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(context.device, buffer.handle, &requirements);
+    buffer.memory = allocateMemory(context, requirements, properties);
+    VK_THROW_IF_FAILED(vkBindBufferMemory(context.device, buffer.handle, buffer.memory, 0), "Failed to bind buffer memory");
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        VK_THROW_IF_FAILED(vkMapMemory(context.device, buffer.memory, 0, size, 0, &buffer.pMapped), "Failed to map buffer");
+
+    buffer.id = nextResourceId();
+    ResourceInfo info;
+    info.kind = ResourceKind::BUFFER;
+    info.category = category;
+    info.name = name;
+    info.sizeInByte = static_cast<size_t>(requirements.size);
+    ResourceRegistry::GetSingleton().Register(buffer.id, info);
+    return buffer;
+}
+
+VulkanBuffer CreateDeviceBuffer(const DeviceContext& context, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, ResourceCategory category, const char* name) {
+    VulkanBuffer staging = CreateBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        category, "staging");
+    memcpy(staging.pMapped, data, static_cast<size_t>(size));
+
+    VulkanBuffer buffer = CreateBuffer(context, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category, name);
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(context);
+    VkBufferCopy region = { 0, 0, size };
+    vkCmdCopyBuffer(commandBuffer, staging.handle, buffer.handle, 1, &region);
+    EndOneShotCommands(context, commandBuffer);
+
+    DestroyBuffer(context, staging);
+    return buffer;
+}
+
+void DestroyBuffer(const DeviceContext& context, VulkanBuffer& buffer) {
+    if (buffer.handle == VK_NULL_HANDLE)
+        return;
+    ResourceRegistry::GetSingleton().Unregister(ResourceKind::BUFFER, buffer.id);
+    vkDestroyBuffer(context.device, buffer.handle, nullptr);
+    vkFreeMemory(context.device, buffer.memory, nullptr);
+    buffer = VulkanBuffer();
+}
+
+static VkImageView createView(const DeviceContext& context, const VulkanTexture& texture, VkImageViewType type,
+                              int baseMip, int mipCount, int baseLayer, int layerCount) {
+    VkImageViewCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    createInfo.image = texture.image;
+    createInfo.viewType = type;
+    createInfo.format = texture.format;
+    createInfo.subresourceRange.aspectMask = texture.format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.subresourceRange.baseMipLevel = baseMip;
+    createInfo.subresourceRange.levelCount = mipCount;
+    createInfo.subresourceRange.baseArrayLayer = baseLayer;
+    createInfo.subresourceRange.layerCount = layerCount;
+    VkImageView view = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkCreateImageView(context.device, &createInfo, nullptr, &view), "Failed to create image view");
+    return view;
+}
+
+VulkanTexture CreateTexture(const DeviceContext& context, VkFormat format, int width, int height, int layers, int mipLevels, VkImageUsageFlags usage, ResourceCategory category, const char* name) {
+    VulkanTexture texture;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.layers = layers;
+    texture.mipLevels = mipLevels;
+
+    VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    createInfo.flags = layers == 6 ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+    createInfo.imageType = VK_IMAGE_TYPE_2D;
+    createInfo.format = format;
+    createInfo.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+    createInfo.mipLevels = mipLevels;
+    createInfo.arrayLayers = layers;
+    createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    createInfo.usage = usage;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_THROW_IF_FAILED(vkCreateImage(context.device, &createInfo, nullptr, &texture.image), string("Failed to create image ") + name);
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(context.device, texture.image, &requirements);
+    texture.memory = allocateMemory(context, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_THROW_IF_FAILED(vkBindImageMemory(context.device, texture.image, texture.memory, 0), "Failed to bind image memory");
+
+    texture.view = createView(context, texture, layers == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D, 0, mipLevels, 0, layers);
+
+    texture.id = nextResourceId();
+    ResourceInfo info;
+    info.kind = ResourceKind::TEXTURE;
+    info.category = category;
+    info.name = name;
+    info.format = FormatToString(format);
+    info.width = width;
+    info.height = height;
+    info.layers = layers;
+    info.mipLevels = mipLevels;
+    info.sizeInByte = ResourceRegistry::TextureSize(width, height, layers, mipLevels, FormatSize(format));
+    ResourceRegistry::GetSingleton().Register(texture.id, info);
+    return texture;
+}
+
+void UploadTexture(const DeviceContext& context, VulkanTexture& texture, const void* data, size_t sizeInByte) {
+    assert(sizeInByte == static_cast<size_t>(texture.width) * texture.height * texture.layers * FormatSize(texture.format));
+    VulkanBuffer staging = CreateBuffer(context, sizeInByte, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        ResourceCategory::MATERIAL, "staging");
+    memcpy(staging.pMapped, data, sizeInByte);
+
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(context);
+    TransitionImage(commandBuffer, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, texture.layers,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = texture.layers;
+    region.imageExtent = { static_cast<uint32_t>(texture.width), static_cast<uint32_t>(texture.height), 1 };
+    vkCmdCopyBufferToImage(commandBuffer, staging.handle, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    TransitionImage(commandBuffer, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, texture.layers,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    EndOneShotCommands(context, commandBuffer);
+
+    DestroyBuffer(context, staging);
+}
+
+VkImageView CreateAttachmentView(const DeviceContext& context, const VulkanTexture& texture, int mipLevel, int layer) {
+    return createView(context, texture, VK_IMAGE_VIEW_TYPE_2D, mipLevel, 1, layer, 1);
+}
+
+void DestroyTexture(const DeviceContext& context, VulkanTexture& texture) {
+    if (texture.image == VK_NULL_HANDLE)
+        return;
+    ResourceRegistry::GetSingleton().Unregister(ResourceKind::TEXTURE, texture.id);
+    vkDestroyImageView(context.device, texture.view, nullptr);
+    vkDestroyImage(context.device, texture.image, nullptr);
+    vkFreeMemory(context.device, texture.memory, nullptr);
+    texture = VulkanTexture();
+}
+
+VkCommandBuffer BeginOneShotCommands(const DeviceContext& context) {
+    VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    allocateInfo.commandPool = context.commandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkAllocateCommandBuffers(context.device, &allocateInfo, &commandBuffer), "Failed to allocate command buffer");
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_THROW_IF_FAILED(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Failed to begin command buffer");
+    return commandBuffer;
+}
+
+void EndOneShotCommands(const DeviceContext& context, VkCommandBuffer commandBuffer) {
+    VK_THROW_IF_FAILED(vkEndCommandBuffer(commandBuffer), "Failed to end command buffer");
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    VK_THROW_IF_FAILED(vkQueueSubmit(context.queue, 1, &submitInfo, VK_NULL_HANDLE), "Failed to submit commands");
+    VK_THROW_IF_FAILED(vkQueueWaitIdle(context.queue), "Failed to wait for the queue");
+    vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
+}
+
+void TransitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+                     uint32_t baseMip, uint32_t mipCount, uint32_t layerCount,
+                     VkImageLayout oldLayout, VkImageLayout newLayout,
+                     VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                     VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = baseMip;
+    barrier.subresourceRange.levelCount = mipCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = layerCount;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+VkShaderModule CreateShaderModule(VkDevice device, const char* name) {
+    const string path = string(SPIRV_DIR) + name + ".spv";
+    // vector storage comes from operator new, aligned well enough for the uint32_t words
+    const vector<char> code = utility::ReadBinaryFile(path);
+    if (code.empty() || code.size() % sizeof(uint32_t) != 0)
+        THROW_EXCEPTION("Vulkan: " + path + " is not a SPIR-V binary");
+
+    VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule module = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkCreateShaderModule(device, &createInfo, nullptr, &module), "Failed to create shader module " + path);
+    return module;
+}
+
+}  // namespace vk
+}  // namespace pbr
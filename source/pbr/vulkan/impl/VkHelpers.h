@@ -0,0 +1,79 @@
+#pragma once
+#include "VkPrerequisites.h"
+#include "base/Definitions.h"
+#include "core/ResourceRegistry.h"
+
+namespace pbr {
+namespace vk {
+
+// device objects the helpers below need, owned by VkRendererImpl
+struct DeviceContext {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    // one shot commands, only used by the main thread
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+};
+
+struct VulkanBuffer {
+    VkBuffer handle = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* pMapped = nullptr;  // host visible buffers stay mapped
+    uint32_t id = 0;
+};
+
+struct VulkanTexture {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;  // all mips and layers, a cube view for six layers
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    int width = 0;
+    int height = 0;
+    int layers = 1;
+    int mipLevels = 1;
+    uint32_t id = 0;
+};
+
+struct PerDrawData {
+    VulkanBuffer vertexBuffer;
+    VulkanBuffer indexBuffer;
+    uint32_t indexCount = 0;
+};
+
+extern size_t FormatSize(VkFormat format);
+extern const char* FormatToString(VkFormat format);
+extern uint32_t FindMemoryType(const DeviceContext& context, uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+// resources created by the helpers below are recorded in the ResourceRegistry,
+// release them with the matching Destroy* function
+extern VulkanBuffer CreateBuffer(const DeviceContext& context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, ResourceCategory category, const char* name);
+// device local buffer filled through a staging buffer
+extern VulkanBuffer CreateDeviceBuffer(const DeviceContext& context, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, ResourceCategory category, const char* name);
+extern void DestroyBuffer(const DeviceContext& context, VulkanBuffer& buffer);
+
+// six layers create a cube compatible image
+extern VulkanTexture CreateTexture(const DeviceContext& context, VkFormat format, int width, int height, int layers, int mipLevels, VkImageUsageFlags usage, ResourceCategory category, const char* name);
+// fills mip 0 of every layer, the texture ends up in SHADER_READ_ONLY_OPTIMAL
+extern void UploadTexture(const DeviceContext& context, VulkanTexture& texture, const void* data, size_t sizeInByte);
+// a view of a single mip level and layer, to render into it
+extern VkImageView CreateAttachmentView(const DeviceContext& context, const VulkanTexture& texture, int mipLevel, int layer);
+extern void DestroyTexture(const DeviceContext& context, VulkanTexture& texture);
+
+extern VkCommandBuffer BeginOneShotCommands(const DeviceContext& context);
+// submits and waits for the queue to drain
+extern void EndOneShotCommands(const DeviceContext& context, VkCommandBuffer commandBuffer);
+
+extern void TransitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+                            uint32_t baseMip, uint32_t mipCount, uint32_t layerCount,
+                            VkImageLayout oldLayout, VkImageLayout newLayout,
+                            VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                            VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+// loads SPIRV_DIR <name>.spv
+extern VkShaderModule CreateShaderModule(VkDevice device, const char* name);
+
+}  // namespace vk
+}  // namespace pbr
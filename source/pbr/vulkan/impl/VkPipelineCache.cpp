@@ -0,0 +1,76 @@
+#include "VkPipelineCache.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+using std::ifstream;
+using std::ios;
+using std::ofstream;
+
+namespace pbr {
+namespace vk {
+
+void PipelineCache::Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const string& cacheDir) {
+    m_device = device;
+    m_properties = properties;
+
+    // one file per device, switching between a GPU and lavapipe keeps both warm
+    char name[64];
+    snprintf(name, sizeof(name), "vulkan_%04x_%04x.bin", properties.vendorID, properties.deviceID);
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+    m_path = error ? string() : cacheDir + name;
+
+    vector<char> data;
+    if (!m_path.empty()) {
+        ifstream file(m_path, ios::ate | ios::binary);
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if (!file.good() || !validateHeader(data))
+                data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+    VK_THROW_IF_FAILED(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_handle), "Failed to create pipeline cache");
+
+#ifdef PBR_VERBOSE
+    cout << "[Log] pipeline cache " << (data.empty() ? "created empty" : "loaded from " + m_path) << endl;
+#endif
+}
+
+void PipelineCache::Finalize() {
+    if (m_handle == VK_NULL_HANDLE)
+        return;
+
+    size_t size = 0;
+    if (!m_path.empty() && vkGetPipelineCacheData(m_device, m_handle, &size, nullptr) == VK_SUCCESS && size > 0) {
+        vector<char> data(size);
+        if (vkGetPipelineCacheData(m_device, m_handle, &size, data.data()) == VK_SUCCESS) {
+            // a failed write only costs a cold compile next launch
+            ofstream file(m_path, ios::binary | ios::trunc);
+            file.write(data.data(), size);
+        }
+    }
+
+    vkDestroyPipelineCache(m_device, m_handle, nullptr);
+    m_handle = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::validateHeader(const vector<char>& data) const {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == m_properties.vendorID &&
+           header.deviceID == m_properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+}  // namespace vk
+}  // namespace pbr
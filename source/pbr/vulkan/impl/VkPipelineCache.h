@@ -0,0 +1,28 @@
+#pragma once
+#include "VkPrerequisites.h"
+
+namespace pbr {
+namespace vk {
+
+// VkPipelineCache persisted to disk between runs. The driver validates the blob as well,
+// it is only handed over when the header matches this device so a stale or foreign file
+// costs a cold compile instead of undefined behaviour.
+class PipelineCache {
+   public:
+    void Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const string& cacheDir);
+    // writes the cache back and destroys it
+    void Finalize();
+    inline VkPipelineCache GetHandle() const { return m_handle; }
+
+   private:
+    bool validateHeader(const vector<char>& data) const;
+
+   private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_handle = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties;
+    string m_path;
+};
+
+}  // namespace vk
+}  // namespace pbr
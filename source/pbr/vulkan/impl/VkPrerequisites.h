@@ -0,0 +1,19 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "base/Error.h"
+#include "base/Prerequisites.h"
+
+namespace pbr {
+namespace vk {
+
+extern const char* ResultToString(VkResult result);
+
+}  // namespace vk
+}  // namespace pbr
+
+#define VK_THROW_IF_FAILED(EXP, DESC)                                                             \
+    {                                                                                             \
+        VkResult _RESULT = (EXP);                                                                 \
+        if (_RESULT != VK_SUCCESS)                                                                \
+            THROW_EXCEPTION(string("Vulkan: ") + DESC + ", " + pbr::vk::ResultToString(_RESULT)); \
+    }
@@ -0,0 +1,1208 @@
+#include "VkRendererImpl.h"
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstring>
+#include "Mesh.h"
+#include "Paths.h"
+#include "Utility.h"
+#include "base/Half.h"
+#include "core/Globals.h"
+#include "core/Renderer.h"
+
+namespace pbr {
+namespace vk {
+
+#ifdef PBR_DEBUG
+static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT,
+                                                    VkDebugUtilsMessageTypeFlagsEXT,
+                                                    const VkDebugUtilsMessengerCallbackDataEXT* pData,
+                                                    void*) {
+    cout << "[Warning] Vulkan: " << pData->pMessage << endl;
+    return VK_FALSE;
+}
+
+static bool hasInstanceLayer(const char* name) {
+    uint32_t count = 0;
+    vkEnumerateInstanceLayerProperties(&count, nullptr);
+    vector<VkLayerProperties> layers(count);
+    vkEnumerateInstanceLayerProperties(&count, layers.data());
+    for (const VkLayerProperties& layer : layers)
+        if (strcmp(layer.layerName, name) == 0)
+            return true;
+    return false;
+}
+#endif
+
+static void setViewport(VkCommandBuffer commandBuffer, int width, int height) {
+    VkViewport viewport = { 0.0f, 0.0f, float(width), float(height), 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { static_cast<uint32_t>(width), static_cast<uint32_t>(height) } };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+// there is no mandatory three component float format
+static vector<char> toRgbaTexels(const Image& image, VkFormat format) {
+    const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+    const float* pSource = reinterpret_cast<const float*>(image.buffer.pData);
+    vector<char> texels(texelCount * FormatSize(format));
+    float* pFloat = reinterpret_cast<float*>(texels.data());
+    half_t* pHalf = reinterpret_cast<half_t*>(texels.data());
+    for (size_t i = 0; i < texelCount; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            const float value = c < image.component ? pSource[i * image.component + c] : 1.0f;
+            if (format == VK_FORMAT_R32G32B32A32_SFLOAT)
+                pFloat[4 * i + c] = value;
+            else
+                pHalf[4 * i + c] = FloatToHalf(value);
+        }
+    }
+    return texels;
+}
+
+VkRendererImpl::VkRendererImpl(const Window* pWindow)
+    : m_pWindow(pWindow), m_headless(g_headless) {
+}
+
+void VkRendererImpl::Initialize() {
+    createInstance();
+    if (!m_headless)
+        VK_THROW_IF_FAILED(glfwCreateWindowSurface(m_instance, m_pWindow->GetInternalWindow(), nullptr, &m_surface), "Failed to create window surface");
+    selectPhysicalDevice();
+    createDevice();
+
+    // blitting the mip chain and sampling it linearly is optional for 32-bit floats
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_context.physicalDevice, VK_FORMAT_R32G32B32A32_SFLOAT, &formatProperties);
+    const VkFormatFeatureFlags cubeMapFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                                 VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    const bool fullPrecision = (formatProperties.optimalTilingFeatures & cubeMapFeatures) == cubeMapFeatures;
+    m_cubeMapFormat = g_reducedPrecision || !fullPrecision ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+
+    if (m_headless) {
+        m_targetFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    } else {
+        // the shaders gamma correct, like the default framebuffer of the OpenGL renderer
+        uint32_t count = 0;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physicalDevice, m_surface, &count, nullptr);
+        vector<VkSurfaceFormatKHR> formats(count);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physicalDevice, m_surface, &count, formats.data());
+        if (formats.empty())
+            THROW_EXCEPTION("Vulkan: surface reports no formats");
+        m_targetFormat = formats.front().format;
+        for (const VkSurfaceFormatKHR& format : formats) {
+            if (format.format == VK_FORMAT_B8G8R8A8_UNORM || format.format == VK_FORMAT_R8G8B8A8_UNORM) {
+                m_targetFormat = format.format;
+                break;
+            }
+        }
+    }
+
+    createRenderPasses();
+    createRenderTargets();
+    createDescriptors();
+    createFrames();
+    m_pipelineCache.Initialize(m_context.device, m_properties, SHADER_CACHE_DIR);
+    m_recorder.Initialize(m_context, FRAMES_IN_FLIGHT);
+}
+
+void VkRendererImpl::DumpGraphicsCardInfo() {
+    const uint32_t version = m_properties.apiVersion;
+    cout << "Graphics Card:     " << m_properties.deviceName << endl;
+    cout << "Version Vulkan:    " << VK_VERSION_MAJOR(version) << "." << VK_VERSION_MINOR(version) << "." << VK_VERSION_PATCH(version) << endl;
+    cout << "Record threads:    " << m_recorder.ThreadCount() << endl;
+}
+
+void VkRendererImpl::PrepareGpuResources() {
+    createSamplers();
+    createGeometries();
+
+    // material
+    m_albedoMetallicMap = utility::FileExists(g_model_dir + "AlbedoMetallic.png");
+    m_normalRoughnessMap = utility::FileExists(g_model_dir + "NormalRoughness.png");
+    m_emissiveAOMap = utility::FileExists(g_model_dir + "EmissiveAO.png");
+    if (m_albedoMetallicMap)
+        m_albedoMetallicTexture = loadMaterialTexture("AlbedoMetallic.png", "albedo metallic");
+    if (m_normalRoughnessMap)
+        m_normalRoughnessTexture = loadMaterialTexture("NormalRoughness.png", "normal roughness");
+    if (m_emissiveAOMap)
+        m_emissiveAOTexture = loadMaterialTexture("EmissiveAO.png", "emissive ao");
+    const uint32_t white = 0xFFFFFFFF;
+    m_defaultTexture = CreateTexture(m_context, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, ResourceCategory::MATERIAL, "default material");
+    UploadTexture(m_context, m_defaultTexture, &white, sizeof(white));
+
+    // load brdf texture
+    auto brdfImage = utility::ReadBrdfLUT(BRDF_LUT, Renderer::brdfLUTImageRes);
+    m_brdfLUTTexture = CreateTexture(m_context, VK_FORMAT_R16G16_SFLOAT, brdfImage.width, brdfImage.height, 1, 1, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, ResourceCategory::LOOKUP_TABLE, "brdf lut");
+    UploadTexture(m_context, m_brdfLUTTexture, brdfImage.buffer.pData, brdfImage.buffer.sizeInByte);
+
+    // convert HDR equirectuangular environment map to cubemap equivalent
+    CubeCamera cubeCamera(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    m_cubeMapPerspective = cubeCamera.ProjectionMatrixD3d();
+    cubeCamera.ViewMatricesGl(m_cubeMapViews);
+    createCubeMap();
+    createIrradianceMap();
+    createPrefilteredMap();
+    updateMaterialDescriptors();
+
+    // scene pipelines, the pbr model variant of the first frame is created right away
+    {
+        VkShaderModule vertModule = CreateShaderModule(m_context.device, "background.vert");
+        VkShaderModule fragModule = CreateShaderModule(m_context.device, "background.frag");
+        PipelineDesc desc;
+        desc.vertModule = vertModule;
+        desc.fragModule = fragModule;
+        desc.layout = m_sceneLayout;
+        desc.renderPass = m_renderPass;
+        desc.cullMode = VK_CULL_MODE_BACK_BIT;
+        desc.depthTest = true;
+        m_backgroundPipeline = createPipeline(desc, "Background Pipeline");
+        vkDestroyShaderModule(m_context.device, vertModule, nullptr);
+        vkDestroyShaderModule(m_context.device, fragModule, nullptr);
+    }
+    m_modelVertModule = CreateShaderModule(m_context.device, "pbr_model.vert");
+    m_modelFragModule = CreateShaderModule(m_context.device, "pbr_model.frag");
+    getModelPipeline(g_debug, g_lightCount);
+}
+
+void VkRendererImpl::Render(const Camera& camera) {
+    if (m_targetsDirty) {
+        vkDeviceWaitIdle(m_context.device);
+        destroyRenderTargets();
+        createRenderTargets();
+        m_targetsDirty = false;
+    }
+    // minimized
+    if (m_extent.width == 0 || m_extent.height == 0)
+        return;
+
+    Frame& frame = m_frames[m_frameIndex];
+    VK_THROW_IF_FAILED(vkWaitForFences(m_context.device, 1, &frame.fence, VK_TRUE, UINT64_MAX), "Failed to wait for frame fence");
+
+    // a headless renderer owns one target per frame in flight
+    uint32_t imageIndex = static_cast<uint32_t>(m_frameIndex);
+    if (!m_headless) {
+        VkResult result = vkAcquireNextImageKHR(m_context.device, m_swapchain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            m_targetsDirty = true;
+            return;
+        }
+        if (result != VK_SUBOPTIMAL_KHR)
+            VK_THROW_IF_FAILED(result, "Failed to acquire swapchain image");
+    }
+    VK_THROW_IF_FAILED(vkResetFences(m_context.device, 1, &frame.fence), "Failed to reset frame fence");
+
+    // the fence guarantees the GPU is done with this frame's copy
+    FrameUniforms uniforms;
+    uniforms.view = camera.ViewMatrix();
+    uniforms.projection = camera.ProjectionMatrixVk();
+    uniforms.viewPos = camera.GetViewPos();
+    std::copy(g_lights.begin(), g_lights.end(), uniforms.lights.begin());
+    memcpy(frame.uniformBuffer.pMapped, &uniforms, sizeof(uniforms));
+
+    // pipelines are created on this thread, the workers only record
+    VkPipeline modelPipeline = getModelPipeline(g_debug, g_lightCount);
+    recordFrame(frame, imageIndex, modelPipeline);
+
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    if (!m_headless) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &frame.imageAvailable;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_renderFinished[imageIndex];
+    }
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    VK_THROW_IF_FAILED(vkQueueSubmit(m_context.queue, 1, &submitInfo, frame.fence), "Failed to submit frame");
+
+    if (!m_headless) {
+        VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &m_renderFinished[imageIndex];
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &m_swapchain;
+        presentInfo.pImageIndices = &imageIndex;
+        VkResult result = vkQueuePresentKHR(m_context.queue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+            m_targetsDirty = true;
+        else
+            VK_THROW_IF_FAILED(result, "Failed to present");
+    }
+
+    m_lastFrameIndex = m_frameIndex;
+    m_frameIndex = (m_frameIndex + 1) % FRAMES_IN_FLIGHT;
+    ++m_renderedFrames;
+}
+
+void VkRendererImpl::recordFrame(Frame& frame, uint32_t imageIndex, VkPipeline modelPipeline) {
+    VK_THROW_IF_FAILED(vkResetCommandPool(m_context.device, frame.commandPool, 0), "Failed to reset command pool");
+    m_recorder.BeginFrame(m_frameIndex);
+
+    VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_THROW_IF_FAILED(vkBeginCommandBuffer(frame.commandBuffer, &beginInfo), "Failed to begin command buffer");
+
+    VkClearValue clearValues[2];
+    clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+    clearValues[1].depthStencil = { 1.0f, 0 };
+    VkRenderPassBeginInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+    renderPassInfo.renderPass = m_renderPass;
+    renderPassInfo.framebuffer = m_framebuffers[imageIndex];
+    renderPassInfo.renderArea.extent = { static_cast<uint32_t>(m_extent.width), static_cast<uint32_t>(m_extent.height) };
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+    vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    VkCommandBufferInheritanceInfo inheritance = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance.renderPass = m_renderPass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = m_framebuffers[imageIndex];
+
+    const VkDescriptorSet descriptorSets[] = { frame.descriptorSet, m_materialSet };
+    const VkDeviceSize offset = 0;
+    vector<CommandRecorder::Task> tasks;
+    // draw model
+    tasks.push_back([&](VkCommandBuffer commandBuffer) {
+        setViewport(commandBuffer, m_extent.width, m_extent.height);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_sceneLayout, 0, 2, descriptorSets, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, m_sceneLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4), &g_transform);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_model.vertexBuffer.handle, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, m_model.indexBuffer.handle, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(commandBuffer, m_model.indexCount, 1, 0, 0, 0);
+    });
+    // draw cube map
+    tasks.push_back([&](VkCommandBuffer commandBuffer) {
+        setViewport(commandBuffer, m_extent.width, m_extent.height);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_backgroundPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_sceneLayout, 0, 2, descriptorSets, 0, nullptr);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_cube.vertexBuffer.handle, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, m_cube.indexBuffer.handle, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(commandBuffer, m_cube.indexCount, 1, 0, 0, 0);
+    });
+
+    vector<VkCommandBuffer> commandBuffers;
+    m_recorder.Record(inheritance, tasks, commandBuffers);
+    vkCmdExecuteCommands(frame.commandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+
+    vkCmdEndRenderPass(frame.commandBuffer);
+    VK_THROW_IF_FAILED(vkEndCommandBuffer(frame.commandBuffer), "Failed to end command buffer");
+}
+
+void VkRendererImpl::Resize(const Extent2i&) {
+    // recreated before the next frame, a minimized window reports a zero extent
+    m_targetsDirty = true;
+}
+
+void VkRendererImpl::Finalize() {
+    vkDeviceWaitIdle(m_context.device);
+    if (m_renderedFrames > 0)
+        cout << "[Log] rendered " << m_renderedFrames << " frames at " << m_extent.width << "x" << m_extent.height << endl;
+    if (!g_outputPath.empty())
+        writeOutput();
+
+    VkDevice device = m_context.device;
+    m_recorder.Finalize();
+    for (auto& it : m_modelPipelines)
+        vkDestroyPipeline(device, it.second, nullptr);
+    m_modelPipelines.clear();
+    vkDestroyPipeline(device, m_backgroundPipeline, nullptr);
+    vkDestroyShaderModule(device, m_modelVertModule, nullptr);
+    vkDestroyShaderModule(device, m_modelFragModule, nullptr);
+    m_pipelineCache.Finalize();
+
+    for (VulkanTexture* pTexture : { &m_brdfLUTTexture, &m_cubeMapTexture, &m_irradianceTexture, &m_specularTexture,
+                                     &m_albedoMetallicTexture, &m_normalRoughnessTexture, &m_emissiveAOTexture, &m_defaultTexture })
+        DestroyTexture(m_context, *pTexture);
+    for (PerDrawData* pDrawData : { &m_cube, &m_model }) {
+        DestroyBuffer(m_context, pDrawData->vertexBuffer);
+        DestroyBuffer(m_context, pDrawData->indexBuffer);
+    }
+    vkDestroySampler(device, m_clampSampler, nullptr);
+    vkDestroySampler(device, m_repeatSampler, nullptr);
+
+    for (Frame& frame : m_frames) {
+        vkDestroyFence(device, frame.fence, nullptr);
+        vkDestroySemaphore(device, frame.imageAvailable, nullptr);
+        vkDestroyCommandPool(device, frame.commandPool, nullptr);
+        DestroyBuffer(m_context, frame.uniformBuffer);
+    }
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyPipelineLayout(device, m_sceneLayout, nullptr);
+    vkDestroyPipelineLayout(device, m_bakeLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_frameSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_materialSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_bakeSetLayout, nullptr);
+
+    destroyRenderTargets();
+    vkDestroyRenderPass(device, m_renderPass, nullptr);
+    vkDestroyRenderPass(device, m_bakeRenderPass, nullptr);
+    vkDestroyCommandPool(device, m_context.commandPool, nullptr);
+    vkDestroyDevice(device, nullptr);
+
+    if (m_surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+#ifdef PBR_DEBUG
+    if (m_debugMessenger != VK_NULL_HANDLE) {
+        auto destroyMessenger = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(m_instance, "vkDestroyDebugUtilsMessengerEXT"));
+        destroyMessenger(m_instance, m_debugMessenger, nullptr);
+    }
+#endif
+    vkDestroyInstance(m_instance, nullptr);
+}
+
+void VkRendererImpl::writeOutput() {
+    if (m_lastFrameIndex < 0)
+        return;
+    if (!m_headless) {
+        cout << "[Warning] the Vulkan renderer only writes the last frame with --headless, " << g_outputPath << " is skipped" << endl;
+        return;
+    }
+    if (g_outputPath.size() > 4 && g_outputPath.compare(g_outputPath.size() - 4, 4, ".hdr") == 0) {
+        cout << "[Warning] only --path-trace writes hdr images, " << g_outputPath << " is skipped" << endl;
+        return;
+    }
+
+    // the render pass left the target in TRANSFER_SRC_OPTIMAL
+    const VulkanTexture& target = m_offscreenTargets[m_lastFrameIndex];
+    const size_t sizeInByte = static_cast<size_t>(target.width) * target.height * FormatSize(target.format);
+    VulkanBuffer readback = CreateBuffer(m_context, sizeInByte, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         ResourceCategory::RENDER_TARGET, "readback");
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(m_context);
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { static_cast<uint32_t>(target.width), static_cast<uint32_t>(target.height), 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.handle, 1, &region);
+    EndOneShotCommands(m_context, commandBuffer);
+
+    // clip space y points down, the first row already is the top of the image
+    Image image;
+    image.width = target.width;
+    image.height = target.height;
+    image.component = 4;
+    image.dataType = DataType::UINT_8T;
+    image.Wrap(readback.pMapped, sizeInByte);
+    utility::WritePng(g_outputPath, image);
+    DestroyBuffer(m_context, readback);
+    cout << "[Log] last frame written to " << g_outputPath << endl;
+}
+
+void VkRendererImpl::createInstance() {
+    VkApplicationInfo appInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+    appInfo.pApplicationName = "PBR";
+    appInfo.pEngineName = "PBR";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+
+    // surfaceless without a window, software implementations like lavapipe need nothing else
+    vector<const char*> extensions;
+    if (!m_headless) {
+        uint32_t count = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&count);
+        if (glfwExtensions == nullptr)
+            THROW_EXCEPTION("GLFW: Vulkan is not supported by the window system");
+        extensions.assign(glfwExtensions, glfwExtensions + count);
+    }
+    vector<const char*> layers;
+#ifdef PBR_DEBUG
+    const bool validation = hasInstanceLayer("VK_LAYER_KHRONOS_validation");
+    if (validation) {
+        layers.push_back("VK_LAYER_KHRONOS_validation");
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+#endif
+
+    VkInstanceCreateInfo createInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+    createInfo.pApplicationInfo = &appInfo;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+    createInfo.ppEnabledLayerNames = layers.data();
+    VK_THROW_IF_FAILED(vkCreateInstance(&createInfo, nullptr, &m_instance), "Failed to create instance");
+
+#ifdef PBR_DEBUG
+    if (validation) {
+        VkDebugUtilsMessengerCreateInfoEXT messengerInfo = { VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT };
+        messengerInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        messengerInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                                    VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        messengerInfo.pfnUserCallback = debugCallback;
+        auto createMessenger = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(m_instance, "vkCreateDebugUtilsMessengerEXT"));
+        if (createMessenger)
+            createMessenger(m_instance, &messengerInfo, nullptr, &m_debugMessenger);
+    }
+#endif
+}
+
+void VkRendererImpl::selectPhysicalDevice() {
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(m_instance, &count, nullptr);
+    vector<VkPhysicalDevice> devices(count);
+    vkEnumeratePhysicalDevices(m_instance, &count, devices.data());
+
+    // prefer real GPUs, a CPU implementation is picked when it is the only one (or VK_ICD_FILENAMES says so)
+    int bestScore = -1;
+    for (VkPhysicalDevice device : devices) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+        vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+
+        int family = -1;
+        for (uint32_t i = 0; i < familyCount && family < 0; ++i) {
+            if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+                continue;
+            VkBool32 present = VK_TRUE;
+            if (m_surface != VK_NULL_HANDLE)
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &present);
+            if (present)
+                family = static_cast<int>(i);
+        }
+        if (family < 0)
+            continue;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        int score = 0;
+        switch (properties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                score = 4;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                score = 3;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                score = 2;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                score = 1;
+                break;
+            default:
+                break;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            m_context.physicalDevice = device;
+            m_context.queueFamily = static_cast<uint32_t>(family);
+            m_properties = properties;
+        }
+    }
+
+    if (m_context.physicalDevice == VK_NULL_HANDLE)
+        THROW_EXCEPTION("Vulkan: no device with a graphics queue");
+    vkGetPhysicalDeviceMemoryProperties(m_context.physicalDevice, &m_context.memoryProperties);
+}
+
+void VkRendererImpl::createDevice() {
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+    queueInfo.queueFamilyIndex = m_context.queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    const char* swapchainExtension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    VkDeviceCreateInfo createInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = &queueInfo;
+    createInfo.enabledExtensionCount = m_headless ? 0 : 1;
+    createInfo.ppEnabledExtensionNames = m_headless ? nullptr : &swapchainExtension;
+    VK_THROW_IF_FAILED(vkCreateDevice(m_context.physicalDevice, &createInfo, nullptr, &m_context.device), "Failed to create device");
+    vkGetDeviceQueue(m_context.device, m_context.queueFamily, 0, &m_context.queue);
+
+    VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_context.queueFamily;
+    VK_THROW_IF_FAILED(vkCreateCommandPool(m_context.device, &poolInfo, nullptr, &m_context.commandPool), "Failed to create command pool");
+}
+
+void VkRendererImpl::createRenderPasses() {
+    // scene
+    {
+        VkAttachmentDescription attachments[2] = {};
+        attachments[0].format = m_targetFormat;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // a headless frame may be read back
+        attachments[0].finalLayout = m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments[1].format = VK_FORMAT_D32_SFLOAT;
+        attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+        subpass.pDepthStencilAttachment = &depthReference;
+
+        // the depth target is shared by the frames in flight, and the color target waits for the acquire semaphore
+        VkSubpassDependency dependencies[2] = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = m_headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        dependencies[1].dstAccessMask = m_headless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+
+        VkRenderPassCreateInfo createInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        createInfo.attachmentCount = 2;
+        createInfo.pAttachments = attachments;
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        createInfo.dependencyCount = 2;
+        createInfo.pDependencies = dependencies;
+        VK_THROW_IF_FAILED(vkCreateRenderPass(m_context.device, &createInfo, nullptr, &m_renderPass), "Failed to create render pass");
+    }
+    // cube map faces, the bake functions transition the images themselves
+    {
+        VkAttachmentDescription attachment = {};
+        attachment.format = m_cubeMapFormat;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+
+        VkRenderPassCreateInfo createInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+        createInfo.attachmentCount = 1;
+        createInfo.pAttachments = &attachment;
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        VK_THROW_IF_FAILED(vkCreateRenderPass(m_context.device, &createInfo, nullptr, &m_bakeRenderPass), "Failed to create render pass");
+    }
+}
+
+void VkRendererImpl::createSwapchain() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    VK_THROW_IF_FAILED(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_context.physicalDevice, m_surface, &capabilities), "Failed to query surface");
+
+    VkExtent2D extent = capabilities.currentExtent;
+    if (extent.width == 0xFFFFFFFF) {
+        const Extent2i& framebufferExtent = m_pWindow->GetFrameBufferExtent();
+        extent.width = glm::clamp(static_cast<uint32_t>(framebufferExtent.width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        extent.height = glm::clamp(static_cast<uint32_t>(framebufferExtent.height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+    }
+    m_extent = Extent2i(static_cast<int>(extent.width), static_cast<int>(extent.height));
+    if (extent.width == 0 || extent.height == 0)
+        return;
+
+    uint32_t imageCount = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+        imageCount = capabilities.maxImageCount;
+
+    VkSwapchainCreateInfoKHR createInfo = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
+    createInfo.surface = m_surface;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = m_targetFormat;
+    createInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.preTransform = capabilities.currentTransform;
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;  // always supported
+    createInfo.clipped = VK_TRUE;
+    VK_THROW_IF_FAILED(vkCreateSwapchainKHR(m_context.device, &createInfo, nullptr, &m_swapchain), "Failed to create swapchain");
+
+    vkGetSwapchainImagesKHR(m_context.device, m_swapchain, &imageCount, nullptr);
+    m_targetImages.resize(imageCount);
+    vkGetSwapchainImagesKHR(m_context.device, m_swapchain, &imageCount, m_targetImages.data());
+    for (VkImage image : m_targetImages) {
+        VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_targetFormat;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        VkImageView view = VK_NULL_HANDLE;
+        VK_THROW_IF_FAILED(vkCreateImageView(m_context.device, &viewInfo, nullptr, &view), "Failed to create swapchain image view");
+        m_targetViews.push_back(view);
+    }
+}
+
+void VkRendererImpl::createRenderTargets() {
+    if (m_headless) {
+        m_extent = m_pWindow->GetFrameBufferExtent();
+        for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+            m_offscreenTargets.push_back(CreateTexture(m_context, m_targetFormat, m_extent.width, m_extent.height, 1, 1,
+                                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                                       ResourceCategory::RENDER_TARGET, "offscreen color"));
+            m_targetImages.push_back(m_offscreenTargets.back().image);
+            m_targetViews.push_back(m_offscreenTargets.back().view);
+        }
+    } else {
+        createSwapchain();
+        if (m_extent.width == 0 || m_extent.height == 0)
+            return;
+    }
+
+    m_depthTarget = CreateTexture(m_context, VK_FORMAT_D32_SFLOAT, m_extent.width, m_extent.height, 1, 1,
+                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, ResourceCategory::RENDER_TARGET, "depth");
+    for (VkImageView view : m_targetViews) {
+        const VkImageView attachments[] = { view, m_depthTarget.view };
+        VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        createInfo.renderPass = m_renderPass;
+        createInfo.attachmentCount = 2;
+        createInfo.pAttachments = attachments;
+        createInfo.width = m_extent.width;
+        createInfo.height = m_extent.height;
+        createInfo.layers = 1;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VK_THROW_IF_FAILED(vkCreateFramebuffer(m_context.device, &createInfo, nullptr, &framebuffer), "Failed to create framebuffer");
+        m_framebuffers.push_back(framebuffer);
+
+        VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        VK_THROW_IF_FAILED(vkCreateSemaphore(m_context.device, &semaphoreInfo, nullptr, &semaphore), "Failed to create semaphore");
+        m_renderFinished.push_back(semaphore);
+    }
+}
+
+void VkRendererImpl::destroyRenderTargets() {
+    VkDevice device = m_context.device;
+    for (VkFramebuffer framebuffer : m_framebuffers)
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    for (VkSemaphore semaphore : m_renderFinished)
+        vkDestroySemaphore(device, semaphore, nullptr);
+    m_framebuffers.clear();
+    m_renderFinished.clear();
+    DestroyTexture(m_context, m_depthTarget);
+
+    // offscreen views belong to their textures
+    for (VulkanTexture& target : m_offscreenTargets)
+        DestroyTexture(m_context, target);
+    if (m_offscreenTargets.empty())
+        for (VkImageView view : m_targetViews)
+            vkDestroyImageView(device, view, nullptr);
+    m_offscreenTargets.clear();
+    m_targetViews.clear();
+    m_targetImages.clear();
+
+    if (m_swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(device, m_swapchain, nullptr);
+        m_swapchain = VK_NULL_HANDLE;
+    }
+}
+
+void VkRendererImpl::createDescriptors() {
+    VkDevice device = m_context.device;
+    // set 0, per frame uniforms
+    {
+        VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+        VkDescriptorSetLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        createInfo.bindingCount = 1;
+        createInfo.pBindings = &binding;
+        VK_THROW_IF_FAILED(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &m_frameSetLayout), "Failed to create descriptor set layout");
+    }
+    // set 1, environment 0, irradiance 1, prefiltered 2, brdf lut 3, albedo metallic 4, normal roughness 5, emissive ao 6
+    {
+        array<VkDescriptorSetLayoutBinding, 7> bindings;
+        for (uint32_t i = 0; i < bindings.size(); ++i)
+            bindings[i] = { i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+        VkDescriptorSetLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        createInfo.pBindings = bindings.data();
+        VK_THROW_IF_FAILED(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &m_materialSetLayout), "Failed to create descriptor set layout");
+    }
+    // source of a cube map bake
+    {
+        VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+        VkDescriptorSetLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        createInfo.bindingCount = 1;
+        createInfo.pBindings = &binding;
+        VK_THROW_IF_FAILED(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &m_bakeSetLayout), "Failed to create descriptor set layout");
+    }
+
+    // one set per bake, the equirectangular map for the environment map, which irradiance and prefilter sample
+    constexpr uint32_t bakeSetCount = 3;
+    const VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7 + bakeSetCount },
+    };
+    VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.maxSets = FRAMES_IN_FLIGHT + 1 + bakeSetCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_THROW_IF_FAILED(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool), "Failed to create descriptor pool");
+
+    VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocateInfo.descriptorPool = m_descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &m_materialSetLayout;
+    VK_THROW_IF_FAILED(vkAllocateDescriptorSets(device, &allocateInfo, &m_materialSet), "Failed to allocate descriptor set");
+
+    // model transform as push constant
+    {
+        const VkDescriptorSetLayout setLayouts[] = { m_frameSetLayout, m_materialSetLayout };
+        VkPushConstantRange range = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4) };
+        VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        createInfo.setLayoutCount = 2;
+        createInfo.pSetLayouts = setLayouts;
+        createInfo.pushConstantRangeCount = 1;
+        createInfo.pPushConstantRanges = &range;
+        VK_THROW_IF_FAILED(vkCreatePipelineLayout(device, &createInfo, nullptr, &m_sceneLayout), "Failed to create pipeline layout");
+    }
+    {
+        VkPushConstantRange range = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(BakePushConstants) };
+        VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        createInfo.setLayoutCount = 1;
+        createInfo.pSetLayouts = &m_bakeSetLayout;
+        createInfo.pushConstantRangeCount = 1;
+        createInfo.pPushConstantRanges = &range;
+        VK_THROW_IF_FAILED(vkCreatePipelineLayout(device, &createInfo, nullptr, &m_bakeLayout), "Failed to create pipeline layout");
+    }
+}
+
+void VkRendererImpl::createFrames() {
+    VkDevice device = m_context.device;
+    for (Frame& frame : m_frames) {
+        // signalled, the first wait of every frame returns right away
+        VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VK_THROW_IF_FAILED(vkCreateFence(device, &fenceInfo, nullptr, &frame.fence), "Failed to create fence");
+        VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        VK_THROW_IF_FAILED(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailable), "Failed to create semaphore");
+
+        VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = m_context.queueFamily;
+        VK_THROW_IF_FAILED(vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool), "Failed to create command pool");
+        VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocateInfo.commandPool = frame.commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VK_THROW_IF_FAILED(vkAllocateCommandBuffers(device, &allocateInfo, &frame.commandBuffer), "Failed to allocate command buffer");
+
+        frame.uniformBuffer = CreateBuffer(m_context, sizeof(FrameUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           ResourceCategory::GEOMETRY, "per frame uniforms");
+        VkDescriptorSetAllocateInfo setInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        setInfo.descriptorPool = m_descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &m_frameSetLayout;
+        VK_THROW_IF_FAILED(vkAllocateDescriptorSets(device, &setInfo, &frame.descriptorSet), "Failed to allocate descriptor set");
+
+        VkDescriptorBufferInfo bufferInfo = { frame.uniformBuffer.handle, 0, sizeof(FrameUniforms) };
+        VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = frame.descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+}
+
+void VkRendererImpl::createSamplers() {
+    VkSamplerCreateInfo createInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    createInfo.magFilter = VK_FILTER_LINEAR;
+    createInfo.minFilter = VK_FILTER_LINEAR;
+    createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    createInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_THROW_IF_FAILED(vkCreateSampler(m_context.device, &createInfo, nullptr, &m_clampSampler), "Failed to create sampler");
+
+    // material maps have a single level
+    createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VK_THROW_IF_FAILED(vkCreateSampler(m_context.device, &createInfo, nullptr, &m_repeatSampler), "Failed to create sampler");
+}
+
+VkPipeline VkRendererImpl::createPipeline(const PipelineDesc& desc, const char* debugName) {
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = desc.vertModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = desc.fragModule;
+    stages[1].pName = "main";
+    stages[1].pSpecializationInfo = desc.pSpecialization;
+
+    VkVertexInputBindingDescription binding = { 0, desc.texturedVertex ? uint32_t(sizeof(TexturedVertex)) : uint32_t(sizeof(vec3)), VK_VERTEX_INPUT_RATE_VERTEX };
+    const VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, uint32_t(offsetof(TexturedVertex, position)) },
+        { 1, 0, VK_FORMAT_R32G32_SFLOAT, uint32_t(offsetof(TexturedVertex, uv)) },
+        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, uint32_t(offsetof(TexturedVertex, normal)) },
+        { 3, 0, VK_FORMAT_R32G32B32_SFLOAT, uint32_t(offsetof(TexturedVertex, tangent)) },
+        { 4, 0, VK_FORMAT_R32G32B32_SFLOAT, uint32_t(offsetof(TexturedVertex, bitangent)) },
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    vertexInput.vertexBindingDescriptionCount = 1;
+    vertexInput.pVertexBindingDescriptions = &binding;
+    vertexInput.vertexAttributeDescriptionCount = desc.texturedVertex ? 5 : 1;
+    vertexInput.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // front faces are clockwise like the OpenGL renderer, the y flip of the projection keeps the winding
+    VkPipelineRasterizationStateCreateInfo rasterization = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = desc.cullMode;
+    rasterization.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depthStencil.depthTestEnable = desc.depthTest;
+    depthStencil.depthWriteEnable = desc.depthWrite;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+
+    const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo createInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    createInfo.stageCount = 2;
+    createInfo.pStages = stages;
+    createInfo.pVertexInputState = &vertexInput;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewport;
+    createInfo.pRasterizationState = &rasterization;
+    createInfo.pMultisampleState = &multisample;
+    createInfo.pDepthStencilState = &depthStencil;
+    createInfo.pColorBlendState = &colorBlend;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.layout = desc.layout;
+    createInfo.renderPass = desc.renderPass;
+    createInfo.subpass = 0;
+
+    SHADER_COMPILING_START_INFO(debugName);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkCreateGraphicsPipelines(m_context.device, m_pipelineCache.GetHandle(), 1, &createInfo, nullptr, &pipeline),
+                       string("Failed to create ") + debugName);
+    SHADER_COMPILING_END_INFO(debugName);
+    return pipeline;
+}
+
+VkPipeline VkRendererImpl::createBakePipeline(const char* fragName, const VkSpecializationInfo* pSpecialization, const char* debugName) {
+    VkShaderModule vertModule = CreateShaderModule(m_context.device, "cubemap.vert");
+    VkShaderModule fragModule = CreateShaderModule(m_context.device, fragName);
+    PipelineDesc desc;
+    desc.vertModule = vertModule;
+    desc.fragModule = fragModule;
+    desc.pSpecialization = pSpecialization;
+    desc.layout = m_bakeLayout;
+    desc.renderPass = m_bakeRenderPass;
+    VkPipeline pipeline = createPipeline(desc, debugName);
+    vkDestroyShaderModule(m_context.device, vertModule, nullptr);
+    vkDestroyShaderModule(m_context.device, fragModule, nullptr);
+    return pipeline;
+}
+
+VkPipeline VkRendererImpl::getModelPipeline(int debugView, int lightCount) {
+    const uint32_t key = static_cast<uint32_t>(debugView) | (static_cast<uint32_t>(lightCount) << 8);
+    auto it = m_modelPipelines.find(key);
+    if (it != m_modelPipelines.end())
+        return it->second;
+
+    // constant_id order of pbr_model.frag
+    struct {
+        int32_t debugView;
+        int32_t lightCount;
+        VkBool32 albedoMetallicMap;
+        VkBool32 normalRoughnessMap;
+        VkBool32 emissiveAOMap;
+        float maxReflectionLod;
+    } constants = { debugView, lightCount, m_albedoMetallicMap, m_normalRoughnessMap, m_emissiveAOMap, Renderer::maxReflectionLod };
+    array<VkSpecializationMapEntry, 6> entries;
+    for (uint32_t i = 0; i < entries.size(); ++i)
+        entries[i] = { i, i * 4, 4 };
+    VkSpecializationInfo specialization = { static_cast<uint32_t>(entries.size()), entries.data(), sizeof(constants), &constants };
+
+    PipelineDesc desc;
+    desc.vertModule = m_modelVertModule;
+    desc.fragModule = m_modelFragModule;
+    desc.pSpecialization = &specialization;
+    desc.layout = m_sceneLayout;
+    desc.renderPass = m_renderPass;
+    desc.texturedVertex = true;
+    desc.cullMode = VK_CULL_MODE_BACK_BIT;
+    desc.depthTest = true;
+    desc.depthWrite = true;
+    VkPipeline pipeline = createPipeline(desc, "PBR Model Pipeline");
+    m_modelPipelines[key] = pipeline;
+    return pipeline;
+}
+
+void VkRendererImpl::createGeometries() {
+    {
+        // cube
+        const auto cube = CreateCubeMesh(1.0f);
+        m_cube.indexCount = static_cast<uint32_t>(3 * cube.indices.size());
+        m_cube.indexBuffer = CreateDeviceBuffer(m_context, cube.indices.data(), cube.indices.size() * sizeof(uvec3), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceCategory::GEOMETRY, "cube indices");
+        m_cube.vertexBuffer = CreateDeviceBuffer(m_context, cube.vertices.data(), cube.vertices.size() * sizeof(vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceCategory::GEOMETRY, "cube vertices");
+    }
+    {
+        // load model
+        auto model = utility::LoadModel(g_model_dir.c_str());
+        m_model.indexCount = static_cast<uint32_t>(3 * model.indices.size());
+        m_model.indexBuffer = CreateDeviceBuffer(m_context, model.indices.data(), model.indices.size() * sizeof(uvec3), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceCategory::GEOMETRY, "model indices");
+        m_model.vertexBuffer = CreateDeviceBuffer(m_context, model.vertices.data(), model.vertices.size() * sizeof(TexturedVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceCategory::GEOMETRY, "model vertices");
+    }
+}
+
+VulkanTexture VkRendererImpl::loadMaterialTexture(const char* file, const char* name) {
+    auto image = utility::ReadPng(g_model_dir + file);
+    const size_t texelCount = static_cast<size_t>(image.width) * image.height;
+    const uint8_t* pSource = reinterpret_cast<const uint8_t*>(image.buffer.pData);
+    vector<uint8_t> texels(4 * texelCount);
+    for (size_t i = 0; i < texelCount; ++i)
+        for (int c = 0; c < 4; ++c)
+            texels[4 * i + c] = c < image.component ? pSource[i * image.component + c] : 255;
+
+    VulkanTexture texture = CreateTexture(m_context, VK_FORMAT_R8G8B8A8_UNORM, image.width, image.height, 1, 1, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, ResourceCategory::MATERIAL, name);
+    UploadTexture(m_context, texture, texels.data(), texels.size());
+    return texture;
+}
+
+VkDescriptorSet VkRendererImpl::allocateBakeSet(const VulkanTexture& source) {
+    VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocateInfo.descriptorPool = m_descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &m_bakeSetLayout;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VK_THROW_IF_FAILED(vkAllocateDescriptorSets(m_context.device, &allocateInfo, &set), "Failed to allocate descriptor set");
+
+    VkDescriptorImageInfo imageInfo = { m_clampSampler, source.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_context.device, 1, &write, 0, nullptr);
+    return set;
+}
+
+void VkRendererImpl::updateMaterialDescriptors() {
+    const VulkanTexture* textures[7] = {
+        &m_cubeMapTexture,
+        &m_irradianceTexture,
+        &m_specularTexture,
+        &m_brdfLUTTexture,
+        m_albedoMetallicMap ? &m_albedoMetallicTexture : &m_defaultTexture,
+        m_normalRoughnessMap ? &m_normalRoughnessTexture : &m_defaultTexture,
+        m_emissiveAOMap ? &m_emissiveAOTexture : &m_defaultTexture,
+    };
+    array<VkDescriptorImageInfo, 7> imageInfos;
+    array<VkWriteDescriptorSet, 7> writes;
+    for (uint32_t i = 0; i < 7; ++i) {
+        imageInfos[i] = { i < 4 ? m_clampSampler : m_repeatSampler, textures[i]->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        writes[i] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        writes[i].dstSet = m_materialSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(m_context.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void VkRendererImpl::bakeCubeMap(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet source, const VulkanTexture& baked, int mipLevel, float roughness,
+                                 vector<VkImageView>& views, vector<VkFramebuffer>& framebuffers) {
+    const int size = std::max(baked.width >> mipLevel, 1);
+    const VkDeviceSize offset = 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_bakeLayout, 0, 1, &source, 0, nullptr);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_cube.vertexBuffer.handle, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, m_cube.indexBuffer.handle, 0, VK_INDEX_TYPE_UINT32);
+    setViewport(commandBuffer, size, size);
+
+    for (int face = 0; face < 6; ++face) {
+        views.push_back(CreateAttachmentView(m_context, baked, mipLevel, face));
+        VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+        framebufferInfo.renderPass = m_bakeRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &views.back();
+        framebufferInfo.width = size;
+        framebufferInfo.height = size;
+        framebufferInfo.layers = 1;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VK_THROW_IF_FAILED(vkCreateFramebuffer(m_context.device, &framebufferInfo, nullptr, &framebuffer), "Failed to create framebuffer");
+        framebuffers.push_back(framebuffer);
+
+        VkRenderPassBeginInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        renderPassInfo.renderPass = m_bakeRenderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.extent = { static_cast<uint32_t>(size), static_cast<uint32_t>(size) };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        BakePushConstants constants = { m_cubeMapPerspective * m_cubeMapViews[face], roughness };
+        vkCmdPushConstants(commandBuffer, m_bakeLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+        vkCmdDrawIndexed(commandBuffer, m_cube.indexCount, 1, 0, 0, 0);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void VkRendererImpl::finishBake(VkCommandBuffer commandBuffer, vector<VkImageView>& views, vector<VkFramebuffer>& framebuffers, VkPipeline pipeline) {
+    EndOneShotCommands(m_context, commandBuffer);
+    for (VkFramebuffer framebuffer : framebuffers)
+        vkDestroyFramebuffer(m_context.device, framebuffer, nullptr);
+    for (VkImageView view : views)
+        vkDestroyImageView(m_context.device, view, nullptr);
+    vkDestroyPipeline(m_context.device, pipeline, nullptr);
+}
+
+void VkRendererImpl::createCubeMap() {
+    // load hdr texture, only the bake samples it, four faces of the cube map span its width
+    auto envImage = utility::ReadHDRImage(g_env_map_path, HdrFormat::FLOAT32, 4 * Renderer::cubeMapRes);
+    const vector<char> texels = toRgbaTexels(envImage, m_cubeMapFormat);
+    envImage.Free();
+    m_hdrTexture = CreateTexture(m_context, m_cubeMapFormat, envImage.width, envImage.height, 1, 1, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, ResourceCategory::ENVIRONMENT, "equirectangular map");
+    UploadTexture(m_context, m_hdrTexture, texels.data(), texels.size());
+
+    int mipLevels = 1;
+    while ((Renderer::cubeMapRes >> mipLevels) > 0)
+        ++mipLevels;
+    m_cubeMapTexture = CreateTexture(m_context, m_cubeMapFormat, Renderer::cubeMapRes, Renderer::cubeMapRes, 6, mipLevels,
+                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                     ResourceCategory::ENVIRONMENT, "environment map");
+    VkPipeline pipeline = createBakePipeline("to_cubemap.frag", nullptr, "Convert Pipeline");
+    VkDescriptorSet source = allocateBakeSet(m_hdrTexture);
+
+    vector<VkImageView> views;
+    vector<VkFramebuffer> framebuffers;
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(m_context);
+    const VkImage image = m_cubeMapTexture.image;
+    TransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 6,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    bakeCubeMap(commandBuffer, pipeline, source, m_cubeMapTexture, 0, 0.0f, views, framebuffers);
+
+    // mip chain, every level is blitted from the one above
+    TransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 6,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    for (int mip = 1; mip < mipLevels; ++mip) {
+        TransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 6,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        const int32_t srcSize = std::max(Renderer::cubeMapRes >> (mip - 1), 1);
+        const int32_t dstSize = std::max(Renderer::cubeMapRes >> mip, 1);
+        VkImageBlit blit = {};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(mip - 1), 0, 6 };
+        blit.srcOffsets[1] = { srcSize, srcSize, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(mip), 0, 6 };
+        blit.dstOffsets[1] = { dstSize, dstSize, 1 };
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        TransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 6,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    TransitionImage(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 6,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    finishBake(commandBuffer, views, framebuffers, pipeline);
+
+    // only the cube map is sampled from now on
+    DestroyTexture(m_context, m_hdrTexture);
+}
+
+void VkRendererImpl::createIrradianceMap() {
+    m_irradianceTexture = CreateTexture(m_context, m_cubeMapFormat, Renderer::irradianceMapRes, Renderer::irradianceMapRes, 6, 1,
+                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, ResourceCategory::ENVIRONMENT, "irradiance map");
+    // a software implementation integrates a coarser grid, the bake would take minutes otherwise
+    const float sampleStep = m_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0.05f : 0.025f;
+    VkSpecializationMapEntry entry = { 0, 0, sizeof(float) };
+    VkSpecializationInfo specialization = { 1, &entry, sizeof(sampleStep), &sampleStep };
+    VkPipeline pipeline = createBakePipeline("irradiance.frag", &specialization, "Irradiance Pipeline");
+    VkDescriptorSet source = allocateBakeSet(m_cubeMapTexture);
+
+    vector<VkImageView> views;
+    vector<VkFramebuffer> framebuffers;
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(m_context);
+    TransitionImage(commandBuffer, m_irradianceTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 6,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    bakeCubeMap(commandBuffer, pipeline, source, m_irradianceTexture, 0, 0.0f, views, framebuffers);
+    TransitionImage(commandBuffer, m_irradianceTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 6,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    finishBake(commandBuffer, views, framebuffers, pipeline);
+}
+
+void VkRendererImpl::createPrefilteredMap() {
+    m_specularTexture = CreateTexture(m_context, m_cubeMapFormat, Renderer::specularMapRes, Renderer::specularMapRes, 6, Renderer::specularMapMipLevels,
+                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, ResourceCategory::ENVIRONMENT, "prefiltered map");
+    // constant_id order of prefilter.frag, a software implementation takes fewer samples
+    struct {
+        uint32_t sampleCount;
+        float envMapResolution;
+    } constants = { m_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 64u : uint32_t(Renderer::prefilterSampleCount), float(Renderer::cubeMapRes) };
+    const VkSpecializationMapEntry entries[] = { { 0, 0, 4 }, { 1, 4, 4 } };
+    VkSpecializationInfo specialization = { 2, entries, sizeof(constants), &constants };
+    VkPipeline pipeline = createBakePipeline("prefilter.frag", &specialization, "Prefilter Pipeline");
+    VkDescriptorSet source = allocateBakeSet(m_cubeMapTexture);
+
+    vector<VkImageView> views;
+    vector<VkFramebuffer> framebuffers;
+    VkCommandBuffer commandBuffer = BeginOneShotCommands(m_context);
+    TransitionImage(commandBuffer, m_specularTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, Renderer::specularMapMipLevels, 6,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    for (int mipLevel = 0; mipLevel < Renderer::specularMapMipLevels; ++mipLevel) {
+        float roughness = float(mipLevel) / float(Renderer::specularMapMipLevels - 1.0f);
+        bakeCubeMap(commandBuffer, pipeline, source, m_specularTexture, mipLevel, roughness, views, framebuffers);
+    }
+    TransitionImage(commandBuffer, m_specularTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, Renderer::specularMapMipLevels, 6,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    finishBake(commandBuffer, views, framebuffers, pipeline);
+}
+
+}  // namespace vk
+}  // namespace pbr
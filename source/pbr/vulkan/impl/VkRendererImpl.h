@@ -0,0 +1,162 @@
+#pragma once
+#include <map>
+#include "Scene.h"
+#include "VkCommandRecorder.h"
+#include "VkHelpers.h"
+#include "VkPipelineCache.h"
+#include "VkPrerequisites.h"
+#include "core/Camera.h"
+#include "core/Window.h"
+
+namespace pbr {
+namespace vk {
+
+class VkRendererImpl {
+   public:
+    // frames the CPU may record ahead of the GPU
+    static constexpr int FRAMES_IN_FLIGHT = 2;
+
+    VkRendererImpl(const Window* pWindow);
+    void Initialize();
+    void DumpGraphicsCardInfo();
+    void PrepareGpuResources();
+    void Render(const Camera& camera);
+    void Resize(const Extent2i& extent);
+    void Finalize();
+
+   private:
+    // set 0, std140 layout of PerFrameBuffer
+    struct FrameUniforms {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPos;
+        array<Light, 4> lights;
+    };
+
+    // cubemap.vert
+    struct BakePushConstants {
+        mat4 viewProjection;
+        float roughness;
+    };
+
+    struct Frame {
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore imageAvailable = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VulkanBuffer uniformBuffer;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    struct PipelineDesc {
+        VkShaderModule vertModule = VK_NULL_HANDLE;
+        VkShaderModule fragModule = VK_NULL_HANDLE;
+        const VkSpecializationInfo* pSpecialization = nullptr;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        bool texturedVertex = false;
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+        bool depthTest = false;
+        bool depthWrite = false;
+    };
+
+    void createInstance();
+    void selectPhysicalDevice();
+    void createDevice();
+    void createRenderTargets();
+    void destroyRenderTargets();
+    void createSwapchain();
+    void createRenderPasses();
+    void createFrames();
+    void createDescriptors();
+    void createSamplers();
+    VkPipeline createPipeline(const PipelineDesc& desc, const char* debugName);
+    // cubemap.vert with the given fragment shader, rendering into m_bakeRenderPass
+    VkPipeline createBakePipeline(const char* fragName, const VkSpecializationInfo* pSpecialization, const char* debugName);
+    VkPipeline getModelPipeline(int debugView, int lightCount);
+    void createGeometries();
+    VulkanTexture loadMaterialTexture(const char* file, const char* name);
+    void updateMaterialDescriptors();
+    void createCubeMap();
+    void createIrradianceMap();
+    void createPrefilteredMap();
+    VkDescriptorSet allocateBakeSet(const VulkanTexture& source);
+    // renders the cube into every face of mipLevel, the faces must be in COLOR_ATTACHMENT_OPTIMAL,
+    // the views and framebuffers have to outlive the command buffer
+    void bakeCubeMap(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet source, const VulkanTexture& baked, int mipLevel, float roughness,
+                     vector<VkImageView>& views, vector<VkFramebuffer>& framebuffers);
+    // submits the bake and releases what bakeCubeMap created
+    void finishBake(VkCommandBuffer commandBuffer, vector<VkImageView>& views, vector<VkFramebuffer>& framebuffers, VkPipeline pipeline);
+    void recordFrame(Frame& frame, uint32_t imageIndex, VkPipeline modelPipeline);
+    void writeOutput();
+
+   private:
+    const Window* m_pWindow;
+    bool m_headless = false;
+
+    VkInstance m_instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT m_debugMessenger = VK_NULL_HANDLE;
+    VkSurfaceKHR m_surface = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties;
+    DeviceContext m_context;
+    PipelineCache m_pipelineCache;
+    CommandRecorder m_recorder;
+
+    // swapchain images, or offscreen images of a headless renderer, one per frame in flight
+    VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+    VkFormat m_targetFormat = VK_FORMAT_UNDEFINED;
+    Extent2i m_extent = { 0, 0 };
+    vector<VkImage> m_targetImages;
+    vector<VkImageView> m_targetViews;
+    vector<VulkanTexture> m_offscreenTargets;
+    vector<VkFramebuffer> m_framebuffers;
+    vector<VkSemaphore> m_renderFinished;  // per target image, a frame may not reuse it before it is presented
+    VulkanTexture m_depthTarget;
+    bool m_targetsDirty = false;
+
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    VkRenderPass m_bakeRenderPass = VK_NULL_HANDLE;
+    VkFormat m_cubeMapFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+    array<Frame, FRAMES_IN_FLIGHT> m_frames;
+    int m_frameIndex = 0;
+    int m_lastFrameIndex = -1;
+    int m_renderedFrames = 0;
+
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_frameSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_materialSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_bakeSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet m_materialSet = VK_NULL_HANDLE;
+    VkPipelineLayout m_sceneLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_bakeLayout = VK_NULL_HANDLE;
+    VkSampler m_clampSampler = VK_NULL_HANDLE;
+    VkSampler m_repeatSampler = VK_NULL_HANDLE;
+
+    VkPipeline m_backgroundPipeline = VK_NULL_HANDLE;
+    // pbr_model variants by debug view and light count, the material maps are fixed per run
+    std::map<uint32_t, VkPipeline> m_modelPipelines;
+    VkShaderModule m_modelVertModule = VK_NULL_HANDLE;
+    VkShaderModule m_modelFragModule = VK_NULL_HANDLE;
+    bool m_albedoMetallicMap = false;
+    bool m_normalRoughnessMap = false;
+    bool m_emissiveAOMap = false;
+
+    PerDrawData m_cube;
+    PerDrawData m_model;
+    VulkanTexture m_hdrTexture;
+    VulkanTexture m_brdfLUTTexture;
+    VulkanTexture m_cubeMapTexture;
+    VulkanTexture m_irradianceTexture;
+    VulkanTexture m_specularTexture;
+    VulkanTexture m_albedoMetallicTexture;
+    VulkanTexture m_normalRoughnessTexture;
+    VulkanTexture m_emissiveAOTexture;
+    VulkanTexture m_defaultTexture;  // bound in place of a missing material map
+
+    mat4 m_cubeMapPerspective;
+    array<mat4, 6> m_cubeMapViews;
+};
+
+}  // namespace vk
+}  // namespace pbr
@@ -1,251 +1,344 @@
+// Headless split-sum BRDF LUT generator.
+// Integrates the GGX/Smith environment BRDF (learnopengl.com, "Specular IBL") on the CPU and
+// writes the scale and bias terms as half-float RG texels, the format the runtime uploads as GL_RG16F.
+//
+// usage: brdfLutGenerator [--size N] [--samples N] [--threads N] [--output brdf.bin]
+//                         [--png brdf.png] [--header BrdfLUT.generated.h] [--header-size N]
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <string>
+#include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
-#define LUT_SIZE 512
-#ifndef SHADER_DIR
-#   define SHADER_DIR ""
+#include "ImageKernels.h"
+#include "base/Half.h"
+#include "base/JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRDF_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define BRDF_USE_SSE 0
 #endif
+
 using namespace std;
+using pbr::half_t;
 
-#define OFILE_NAME "brdf.bin"
+static const float PI = 3.14159265359f;
 
-void writePng(const float* data)
+struct Options
 {
-    constexpr int size = 3 * LUT_SIZE * LUT_SIZE;
-    vector<unsigned char> buffer(size);
-    for (int i = 0; i < size; ++i)
-    {
-        buffer[i] = static_cast<unsigned char>(255.999f * data[i]);
-    }
+    int size = 512;
+    int samples = 1024;
+    int threads = 0;
+    string output = "brdf.bin";
+    string png;
+    string header;
+    int headerSize = 32;
+};
 
-    std::cout << "writing png\n";
-    stbi_write_png("brdf.png", LUT_SIZE, LUT_SIZE, 3, buffer.data(), 3 * LUT_SIZE);
+// http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
+static float radicalInverseVdC(uint32_t bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return float(bits) * 2.3283064365386963e-10f;  // / 0x100000000
 }
 
-void readBin(float* in)
+// Half vectors of one LUT row, stored SoA and padded to a multiple of 4.
+// N is fixed to +Z, so the tangent frame of ImportanceSampleGGX is constant and
+// H only depends on the sample index and the roughness of the row.
+struct HalfVectors
 {
-    ifstream bin(OFILE_NAME, ios::out | ios::binary);
-    if (!bin.is_open())
-        throw runtime_error("Failed to open " OFILE_NAME " for read");
+    vector<float> x;
+    vector<float> z;
+    int count = 0;
+};
 
-    constexpr int size = 2 * LUT_SIZE * LUT_SIZE;
-    bin.read(reinterpret_cast<char*>(in), size * sizeof(float));
+static void importanceSampleGGX(float roughness, int sampleCount, HalfVectors& out)
+{
+    const int padded = (sampleCount + 3) & ~3;
+    out.x.assign(padded, 0.0f);
+    out.z.assign(padded, 0.0f);
+    out.count = sampleCount;
 
-    vector<unsigned char> buffer(3 * LUT_SIZE * LUT_SIZE);
-    for (int i = 0; i < LUT_SIZE * LUT_SIZE; ++i)
+    const float a = roughness * roughness;
+    for (int i = 0; i < sampleCount; ++i)
     {
-        buffer[3 * i] = static_cast<unsigned char>(255.999f * in[2 * i]);
-        buffer[3 * i + 1] = static_cast<unsigned char>(255.999f * in[2 * i + 1]);
-        buffer[3 * i + 2] = 0;
+        const float u = float(i) / float(sampleCount);
+        const float v = radicalInverseVdC(uint32_t(i));
+        const float phi = 2.0f * PI * u;
+        const float cosTheta = sqrtf((1.0f - v) / (1.0f + (a * a - 1.0f) * v));
+        const float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+        // tangent = (0, -1, 0), bitangent = (1, 0, 0), so world H = (H.y, -H.x, H.z);
+        // V has no y component, which makes the y term irrelevant
+        out.x[i] = sinf(phi) * sinTheta;
+        out.z[i] = cosTheta;
     }
+    // padded lanes keep z = 0 and therefore never pass the NdotL test
+}
 
-    std::cout << "writing png\n";
-    stbi_write_png("brdf.png", LUT_SIZE, LUT_SIZE, 3, buffer.data(), 3 * LUT_SIZE);
+static inline float geometrySchlickGGX(float NdotV, float k)
+{
+    return NdotV / (NdotV * (1.0f - k) + k);
 }
 
-void writeBin(const float* data)
+#if !BRDF_USE_SSE
+static void integrateScalar(const HalfVectors& h, float NdotV, float roughness, float& outA, float& outB)
 {
-    ofstream bin(OFILE_NAME, ios::out | ios::binary);
-    if (!bin.is_open())
-        throw runtime_error("Failed to open " OFILE_NAME " for write");
+    const float Vx = sqrtf(1.0f - NdotV * NdotV);
+    const float Vz = NdotV;
+    const float k = (roughness * roughness) / 2.0f;
+    const float gV = geometrySchlickGGX(NdotV, k);
+
+    float A = 0.0f;
+    float B = 0.0f;
+    for (int i = 0; i < h.count; ++i)
+    {
+        const float VdotH = max(Vx * h.x[i] + Vz * h.z[i], 0.0f);
+        const float NdotL = 2.0f * VdotH * h.z[i] - Vz;
+        if (NdotL > 0.0f)
+        {
+            const float NdotH = h.z[i];
+            const float G = gV * geometrySchlickGGX(NdotL, k);
+            const float G_Vis = (G * VdotH) / (NdotH * NdotV);
+            const float c = 1.0f - VdotH;
+            const float Fc = c * c * c * c * c;
+            A += (1.0f - Fc) * G_Vis;
+            B += Fc * G_Vis;
+        }
+    }
 
-    int size = 2 * LUT_SIZE * LUT_SIZE;
+    outA = A / float(h.count);
+    outB = B / float(h.count);
+}
+#else
+static inline float horizontalSum(__m128 v)
+{
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
 
-    vector<float> buffer(size);
-    for (int i = 0; i < LUT_SIZE * LUT_SIZE; ++i)
+// same as integrateScalar, four samples per iteration
+static void integrateSSE(const HalfVectors& h, float NdotV, float roughness, float& outA, float& outB)
+{
+    const float k = (roughness * roughness) / 2.0f;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 vx = _mm_set1_ps(sqrtf(1.0f - NdotV * NdotV));
+    const __m128 vz = _mm_set1_ps(NdotV);
+    const __m128 vk = _mm_set1_ps(k);
+    const __m128 oneMinusK = _mm_set1_ps(1.0f - k);
+    const __m128 gVOverNdotV = _mm_set1_ps(geometrySchlickGGX(NdotV, k) / NdotV);
+
+    __m128 A = zero;
+    __m128 B = zero;
+    const int padded = static_cast<int>(h.x.size());
+    for (int i = 0; i < padded; i += 4)
     {
-        buffer[2 * i] = data[3 * i];
-        buffer[2 * i + 1] = data[3 * i + 1];
+        const __m128 hx = _mm_loadu_ps(&h.x[i]);
+        const __m128 hz = _mm_loadu_ps(&h.z[i]);
+        const __m128 VdotH = _mm_max_ps(_mm_add_ps(_mm_mul_ps(vx, hx), _mm_mul_ps(vz, hz)), zero);
+        const __m128 NdotL = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(VdotH, VdotH), hz), vz);
+        const __m128 mask = _mm_cmpgt_ps(NdotL, zero);
+
+        // G_Vis = G(V) * G(L) * VdotH / (NdotH * NdotV)
+        const __m128 gL = _mm_div_ps(NdotL, _mm_add_ps(_mm_mul_ps(NdotL, oneMinusK), vk));
+        // masked lanes may divide by zero (hz == 0 in padding), the result is discarded below
+        __m128 gVis = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(gVOverNdotV, gL), VdotH), hz);
+        gVis = _mm_and_ps(mask, gVis);
+
+        const __m128 c = _mm_sub_ps(one, VdotH);
+        const __m128 c2 = _mm_mul_ps(c, c);
+        const __m128 Fc = _mm_mul_ps(_mm_mul_ps(c2, c2), c);
+
+        A = _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(one, Fc), gVis));
+        B = _mm_add_ps(B, _mm_mul_ps(Fc, gVis));
     }
 
-    bin.write((char*) buffer.data(), size * sizeof(float));
+    outA = horizontalSum(A) / float(h.count);
+    outB = horizontalSum(B) / float(h.count);
+}
+#endif
+
+// row j holds roughness (j + 0.5) / size, column i holds NdotV (i + 0.5) / size,
+// matching a full screen quad rendered at size x size and read back with glReadPixels
+static vector<float> generateLUT(int size, int samples)
+{
+    pbr::JobSystem& jobSystem = pbr::JobSystem::GetSingleton();
+    vector<float> lut(2 * size_t(size) * size_t(size));
+    vector<HalfVectors> scratch(jobSystem.ThreadCount());
+
+    // one row per job, rough rows take longer to converge
+    jobSystem.ParallelFor("brdf row", size, [&](int row, int workerIndex)
+    {
+        HalfVectors& h = scratch[workerIndex];
+        const float roughness = (float(row) + 0.5f) / float(size);
+        importanceSampleGGX(roughness, samples, h);
+        float* out = &lut[2 * size_t(row) * size_t(size)];
+        for (int col = 0; col < size; ++col)
+        {
+            const float NdotV = (float(col) + 0.5f) / float(size);
+#if BRDF_USE_SSE
+            integrateSSE(h, NdotV, roughness, out[2 * col], out[2 * col + 1]);
+#else
+            integrateScalar(h, NdotV, roughness, out[2 * col], out[2 * col + 1]);
+#endif
+        }
+    }, 1);
+
+    return lut;
+}
+
+static vector<half_t> toHalf(const vector<float>& data)
+{
+    vector<half_t> result(data.size());
+    pbr::kernels::FloatToHalf(data.data(), result.data(), data.size());
+    return result;
+}
+
+static void writeBin(const string& path, const vector<half_t>& data)
+{
+    ofstream bin(path, ios::out | ios::binary);
+    if (!bin.is_open())
+        throw runtime_error("Failed to open " + path + " for write");
+
+    bin.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(half_t));
     bin.close();
 
     if (!bin.good())
-        throw runtime_error("Error occured when writing to " OFILE_NAME);
+        throw runtime_error("Error occured when writing to " + path);
 }
 
-string readAscciFile(const char* path)
+static void writePng(const string& path, const vector<float>& data, int size)
 {
-    ifstream f(path);
-    if (!f.good())
-        throw runtime_error("Failed to openfile: " + string(path));
-
-    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    vector<uint8_t> rg(data.size());
+    pbr::kernels::FloatToUnorm(data.data(), rg.data(), data.size());
+    vector<unsigned char> buffer(3 * size_t(size) * size_t(size));
+    pbr::kernels::Swizzle(rg.data(), 2, buffer.data(), 3, { 0, 1, pbr::kernels::ZERO }, size_t(size) * size_t(size));
+
+    // flip, so roughness 0 is at the bottom like the original GPU visualization
+    const int stride = 3 * size;
+    stbi_write_png(path.c_str(), size, size, 3, buffer.data() + size_t(stride) * (size - 1), -stride);
 }
 
-GLuint createShaderFromString(const string& source, GLenum type)
-{
-    const int MAX_LOG_SIZE = 512;
-    GLuint handle = glCreateShader(type);
-    const char* sources[] = { source.c_str() };
-    glShaderSource(handle, 1, sources, NULL);
-    glCompileShader(handle);
-    int success;
-    char log[MAX_LOG_SIZE];
-    glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
-    if (!success)
+// small table meant to be compiled into the runtime, e.g. as a fallback when brdf.bin is missing
+static void writeHeader(const string& path, const vector<half_t>& data, int size, int samples)
+{
+    ofstream header(path);
+    if (!header.is_open())
+        throw runtime_error("Failed to open " + path + " for write");
+
+    header << "#pragma once\n";
+    header << "// generated by brdfLutGenerator --header-size " << size << " --samples " << samples << "\n";
+    header << "#include <cstdint>\n\n";
+    header << "namespace generated {\n\n";
+    header << "constexpr int brdf_lut_size = " << size << ";\n";
+    header << "// half-float RG, row-major, rows from roughness 0 to 1\n";
+    header << "constexpr uint16_t brdf_lut[" << data.size() << "] = {";
+    for (size_t i = 0; i < data.size(); ++i)
     {
-        glGetShaderInfoLog(handle, MAX_LOG_SIZE, NULL, log);
-        log[MAX_LOG_SIZE - 1] = '\0'; // prevent overflow
-        string error("glsl: Failed to compile shader\n");
-        error.append(log).pop_back(); // remove new line
-        throw runtime_error(error);
+        if (i % 16 == 0)
+            header << "\n   ";
+        header << " 0x" << hex << data[i] << dec << ",";
     }
+    header << "\n};\n\n} // namespace generated\n";
 
-    return handle;
+    if (!header.good())
+        throw runtime_error("Error occured when writing to " + path);
 }
 
-GLuint compileShader(const char* vert, const char* frag)
+static int parsePositive(const char* option, const char* value)
 {
-    const string vertSource = readAscciFile(vert);
-    GLuint vertShader = createShaderFromString(vertSource, GL_VERTEX_SHADER);
-    const string fragSource = readAscciFile(frag);
-    GLuint fragShader = createShaderFromString(fragSource, GL_FRAGMENT_SHADER);
-
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertShader);
-    glAttachShader(program, fragShader);
-    glLinkProgram(program);
+    const int result = atoi(value);
+    if (result <= 0)
+        throw runtime_error(string("Invalid value for ") + option + ": " + value);
+    return result;
+}
 
-    const int MAX_LOG_SIZE = 512;
-    int success;
-    char log[MAX_LOG_SIZE];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
     {
-        glGetProgramInfoLog(program, MAX_LOG_SIZE, NULL, log);
-        log[MAX_LOG_SIZE - 1] = '\0'; // prevent overflow
-        string error("glsl: Failed to link program\n");
-        error.append(log).pop_back(); // remove new line
-        throw runtime_error(error);
+        const string arg = argv[i];
+        if (i + 1 >= argc)
+            throw runtime_error("Missing value for " + arg);
+
+        const char* value = argv[++i];
+        if (arg == "--size")
+            options.size = parsePositive("--size", value);
+        else if (arg == "--samples")
+            options.samples = parsePositive("--samples", value);
+        else if (arg == "--threads")
+            options.threads = parsePositive("--threads", value);
+        else if (arg == "--output")
+            options.output = value;
+        else if (arg == "--png")
+            options.png = value;
+        else if (arg == "--header")
+            options.header = value;
+        else if (arg == "--header-size")
+            options.headerSize = parsePositive("--header-size", value);
+        else
+            throw runtime_error("Unknown option " + arg);
     }
 
-    glDeleteShader(vertShader);
-    glDeleteShader(fragShader);
+    if (options.threads == 0)
+        options.threads = max(1, int(thread::hardware_concurrency()));
 
-    return program;
+    return options;
 }
 
-struct Vertex
+int main(int argc, const char** argv)
 {
-    GLfloat x, y;
-};
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        pbr::JobSystem::GetSingleton().Initialize(options.threads);
 
-Vertex vertices[] = {
-    { -1.0f, +1.0f },
-    { -1.0f, -1.0f },
-    { +1.0f, +1.0f },
-    { +1.0f, +1.0f },
-    { -1.0f, -1.0f },
-    { +1.0f, -1.0f },
-};
+        cout << "generating " << options.size << "x" << options.size << " LUT, "
+             << options.samples << " samples, " << options.threads << " threads"
+             << (BRDF_USE_SSE ? ", SSE" : "") << endl;
 
-int main()
-{
-    glfwSetErrorCallback([](int error, const char* desc)
-    {
-        throw runtime_error("[Error] glfw: " + string(desc));
-    });
+        const auto start = chrono::steady_clock::now();
+        const vector<float> lut = generateLUT(options.size, options.samples);
+        const auto end = chrono::steady_clock::now();
+        cout << "integrated in " << chrono::duration<double, milli>(end - start).count() << " ms" << endl;
 
-    try
-    {
-        glfwInit();
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-        GLFWwindow* window = glfwCreateWindow(LUT_SIZE, LUT_SIZE, "BRDF LUT", 0, 0);
-        glfwMakeContextCurrent(window);
-        if (gladLoadGL() == 0)
-            throw runtime_error("[Error] glad: failed to load gl functions");
-
-        // shader
-        GLuint brdfProgram = compileShader(SHADER_DIR "quad.vert", SHADER_DIR "brdf.frag");
-        GLuint quadProgram = compileShader(SHADER_DIR "quad.vert", SHADER_DIR "visualization.frag");
-        // vao
-        GLuint vao, vbo;
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-        glEnableVertexAttribArray(0);
-        glUseProgram(brdfProgram);
-
-        // texture
-        // unsigned int brdfLUTTexture;
-        // glGenTextures(1, &brdfLUTTexture);
-        // glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-        // glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, LUT_SIZE, LUT_SIZE, 0, GL_RGB, GL_FLOAT, 0);
-        // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // // fbo
-        // unsigned int captureFBO;
-        // unsigned int captureRBO;
-        // glGenFramebuffers(1, &captureFBO);
-        // glGenRenderbuffers(1, &captureRBO);
-        // glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-        // glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        // glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-        // glViewport(0, 0, LUT_SIZE, LUT_SIZE);
-        // glUseProgram(brdfProgram);
-        // glClear(GL_COLOR_BUFFER_BIT);
-        // glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // // read pixels
-        // vector<float> buffer(3 * LUT_SIZE * LUT_SIZE);
-        // // float* buffer = new float[3 * LUT_SIZE * LUT_SIZE];
-        // glReadPixels(0, 0, LUT_SIZE, LUT_SIZE, GL_RGB, GL_FLOAT, buffer.data());
-        // writeBin(buffer);
-        // writePng(buffer.data());
-        float* in = new float[2 * LUT_SIZE * LUT_SIZE];
-        readBin(in);
-
-        unsigned int brdfLUTTexture;
-        glGenTextures(1, &brdfLUTTexture);
-        glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, LUT_SIZE, LUT_SIZE, 0, GL_RG, GL_FLOAT, in);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        delete [] in;
-
-        // render to screen
-        glUseProgram(quadProgram);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        while(!glfwWindowShouldClose(window))
+        writeBin(options.output, toHalf(lut));
+        cout << "written " << options.output << endl;
+
+        if (!options.png.empty())
         {
-            glfwPollEvents();
-            glViewport(0, 0, LUT_SIZE, LUT_SIZE);
-            glClear(GL_COLOR_BUFFER_BIT);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glfwSwapBuffers(window);
+            writePng(options.png, lut, options.size);
+            cout << "written " << options.png << endl;
         }
 
-        glDeleteBuffers(1, &vbo);
-        glDeleteVertexArrays(1, &vao);
-        glDeleteProgram(brdfProgram);
-
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!options.header.empty())
+        {
+            const vector<float> small = generateLUT(options.headerSize, options.samples);
+            writeHeader(options.header, toHalf(small), options.headerSize, options.samples);
+            cout << "written " << options.header << endl;
+        }
+        pbr::JobSystem::GetSingleton().Finalize();
     }
-    catch(const runtime_error& e)
+    catch (const runtime_error& e)
     {
-        cerr << e.what() << endl;
+        cerr << "[Error] " << e.what() << endl;
         return -1;
     }
 
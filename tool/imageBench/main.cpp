@@ -0,0 +1,318 @@
+// Times the image kernels of ImageKernels.h on a synthetic --size x --size image against the scalar loops
+// they replaced: the RGB expansion of utility::ReadPng, the channel merge of mergeTextures, the half-float
+// conversion of brdfLutGenerator and the 2x2 box filter of the mip chains. Every version the CPU supports
+// runs, the best of --runs on --threads threads counts. The output of each version must match the scalar
+// reference bit for bit, the scalar reference must be at least as fast as the loop it replaced, it is what
+// ARM and the browser run, and DecodeHdr must reject a set of truncated and corrupt Radiance files; the exit
+// code is -1 when one of them doesn't hold.
+//
+// usage: imageBench [--size N] [--runs N] [--threads N]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HdrDecoder.h"
+#include "ImageKernels.h"
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+using namespace std;
+namespace kernels = pbr::kernels;
+using pbr::half_t;
+
+// the scalar reference of a kernel that runs the very code of its loop still comes out a few percent
+// either side of it
+static const double TIMING_NOISE = 1.05;
+
+struct Options
+{
+    int size = 2048;
+    int runs = 10;
+    int threads = 0;
+};
+
+static int parsePositive(const char* name, const char* value)
+{
+    const int result = atoi(value);
+    if (result <= 0)
+        throw runtime_error(string(name) + " expects a positive number, got '" + value + "'");
+    return result;
+}
+
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (i + 1 >= argc)
+            throw runtime_error("usage: imageBench [--size N] [--runs N] [--threads N]");
+
+        const char* value = argv[++i];
+        if (arg == "--size")
+            options.size = parsePositive("--size", value);
+        else if (arg == "--runs")
+            options.runs = parsePositive("--runs", value);
+        else if (arg == "--threads")
+            options.threads = parsePositive("--threads", value);
+        else
+            throw runtime_error("Unknown option " + arg);
+    }
+    if (options.threads == 0)
+        options.threads = max(1, int(thread::hardware_concurrency()));
+    return options;
+}
+
+// the loops as they were before the kernels, single threaded like they ran in their callers
+
+static void expandRgbLoop(const uint8_t* data, uint8_t* buffer, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        buffer[4 * i] = data[3 * i];
+        buffer[4 * i + 1] = data[3 * i + 1];
+        buffer[4 * i + 2] = data[3 * i + 2];
+        buffer[4 * i + 3] = 0;
+    }
+}
+
+static void mergeLoop(const uint8_t* buffer1, const uint8_t* buffer2, uint8_t* buffer, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        buffer[4 * i + 0] = buffer1[3 * i];
+        buffer[4 * i + 1] = buffer1[3 * i + 1];
+        buffer[4 * i + 2] = buffer1[3 * i + 2];
+        buffer[4 * i + 3] = buffer2[i];
+    }
+}
+
+static void toHalfLoop(const vector<float>& data, vector<half_t>& result)
+{
+    for (size_t i = 0; i < data.size(); ++i)
+        result[i] = pbr::FloatToHalf(data[i]);
+}
+
+static void downsampleLoop(const pbr::Image& source, pbr::Image& target)
+{
+    const int c = source.component;
+    target.width = max(1, source.width / 2);
+    target.height = max(1, source.height / 2);
+    target.component = c;
+    target.dataType = pbr::DataType::UINT_8T;
+    target.Allocate(size_t(target.width) * target.height * c);
+
+    const uint8_t* pSource = static_cast<const uint8_t*>(source.buffer.pData);
+    uint8_t* pTarget = static_cast<uint8_t*>(target.buffer.pData);
+    for (int y = 0; y < target.height; ++y)
+    {
+        const uint8_t* pRow0 = pSource + size_t(min(2 * y, source.height - 1)) * source.width * c;
+        const uint8_t* pRow1 = pSource + size_t(min(2 * y + 1, source.height - 1)) * source.width * c;
+        uint8_t* pOut = pTarget + size_t(y) * target.width * c;
+        for (int x = 0; x < target.width; ++x)
+        {
+            const int x0 = min(2 * x, source.width - 1) * c;
+            const int x1 = min(2 * x + 1, source.width - 1) * c;
+            for (int i = 0; i < c; ++i)
+                pOut[x * c + i] = uint8_t((pRow0[x0 + i] + pRow0[x1 + i] + pRow1[x0 + i] + pRow1[x1 + i] + 2) / 4);
+        }
+    }
+}
+
+static double elapsed(const function<void()>& run)
+{
+    const auto start = chrono::high_resolution_clock::now();
+    run();
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// best of runs in ms
+static double measure(int runs, const function<void()>& run)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i)
+        best = min(best, elapsed(run));
+    return best;
+}
+
+class Bench
+{
+public:
+    explicit Bench(const Options& options) : m_options(options) {}
+
+    // loop is the code the kernel replaced, empty if there was none, kernel runs at the active isa and
+    // output reads what it wrote
+    void add(const string& name, const function<void()>& loop, const function<void()>& kernel, const function<vector<uint8_t>()>& output)
+    {
+        kernels::SetIsa(kernels::Isa::SCALAR);
+        kernel();
+        const vector<uint8_t> reference = output();
+        // the loop and the scalar reference take turns, a slow stretch of a busy machine hits both
+        double loopMs = 0.0, scalarMs = 1e30;
+        if (loop)
+        {
+            loopMs = 1e30;
+            for (int i = 0; i < m_options.runs; ++i)
+            {
+                loopMs = min(loopMs, elapsed(loop));
+                scalarMs = min(scalarMs, elapsed(kernel));
+            }
+        }
+        cout << left << setw(24) << name;
+        if (loop)
+            cout << " loop " << fixed << setprecision(2) << setw(8) << loopMs << " ms";
+        cout << endl;
+        for (kernels::Isa isa : { kernels::Isa::SCALAR, kernels::Isa::SSE41, kernels::Isa::AVX2 })
+        {
+            if (!kernels::IsSupported(isa))
+                continue;
+            kernels::SetIsa(isa);
+            const double ms = loop && isa == kernels::Isa::SCALAR ? scalarMs : measure(m_options.runs, kernel);
+            const bool same = output() == reference;
+            const bool slower = loop && isa == kernels::Isa::SCALAR && ms > loopMs * TIMING_NOISE;
+            cout << "    " << left << setw(8) << kernels::IsaToString(isa) << fixed << setprecision(2) << setw(8) << ms << " ms";
+            if (loop)
+                cout << "  x" << setprecision(1) << loopMs / ms;
+            cout << (same ? "" : "  differs from the scalar reference") << (slower ? "  slower than the loop" : "") << endl;
+            m_failed |= !same || slower;
+        }
+    }
+
+    bool Failed() const { return m_failed; }
+
+private:
+    const Options& m_options;
+    bool m_failed = false;
+};
+
+// each file in a buffer of its exact size, a read past the end shows under AddressSanitizer
+static bool rejectsMalformedHdr()
+{
+    const string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n";
+    const struct
+    {
+        const char* name;
+        string data;
+    } files[] = {
+        { "header without its end", "#?RADIANCE\nFORMAT=32-bit_rle_rgbe" },
+        { "resolution without newline", "#?RADIANCE\n\n-Y 2 +X 14" },
+        { "missing scanlines", header + "-Y 2 +X 14\n" },
+        { "short flat scanline", header + "-Y 1 +X 2\n" + string(5, '\x40') },
+        { "run without its value", header + "-Y 1 +X 8\n" + string("\x02\x02\x00\x08\x88", 5) },
+        { "run past the width", header + "-Y 1 +X 8\n" + string("\x02\x02\x00\x08\x89\x40", 6) },
+    };
+
+    bool rejected = true;
+    cout << "malformed hdr files" << endl;
+    for (const auto& file : files)
+    {
+        const vector<uint8_t> data(file.data.begin(), file.data.end());
+        string result = "accepted";
+        try
+        {
+            pbr::DecodeHdr(data.data(), data.size(), pbr::HdrFormat::FLOAT32, 0, file.name);
+        }
+        catch (const pbr::Exception&)
+        {
+            result = "rejected";
+        }
+        cout << "    " << left << setw(28) << file.name << result << endl;
+        rejected &= result == "rejected";
+    }
+    return rejected;
+}
+
+template <typename T>
+static vector<uint8_t> bytesOf(const T* pData, size_t count)
+{
+    const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+    return vector<uint8_t>(pBytes, pBytes + count * sizeof(T));
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        pbr::JobSystem::GetSingleton().Initialize(options.threads);
+        const int count = options.size * options.size;
+        cout << options.size << "x" << options.size << ", best of " << options.runs << " runs, " << options.threads << " threads" << endl;
+
+        // noisy gradients, like the texels of the material maps
+        mt19937 random(7);
+        vector<uint8_t> rgb(3 * size_t(count)), gray(count), rgba(4 * size_t(count));
+        for (size_t i = 0; i < rgb.size(); ++i)
+            rgb[i] = uint8_t(i / 3 % options.size + random() % 16);
+        for (size_t i = 0; i < gray.size(); ++i)
+            gray[i] = uint8_t(i / options.size + random() % 16);
+        for (size_t i = 0; i < rgba.size(); ++i)
+            rgba[i] = uint8_t(i / 4 % options.size + random() % 16);
+        vector<float> floats(2 * size_t(count));
+        uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (float& value : floats)
+            value = unit(random);
+
+        Bench bench(options);
+        vector<uint8_t> expanded(4 * size_t(count));
+        auto expandedBytes = [&] { return expanded; };
+        bench.add("expand rgb (ReadPng)", [&] { expandRgbLoop(rgb.data(), expanded.data(), count); }, [&] {
+            kernels::Swizzle(rgb.data(), 3, expanded.data(), 4, { 0, 1, 2, kernels::ZERO }, count);
+        }, expandedBytes);
+        bench.add("merge (mergeTextures)", [&] { mergeLoop(rgb.data(), gray.data(), expanded.data(), count); }, [&] {
+            kernels::Swizzle(rgb.data(), 3, expanded.data(), 4, { 0, 1, 2, kernels::ZERO }, count);
+            kernels::Swizzle(gray.data(), 1, expanded.data(), 4, { kernels::KEEP, kernels::KEEP, kernels::KEEP, 0 }, count);
+        }, expandedBytes);
+
+        vector<half_t> halves(floats.size());
+        bench.add("float to half (brdf)", [&] { toHalfLoop(floats, halves); }, [&] {
+            kernels::FloatToHalf(floats.data(), halves.data(), floats.size());
+        }, [&] { return bytesOf(halves.data(), halves.size()); });
+        vector<float> decoded(floats.size());
+        bench.add("half to float", nullptr, [&] {
+            kernels::HalfToFloat(halves.data(), decoded.data(), halves.size());
+        }, [&] { return bytesOf(decoded.data(), decoded.size()); });
+        vector<float> radiance(3 * size_t(count));
+        bench.add("rgbe to float", nullptr, [&] {
+            kernels::RgbeToFloat(rgba.data(), radiance.data(), count);
+        }, [&] { return bytesOf(radiance.data(), radiance.size()); });
+
+        pbr::Image image;
+        image.width = image.height = options.size;
+        image.component = 4;
+        image.dataType = pbr::DataType::UINT_8T;
+        image.Wrap(rgba.data(), rgba.size());
+        pbr::Image mip;
+        auto mipBytes = [&] { return bytesOf(static_cast<const uint8_t*>(mip.buffer.pData), mip.buffer.sizeInByte); };
+        bench.add("box mip (MipChain)", [&] { downsampleLoop(image, mip); }, [&] { kernels::Downsample(image, mip, kernels::MipFilter::BOX); }, mipBytes);
+        bench.add("box mip, sRGB", nullptr, [&] { kernels::Downsample(image, mip, kernels::MipFilter::BOX, kernels::SRGB_RGB); }, mipBytes);
+        bench.add("kaiser mip", nullptr, [&] { kernels::Downsample(image, mip, kernels::MipFilter::KAISER); }, mipBytes);
+        bench.add("kaiser mip, sRGB", nullptr, [&] { kernels::Downsample(image, mip, kernels::MipFilter::KAISER, kernels::SRGB_RGB); }, mipBytes);
+
+        const bool hdrRejected = rejectsMalformedHdr();
+
+        pbr::JobSystem::GetSingleton().Finalize();
+        if (bench.Failed() || !hdrRejected)
+            return -1;
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << "[Error] " << e.what() << endl;
+        return -1;
+    }
+    catch (const pbr::Exception& e)
+    {
+        cerr << "[Error] " << e << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <stb_image_write.h>
 #include <iostream>
 #include <assert.h>
+#include "ImageKernels.h"
+#include "base/JobSystem.h"
 
 void merge(const char* image1, const char* image2)
 {
@@ -23,13 +25,8 @@ void merge(const char* image1, const char* image2)
     int size = width1 * height1;
     unsigned char* buffer = new unsigned char[4 * size];
 
-    for (int i = 0; i < size; ++i)
-    {
-        buffer[4 * i + 0] = buffer1[channel1 * i];
-        buffer[4 * i + 1] = buffer1[channel1 * i + 1];
-        buffer[4 * i + 2] = buffer1[channel1 * i + 2];
-        buffer[4 * i + 3] = buffer2[channel2 * i + 0];
-    }
+    pbr::kernels::Swizzle(buffer1, channel1, buffer, 4, { 0, 1, 2, pbr::kernels::ZERO }, size);
+    pbr::kernels::Swizzle(buffer2, channel2, buffer, 4, { pbr::kernels::KEEP, pbr::kernels::KEEP, pbr::kernels::KEEP, 0 }, size);
 
     stbi_write_png("test.png", width1, height1, 4, buffer, 4 * width1);
 
@@ -38,7 +35,9 @@ void merge(const char* image1, const char* image2)
 
 int main()
 {
+    pbr::JobSystem::GetSingleton().Initialize();
     merge("e.png", "ao_r_m.png");
+    pbr::JobSystem::GetSingleton().Finalize();
     // int width, height, channel;
     // unsigned char* buffer1 = stbi_load("Emissive.jpg", &width, &height, &channel, 0);
 
@@ -0,0 +1,184 @@
+// Compresses model.txt and model.bin of a model directory into the model.mesh utility::LoadModel prefers.
+// The triangles are grouped into meshlets first, see BuildMeshlets(). Every mesh is decoded again before
+// it is written: positions, uvs and triangles must come back exactly, triangles may be rotated, the
+// filtered normals, tangents and bitangents within --max-angle degrees.
+// The decode time is the best of --runs decodes on --threads threads.
+//
+// usage: meshCompressor [--threads N] [--runs N] [--max-angle degrees] <model dir>...
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MeshCodec.h"
+#include "Utility.h"
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+using namespace std;
+using pbr::MeshCodec;
+using pbr::TexturedMesh;
+using pbr::TexturedVertex;
+
+struct Options
+{
+    int threads = 0;
+    int runs = 20;
+    float maxAngle = 0.05f;
+    vector<string> directories;
+};
+
+static int parsePositive(const char* name, const char* value)
+{
+    const int result = atoi(value);
+    if (result <= 0)
+        throw runtime_error(string(name) + " expects a positive number, got '" + value + "'");
+    return result;
+}
+
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            // LoadModel appends the file names
+            options.directories.push_back(arg.back() == '/' ? arg : arg + "/");
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw runtime_error("Missing value for " + arg);
+
+        const char* value = argv[++i];
+        if (arg == "--threads")
+            options.threads = parsePositive("--threads", value);
+        else if (arg == "--runs")
+            options.runs = parsePositive("--runs", value);
+        else if (arg == "--max-angle")
+            options.maxAngle = float(atof(value));
+        else
+            throw runtime_error("Unknown option " + arg);
+    }
+
+    if (options.directories.empty())
+        throw runtime_error("usage: meshCompressor [--threads N] [--runs N] [--max-angle degrees] <model dir>...");
+    if (options.threads == 0)
+        options.threads = max(1, int(thread::hardware_concurrency()));
+
+    return options;
+}
+
+// degrees between a unit vector and the decoded one, 0 for the zero vectors the filter can't keep
+static float angleBetween(const pbr::vec3& a, const pbr::vec3& b)
+{
+    const float length = sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+    if (length == 0.0f)
+        return 0.0f;
+    const float cosine = (a.x * b.x + a.y * b.y + a.z * b.z) / length;
+    return acos(min(1.0f, cosine)) * 57.2957795f;
+}
+
+static bool sameTriangle(const pbr::uvec3& a, const pbr::uvec3& b)
+{
+    for (int r = 0; r < 3; ++r)
+    {
+        if (a[r] == b.x && a[(r + 1) % 3] == b.y && a[(r + 2) % 3] == b.z)
+            return true;
+    }
+    return false;
+}
+
+static void verify(const TexturedMesh& source, const TexturedMesh& decoded, float maxAngle)
+{
+    if (source.vertices.size() != decoded.vertices.size() || source.indices.size() != decoded.indices.size())
+        throw runtime_error("decoded mesh has a different size");
+
+    float worst = 0.0f;
+    for (size_t i = 0; i < source.vertices.size(); ++i)
+    {
+        const TexturedVertex& a = source.vertices[i];
+        const TexturedVertex& b = decoded.vertices[i];
+        if (memcmp(&a.position, &b.position, sizeof(a.position)) != 0 || memcmp(&a.uv, &b.uv, sizeof(a.uv)) != 0)
+            throw runtime_error("vertex " + to_string(i) + " changed");
+        worst = max({ worst, angleBetween(a.normal, b.normal), angleBetween(a.tangent, b.tangent), angleBetween(a.bitangent, b.bitangent) });
+    }
+    for (size_t i = 0; i < source.indices.size(); ++i)
+    {
+        if (!sameTriangle(source.indices[i], decoded.indices[i]))
+            throw runtime_error("triangle " + to_string(i) + " changed");
+    }
+    if (source.meshlets.size() != decoded.meshlets.size() ||
+        memcmp(source.meshlets.data(), decoded.meshlets.data(), source.meshlets.size() * sizeof(pbr::Meshlet)) != 0)
+        throw runtime_error("meshlets changed");
+
+    cout << "  largest vector error " << worst << " degrees" << endl;
+    if (worst > maxAngle)
+        throw runtime_error("vector error above --max-angle");
+}
+
+static void compress(const string& directory, const Options& options)
+{
+    cout << directory << endl;
+    TexturedMesh mesh = pbr::utility::LoadRawModel(directory.c_str());
+    const auto buildStart = chrono::steady_clock::now();
+    pbr::BuildMeshlets(mesh);
+    const double buildTime = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+    const vector<uint8_t> encoded = MeshCodec::Encode(mesh);
+    const size_t rawSize = mesh.vertices.size() * sizeof(TexturedVertex) + mesh.indices.size() * sizeof(pbr::uvec3);
+
+    double best = 1e9;
+    TexturedMesh decoded;
+    for (int run = 0; run < options.runs; ++run)
+    {
+        const auto start = chrono::steady_clock::now();
+        decoded = MeshCodec::Decode(encoded.data(), encoded.size());
+        const auto end = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double>(end - start).count());
+    }
+    verify(mesh, decoded, options.maxAngle);
+
+    const string path = directory + "model.mesh";
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    if (!file.good())
+        throw runtime_error("Failed to write " + path);
+
+    cout << "  " << mesh.vertices.size() << " vertices, " << mesh.indices.size() << " triangles, "
+         << rawSize << " -> " << encoded.size() << " bytes (" << double(rawSize) / encoded.size() << "x)" << endl;
+    cout << "  " << mesh.meshlets.size() << " meshlets of " << double(mesh.indices.size()) / mesh.meshlets.size() << " triangles on average, built in "
+         << buildTime * 1000.0 << " ms" << endl;
+    cout << "  decoded in " << best * 1000.0 << " ms, " << rawSize / best / 1e9 << " GB/s" << endl;
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        pbr::JobSystem::GetSingleton().Initialize(options.threads);
+        cout << "decoding on " << options.threads << " threads" << endl;
+        for (const string& directory : options.directories)
+            compress(directory, options);
+        pbr::JobSystem::GetSingleton().Finalize();
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << "[Error] " << e.what() << endl;
+        return -1;
+    }
+    catch (const pbr::Exception& e)
+    {
+        cerr << "[Error] " << e << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Packs the runtime data into the archive --archive mounts, see AssetArchive.h. Every entry is read back
+// through the archive and compared with its file before the tool reports success.
+// Without paths it packs every file of the data directory except cache/, which the renderer writes,
+// images/, which only the README shows, and the archive itself.
+//
+// usage: packAssets [--no-compress] [--output archive] <data dir> [paths relative to data dir...]
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AssetArchive.h"
+#include "base/Error.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+using pbr::AssetArchive;
+
+struct Options
+{
+    bool compress = true;
+    string output;
+    string root;
+    vector<string> names;
+};
+
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (arg == "--no-compress")
+            options.compress = false;
+        else if (arg == "--output" && i + 1 < argc)
+            options.output = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0)
+            throw runtime_error("Unknown option " + arg);
+        else if (options.root.empty())
+            options.root = arg.back() == '/' ? arg : arg + "/";
+        else
+            options.names.push_back(arg);
+    }
+
+    if (options.root.empty())
+        throw runtime_error("usage: packAssets [--no-compress] [--output archive] <data dir> [paths...]");
+    if (options.output.empty())
+        options.output = options.root + "assets.pak";
+
+    return options;
+}
+
+static vector<string> collectNames(const Options& options)
+{
+    vector<string> names;
+    error_code error;
+    const fs::path output = fs::weakly_canonical(options.output, error);
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.root))
+    {
+        if (!entry.is_regular_file() || fs::weakly_canonical(entry.path(), error) == output)
+            continue;
+        const string name = fs::relative(entry.path(), options.root).generic_string();
+        if (name.compare(0, 6, "cache/") == 0 || name.compare(0, 7, "images/") == 0)
+            continue;
+        names.push_back(name);
+    }
+    return names;
+}
+
+static vector<char> readFile(const string& path)
+{
+    ifstream file(path, ios::ate | ios::binary);
+    vector<char> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(bytes.data(), bytes.size());
+    return bytes;
+}
+
+static void verify(const Options& options, const vector<string>& names)
+{
+    AssetArchive archive;
+    archive.Open(options.output);
+    for (const string& name : names)
+    {
+        const int entry = archive.Find(name);
+        if (entry < 0)
+            throw runtime_error("'" + name + "' is missing from the archive");
+        const pbr::FileData data = archive.Read(entry);
+        const vector<char> original = readFile(options.root + name);
+        if (data.Size() != original.size() || memcmp(data.Data(), original.data(), original.size()) != 0)
+            throw runtime_error("'" + name + "' changed in the archive");
+    }
+    if (archive.Find("no/such/file") >= 0)
+        throw runtime_error("the archive finds a file it doesn't hold");
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        // sorted, an unchanged data directory packs into the same bytes
+        vector<string> names = options.names.empty() ? collectNames(options) : options.names;
+        sort(names.begin(), names.end());
+        names.erase(unique(names.begin(), names.end()), names.end());
+
+        const AssetArchive::BuildStats stats = AssetArchive::Build(options.root, names, options.output, options.compress);
+        verify(options, names);
+
+        cout << options.output << endl;
+        cout << "  " << stats.entryCount << " entries, " << stats.compressedCount << " compressed, "
+             << stats.duplicateCount << " duplicates" << endl;
+        cout << "  " << stats.inputSize << " -> " << stats.archiveSize << " bytes ("
+             << double(stats.inputSize) / max<uint64_t>(stats.archiveSize, 1) << "x)" << endl;
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << "[Error] " << e.what() << endl;
+        return -1;
+    }
+    catch (const pbr::Exception& e)
+    {
+        cerr << "[Error] " << e << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,380 @@
+// Error measurement for the REDUCED_PRECISION shading tier.
+// Evaluates the image based lighting path of pbr_model.frag and the tonemap of tonemap.frag for
+// random inputs twice: in fp32, and with every mediump value rounded to binary16 the way a mobile
+// ALU computes it, optionally with the IBL textures stored as R11F_G11F_B10F. The difference is
+// reported in steps of the 8-bit output.
+//
+// Fails when more than --max-outliers percent of the channels are off by more than one step.
+// Such outliers are expected at grazing angles, where 1 - F cancels and dot(N, V) itself carries the
+// rounding of the normal; they are edge pixels of smooth surfaces.
+//
+// usage: precisionCheck [--samples N] [--seed N] [--lut data/preload/brdf.bin] [--lut-size N] [--max-outliers percent]
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "base/Half.h"
+
+using namespace std;
+using pbr::FloatToHalf;
+using pbr::half_t;
+using pbr::HalfToFloat;
+
+struct Options
+{
+    int samples = 1 << 20;
+    uint32_t seed = 1;
+    string lut = "data/preload/brdf.bin";
+    int lutSize = 512;
+    double maxOutliers = 0.01;
+};
+
+// float rounded to binary16 after every operation, what a mediump ALU computes
+struct Half
+{
+    float v;
+    Half(float f = 0.0f) : v(HalfToFloat(FloatToHalf(f))) {}
+};
+
+static inline Half operator+(Half a, Half b) { return Half(a.v + b.v); }
+static inline Half operator-(Half a, Half b) { return Half(a.v - b.v); }
+static inline Half operator*(Half a, Half b) { return Half(a.v * b.v); }
+static inline Half operator/(Half a, Half b) { return Half(a.v / b.v); }
+static inline float toFloat(float a) { return a; }
+static inline float toFloat(Half a) { return a.v; }
+static inline float maxT(float a, float b) { return max(a, b); }
+static inline Half maxT(Half a, Half b) { return Half(max(a.v, b.v)); }
+static inline float minT(float a, float b) { return min(a, b); }
+static inline Half minT(Half a, Half b) { return Half(min(a.v, b.v)); }
+static inline float sqrtT(float a) { return sqrtf(a); }
+static inline Half sqrtT(Half a) { return Half(sqrtf(a.v)); }
+// pow is exp2(y * log2(x)) in hardware, every step rounds
+static inline float powT(float x, float y) { return powf(x, y); }
+static inline Half powT(Half x, Half y) { return Half(exp2f((Half(log2f(x.v)) * y).v)); }
+
+template <typename T>
+struct Vec3
+{
+    T x, y, z;
+};
+
+template <typename T>
+static inline Vec3<T> operator+(const Vec3<T>& a, const Vec3<T>& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+template <typename T>
+static inline Vec3<T> operator-(const Vec3<T>& a, const Vec3<T>& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+template <typename T>
+static inline Vec3<T> operator*(const Vec3<T>& a, const Vec3<T>& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+template <typename T>
+static inline Vec3<T> operator/(const Vec3<T>& a, const Vec3<T>& b) { return { a.x / b.x, a.y / b.y, a.z / b.z }; }
+template <typename T>
+static inline Vec3<T> splat(T s) { return { s, s, s }; }
+template <typename T>
+static inline T dot(const Vec3<T>& a, const Vec3<T>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+template <typename T>
+static inline Vec3<T> normalize(const Vec3<T>& a) { return a / splat(sqrtT(dot(a, a))); }
+template <typename T>
+static inline Vec3<T> convert(const Vec3<float>& a) { return { T(a.x), T(a.y), T(a.z) }; }
+template <typename T>
+static inline Vec3<float> toFloat(const Vec3<T>& a) { return { toFloat(a.x), toFloat(a.y), toFloat(a.z) }; }
+
+// float with the given number of explicit mantissa bits and a 5-bit exponent, no sign:
+// 6 for the red and green, 5 for the blue channel of R11F_G11F_B10F
+static float packedFloat(float x, int mantissaBits)
+{
+    if (!(x > 0.0f))
+        return 0.0f;
+    int exponent;
+    frexpf(x, &exponent);
+    // below 2^-14 the format is subnormal and the step stays constant
+    const float step = ldexpf(1.0f, max(exponent, -13) - 1 - mantissaBits);
+    const float maxValue = ldexpf(2.0f - ldexpf(1.0f, -mantissaBits), 15);
+    return min(roundf(x / step) * step, maxValue);
+}
+
+static Vec3<float> storeR11G11B10(const Vec3<float>& c)
+{
+    return { packedFloat(c.x, 6), packedFloat(c.y, 6), packedFloat(c.z, 5) };
+}
+
+class BrdfLUT
+{
+public:
+    void load(const string& path, int size)
+    {
+        ifstream bin(path, ios::ate | ios::binary);
+        if (!bin.is_open())
+            throw runtime_error("Failed to open " + path);
+        const size_t sizeInByte = sizeof(half_t) * 2 * size_t(size) * size_t(size);
+        if (static_cast<size_t>(bin.tellg()) != sizeInByte)
+            throw runtime_error(path + " is not a " + to_string(size) + "x" + to_string(size) + " half-float LUT");
+        bin.seekg(0);
+        vector<half_t> texels(2 * size_t(size) * size_t(size));
+        bin.read(reinterpret_cast<char*>(texels.data()), sizeInByte);
+
+        m_size = size;
+        m_data.resize(texels.size());
+        for (size_t i = 0; i < texels.size(); ++i)
+            m_data[i] = HalfToFloat(texels[i]);
+    }
+
+    // bilinear, clamp to edge
+    void sample(float u, float v, float& a, float& b) const
+    {
+        const float x = min(max(u * m_size - 0.5f, 0.0f), float(m_size - 1));
+        const float y = min(max(v * m_size - 0.5f, 0.0f), float(m_size - 1));
+        const int x0 = int(x), y0 = int(y);
+        const int x1 = min(x0 + 1, m_size - 1), y1 = min(y0 + 1, m_size - 1);
+        const float fx = x - x0, fy = y - y0;
+        for (int c = 0; c < 2; ++c)
+        {
+            const float top = texel(x0, y0, c) * (1.0f - fx) + texel(x1, y0, c) * fx;
+            const float bottom = texel(x0, y1, c) * (1.0f - fx) + texel(x1, y1, c) * fx;
+            (c == 0 ? a : b) = top * (1.0f - fy) + bottom * fy;
+        }
+    }
+
+private:
+    float texel(int x, int y, int c) const { return m_data[2 * (size_t(y) * m_size + x) + c]; }
+
+    int m_size = 0;
+    vector<float> m_data;
+};
+
+// inputs of one fragment, textures already sampled
+struct Fragment
+{
+    Vec3<float> albedo;
+    float metallic;
+    float roughness;
+    float ao;
+    Vec3<float> emissive;
+    Vec3<float> N;
+    Vec3<float> V;
+    Vec3<float> irradiance;
+    Vec3<float> prefiltered;
+};
+
+template <typename T>
+static Vec3<T> tonemap(Vec3<T> color)
+{
+    const T one(1.0f);
+    color = color / (color + splat(one));
+    const T gamma(1.0f / 2.2f);
+    return { powT(color.x, gamma), powT(color.y, gamma), powT(color.z, gamma) };
+}
+
+// IBL_MODE 1, LIGHT_COUNT 0 path of pbr_model.frag
+template <typename T>
+static Vec3<T> shadePbrModel(const Fragment& frag, const BrdfLUT& lut)
+{
+    const T one(1.0f);
+    const T zero(0.0f);
+    const Vec3<T> albedo = convert<T>(frag.albedo);
+    const T metallic(frag.metallic);
+    const T roughness(frag.roughness);
+    const T ao(frag.ao);
+
+    const Vec3<T> N = normalize(convert<T>(frag.N));
+    const Vec3<T> V = normalize(convert<T>(frag.V));
+    // clamp(dot(N, V), 0.0, 1.0)
+    const T NdotV = minT(maxT(dot(N, V), zero), one);
+
+    // mix(vec3(0.04), albedo, metallic)
+    const Vec3<T> F0 = splat(T(0.04f)) * splat(one - metallic) + albedo * splat(metallic);
+    const T c = one - NdotV;
+    const T fresnel = powT(c, T(5.0f));
+    const Vec3<T> headroom = splat(one - roughness) - F0;
+    const Vec3<T> F = F0 + Vec3<T>{ maxT(headroom.x, zero), maxT(headroom.y, zero), maxT(headroom.z, zero) } * splat(fresnel);
+    const Vec3<T> kD = (splat(one) - F) * splat(one - metallic);
+    const Vec3<T> diffuse = convert<T>(frag.irradiance) * albedo;
+
+    float brdfA, brdfB;
+    lut.sample(toFloat(NdotV), toFloat(one - roughness), brdfA, brdfB);
+    const Vec3<T> specular = convert<T>(frag.prefiltered) * (F * splat(T(brdfA)) + splat(T(brdfB)));
+    const Vec3<T> ambient = (kD * diffuse + specular) * splat(ao);
+
+    const T gamma(2.2f);
+    const Vec3<T> emissive = convert<T>(frag.emissive);
+    const Vec3<T> color = ambient + Vec3<T>{ powT(emissive.x, gamma), powT(emissive.y, gamma), powT(emissive.z, gamma) };
+    return tonemap(color);
+}
+
+static int toUnorm8(float value)
+{
+    return int(roundf(min(max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+struct ErrorStats
+{
+    const char* name;
+    uint64_t count = 0;
+    uint64_t histogram[4] = {};  // 0, 1, 2, more steps
+    int maxError = 0;
+    double sumError = 0.0;
+
+    void add(const Vec3<float>& reference, const Vec3<float>& result)
+    {
+        const int errors[3] = {
+            abs(toUnorm8(reference.x) - toUnorm8(result.x)),
+            abs(toUnorm8(reference.y) - toUnorm8(result.y)),
+            abs(toUnorm8(reference.z) - toUnorm8(result.z)),
+        };
+        for (int error : errors)
+        {
+            ++count;
+            ++histogram[min(error, 3)];
+            maxError = max(maxError, error);
+            sumError += error;
+        }
+    }
+
+    // percentage of channels off by more than one step
+    double outliers() const
+    {
+        return 100.0 * double(histogram[2] + histogram[3]) / double(count);
+    }
+
+    void print() const
+    {
+        const double scale = 100.0 / double(count);
+        cout << left << setw(36) << name << right << fixed << setprecision(4)
+             << " max " << maxError << "  mean " << sumError / double(count)
+             << "  =0 " << setw(8) << histogram[0] * scale << "%"
+             << "  =1 " << setw(8) << histogram[1] * scale << "%"
+             << "  =2 " << setw(8) << histogram[2] * scale << "%"
+             << "  >2 " << setw(8) << histogram[3] * scale << "%" << endl;
+    }
+};
+
+static Vec3<float> randomDirection(mt19937& rng)
+{
+    normal_distribution<float> gaussian;
+    Vec3<float> d;
+    float length;
+    do
+    {
+        d = { gaussian(rng), gaussian(rng), gaussian(rng) };
+        length = sqrtf(dot(d, d));
+    } while (length < 1e-4f);
+    return d / splat(length);
+}
+
+static Fragment randomFragment(mt19937& rng)
+{
+    uniform_int_distribution<int> unorm8(0, 255);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    auto texel = [&]() { return float(unorm8(rng)) / 255.0f; };
+    // radiance spans 20 stops around 1, channels differ by up to a factor of 3
+    auto radiance = [&]() {
+        const float luminance = exp2f(uniform(rng) * 20.0f - 10.0f);
+        return Vec3<float>{ luminance * (0.5f + uniform(rng)), luminance * (0.5f + uniform(rng)), luminance * (0.5f + uniform(rng)) };
+    };
+
+    Fragment frag;
+    frag.albedo = { texel(), texel(), texel() };
+    frag.metallic = texel();
+    frag.roughness = texel();
+    frag.ao = texel();
+    // most texels of an emissive map are black
+    frag.emissive = uniform(rng) < 0.9f ? Vec3<float>{ 0.0f, 0.0f, 0.0f } : Vec3<float>{ texel(), texel(), texel() };
+    frag.N = randomDirection(rng);
+    frag.V = randomDirection(rng);
+    // back facing fragments are culled
+    if (dot(frag.N, frag.V) < 0.0f)
+        frag.V = splat(0.0f) - frag.V;
+    frag.irradiance = radiance();
+    frag.prefiltered = radiance();
+    return frag;
+}
+
+static int parsePositive(const char* option, const char* value)
+{
+    const int result = atoi(value);
+    if (result <= 0)
+        throw runtime_error(string("Invalid value for ") + option + ": " + value);
+    return result;
+}
+
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (i + 1 >= argc)
+            throw runtime_error("Missing value for " + arg);
+
+        const char* value = argv[++i];
+        if (arg == "--samples")
+            options.samples = parsePositive("--samples", value);
+        else if (arg == "--seed")
+            options.seed = uint32_t(parsePositive("--seed", value));
+        else if (arg == "--lut")
+            options.lut = value;
+        else if (arg == "--lut-size")
+            options.lutSize = parsePositive("--lut-size", value);
+        else if (arg == "--max-outliers")
+            options.maxOutliers = atof(value);
+        else
+            throw runtime_error("Unknown option " + arg);
+    }
+
+    return options;
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+
+        BrdfLUT lut;
+        lut.load(options.lut, options.lutSize);
+
+        ErrorStats modelAlu{ "pbr_model, mediump" };
+        ErrorStats modelStorage{ "pbr_model, R11F_G11F_B10F" };
+        ErrorStats modelTier{ "pbr_model, mediump + R11F_G11F_B10F" };
+        ErrorStats backgroundTier{ "background, mediump + R11F_G11F_B10F" };
+
+        mt19937 rng(options.seed);
+        for (int i = 0; i < options.samples; ++i)
+        {
+            const Fragment frag = randomFragment(rng);
+            Fragment packed = frag;
+            packed.irradiance = storeR11G11B10(frag.irradiance);
+            packed.prefiltered = storeR11G11B10(frag.prefiltered);
+
+            const Vec3<float> reference = shadePbrModel<float>(frag, lut);
+            modelAlu.add(reference, toFloat(shadePbrModel<Half>(frag, lut)));
+            modelStorage.add(reference, shadePbrModel<float>(packed, lut));
+            modelTier.add(reference, toFloat(shadePbrModel<Half>(packed, lut)));
+
+            backgroundTier.add(tonemap(frag.prefiltered), toFloat(tonemap(convert<Half>(packed.prefiltered))));
+        }
+
+        modelAlu.print();
+        modelStorage.print();
+        modelTier.print();
+        backgroundTier.print();
+
+        if (modelTier.outliers() > options.maxOutliers || backgroundTier.outliers() > options.maxOutliers)
+        {
+            cerr << "[Error] more than " << options.maxOutliers << "% of the channels are off by more than one step" << endl;
+            return 1;
+        }
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << "[Error] " << e.what() << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Writes the mirror of the data directory the web build downloads with --asset-url, see AssetFetcher.h.
+// It holds the full and a coarse model.mesh, the material mip chains split into an inline tail and one
+// deflated chunk per finer level, the brdf lut, the hdr and its spherical harmonics ambient. The output
+// directory is served as is, e.g. as assets/ next to the page.
+//
+// usage: webAssets [--tail size] [--lod-cells N] [--kaiser] <data dir> <output dir> <model> <hdr relative to data dir>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "MeshCodec.h"
+#include "MipChain.h"
+#include "ShEnvironment.h"
+#include "Utility.h"
+#include "base/Error.h"
+#include "base/JobSystem.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct Options
+{
+    int tailSize = 128;
+    int lodCells = 48;
+    // sharper mips than the box filter the renderer builds
+    bool kaiser = false;
+    string root;
+    string output;
+    string model;
+    string hdr;
+};
+
+static Options parseOptions(int argc, const char** argv)
+{
+    Options options;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (arg == "--tail" && i + 1 < argc)
+            options.tailSize = atoi(argv[++i]);
+        else if (arg == "--lod-cells" && i + 1 < argc)
+            options.lodCells = atoi(argv[++i]);
+        else if (arg == "--kaiser")
+            options.kaiser = true;
+        else if (arg.compare(0, 2, "--") == 0)
+            throw runtime_error("Unknown option " + arg);
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.size() != 4 || options.tailSize <= 0 || options.lodCells <= 1)
+        throw runtime_error("usage: webAssets [--tail size] [--lod-cells N] [--kaiser] <data dir> <output dir> <model> <hdr>");
+    options.root = paths[0].back() == '/' ? paths[0] : paths[0] + "/";
+    options.output = paths[1].back() == '/' ? paths[1] : paths[1] + "/";
+    options.model = paths[2];
+    options.hdr = paths[3];
+    return options;
+}
+
+static uint64_t writeFile(const string& path, const vector<uint8_t>& bytes)
+{
+    fs::create_directories(fs::path(path).parent_path());
+    ofstream file(path, ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!file.good())
+        throw runtime_error("Failed to write '" + path + "'");
+    return bytes.size();
+}
+
+static uint64_t copyFile(const string& from, const string& to)
+{
+    fs::create_directories(fs::path(to).parent_path());
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing);
+    return fs::file_size(to);
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        const Options options = parseOptions(argc, argv);
+        pbr::JobSystem::GetSingleton().Initialize();
+        // what the first frame waits for and what refines it later
+        uint64_t previewBytes = 0, totalBytes = 0;
+
+        const string modelDir = "models/" + options.model + "/";
+        // the renderer culls meshlets, a raw model and the coarse one get theirs here rather than at load
+        pbr::TexturedMesh model = pbr::utility::LoadModel((options.root + modelDir).c_str());
+        if (model.meshlets.empty())
+            pbr::BuildMeshlets(model);
+        pbr::TexturedMesh lod = pbr::SimplifyMesh(model, options.lodCells);
+        pbr::BuildMeshlets(lod);
+        totalBytes += writeFile(options.output + modelDir + "model.mesh", pbr::MeshCodec::Encode(model));
+        previewBytes += writeFile(options.output + modelDir + "model.lod.mesh", pbr::MeshCodec::Encode(lod));
+        cout << modelDir << ": " << model.indices.size() << " triangles, coarse " << lod.indices.size() << endl;
+
+        const string cacheDir = "cache/textures/" + options.model + "/";
+        for (const char* map : { "AlbedoMetallic", "NormalRoughness", "EmissiveAO" })
+        {
+            const string png = options.root + modelDir + map + ".png";
+            if (!fs::exists(png))
+                continue;
+            const string path = options.output + cacheDir + map + ".mips";
+            const string unsplit = path + ".tmp";
+            fs::create_directories(fs::path(path).parent_path());
+            fs::remove(unsplit);
+            const uint32_t srgbMask = string(map) == "EmissiveAO" ? pbr::kernels::SRGB_RGB : 0;
+            pbr::MipChainFile::Build(png, unsplit, options.kaiser ? pbr::kernels::MipFilter::KAISER : pbr::kernels::MipFilter::BOX, srgbMask);
+            pbr::MipChainFile::Split(unsplit, path, options.tailSize);
+            fs::remove(unsplit);
+
+            pbr::MipChainFile chain;
+            chain.Open(path);
+            previewBytes += fs::file_size(path);
+            int chunkCount = 0;
+            for (int level = 0; level < chain.LevelCount(); ++level)
+            {
+                if (!chain.IsChunk(level))
+                    continue;
+                totalBytes += fs::file_size(chain.ChunkPath(level));
+                ++chunkCount;
+            }
+            cout << cacheDir << map << ".mips: " << chain.LevelCount() - chunkCount << " levels inline, " << chunkCount << " chunks" << endl;
+        }
+
+        totalBytes += copyFile(options.root + "preload/brdf.bin", options.output + "preload/brdf.bin");
+        // nine coefficients don't need every texel, a 512 texel wide reduction projects the same light
+        const pbr::ShEnvironment environment = pbr::ShEnvironment::Project(pbr::utility::ReadHDRImage(options.root + options.hdr, pbr::HdrFormat::FLOAT32, 512));
+        totalBytes += copyFile(options.root + options.hdr, options.output + options.hdr);
+        const string sh = options.hdr.substr(0, options.hdr.find_last_of('.')) + ".sh";
+        environment.Write(options.output + sh);
+        previewBytes += fs::file_size(options.output + sh);
+        totalBytes += previewBytes;
+
+        cout << options.output << ": " << (totalBytes >> 10) << " KB, the first frame needs " << (previewBytes >> 10) << " KB" << endl;
+        pbr::JobSystem::GetSingleton().Finalize();
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << "[Error] " << e.what() << endl;
+        return -1;
+    }
+    catch (const pbr::Exception& e)
+    {
+        cerr << "[Error] " << e << endl;
+        return -1;
+    }
+
+    return 0;
+}